@@ -0,0 +1,9 @@
+add_library(
+    stb INTERFACE
+)
+
+# Included as a system header so that its warnings do not trip -Werror.
+target_include_directories(
+    stb SYSTEM INTERFACE
+    "stb"
+)
@@ -1,8 +0,0 @@
-add_library(
-	tinyObjLoader INTERFACE
-)
-
-target_include_directories(
-	tinyObjLoader INTERFACE
-	"tinyobjloader"
-	)
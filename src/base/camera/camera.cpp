@@ -31,6 +31,52 @@ bool Camera::GetCameraRay(const Vec2f& sample, Vec3f& origin, Vec3f& direction)
 	return true;
 }
 
+bool Camera::ProjectToPixel(const Vec3f& point, Vec2f& pixel) const
+{
+	Vec2f film;
+	Vec3f filmPoint;
+	if (!FilmPoint(point - GetPosition(), film, filmPoint))
+		return false;
+
+	pixel = Vec2f((film.x + 1.f) * 0.5f * GetResolution().x, (film.y + 1.f) * 0.5f * GetResolution().y);
+
+	return true;
+}
+
+float Camera::EvalImportance(const Vec3f& direction) const
+{
+	Vec2f film;
+	Vec3f filmPoint;
+	if (!FilmPoint(direction, film, filmPoint))
+		return 0.f;
+
+	// The film spans twice the right and top vectors, which spreads over solid angle by the cube of the distance to it.
+	const float filmArea = 4.f * abs(LinearSpace3f(m_right, m_top, m_zAxis).det());
+	const float dist = length(filmPoint);
+
+	return filmArea > 0.f ? dist * dist * dist / filmArea : 0.f;
+}
+
+bool Camera::FilmPoint(const Vec3f& direction, Vec2f& film, Vec3f& filmPoint) const
+{
+	const LinearSpace3f frame(m_right, m_top, m_zAxis);
+	if (frame.det() == 0.f)
+		return false;
+
+	// The direction in terms of the vectors GetCameraRay builds its rays from.
+	const Vec3f coords = rcp(frame) * direction;
+	if (coords.z <= 0.f)
+		return false;
+
+	film = Vec2f(coords.x / coords.z, coords.y / coords.z);
+	if (film.x < -1.f || film.x >= 1.f || film.y < -1.f || film.y >= 1.f)
+		return false;
+
+	filmPoint = m_zAxis + m_right * film.x + m_top * film.y;
+
+	return true;
+}
+
 // -----------------------------------------------------
 // Mouse Callbacks
 // -----------------------------------------------------
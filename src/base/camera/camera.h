@@ -48,6 +48,13 @@ class Camera
 
 		virtual bool GetCameraRay(const Vec2f& sample, Vec3f& origin, Vec3f& direction) const;
 
+		// The pixel position the point is seen at, in the same space as the samples GetCameraRay takes.
+		// False if the point is behind the camera or outside of the film.
+		virtual bool ProjectToPixel(const Vec3f& point, Vec2f& pixel) const;
+		// The importance of a ray leaving the camera in the direction, which is the density over solid angle of
+		// GetCameraRay picking it across the whole film. Zero outside of the film.
+		virtual float EvalImportance(const Vec3f& direction) const;
+
 		// Set Methods
 		bool SetName(const std::string& name) { return name != std::exchange(m_name, name); }
 
@@ -69,12 +76,14 @@ class Camera
 		// Get Methods
 		const std::string&   GetName()                      const { return m_name;                      }
 		const Vec2f&         GetResolution()                const { return m_resolution;                }
+		const AffineSpace3f& GetAffine()                    const { return m_affine;                    }
 		const Vec3f&         GetPosition()                  const { return m_affine.p;                  }
 		const LinearSpace3f& GetRotation()                  const { return m_affine.l;                  }
 		Projection           GetProjection()                const { return m_projection;                }
 		float                GetHorizontalAperature()       const { return m_horizontalAperature;       }
 		float                GetVerticalAperature()         const { return m_verticalAperature;         }
 		float                GetHorizontalAperatureOffset() const { return m_horizontalAperatureOffset; }
+		float                GetVerticalAperatureOffset()   const { return m_verticalAperatureOffset;   }
 		float                GetFocalLength()               const { return m_focalLength;               }
 		float                GetFar()                       const { return m_far;                       }
 		float                GetClose()                     const { return m_close;                     }
@@ -86,6 +95,11 @@ class Camera
 		float GetSpeed()       const { return m_speed;      }
 		float GetSensitivity() const { return m_sensitivity; }
 
+	protected:
+		// Where the direction crosses the film, in the -1 to 1 range GetCameraRay maps the film to, and the
+		// matching point on the film plane a unit distance along the view axis. False if it misses the film.
+		bool FilmPoint(const Vec3f& direction, Vec2f& film, Vec3f& filmPoint) const;
+
 	protected:
 		std::string m_name;
 
@@ -9,4 +9,13 @@ Curve::Curve(Geometry::GeometryTypes type, const std::string& name /* = "Default
 	m_geomType = type;
 }
 
+Curve::Curve(Curve&& curve)
+	: m_points(std::move(curve.m_points))
+	, m_normals(std::move(curve.m_normals))
+	, m_widths(std::move(curve.m_widths))
+	, m_curveType(curve.m_curveType)
+{
+	MoveGeometry(std::move(curve));
+}
+
 BASE_NAMESPACE_CLOSE_SCOPE
@@ -24,6 +24,8 @@ class Curve : virtual public Geometry
 		};
 
 		Curve(Geometry::GeometryTypes type, const std::string& name = "DefaultCurve");
+		// Takes over the buffers of the given curve rather than copying them.
+		Curve(Curve&& curve);
 
 		// Get Methods
 		const std::vector<Vec3f>& GetPoints()    const { return m_points;     }
@@ -32,10 +34,15 @@ class Curve : virtual public Geometry
 		CurveTypes                GetCurveType() const { return m_curveType;  }
 
 		// Set Methods
-		bool SetPoints(const std::vector<Vec3f> points)   { return points != std::exchange(m_points, points);          }
-		bool SetNormals(const std::vector<Vec3f> normals) { return normals != std::exchange(m_normals, normals);       }
-		bool SetWidths(const std::vector<float> widths)   { return widths != std::exchange(m_widths, widths);          }
-		bool SetCurveType(CurveTypes curveType)           { return curveType != std::exchange(m_curveType, curveType); }
+		bool SetPoints(const std::vector<Vec3f>& points)   { return points != std::exchange(m_points, points);          }
+		bool SetNormals(const std::vector<Vec3f>& normals) { return normals != std::exchange(m_normals, normals);       }
+		bool SetWidths(const std::vector<float>& widths)   { return widths != std::exchange(m_widths, widths);          }
+		bool SetCurveType(CurveTypes curveType)            { return curveType != std::exchange(m_curveType, curveType); }
+
+		// Move overloads so loaders can hand their buffers over without a copy.
+		bool SetPoints(std::vector<Vec3f>&& points)        { return MoveBuffer(m_points, std::move(points));            }
+		bool SetNormals(std::vector<Vec3f>&& normals)      { return MoveBuffer(m_normals, std::move(normals));          }
+		bool SetWidths(std::vector<float>&& widths)        { return MoveBuffer(m_widths, std::move(widths));            }
 
 		bool HasVertexNormals() const { return m_normals.size() != 0; }
 
@@ -2,6 +2,7 @@
 #define GEOMETRY_H
 
 #include <utility>
+#include <vector>
 
 #include <spindulys/math/vec3.h>
 #include <spindulys/math/col3.h>
@@ -42,10 +43,36 @@ class Geometry
 		bool SetTransfrom(const AffineSpace3f& affine)  { return affine       != std::exchange(m_transform, affine);          }
 		bool SetDisplayColor(const Col3f& displayColor) { return displayColor != std::exchange(m_displayColor, displayColor); }
 		bool SetGeometryType(GeometryTypes type)        { return type         != std::exchange(m_geomType, type);             }
+		// Geometry whose points are going to be updated after it has been created.
+		bool SetDeforming(bool deforming)               { return deforming    != std::exchange(m_deforming, deforming);       }
+		// Geometry with a light attached emits light from its surface.
+		void SetLight(std::unique_ptr<Light> light)     { m_light = std::move(light);                                         }
 
 		bool IsLight() const { return (bool) m_light; }
+		bool IsDeforming() const { return m_deforming; }
 
 
+	protected:
+		// Move a buffer into place. Comparing large buffers would cost more than any update it saves,
+		// so a moved in buffer always counts as changed.
+		template<typename T>
+		static bool MoveBuffer(std::vector<T>& buffer, std::vector<T>&& value)
+		{
+			buffer = std::move(value);
+			return true;
+		}
+
+		// Geometry is inherited virtually, so derived move constructors take over its data with this.
+		void MoveGeometry(Geometry&& geom)
+		{
+			m_name = std::move(geom.m_name);
+			m_transform = geom.m_transform;
+			m_displayColor = geom.m_displayColor;
+			m_geomType = geom.m_geomType;
+			m_deforming = geom.m_deforming;
+			m_light = std::move(geom.m_light);
+		}
+
 	protected:
 		unsigned int m_geomID         = SPINDULYS_INVALID_GEOMETRY_ID;
 		unsigned int m_geomInstanceID = SPINDULYS_INVALID_GEOMETRY_ID;
@@ -54,6 +81,7 @@ class Geometry
 		AffineSpace3f m_transform = AffineSpace3f(one, zero);
 		Col3f m_displayColor = Col3f(0.5);
 		GeometryTypes m_geomType;
+		bool m_deforming = false;
 
 		std::unique_ptr<Light> m_light = nullptr;
 	private:
@@ -1,5 +1,15 @@
 #include "mesh.h"
 
+#include <cstring>
+#include <limits>
+
+#include <tbb/parallel_for.h>
+#include <tbb/parallel_sort.h>
+
+#include <spindulys/math/bbox.h>
+
+#include "../utils/hash.h"
+
 
 BASE_NAMESPACE_OPEN_SCOPE
 
@@ -9,4 +19,153 @@ Mesh::Mesh(Geometry::GeometryTypes type, const std::string& name /* = "DefaultMe
 	m_geomType = type;
 }
 
+Mesh::Mesh(Mesh&& mesh)
+	: m_points(std::move(mesh.m_points))
+	, m_normals(std::move(mesh.m_normals))
+	, m_indices(std::move(mesh.m_indices))
+	, m_packedNormals(std::move(mesh.m_packedNormals))
+	, m_type(mesh.m_type)
+	, m_compact(mesh.m_compact)
+	, m_reordered(mesh.m_reordered)
+{
+	MoveGeometry(std::move(mesh));
+}
+
+void Mesh::Compact()
+{
+	BASE_TRACE();
+	if (std::exchange(m_compact, true))
+		return;
+
+	// The points and indices are shared with the BVH, whose compact leaves read them in place and only accept
+	// float and 32 bit buffers. A quantised copy alongside them would add memory rather than save it, and leaves
+	// holding their own vertices cost more than quantising would save, so only the shading data is packed.
+	m_packedNormals.resize(m_normals.size());
+	for (size_t i = 0; i < m_normals.size(); ++i)
+		m_packedNormals[i] = oct_encode(m_normals[i]);
+
+	std::vector<Vec3f>().swap(m_normals);
+}
+
+void Mesh::OptimizeLocality()
+{
+	BASE_TRACE();
+	if (m_deforming)
+		return;
+
+	const size_t faceSize = m_type == MeshType::QuadMesh ? 4 : 3;
+	const size_t faceCount = m_indices.size() / faceSize;
+	if (faceCount < 2 || m_indices.size() != faceCount * faceSize)
+		return;
+
+	const int pointCount = static_cast<int>(m_points.size());
+	if (std::any_of(m_indices.begin(), m_indices.end(), [pointCount](int index) { return index < 0 || index >= pointCount; }))
+	{
+		spdlog::warn("Mesh {} has out of range indices, leaving it in its original order.", m_name);
+		return;
+	}
+
+	BBox3f bounds(empty);
+	for (const Vec3f& point : m_points)
+		bounds.extend(point);
+	const Vec3f extent = max(bounds.size(), Vec3f(std::numeric_limits<float>::min()));
+	const Vec3f scale = Vec3f(1023.f) / extent;
+
+	// Sorted on the code with the face index breaking ties, so the order does not depend on the sort.
+	std::vector<std::pair<uint32_t, uint32_t>> faces(faceCount);
+	tbb::parallel_for(tbb::blocked_range<size_t>(0, faceCount), [&](const tbb::blocked_range<size_t>& range)
+	{
+		for (size_t face = range.begin(); face != range.end(); ++face)
+		{
+			Vec3f centroid(zero);
+			for (size_t corner = 0; corner < faceSize; ++corner)
+				centroid += m_points[m_indices[face * faceSize + corner]];
+			const Vec3f cell = clamp((centroid / (float) faceSize - bounds.lower) * scale, Vec3f(zero), Vec3f(1023.f));
+
+			faces[face] = { morton_encode((uint32_t) cell.x, (uint32_t) cell.y, (uint32_t) cell.z), (uint32_t) face };
+		}
+	});
+	tbb::parallel_sort(faces.begin(), faces.end());
+
+	std::vector<int> indices(m_indices.size());
+	tbb::parallel_for(tbb::blocked_range<size_t>(0, faceCount), [&](const tbb::blocked_range<size_t>& range)
+	{
+		for (size_t face = range.begin(); face != range.end(); ++face)
+			std::copy_n(m_indices.begin() + faces[face].second * faceSize, faceSize, indices.begin() + face * faceSize);
+	});
+	std::vector<std::pair<uint32_t, uint32_t>>().swap(faces);
+
+	// Normals which are not one per vertex cannot follow the vertices around, so only the faces move.
+	const bool vertexNormals = (m_normals.empty() || m_normals.size() == m_points.size()) &&
+		(m_packedNormals.empty() || m_packedNormals.size() == m_points.size());
+	if (vertexNormals)
+	{
+		std::vector<int> remap(m_points.size(), -1);
+		std::vector<Vec3f> points;
+		std::vector<Vec3f> normals;
+		std::vector<uint32_t> packedNormals;
+		// Keep the padding Embree needs past the last point.
+		points.reserve(m_points.size() + 1);
+		normals.reserve(m_normals.size());
+		packedNormals.reserve(m_packedNormals.size());
+
+		for (int& index : indices)
+		{
+			int& renumbered = remap[index];
+			if (renumbered < 0)
+			{
+				renumbered = static_cast<int>(points.size());
+				points.emplace_back(m_points[index]);
+				if (!m_normals.empty())
+					normals.emplace_back(m_normals[index]);
+				if (!m_packedNormals.empty())
+					packedNormals.emplace_back(m_packedNormals[index]);
+			}
+			index = renumbered;
+		}
+
+		m_points.swap(points);
+		m_normals.swap(normals);
+		m_packedNormals.swap(packedNormals);
+	}
+
+	m_indices.swap(indices);
+	m_reordered = true;
+}
+
+uint64_t Mesh::ContentHash() const
+{
+	BASE_TRACE();
+	uint64_t hash = HashBytes(&m_type, sizeof(m_type), m_compact);
+	hash = HashBytes(m_points.data(), m_points.size() * sizeof(Vec3f), hash);
+	hash = HashBytes(m_indices.data(), m_indices.size() * sizeof(int), hash);
+	hash = HashBytes(m_normals.data(), m_normals.size() * sizeof(Vec3f), hash);
+	hash = HashBytes(m_packedNormals.data(), m_packedNormals.size() * sizeof(uint32_t), hash);
+
+	return hash;
+}
+
+bool Mesh::SameContent(const Mesh& mesh) const
+{
+	const auto sameBuffer = [](const auto& a, const auto& b)
+	{
+		return a.size() == b.size() && (a.empty() || std::memcmp(a.data(), b.data(), a.size() * sizeof(a[0])) == 0);
+	};
+
+	return m_type == mesh.m_type &&
+		m_compact == mesh.m_compact &&
+		sameBuffer(m_points, mesh.m_points) &&
+		sameBuffer(m_indices, mesh.m_indices) &&
+		sameBuffer(m_normals, mesh.m_normals) &&
+		sameBuffer(m_packedNormals, mesh.m_packedNormals);
+}
+
+size_t Mesh::BufferSize() const
+{
+	return m_points.size() * sizeof(Vec3f) +
+		m_indices.size() * sizeof(int) +
+		m_normals.size() * sizeof(Vec3f) +
+		m_packedNormals.size() * sizeof(uint32_t);
+}
+
 BASE_NAMESPACE_CLOSE_SCOPE
@@ -3,6 +3,9 @@
 
 #include <vector>
 
+#include <spindulys/math/octahedral.h>
+#include <spindulys/math/morton.h>
+
 #include "../spindulysBase.h"
 
 #include "geometry.h"
@@ -20,6 +23,8 @@ class Mesh : virtual public Geometry
 		};
 
 		Mesh(Geometry::GeometryTypes type, const std::string& name = "DefaultMesh");
+		// Takes over the buffers of the given mesh rather than copying them.
+		Mesh(Mesh&& mesh);
 
 		// Get Methods
 		const std::vector<Vec3f>& GetPoints()   const { return m_points;  }
@@ -28,20 +33,51 @@ class Mesh : virtual public Geometry
 		MeshType                  GetMeshType() const { return m_type;    }
 
 		// Set Methods
-		bool SetPoints(const std::vector<Vec3f> points)   { return points != std::exchange(m_points, points);    }
-		bool SetNormals(const std::vector<Vec3f> normals) { return normals != std::exchange(m_normals, normals); }
-		bool SetIndices(const std::vector<int> indices)   { return indices != std::exchange(m_indices, indices); }
-		bool SetMeshType(MeshType meshType)               { return meshType != std::exchange(m_type, meshType);  }
-
-		bool HasVertexNormals() const { return m_normals.size() != 0; }
+		bool SetPoints(const std::vector<Vec3f>& points)   { return points != std::exchange(m_points, points);    }
+		bool SetNormals(const std::vector<Vec3f>& normals) { return normals != std::exchange(m_normals, normals); }
+		bool SetIndices(const std::vector<int>& indices)   { return indices != std::exchange(m_indices, indices); }
+		bool SetMeshType(MeshType meshType)                { return meshType != std::exchange(m_type, meshType);  }
+
+		// Move overloads so loaders can hand their buffers over without a copy.
+		bool SetPoints(std::vector<Vec3f>&& points)        { return MoveBuffer(m_points, std::move(points));      }
+		bool SetNormals(std::vector<Vec3f>&& normals)      { return MoveBuffer(m_normals, std::move(normals));    }
+		bool SetIndices(std::vector<int>&& indices)        { return MoveBuffer(m_indices, std::move(indices));    }
+
+		bool HasVertexNormals() const { return m_normals.size() != 0 || m_packedNormals.size() != 0; }
+
+		// Switch the mesh over to its compact representation, which packs the vertex normals and has the BVH
+		// leaves index into the shared points rather than copy them. The points and indices stay full precision,
+		// since the compact leaves read them directly. Once compacted the vertex normals are only accessible
+		// through GetVertexNormal.
+		void Compact();
+		bool IsCompact() const { return m_compact; }
+
+		// Sort the faces along a Morton curve through their centroids and renumber the vertices in the order
+		// the faces first use them, so that neighbouring faces fetch neighbouring vertices. Vertices no face uses
+		// are dropped, so point updates in the original order no longer apply afterwards. Deforming meshes, whose
+		// points or normals are animated, are left in their original order.
+		void OptimizeLocality();
+		bool IsReordered() const { return m_reordered; }
+
+		// Hash of the buffers the prototype is built from, so that identical meshes can share one.
+		uint64_t ContentHash() const;
+		// Compares the buffers byte for byte, to rule out hash collisions.
+		bool SameContent(const Mesh& mesh) const;
+		size_t BufferSize() const;
 
 	protected:
 		std::vector<Vec3f> m_points;
 		std::vector<Vec3f> m_normals;
 		std::vector<int> m_indices;
 
+		// Octahedral encoded vertex normals used in place of m_normals when compact.
+		std::vector<uint32_t> m_packedNormals;
+
 		MeshType m_type = MeshType::QuadMesh;
 
+		bool m_compact = false;
+		bool m_reordered = false;
+
 	protected:
 		Vec3i GetTriangleFaceIndex(int index) const
 		{
@@ -50,7 +86,7 @@ class Mesh : virtual public Geometry
 		}
 
 		Vec3f GetVertexPosition(int index) const { return m_points[index];  }
-		Vec3f GetVertexNormal(int index)   const { return m_normals[index]; }
+		Vec3f GetVertexNormal(int index)   const { return m_compact ? oct_decode(m_packedNormals[index]) : m_normals[index]; }
 
 	private:
 
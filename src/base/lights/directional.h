@@ -15,9 +15,13 @@ BASE_NAMESPACE_OPEN_SCOPE
 class DirectionalLight : virtual public Light
 {
 	public:
-		DirectionalLight(const Col3f& irradiance = Col3f(one))
+		// Shines down the -Z axis of the transform.
+		DirectionalLight(const Col3f& irradiance = Col3f(one), const AffineSpace3f& transform = AffineSpace3f(one, zero))
 			: m_irradiance(irradiance)
-		{ m_flags = (uint32_t) LightFlags::DeltaDirection | (uint32_t) LightFlags::Infinite; }
+		{
+			m_transform = transform;
+			m_flags = (uint32_t) LightFlags::DeltaDirection | (uint32_t) LightFlags::Infinite;
+		}
 
 		virtual ~DirectionalLight() = default;
 
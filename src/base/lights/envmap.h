@@ -1 +1,46 @@
-// TODO: envmap light
+#ifndef LIGHT_ENVMAP_H
+#define LIGHT_ENVMAP_H
+
+#include <string>
+
+#include <spindulys/math/col3.h>
+
+#include "../spindulysBase.h"
+
+#include "light.h"
+
+
+BASE_NAMESPACE_OPEN_SCOPE
+
+// Environment lit by a latitude-longitude image. The top of the image is +Y and its centre looks down -Z,
+// before the transform is applied. The image is multiplied by the scale.
+class EnvmapLight : virtual public Light
+{
+	public:
+		EnvmapLight(const std::string& filepath = "", const AffineSpace3f& transform = AffineSpace3f(one, zero),
+				const Col3f& scale = Col3f(one))
+			: m_filepath(filepath), m_scale(scale)
+		{
+			m_transform = transform;
+			m_flags = (uint32_t) LightFlags::Infinite | (uint32_t) LightFlags::SpatiallyVarying;
+		}
+
+		virtual ~EnvmapLight() = default;
+
+		// Get Methods
+		const std::string& GetFilePath() const { return m_filepath; }
+		const Col3f&       GetScale()    const { return m_scale;    }
+
+		// Set Methods
+		bool SetScale(const Col3f& scale) { return scale != std::exchange(m_scale, scale); }
+
+	protected:
+		std::string m_filepath;
+		Col3f m_scale = Col3f(one);
+
+	private:
+};
+
+BASE_NAMESPACE_CLOSE_SCOPE
+
+#endif // LIGHT_ENVMAP_H
@@ -58,7 +58,7 @@ class Light
 		bool IsEnvironment() const
 		{
 			return (m_flags & (uint32_t)LightFlags::Infinite) != 0 &&
-				   (m_flags & (uint32_t)LightFlags::Infinite) == 0;
+				   (m_flags & (uint32_t)LightFlags::Delta) == 0;
 		}
 
 		// Get Methods
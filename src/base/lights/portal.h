@@ -0,0 +1,59 @@
+#ifndef LIGHT_PORTAL_H
+#define LIGHT_PORTAL_H
+
+#include <array>
+
+#include <spindulys/math/vec3.h>
+
+#include "../spindulysBase.h"
+
+#include "light.h"
+
+
+BASE_NAMESPACE_OPEN_SCOPE
+
+/* An opening, such as a window, through which the environment lights the scene. It emits nothing itself,
+	 it only guides the environment to sample the directions which pass through it. The portal is a rectangle
+	 centred in the XY plane which lets light through towards -Z, before the transform is applied. */
+class PortalLight : virtual public Light
+{
+	public:
+		PortalLight(const AffineSpace3f& transform = AffineSpace3f(one, zero), float width = 1.f, float height = 1.f)
+			: m_width(width), m_height(height)
+		{
+			m_transform = transform;
+		}
+
+		virtual ~PortalLight() = default;
+
+		// Get Methods
+		float GetWidth()  const { return m_width;  }
+		float GetHeight() const { return m_height; }
+
+		// The corners in world space, in order around the rectangle.
+		std::array<Vec3f, 4> GetCorners() const
+		{
+			const float x = 0.5f * m_width;
+			const float y = 0.5f * m_height;
+			return {
+				xfmPoint(m_transform, Vec3f(-x, -y, 0.f)),
+				xfmPoint(m_transform, Vec3f( x, -y, 0.f)),
+				xfmPoint(m_transform, Vec3f( x,  y, 0.f)),
+				xfmPoint(m_transform, Vec3f(-x,  y, 0.f)),
+			};
+		}
+
+		// Set Methods
+		bool SetWidth(float width)   { return width  != std::exchange(m_width, width);   }
+		bool SetHeight(float height) { return height != std::exchange(m_height, height); }
+
+	protected:
+		float m_width = 1.f;
+		float m_height = 1.f;
+
+	private:
+};
+
+BASE_NAMESPACE_CLOSE_SCOPE
+
+#endif // LIGHT_PORTAL_H
@@ -1,6 +1,7 @@
 #ifndef RENDER_GLOBALS_H
 #define RENDER_GLOBALS_H
 
+#include <algorithm>
 #include <unordered_set>
 
 #include <spindulys/buffer.h>
@@ -8,6 +9,8 @@
 
 #include "../spindulysBase.h"
 
+#include "../scene/sceneLoader.h"
+
 BASE_NAMESPACE_OPEN_SCOPE
 
 enum class SamplerIds
@@ -21,6 +24,17 @@ enum class IntegratorIds : uint32_t
 {
 	kDirect = 0,
 	kForwardPath,
+	kReSTIRDirect,
+	kBidirectional,
+	kLightTracer,
+	kSPPM,
+};
+
+enum class LightSamplerIds : uint32_t
+{
+	kUniform = 0,
+	kBVH,
+	kPower,
 };
 
 enum class BufferIds
@@ -55,10 +69,17 @@ struct RenderGlobals
 	// Forward Path Integrator
 	uint32_t m_maxDepth = kDefaultMaxDepth;
 	uint32_t m_russianRouletteDepth = kDefaultRussianRouletteDepth;
+	bool m_pathGuiding = kDefaultPathGuiding;
+
+	// ReSTIR Direct Integrator
+	uint32_t m_lightCandidates = kDefaultLightCandidates;
 
 	// Samplers - sampling method to use.
 	SamplerIds m_samplerId = SamplerIds::kIndependent;
 
+	// How lights are picked for next event estimation.
+	LightSamplerIds m_lightSamplerId = LightSamplerIds::kBVH;
+
 	// Buffers
 	BufferIds m_bufferID = BufferIds::kBeauty;
 	std::unordered_set<BufferIds> m_currentBufferIds = { BufferIds::kBeauty };
@@ -67,6 +88,19 @@ struct RenderGlobals
 	bool m_scaleResolution = kDefaultScaleResolution;
 	float m_growSize = kDefaultGrowSize;
 
+	// Geometry
+	bool m_compactGeometry = kDefaultCompactGeometry;
+	bool m_smoothNormals = kDefaultSmoothNormals;
+	bool m_optimizeLocality = kDefaultOptimizeLocality;
+	bool m_sceneCache = kDefaultSceneCache;
+
+	// Scene Loading
+	SceneLoadOptions m_sceneLoadOptions;
+
+	// Animation
+	float m_frame = kDefaultFrame;
+	bool m_playback = kDefaultPlayback;
+
 	// ----------------------- Set Methods -----------------------
 	// Return true if the class parameter was changed.
 	bool SetWidth(uint32_t width)                  { return width         != std::exchange(m_width, width);                       }
@@ -89,14 +123,27 @@ struct RenderGlobals
 
 	bool SetMaxDepth(uint32_t maxDepth)
 	{
-		return maxDepth != std::exchange(m_maxDepth, maxDepth) && m_integratorID == IntegratorIds::kForwardPath;
+		return maxDepth != std::exchange(m_maxDepth, maxDepth) &&
+			(m_integratorID == IntegratorIds::kForwardPath || m_integratorID == IntegratorIds::kBidirectional ||
+			 m_integratorID == IntegratorIds::kLightTracer || m_integratorID == IntegratorIds::kSPPM);
 	}
 	bool SetRussianRouletteDepth(uint32_t rrDepth)
 	{
 		return rrDepth != std::exchange(m_russianRouletteDepth, rrDepth) && m_integratorID == IntegratorIds::kForwardPath;
 	}
+	bool SetPathGuiding(bool pathGuiding)
+	{
+		return pathGuiding != std::exchange(m_pathGuiding, pathGuiding) && m_integratorID == IntegratorIds::kForwardPath;
+	}
+
+	bool SetLightCandidates(uint32_t candidates)
+	{
+		candidates = std::clamp(candidates, 1u, kMaxLightCandidates);
+		return candidates != std::exchange(m_lightCandidates, candidates) && m_integratorID == IntegratorIds::kReSTIRDirect;
+	}
 
 	bool SetSampler(SamplerIds samplerId) { return samplerId != std::exchange(m_samplerId, samplerId); }
+	bool SetLightSampler(LightSamplerIds lightSamplerId) { return lightSamplerId != std::exchange(m_lightSamplerId, lightSamplerId); }
 
 	bool SetCurrentBuffer(BufferIds bufferID) { return bufferID != std::exchange(m_bufferID, bufferID); }
 	bool AddBuffer(BufferIds bufferID)
@@ -124,6 +171,23 @@ struct RenderGlobals
 	bool SetScaleResolution(bool scaleResolution)  { return scaleResolution != std::exchange(m_scaleResolution, scaleResolution);        }
 	bool SetGrowSize(float growSize)               { return growSize        != std::exchange(m_growSize, growSize) && m_scaleResolution; }
 
+	bool SetCompactGeometry(bool compact)          { return compact         != std::exchange(m_compactGeometry, compact);                }
+	bool SetSmoothNormals(bool smoothNormals)      { return smoothNormals   != std::exchange(m_smoothNormals, smoothNormals);            }
+	bool SetOptimizeLocality(bool optimize)        { return optimize        != std::exchange(m_optimizeLocality, optimize);              }
+	bool SetSceneCache(bool sceneCache)            { return sceneCache      != std::exchange(m_sceneCache, sceneCache);                  }
+
+	bool SetRenderPurposeOnly(bool renderOnly)     { return renderOnly      != std::exchange(m_sceneLoadOptions.m_renderPurposeOnly, renderOnly); }
+	bool SetSkipInvisible(bool skipInvisible)      { return skipInvisible   != std::exchange(m_sceneLoadOptions.m_skipInvisible, skipInvisible);  }
+	bool SetLoadPayloads(bool loadPayloads)        { return loadPayloads    != std::exchange(m_sceneLoadOptions.m_loadPayloads, loadPayloads);    }
+	bool SetPopulationMask(const std::vector<std::string>& mask)
+	{
+		return mask != std::exchange(m_sceneLoadOptions.m_populationMask, mask);
+	}
+	void SetSceneLoadOptions(const SceneLoadOptions& options) { m_sceneLoadOptions = options; }
+
+	bool SetFrame(float frame)                     { return frame           != std::exchange(m_frame, frame);                            }
+	bool SetPlayback(bool playback)                { return playback        != std::exchange(m_playback, playback);                      }
+
 	// ----------------------- Get Methods -----------------------
 	uint32_t                             GetWidth()                const { return m_width;                }
 	uint32_t                             GetHeight()               const { return m_height;               }
@@ -139,14 +203,27 @@ struct RenderGlobals
 
 	uint32_t                             GetMaxDepth()             const { return m_maxDepth;             }
 	uint32_t                             GetRussianRouletteDepth() const { return m_russianRouletteDepth; }
+	bool                                 GetPathGuiding()          const { return m_pathGuiding;          }
+
+	uint32_t                             GetLightCandidates()      const { return m_lightCandidates;      }
 
 	SamplerIds                           GetSampler()              const { return m_samplerId;            }
+	LightSamplerIds                      GetLightSampler()         const { return m_lightSamplerId;       }
 
 	BufferIds                            GetBufferID()             const { return m_bufferID;             }
 	const std::unordered_set<BufferIds>& GetCurrentBufferIds()     const { return m_currentBufferIds;     }
 
 	bool                                 GetScaleResolution()      const { return m_scaleResolution;      }
 	float                                GetGrowSize()             const { return m_growSize;             }
+
+	bool                                 GetCompactGeometry()      const { return m_compactGeometry;      }
+	bool                                 GetSmoothNormals()        const { return m_smoothNormals;        }
+	bool                                 GetOptimizeLocality()     const { return m_optimizeLocality;     }
+	bool                                 GetSceneCache()           const { return m_sceneCache;           }
+	const SceneLoadOptions&              GetSceneLoadOptions()     const { return m_sceneLoadOptions;     }
+
+	float                                GetFrame()                const { return m_frame;                }
+	bool                                 GetPlayback()             const { return m_playback;             }
 };
 
 BASE_NAMESPACE_CLOSE_SCOPE
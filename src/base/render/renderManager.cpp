@@ -6,7 +6,10 @@
 #include <tbb/blocked_range3d.h>
 #include <tbb/parallel_for.h>
 #include <tbb/parallel_for_each.h>
+#include <tbb/task_arena.h>
+#include <tbb/task_group.h>
 
+#include "../scene/sceneCache.h"
 #include "../scene/objTranslators/objSceneLoader.h"
 
 #ifdef USING_USD
@@ -25,13 +28,45 @@ RenderManager::RenderManager()
 RenderManager::~RenderManager()
 {
 	BASE_TRACE();
+	if (m_loadThread.joinable())
+		m_loadThread.join();
+
 	delete m_scene;
 
 	for (const auto& bufferID : m_renderGlobals.GetCurrentBufferIds())
 		delete m_buffers[bufferID];
 }
 
-bool RenderManager::ImportScene(const std::string& filepath)
+bool RenderManager::ImportScenes(const std::vector<std::string>& filepaths)
+{
+	BASE_TRACE();
+	// Loaders only queue up what they create while the scene is streaming, so the files can be imported at
+	// the same time without committing the scene under each other. Background loads are already streaming
+	// and get committed on the render thread.
+	const bool streaming = m_scene->IsStreaming();
+	m_scene->SetStreaming(true);
+
+	std::atomic<bool> imported = true;
+	tbb::parallel_for_each(filepaths.begin(), filepaths.end(), [&](const std::string& filepath)
+	{
+		if (!ImportFile(filepath))
+		{
+			spdlog::error("Could not load {}.", filepath);
+			imported = false;
+		}
+	});
+
+	if (!streaming)
+	{
+		m_scene->SetStreaming(false);
+		m_scene->CommitPending();
+		m_scene->CommitScene();
+	}
+
+	return imported;
+}
+
+bool RenderManager::ImportFile(const std::string& filepath)
 {
 	BASE_TRACE();
 	if (filepath.empty())
@@ -42,16 +77,29 @@ bool RenderManager::ImportScene(const std::string& filepath)
 
 	const std::string ext = std::filesystem::path(filepath).extension();
 
-	bool sceneLoaded = false;
-	if (ext == ".obj")
+	// Try the cache first and otherwise record what the loaders create into a new one.
+	const bool useCache = m_renderGlobals.GetSceneCache();
+	const SceneLoadOptions& options = m_renderGlobals.GetSceneLoadOptions();
+	bool sceneLoaded = useCache && SceneCache::Load(filepath, options, m_scene);
+
+	SceneCache cache;
+	SceneRecorder* recorder = useCache && !sceneLoaded && cache.BeginWrite(filepath, options) ? &cache : nullptr;
+
+	if (sceneLoaded)
+	{
+		spdlog::info("Loaded {} from the scene cache.", filepath);
+	}
+	else if (ext == ".obj")
 	{
-		ObjSceneLoader loader(m_scene);
+		ObjSceneLoader loader(m_scene, options);
+		loader.SetRecorder(recorder);
 		sceneLoaded = loader.LoadScene(filepath);
 	}
 #ifdef USING_USD
 	else if (ext == ".usd" || ext == ".usda" || ext == ".usdc" || ext == ".usdz")
 	{
-		UsdSceneLoader loader(m_scene);
+		UsdSceneLoader loader(m_scene, options);
+		loader.SetRecorder(recorder);
 		sceneLoaded = loader.LoadScene(filepath);
 	}
 #endif
@@ -60,6 +108,18 @@ bool RenderManager::ImportScene(const std::string& filepath)
 		spdlog::warn("Unsupported filetype: {}", ext);
 	}
 
+	cache.EndWrite(sceneLoaded);
+
+	return sceneLoaded;
+}
+
+bool RenderManager::LoadScene(const std::vector<std::string>& filepaths)
+{
+	BASE_TRACE();
+	m_scene->ResetScene();
+
+	const bool sceneLoaded = ImportScenes(filepaths);
+
 	// Scene must have at least one light
 	if (m_scene->NumLights() < 1)
 	{
@@ -67,20 +127,122 @@ bool RenderManager::ImportScene(const std::string& filepath)
 		m_scene->CreateDefaultLight();
 	}
 
+	if (m_scene->GetSceneCameras().empty())
+		m_scene->CreateDefaultCamera();
+
+	m_scene->CommitScene();
+	SceneLoaded();
+
 	return sceneLoaded;
 }
 
-void RenderManager::LoadScene(const std::string& filepath)
+void RenderManager::LoadSceneAsync(const std::vector<std::string>& filepaths)
 {
 	BASE_TRACE();
-	m_scene->ResetScene();
+	const std::lock_guard<std::mutex> lock(m_loadMutex);
+	m_pendingLoad = PendingLoad{ filepaths, true };
+}
 
-	ImportScene(filepath);
+void RenderManager::ImportScenesAsync(const std::vector<std::string>& filepaths)
+{
+	BASE_TRACE();
+	// Added to a load which has not started yet rather than replacing it.
+	const std::lock_guard<std::mutex> lock(m_loadMutex);
+	if (!m_pendingLoad)
+		m_pendingLoad = PendingLoad();
+	m_pendingLoad->filepaths.insert(m_pendingLoad->filepaths.end(), filepaths.begin(), filepaths.end());
+}
 
-	if (m_scene->GetSceneCameras().empty())
-		m_scene->CreateDefaultCamera();
+void RenderManager::UpdateLoading()
+{
+	std::optional<PendingLoad> load;
+	{
+		const std::lock_guard<std::mutex> lock(m_loadMutex);
+		load.swap(m_pendingLoad);
+	}
+
+	if (load)
+		StartLoading(*load);
+
+	if (!m_loading)
+		return;
+
+	if (m_loadFinished)
+	{
+		FinishLoading();
+		return;
+	}
+
+	// Streamed geometry restarts the render, so it is only added in batches.
+	const auto now = std::chrono::steady_clock::now();
+	if (now - m_lastStreamCommit < std::chrono::milliseconds(kStreamCommitInterval))
+		return;
+
+	m_lastStreamCommit = now;
+	if (m_scene->CommitPending())
+		m_update = true;
+}
+
+void RenderManager::StartLoading(const PendingLoad& load)
+{
+	BASE_TRACE();
+	// A load which is still running has to finish before its scene can be reset or another load can start.
+	// Whatever it streamed in is committed along with the next load.
+	if (m_loadThread.joinable())
+		m_loadThread.join();
 
+	if (load.reset)
+	{
+		m_scene->SetStreaming(false);
+		m_scene->ResetScene();
+
+		// Something to render with while the scene streams in.
+		m_scene->CreatePlaceholderCamera();
+		if (m_scene->NumLights() < 1)
+			m_scene->CreateDefaultLight();
+		m_scene->CommitScene();
+	}
+
+	m_scene->SetStreaming(true);
+	m_loading = true;
+	m_loadFinished = false;
+	m_lastStreamCommit = std::chrono::steady_clock::now();
+	m_update = true;
+
+	m_loadThread = std::thread([this, filepaths = load.filepaths]
+	{
+		ImportScenes(filepaths);
+		m_loadFinished = true;
+	});
+}
+
+void RenderManager::FinishLoading()
+{
+	BASE_TRACE();
+	m_loadThread.join();
+
+	m_scene->SetStreaming(false);
+	m_scene->CommitPending();
 	m_scene->CommitScene();
+	SceneLoaded();
+
+	m_loading = false;
+	m_update = true;
+}
+
+void RenderManager::SceneLoaded()
+{
+	BASE_TRACE();
+	m_scene->ReportLoad();
+
+	// Animated scenes are loaded at their start time, so only move them if another frame is wanted.
+	m_frameDirty = false;
+	if (m_scene->IsAnimated())
+	{
+		const float startTime = m_scene->GetStartTime();
+		m_renderGlobals.SetFrame(clamp(m_renderGlobals.GetFrame(), startTime, (float) m_scene->GetEndTime()));
+		m_frameDirty = m_renderGlobals.GetFrame() != startTime;
+	}
 }
 
 const std::string_view RenderManager::ValidSceneFormats()
@@ -104,6 +266,21 @@ void RenderManager::Render()
 		if (m_updateRendererFunction)
 			m_updateRendererFunction();
 
+		UpdateLoading();
+
+		if (m_scene->ApplyChanges())
+			m_update = true;
+
+		if (m_renderGlobals.GetPlayback() && m_scene->IsAnimated() && m_iterations >= m_renderGlobals.GetMaxIterations())
+			AdvanceFrame();
+
+		if (m_frameDirty)
+		{
+			m_frameDirty = false;
+			if (m_scene->SetTime(m_renderGlobals.GetFrame()))
+				m_update = true;
+		}
+
 		if (m_update)
 			ResetRender();
 
@@ -121,16 +298,11 @@ void RenderManager::Render()
 		if (m_iterations < m_renderGlobals.GetMaxIterations())
 		{
 			arena.execute( [&] {
-			tbb::parallel_for(tbb::blocked_range<int>(0, m_currentResolution.y), [&](tbb::blocked_range<int> heightRange)
-			{
-				Trace(m_iterations, heightRange.begin(), heightRange.end());
-				m_sampler->Advance();
-			});
+			TraceIteration();
 			const std::lock_guard<std::mutex> lock(GetLock());
 			if (m_updateBufferFunction)
 				m_updateBufferFunction(*(m_buffers[m_renderGlobals.GetBufferID()]));
 			} );
-			++m_iterations;
 		}
 
 		if (m_drawBufferFunction)
@@ -138,6 +310,60 @@ void RenderManager::Render()
 	}
 }
 
+void RenderManager::RenderFrames(const std::vector<float>& frames, FrameDone frameDone)
+{
+	BASE_TRACE();
+
+	// Reading the next frame is mostly waiting on USD, so it gets a small arena of its own
+	// rather than competing with tracing for the whole thread pool.
+	tbb::task_arena traceArena;
+	tbb::task_arena prepareArena(std::max(1, tbb::this_task_arena::max_concurrency() / 4));
+	tbb::task_group prepareGroup;
+
+	for (size_t frameIdx = 0; frameIdx < frames.size(); ++frameIdx)
+	{
+		if (m_stopRendererFunction())
+			break;
+
+		// Applying the frame refits the prototypes the previous frame was traced against, so it cannot overlap.
+		const float frame = frames[frameIdx];
+		if (m_scene->IsAnimated())
+			m_scene->SetTime(frame);
+		m_renderGlobals.SetFrame(frame);
+		m_frameDirty = false;
+		ResetRender();
+
+		if (m_scene->IsAnimated() && frameIdx + 1 < frames.size())
+		{
+			const float nextFrame = frames[frameIdx + 1];
+			prepareArena.execute([&] { prepareGroup.run([this, nextFrame] { m_scene->PrepareTime(nextFrame); }); });
+		}
+
+		traceArena.execute([&]
+		{
+			while (m_iterations < m_renderGlobals.GetMaxIterations() && !m_stopRendererFunction())
+				TraceIteration();
+		});
+
+		prepareArena.execute([&] { prepareGroup.wait(); });
+
+		if (frameDone)
+			frameDone(frame, *(m_buffers[m_renderGlobals.GetBufferID()]));
+	}
+}
+
+void RenderManager::TraceIteration()
+{
+	IterationStarted();
+	tbb::parallel_for(tbb::blocked_range<int>(0, m_currentResolution.y), [&](tbb::blocked_range<int> heightRange)
+	{
+		Trace(m_iterations, heightRange.begin(), heightRange.end());
+		m_sampler->Advance();
+	});
+	IterationFinished();
+	++m_iterations;
+}
+
 void RenderManager::ResetRender()
 {
 	BASE_TRACE();
@@ -149,10 +375,21 @@ void RenderManager::ResetRender()
 	for (const auto& bufferID : m_renderGlobals.GetCurrentBufferIds())
 		m_buffers[bufferID]->Clean(m_currentResolution.x, m_currentResolution.y);
 	GetCamera().SetResolution(Vec2f(m_currentResolution.x, m_currentResolution.y));
+	RenderReset();
 
 	m_update = false;
 }
 
+void RenderManager::AdvanceFrame()
+{
+	BASE_TRACE();
+	float frame = m_renderGlobals.GetFrame() + 1.f;
+	if (frame > m_scene->GetEndTime())
+		frame = m_scene->GetStartTime();
+
+	SetFrame(frame);
+}
+
 bool RenderManager::AddBuffer(BufferIds bufferID)
 {
 	BASE_TRACE();
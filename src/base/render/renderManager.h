@@ -1,7 +1,11 @@
 #ifndef RENDER_MANAGER_H
 #define RENDER_MANAGER_H
 
+#include <atomic>
+#include <chrono>
 #include <memory>
+#include <optional>
+#include <thread>
 #include <vector>
 #include <unordered_map>
 #include <unordered_set>
@@ -31,14 +35,26 @@ class RenderManager
 		using RegisterUpdates = std::function<bool(void)>;
 		using DrawBuffer = std::function<void(int, int, const Buffer3f&)>;
 		using UpdateBuffer = std::function<void(const Buffer3f&)>;
+		using FrameDone = std::function<void(float, const Buffer3f&)>;
 
 		using Buffers = std::unordered_map<BufferIds, Buffer3f*>;
 
 		RenderManager();
 		virtual ~RenderManager();
 
-		bool ImportScene(const std::string& filepath);
-		void LoadScene(const std::string& filepath);
+		// Import the files alongside what is already loaded. The files are imported concurrently and
+		// the scene is committed once they are all in. Returns false if any of them failed to load.
+		bool ImportScenes(const std::vector<std::string>& filepaths);
+		bool ImportScene(const std::string& filepath) { return ImportScenes({ filepath }); }
+		// Replace the scene with the given files.
+		bool LoadScene(const std::vector<std::string>& filepaths);
+		// Load the scene on a background thread, rendering what has been loaded so far while it streams in.
+		// Can be called from any thread, the load starts at the beginning of the next render iteration.
+		void LoadSceneAsync(const std::vector<std::string>& filepaths);
+		// Stream the files into the scene alongside what is already loaded.
+		void ImportScenesAsync(const std::vector<std::string>& filepaths);
+		bool IsLoading() const { return m_loading; }
+		float GetLoadProgress() const { return m_scene->GetLoadProgress(); }
 		// TODO: Find out a way to make this work with constexpr.
 		static const std::string_view ValidSceneFormats();
 
@@ -51,7 +67,12 @@ class RenderManager
 		bool RenderDirty() const { return (m_update || m_scene->SceneDirty()); }
 
 		void Render();
+		// Render each frame to max iterations without any interaction, calling frameDone once each has finished.
+		// The next frame's animation is read while the current one is traced.
+		void RenderFrames(const std::vector<float>& frames, FrameDone frameDone);
 		void ResetRender();
+		// Move on to the next frame, wrapping around at the end of the animation.
+		void AdvanceFrame();
 		virtual void Trace(int iterations, size_t heightBegin, size_t heightEnd) = 0;
 
 		// Set Methods - return true if the class parameter was changed.
@@ -61,6 +82,38 @@ class RenderManager
 		bool SetScaleResolution(bool scaleResolution)  { return m_renderGlobals.SetScaleResolution(scaleResolution); }
 		bool SetGrowSize(float growSize)               { return m_renderGlobals.SetGrowSize(growSize);               }
 		bool SetCurrentCamera(size_t cameraId)         { return m_scene->SetSceneCamera(cameraId);                   }
+		// Only affects geometry loaded after it is set.
+		bool SetCompactGeometry(bool compact)
+		{
+			m_scene->SetCompactGeometry(compact);
+			return m_renderGlobals.SetCompactGeometry(compact);
+		}
+		// Only affects geometry loaded after it is set.
+		bool SetSmoothNormals(bool smoothNormals)
+		{
+			m_scene->SetSmoothNormals(smoothNormals);
+			return m_renderGlobals.SetSmoothNormals(smoothNormals);
+		}
+		// Only affects geometry loaded after it is set.
+		bool SetOptimizeLocality(bool optimize)
+		{
+			m_scene->SetOptimizeLocality(optimize);
+			return m_renderGlobals.SetOptimizeLocality(optimize);
+		}
+		bool SetSceneCache(bool sceneCache)            { return m_renderGlobals.SetSceneCache(sceneCache);           }
+		// Only affects scenes loaded after they are set.
+		void SetSceneLoadOptions(const SceneLoadOptions& options) { m_renderGlobals.SetSceneLoadOptions(options); }
+		// The scene is moved to the new frame at the start of the next render iteration.
+		bool SetFrame(float frame)
+		{
+			if (!m_renderGlobals.SetFrame(frame))
+				return false;
+
+			m_frameDirty = true;
+			return true;
+		}
+		// Steps through the frames of an animated scene once each frame has finished rendering.
+		bool SetPlayback(bool playback)                { return m_renderGlobals.SetPlayback(playback);               }
 
 		// Variant render manager will set the correct integrator parts.
 		virtual bool SetIntegrator(IntegratorIds integratorID) { return m_renderGlobals.SetIntegrator(integratorID);    }
@@ -69,6 +122,9 @@ class RenderManager
 		virtual bool SetMaxBSDFSamples(uint32_t samples)       { return m_renderGlobals.SetMaxBSDFSamples(samples);     }
 		virtual bool SetMaxDepth(uint32_t maxDepth)            { return m_renderGlobals.SetMaxDepth(maxDepth);          }
 		virtual bool SetRussianRouletteDepth(uint32_t depth)   { return m_renderGlobals.SetRussianRouletteDepth(depth); }
+		virtual bool SetPathGuiding(bool pathGuiding)          { return m_renderGlobals.SetPathGuiding(pathGuiding);    }
+		virtual bool SetLightCandidates(uint32_t candidates)   { return m_renderGlobals.SetLightCandidates(candidates); }
+		virtual bool SetLightSampler(LightSamplerIds lightSamplerID) { return m_renderGlobals.SetLightSampler(lightSamplerID); }
 
 		// Unique Set/Add/Remove method that also returns true if class parameter was changed
 		bool SetSampler(SamplerIds samplerID);
@@ -84,7 +140,10 @@ class RenderManager
 		int             GetHeight()          const { return m_currentResolution.y;                          }
 		IntegratorIds   GetIntegrator()      const { return m_renderGlobals.GetIntegrator();                }
 		SamplerIds      GetSampler()         const { return m_renderGlobals.GetSampler();                   }
+		LightSamplerIds GetLightSampler()    const { return m_renderGlobals.GetLightSampler();              }
 		bool            GetScaleResolution() const { return m_renderGlobals.GetScaleResolution();           }
+		float           GetFrame()           const { return m_renderGlobals.GetFrame();                     }
+		bool            GetPlayback()        const { return m_renderGlobals.GetPlayback();                  }
 		const Buffer3f& GetBuffer()          const { return *(m_buffers.at(m_renderGlobals.GetBufferID())); }
 		const Buffers&  GetBuffers()         const { return m_buffers;                                      }
 		const Scene*    GetScene()           const { return m_scene;                                        }
@@ -93,6 +152,29 @@ class RenderManager
 		// TODO: Tidy the camera handling.
 		Camera& GetCamera() { return m_scene->UpdateSceneCamera(); }
 
+	protected:
+		// Files queued to load in the background, replacing the scene first if reset is set.
+		struct PendingLoad
+		{
+			std::vector<std::string> filepaths;
+			bool reset = false;
+		};
+
+		void TraceIteration();
+		// Variant render managers can hook into either side of every iteration and render reset.
+		virtual void IterationStarted() {}
+		virtual void IterationFinished() {}
+		virtual void RenderReset() {}
+
+		bool ImportFile(const std::string& filepath);
+
+		// Called at the start of every render iteration to start, stream in and finish background loads.
+		void UpdateLoading();
+		void StartLoading(const PendingLoad& load);
+		void FinishLoading();
+		// Everything after importing which LoadScene and LoadSceneAsync share.
+		void SceneLoaded();
+
 	protected:
 		// Render Info
 		uint32_t m_iterations = 1;
@@ -111,6 +193,7 @@ class RenderManager
 		std::unique_ptr<Sampler> m_sampler = std::make_unique<IndependentSampler>();
 
 		bool m_update = false;
+		bool m_frameDirty = false;
 
 		// Callback functions.
 		StopRenderer m_stopRendererFunction = [] { return false; };
@@ -120,6 +203,14 @@ class RenderManager
 
 		mutable std::mutex m_renderMutex;
 
+		// Background loading
+		std::thread m_loadThread;
+		std::mutex m_loadMutex;
+		std::optional<PendingLoad> m_pendingLoad;
+		std::atomic<bool> m_loading = false;
+		std::atomic<bool> m_loadFinished = false;
+		std::chrono::steady_clock::time_point m_lastStreamCommit;
+
 	private:
 };
 
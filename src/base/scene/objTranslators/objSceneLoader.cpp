@@ -1,59 +1,352 @@
-#define TINYOBJLOADER_IMPLEMENTATION
-
 #include "objSceneLoader.h"
 
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <algorithm>
+#include <unordered_map>
+
+#include <tbb/parallel_for.h>
+#include <tbb/parallel_for_each.h>
+
 #include "../../geometry/mesh.h"
+#include "../../utils/mappedFile.h"
 
 BASE_NAMESPACE_OPEN_SCOPE
 
+// Files are split into chunks of roughly this many bytes which are parsed in parallel.
+static constexpr size_t kObjChunkSize = 1 << 22;
+
+static inline bool IsSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+static inline bool IsDigit(char c) { return c >= '0' && c <= '9'; }
+
+static inline const char* SkipSpace(const char* it, const char* end)
+{
+	while (it < end && IsSpace(*it))
+		++it;
+	return it;
+}
+
+static inline const char* FindLineEnd(const char* it, const char* end)
+{
+	const char* lineEnd = static_cast<const char*>(std::memchr(it, '\n', end - it));
+	return lineEnd ? lineEnd : end;
+}
+
+static inline double Pow10(int exponent)
+{
+	// Powers of ten that are exactly representable as doubles.
+	static constexpr double kPow10[] =
+	{
+		1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+	};
+	return exponent <= 22 ? kPow10[exponent] : std::pow(10.0, exponent);
+}
+
+static const char* ParseInt(const char* it, const char* end, int& value)
+{
+	bool negative = false;
+	if (it < end && (*it == '-' || *it == '+'))
+		negative = *it++ == '-';
+
+	value = 0;
+	while (it < end && IsDigit(*it))
+		value = value * 10 + (*it++ - '0');
+
+	value = negative ? -value : value;
+	return it;
+}
+
+// Locale independent float parsing which does not rely on the input being null terminated.
+static const char* ParseFloat(const char* it, const char* end, float& value)
+{
+	bool negative = false;
+	if (it < end && (*it == '-' || *it == '+'))
+		negative = *it++ == '-';
+
+	// Accumulate up to 19 significant digits as an integer and track the decimal exponent.
+	uint64_t mantissa = 0;
+	int digits = 0;
+	int exponent = 0;
+	for (; it < end && IsDigit(*it); ++it)
+	{
+		if (digits < 19)
+		{
+			mantissa = mantissa * 10 + (*it - '0');
+			digits += mantissa != 0;
+		}
+		else
+			++exponent;
+	}
+
+	if (it < end && *it == '.')
+	{
+		for (++it; it < end && IsDigit(*it); ++it)
+		{
+			if (digits < 19)
+			{
+				mantissa = mantissa * 10 + (*it - '0');
+				digits += mantissa != 0;
+				--exponent;
+			}
+		}
+	}
+
+	if (it < end && (*it == 'e' || *it == 'E'))
+	{
+		int e = 0;
+		it = ParseInt(it + 1, end, e);
+		exponent += e;
+	}
+
+	double result = static_cast<double>(mantissa);
+	result = exponent < 0 ? result / Pow10(-exponent) : result * Pow10(exponent);
+
+	value = static_cast<float>(negative ? -result : result);
+	return it;
+}
+
+void ObjSceneLoader::ParseChunk(ObjChunk& chunk)
+{
+	BASE_TRACE();
+	const char* it = chunk.begin;
+	const char* end = chunk.end;
+
+	chunk.groups.emplace_back();
+	chunk.groups.back().continued = true;
+
+	// Face vertex indices of the current line before triangulation.
+	std::vector<int> face;
+
+	while (it < end)
+	{
+		it = SkipSpace(it, end);
+		const char* lineEnd = FindLineEnd(it, end);
+
+		if (lineEnd - it < 2 || !IsSpace(it[1]))
+		{
+			// Blank lines, comments and multi letter statements such as vt, vn, usemtl and mtllib are not used.
+		}
+		else if (it[0] == 'v')
+		{
+			Vec3f vertex(zero);
+			const char* token = it + 1;
+			for (int i = 0; i < 3; ++i)
+				token = ParseFloat(SkipSpace(token, lineEnd), lineEnd, vertex[i]);
+
+			chunk.vertices.emplace_back(vertex);
+		}
+		else if (it[0] == 'f')
+		{
+			const int vertexCount = static_cast<int>(chunk.vertexOffset + chunk.vertices.size());
+
+			face.clear();
+			const char* token = SkipSpace(it + 1, lineEnd);
+			while (token < lineEnd)
+			{
+				int index = 0;
+				token = ParseInt(token, lineEnd, index);
+
+				// OBJ indices are one based, negative indices are relative to the last vertex read.
+				if (index > 0)
+					face.emplace_back(index - 1);
+				else if (index < 0)
+					face.emplace_back(vertexCount + index);
+				else
+					chunk.invalidFaces = true;
+
+				// Texture coordinate and normal indices are skipped.
+				while (token < lineEnd && !IsSpace(*token))
+					++token;
+				token = SkipSpace(token, lineEnd);
+			}
+
+			if (face.size() < 3)
+			{
+				chunk.invalidFaces = true;
+			}
+			else
+			{
+				std::vector<int>& indices = chunk.groups.back().indices;
+				for (size_t i = 1; i + 1 < face.size(); ++i)
+				{
+					indices.emplace_back(face[0]);
+					indices.emplace_back(face[i]);
+					indices.emplace_back(face[i + 1]);
+				}
+			}
+		}
+		else if (it[0] == 'o' || it[0] == 'g')
+		{
+			const char* nameBegin = SkipSpace(it + 1, lineEnd);
+			const char* nameEnd = lineEnd;
+			while (nameEnd > nameBegin && IsSpace(nameEnd[-1]))
+				--nameEnd;
+
+			chunk.groups.emplace_back();
+			chunk.groups.back().name.assign(nameBegin, nameEnd);
+		}
+
+		it = lineEnd + 1;
+	}
+}
+
 bool ObjSceneLoader::LoadScene(const std::string& filepath)
 {
 	BASE_TRACE();
 	// We assume that the incoming file is a valid obj file
 
+	MappedFile file;
+	if (!file.Open(filepath))
+	{
+		spdlog::error("Could not open {}.", filepath);
+		return false;
+	}
+
 	m_scene->AddFilePath(filepath);
 
-	tinyobj::attrib_t attrib;
-	std::vector<tinyobj::shape_t> shapes;
-	std::vector<tinyobj::material_t> materials;
-	std::string warn;
-	std::string err;
-	bool ret = tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, filepath.c_str(),
-			NULL, /* triangulate = */ true);
+	const char* data = file.GetData();
+	const size_t size = file.GetSize();
 
-	if (!ret)
-		return false;
+	// Split the file into chunks, with each boundary moved forward to the start of the next line.
+	std::vector<ObjChunk> chunks(std::max<size_t>(1, size / kObjChunkSize));
+	for (size_t i = 0; i < chunks.size(); ++i)
+	{
+		chunks[i].begin = i == 0 ? data : chunks[i - 1].end;
+		chunks[i].end = i + 1 == chunks.size() ? data + size : std::min(data + size, FindLineEnd(data + (i + 1) * kObjChunkSize, data + size) + 1);
+		chunks[i].end = std::max(chunks[i].begin, chunks[i].end);
+	}
+
+	// Relative face indices need to know how many vertices came before them in the file,
+	// so count the vertex statements of each chunk first.
+	BASE_BEGIN("COUNT OBJ VERTICES");
+	tbb::parallel_for_each(chunks.begin(), chunks.end(), [](ObjChunk& chunk)
+	{
+		for (const char* it = chunk.begin; it < chunk.end; it = FindLineEnd(it, chunk.end) + 1)
+		{
+			it = SkipSpace(it, chunk.end);
+			chunk.vertexCount += chunk.end - it >= 2 && it[0] == 'v' && IsSpace(it[1]);
+		}
+	});
+	for (size_t i = 1; i < chunks.size(); ++i)
+		chunks[i].vertexOffset = chunks[i - 1].vertexOffset + chunks[i - 1].vertexCount;
+	BASE_END("COUNT OBJ VERTICES");
+
+	BASE_BEGIN("PARSE OBJ");
+	tbb::parallel_for_each(chunks.begin(), chunks.end(), [](ObjChunk& chunk) { ParseChunk(chunk); });
+	BASE_END("PARSE OBJ");
+
+	// Gather the vertices of every chunk into a single list.
+	const size_t vertexCount = chunks.back().vertexOffset + chunks.back().vertices.size();
+	std::vector<Vec3f> vertices(vertexCount);
+	tbb::parallel_for_each(chunks.begin(), chunks.end(), [&](ObjChunk& chunk)
+	{
+		std::copy(chunk.vertices.begin(), chunk.vertices.end(), vertices.begin() + chunk.vertexOffset);
+		std::vector<Vec3f>().swap(chunk.vertices);
+	});
 
-	std::vector<Vec3f> vertices;
-	for (size_t i = 0; i < attrib.vertices.size(); i += 3)
-		vertices.emplace_back(attrib.vertices[i], attrib.vertices[i + 1], attrib.vertices[i + 2]);
+	// Name the groups which carry on from the previous chunk and merge the groups sharing a name,
+	// keeping the order in which they first appear in the file.
+	std::string currentName = std::filesystem::path(filepath).stem().string();
+	std::vector<ObjGroup> groups;
+	std::unordered_map<std::string, size_t> groupLookup;
+	bool invalidFaces = false;
+	for (ObjChunk& chunk : chunks)
+	{
+		invalidFaces |= chunk.invalidFaces;
+		for (ObjGroup& group : chunk.groups)
+		{
+			if (!group.continued && !group.name.empty())
+				currentName = group.name;
 
-	for (size_t i = 0; i < shapes.size(); ++i)
-		LoadMesh(vertices, shapes[i]);
+			if (group.indices.empty())
+				continue;
+
+			const auto [lookup, inserted] = groupLookup.emplace(currentName, groups.size());
+			if (inserted)
+			{
+				groups.emplace_back(std::move(group));
+				groups.back().name = currentName;
+			}
+			else
+			{
+				std::vector<int>& indices = groups[lookup->second].indices;
+				indices.insert(indices.end(), group.indices.begin(), group.indices.end());
+			}
+		}
+	}
+	chunks.clear();
+
+	if (invalidFaces)
+		spdlog::warn("Faces with fewer than three vertices or invalid indices have been found in {}.", filepath);
+
+	// Every group becomes its own mesh so their BVHs are also built in parallel.
+	m_scene->ExpectGeometry(groups.size());
+	tbb::parallel_for_each(groups.begin(), groups.end(), [&](const ObjGroup& group)
+	{
+		LoadMesh(group.name, vertices, group.indices);
+	});
 
 	m_scene->CommitScene();
 
 	return true;
 }
 
-// TODO:
-// ----
-// This code is very inefficient but it works so ¯\_(ツ)_/¯
-void ObjSceneLoader::LoadMesh(const std::vector<Vec3f>& vertices, tinyobj::shape_t& shape)
+void ObjSceneLoader::LoadMesh(const std::string& name, const std::vector<Vec3f>& vertices, const std::vector<int>& indices)
 {
 	BASE_TRACE();
-	Mesh* mesh = new Mesh(Geometry::GeometryTypes::Mesh, shape.name);
+	// Groups usually reference a contiguous range of the file's vertices, so the remapping
+	// table only has to cover the range actually used.
+	const int vertexCount = static_cast<int>(vertices.size());
+	int minIndex = vertexCount;
+	int maxIndex = -1;
+	for (const int index : indices)
+	{
+		if (index < 0 || index >= vertexCount)
+			continue;
+		minIndex = std::min(minIndex, index);
+		maxIndex = std::max(maxIndex, index);
+	}
+
+	if (maxIndex < minIndex)
+	{
+		spdlog::warn("Group {} does not reference any valid vertices. Skipping it.", name);
+		return;
+	}
+
+	// Renumber the vertices in the order they are first used, dropping any faces with invalid indices.
+	std::vector<int> remap(maxIndex - minIndex + 1, -1);
+	std::vector<Vec3f> points;
+	std::vector<int> meshIndices;
+	meshIndices.reserve(indices.size());
+
+	for (size_t i = 0; i < indices.size(); i += 3)
+	{
+		if (std::any_of(indices.begin() + i, indices.begin() + i + 3, [&](int index) { return index < 0 || index >= vertexCount; }))
+			continue;
 
-	mesh->SetPoints(vertices);
+		for (size_t j = i; j < i + 3; ++j)
+		{
+			int& local = remap[indices[j] - minIndex];
+			if (local < 0)
+			{
+				local = static_cast<int>(points.size());
+				points.emplace_back(vertices[indices[j]]);
+			}
+			meshIndices.emplace_back(local);
+		}
+	}
 
-	std::vector<int> indices;
-	for (size_t i = 0; i < shape.mesh.indices.size(); ++i)
-		indices.emplace_back(size_t(shape.mesh.indices[i].vertex_index));
-	mesh->SetIndices(indices);
+	// One extra point is reserved as Embree reads vertex buffers with 16 byte loads.
+	points.reserve(points.size() + 1);
 
+	Mesh* mesh = new Mesh(Geometry::GeometryTypes::Mesh, name);
+	mesh->SetPoints(std::move(points));
+	mesh->SetIndices(std::move(meshIndices));
 	mesh->SetMeshType(Mesh::MeshType::TriangleMesh);
 
-	m_scene->CreateGeomerty(mesh);
+	AddGeometry(mesh);
 }
 
 BASE_NAMESPACE_CLOSE_SCOPE
@@ -1,9 +1,8 @@
 #ifndef OBJSCENE_LOADER_H
 #define OBJSCENE_LOADER_H
 
-#include<vector>
-
-#include <tiny_obj_loader.h>
+#include <string>
+#include <vector>
 
 #include "../../spindulysBase.h"
 
@@ -15,13 +14,39 @@ BASE_NAMESPACE_OPEN_SCOPE
 class ObjSceneLoader final : public SceneLoader
 {
 	public:
-		ObjSceneLoader(Scene* scene) : SceneLoader(scene) { };
+		ObjSceneLoader(Scene* scene, const SceneLoadOptions& options = SceneLoadOptions()) : SceneLoader(scene, options) { };
 		~ObjSceneLoader() = default;
 
 		virtual bool LoadScene(const std::string& filepath) override;
 
 	private:
-		void LoadMesh(const std::vector<Vec3f>& vertices, tinyobj::shape_t& shape);
+		// Faces belonging to a single o/g group, indexing into the vertices of the whole file.
+		struct ObjGroup
+		{
+			std::string name;
+			// Set when the faces come before any o/g statement in their chunk, the name then
+			// carries over from the previous chunk.
+			bool continued = false;
+			std::vector<int> indices;
+		};
+
+		// The result of parsing one line aligned chunk of the file.
+		struct ObjChunk
+		{
+			const char* begin = nullptr;
+			const char* end = nullptr;
+
+			// Number of vertices in all preceding chunks, used to resolve relative indices.
+			size_t vertexOffset = 0;
+			size_t vertexCount = 0;
+
+			std::vector<Vec3f> vertices;
+			std::vector<ObjGroup> groups;
+			bool invalidFaces = false;
+		};
+
+		static void ParseChunk(ObjChunk& chunk);
+		void LoadMesh(const std::string& name, const std::vector<Vec3f>& vertices, const std::vector<int>& indices);
 };
 
 BASE_NAMESPACE_CLOSE_SCOPE
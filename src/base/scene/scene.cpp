@@ -1,12 +1,21 @@
 #include "scene.h"
 
 #include <vector>
+#include <algorithm>
+#include <iterator>
+#include <limits>
 
 #include "../geometry/mesh.h"
 #include "../geometry/curve.h"
 
 BASE_NAMESPACE_OPEN_SCOPE
 
+void Scene::AddFilePath(const std::string& filepath)
+{
+	const std::lock_guard<std::mutex> lock(m_sceneMutex);
+	m_filepaths.emplace_back(filepath);
+}
+
 const std::vector<std::string> Scene::GetSceneCameras() const
 {
 	BASE_TRACE();
@@ -28,12 +37,183 @@ bool Scene::CreateDefaultCamera()
 	return true;
 }
 
+void Scene::CreatePlaceholderCamera()
+{
+	BASE_TRACE();
+	if (CreateDefaultCamera())
+		m_placeholderCamera = true;
+}
+
+size_t Scene::AddCamera(Camera* camera)
+{
+	const std::lock_guard<std::mutex> lock(m_sceneMutex);
+	const size_t committedCameras = m_placeholderCamera ? 0 : m_cameras.size();
+	if (m_streaming)
+	{
+		m_pendingCameras.emplace_back(camera);
+		return committedCameras + m_pendingCameras.size() - 1;
+	}
+
+	if (m_placeholderCamera)
+	{
+		m_cameras.front().reset(camera);
+		m_placeholderCamera = false;
+	}
+	else
+	{
+		m_cameras.emplace_back(camera);
+	}
+
+	return committedCameras;
+}
+
+size_t Scene::NumCameras() const
+{
+	const std::lock_guard<std::mutex> lock(m_sceneMutex);
+	return (m_placeholderCamera ? 0 : m_cameras.size()) + m_pendingCameras.size();
+}
+
+const Camera& Scene::GetCamera(size_t cameraIndex) const
+{
+	const std::lock_guard<std::mutex> lock(m_sceneMutex);
+	const size_t committedCameras = m_placeholderCamera ? 0 : m_cameras.size();
+	if (cameraIndex < committedCameras)
+		return *(m_cameras[cameraIndex].get());
+
+	return *(m_pendingCameras[cameraIndex - committedCameras].get());
+}
+
+void Scene::AddAnimator(SceneAnimator* animator)
+{
+	const std::lock_guard<std::mutex> lock(m_sceneMutex);
+	(m_streaming ? m_pendingAnimators : m_animators).emplace_back(animator);
+}
+
+void Scene::AddWatcher(SceneWatcher* watcher)
+{
+	const std::lock_guard<std::mutex> lock(m_sceneMutex);
+	(m_streaming ? m_pendingWatchers : m_watchers).emplace_back(watcher);
+}
+
+bool Scene::CommitPending()
+{
+	BASE_TRACE();
+	const std::lock_guard<std::mutex> lock(m_sceneMutex);
+	const bool updated = !m_pendingCameras.empty() || !m_pendingAnimators.empty() || !m_pendingWatchers.empty();
+
+	for (auto& camera : m_pendingCameras)
+	{
+		if (m_placeholderCamera)
+		{
+			m_cameras.front() = std::move(camera);
+			m_placeholderCamera = false;
+		}
+		else
+		{
+			m_cameras.emplace_back(std::move(camera));
+		}
+	}
+	m_pendingCameras.clear();
+
+	std::move(m_pendingAnimators.begin(), m_pendingAnimators.end(), std::back_inserter(m_animators));
+	m_pendingAnimators.clear();
+	std::move(m_pendingWatchers.begin(), m_pendingWatchers.end(), std::back_inserter(m_watchers));
+	m_pendingWatchers.clear();
+
+	return updated;
+}
+
+float Scene::GetLoadProgress() const
+{
+	const size_t expected = m_expectedGeometry;
+	return expected == 0 ? 0.f : std::min(1.f, (float) m_createdGeometry / expected);
+}
+
+void Scene::ReportLoad() const
+{
+	spdlog::info("Loaded {} geometry.", m_createdGeometry.load());
+	if (m_sharedGeometry > 0)
+		spdlog::info("{} duplicate geometry share their prototype with identical geometry, saving {:.2f} MB.",
+				m_sharedGeometry.load(), m_sharedBytes / (1024.0 * 1024.0));
+}
+
+bool Scene::IsAnimated() const
+{
+	return std::any_of(m_animators.begin(), m_animators.end(), [](const auto& animator) { return animator->IsAnimated(); });
+}
+
+double Scene::GetStartTime() const
+{
+	double startTime = std::numeric_limits<double>::max();
+	for (const auto& animator : m_animators)
+		if (animator->IsAnimated())
+			startTime = std::min(startTime, animator->GetStartTime());
+
+	return IsAnimated() ? startTime : 0.0;
+}
+
+double Scene::GetEndTime() const
+{
+	double endTime = std::numeric_limits<double>::lowest();
+	for (const auto& animator : m_animators)
+		if (animator->IsAnimated())
+			endTime = std::max(endTime, animator->GetEndTime());
+
+	return IsAnimated() ? endTime : 0.0;
+}
+
+void Scene::PrepareTime(double time)
+{
+	BASE_TRACE();
+	for (const auto& animator : m_animators)
+		animator->Prepare(time);
+}
+
+bool Scene::SetTime(double time)
+{
+	BASE_TRACE();
+	bool updated = false;
+	for (const auto& animator : m_animators)
+		updated |= animator->SetTime(this, time);
+
+	if (updated)
+		CommitScene();
+
+	return updated;
+}
+
+bool Scene::ApplyChanges()
+{
+	BASE_TRACE();
+	bool updated = false;
+	for (const auto& watcher : m_watchers)
+		updated |= watcher->ApplyChanges(this);
+
+	if (updated)
+		CommitScene();
+
+	return updated;
+}
+
 void Scene::ResetScene()
 {
 	BASE_TRACE();
 	m_filepaths.clear();
 	m_mainCamera = 0;
 	m_cameras.clear();
+	// Watchers can refer to the animators of the same file, so they go first.
+	m_watchers.clear();
+	m_animators.clear();
+
+	m_placeholderCamera = false;
+	m_pendingCameras.clear();
+	m_pendingWatchers.clear();
+	m_pendingAnimators.clear();
+
+	m_expectedGeometry = 0;
+	m_createdGeometry = 0;
+	m_sharedGeometry = 0;
+	m_sharedBytes = 0;
 }
 
 BASE_NAMESPACE_CLOSE_SCOPE
@@ -1,6 +1,7 @@
 #ifndef SCENE_H
 #define SCENE_H
 
+#include <atomic>
 #include <string>
 #include <mutex>
 #include <vector>
@@ -13,6 +14,9 @@
 #include "../geometry/geometry.h"
 #include "../lights/light.h"
 
+#include "sceneAnimator.h"
+#include "sceneWatcher.h"
+
 BASE_NAMESPACE_OPEN_SCOPE
 
 class Scene
@@ -22,14 +26,28 @@ class Scene
 		virtual ~Scene() = default;
 
 		virtual void CommitScene() = 0;
-		virtual bool CreateGeomerty(Geometry* geom) = 0;
-
-		virtual bool CreateLight(Light* light) = 0;
+		// Loaders call this from multiple threads at once, so implementations must be thread safe.
+		// Returns the id to update the geometry through, or SPINDULYS_INVALID_GEOMETRY_ID on failure.
+		virtual unsigned int CreateGeomerty(Geometry* geom) = 0;
+
+		// Update geometry already in the scene. Updates to different geometry can run in parallel,
+		// CommitScene must be called once they are all done.
+		virtual bool UpdateGeometryTransform(unsigned int geomID, const AffineSpace3f& affine) = 0;
+		virtual bool UpdateGeometryPoints(unsigned int geomID, const std::vector<Vec3f>& points) = 0;
+		virtual bool UpdateGeometryNormals(unsigned int geomID, const std::vector<Vec3f>& normals) = 0;
+		virtual bool SetGeometryVisible(unsigned int geomID, bool visible) = 0;
+		virtual bool RemoveGeometry(unsigned int geomID) = 0;
+
+		// Returns the id to remove the light through, or SPINDULYS_INVALID_LIGHT_ID on failure.
+		virtual unsigned int CreateLight(Light* light) = 0;
+		// Lights cannot be changed in place, so edited ones are removed and created again.
+		virtual bool RemoveLight(unsigned int lightID) = 0;
 		virtual void CreateDefaultLight() = 0;
 
 		virtual int NumLights() const = 0;
 
-		void AddFilePath(const std::string& filepath) { m_filepaths.emplace_back(filepath); }
+		// Thread safe, as several files can be imported at once.
+		void AddFilePath(const std::string& filepath);
 		const std::vector<std::string>& GetFilePaths() const { return m_filepaths; }
 
 		bool SetSceneCamera(size_t cameraIndex) { return cameraIndex != std::exchange(m_mainCamera, cameraIndex); }
@@ -38,20 +56,90 @@ class Scene
 
 		const std::vector<std::string> GetSceneCameras() const;
 		bool CreateDefaultCamera();
-		void AddCamera(Camera* camera) { m_cameras.emplace_back(camera); }
+		// A default camera to render through until the first camera is added, which then takes its place.
+		void CreatePlaceholderCamera();
+		// Thread safe. Returns the index of the camera, which stays the same once the camera is committed.
+		size_t AddCamera(Camera* camera);
+		// These include cameras which are still waiting to be committed.
+		size_t NumCameras() const;
+		const Camera& GetCamera(size_t cameraIndex) const;
+		Camera& UpdateCamera(size_t cameraIndex) { return *(m_cameras[cameraIndex].get()); }
+
+		// Meshes created while set have their normals packed and compact BVH leaves, see Mesh::Compact.
+		void SetCompactGeometry(bool compact) { m_compactGeometry = compact; }
+		bool CompactGeometry() const { return m_compactGeometry; }
+		// Meshes created while set are shaded with their interpolated vertex normals, otherwise their vertex
+		// normals are dropped and they are shaded with their geometric normals.
+		void SetSmoothNormals(bool smoothNormals) { m_smoothNormals = smoothNormals; }
+		bool SmoothNormals() const { return m_smoothNormals; }
+		// Meshes created while set are reordered for memory locality, apart from deforming ones.
+		void SetOptimizeLocality(bool optimize) { m_optimizeLocality = optimize; }
+		bool OptimizeLocality() const { return m_optimizeLocality; }
+
+		// Streaming
+		// While streaming, whatever loaders create is held back until CommitPending is called on the render thread,
+		// so that a scene can be loaded on another thread while it is being rendered.
+		void SetStreaming(bool streaming) { m_streaming = streaming; }
+		bool IsStreaming() const { return m_streaming; }
+		// Add everything created since the last call to the scene. Returns true if anything was added,
+		// the scene still needs committing afterwards.
+		virtual bool CommitPending();
+
+		// Loaders say how much geometry they are about to create so that loading can show its progress.
+		void ExpectGeometry(size_t count) { m_expectedGeometry += count; }
+		float GetLoadProgress() const;
+		// Log a summary of the geometry created since the scene was reset.
+		void ReportLoad() const;
+
+		// Animation
+		void AddAnimator(SceneAnimator* animator);
+		bool IsAnimated() const;
+		double GetStartTime() const;
+		double GetEndTime() const;
+		// Read the animation at the given time ahead of SetTime, safe to call while rendering.
+		void PrepareTime(double time);
+		// Evaluate all animation at the given time and commit the scene. Returns true if anything changed.
+		bool SetTime(double time);
+
+		// Live editing
+		void AddWatcher(SceneWatcher* watcher);
+		// Apply any edits made to the loaded files and commit the scene. Returns true if anything changed.
+		bool ApplyChanges();
 
 		void SetSceneDirty() { m_update = true; }
 		bool SceneDirty() const { return m_update; }
 
 		virtual void ResetScene();
 
+	protected:
+		void GeometryCreated() { ++m_createdGeometry; }
+		// Geometry identical to earlier geometry which shares its prototype, rather than holding its own copy.
+		void GeometryShared(size_t bytes) { ++m_sharedGeometry; m_sharedBytes += bytes; }
+
 	protected:
 		std::vector<std::string> m_filepaths;
 
 		size_t m_mainCamera = 0;
 		std::vector<std::unique_ptr<Camera>> m_cameras;
 
+		std::vector<std::unique_ptr<SceneAnimator>> m_animators;
+		std::vector<std::unique_ptr<SceneWatcher>> m_watchers;
+
+		std::atomic<bool> m_streaming = false;
+		bool m_placeholderCamera = false;
+		std::vector<std::unique_ptr<Camera>> m_pendingCameras;
+		std::vector<std::unique_ptr<SceneAnimator>> m_pendingAnimators;
+		std::vector<std::unique_ptr<SceneWatcher>> m_pendingWatchers;
+
+		std::atomic<size_t> m_expectedGeometry = 0;
+		std::atomic<size_t> m_createdGeometry = 0;
+		std::atomic<size_t> m_sharedGeometry = 0;
+		std::atomic<size_t> m_sharedBytes = 0;
+
 		bool m_update = false;
+		bool m_compactGeometry = false;
+		bool m_smoothNormals = false;
+		bool m_optimizeLocality = false;
 
 		mutable std::mutex m_sceneMutex;
 	private:
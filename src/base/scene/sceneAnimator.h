@@ -0,0 +1,34 @@
+#ifndef SCENE_ANIMATOR_H
+#define SCENE_ANIMATOR_H
+
+#include "../spindulysBase.h"
+
+BASE_NAMESPACE_OPEN_SCOPE
+
+class Scene;
+
+// Created by scene loaders for files with animation, keeps hold of whatever is needed to
+// re-evaluate the animated parts of the file at another time.
+class SceneAnimator
+{
+	public:
+		SceneAnimator() = default;
+		virtual ~SceneAnimator() = default;
+
+		// Read everything which is animated at the given time ahead of SetTime.
+		// Does not touch the scene, so it can run while the scene is being rendered.
+		virtual void Prepare(double time) = 0;
+
+		// Push everything which is animated at the given time into the scene, using what was prepared if it matches.
+		// Returns true if anything was updated, the scene still needs committing afterwards.
+		virtual bool SetTime(Scene* scene, double time) = 0;
+
+		// Whether there is anything to animate, the time range is only meaningful if there is.
+		virtual bool IsAnimated() const = 0;
+		virtual double GetStartTime() const = 0;
+		virtual double GetEndTime() const = 0;
+};
+
+BASE_NAMESPACE_CLOSE_SCOPE
+
+#endif // SCENE_ANIMATOR_H
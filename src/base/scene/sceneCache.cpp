@@ -0,0 +1,661 @@
+#include "sceneCache.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <tbb/parallel_for_each.h>
+
+#include "../camera/camera.h"
+#include "../geometry/mesh.h"
+#include "../geometry/curve.h"
+#include "../lights/area.h"
+#include "../lights/envmap.h"
+#include "../lights/portal.h"
+#include "../utils/hash.h"
+#include "../utils/mappedFile.h"
+
+BASE_NAMESPACE_OPEN_SCOPE
+
+/* File layout
+	 -----------
+	 CacheHeader followed by recordCount records, among them one for every file the scene was read from
+	 besides the source. Every record starts with a RecordHeader and is
+	 padded to 16 bytes, as is every array inside it. Arrays are copied out of the mapping into the geometry,
+	 which owns its buffers, so loading costs one copy of each but no parsing. */
+
+static constexpr char kCacheMagic[8] = { 'S', 'P', 'D', 'C', 'A', 'C', 'H', 'E' };
+static constexpr size_t kCacheAlignment = 16;
+
+struct CacheHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t complete;
+
+	// Key of the source file the cache was written from.
+	uint64_t sourceHash;
+	uint64_t sourceSize;
+	int64_t sourceTime;
+	// Hash of the SceneLoadOptions used to load the source.
+	uint64_t optionsHash;
+
+	uint64_t recordCount;
+};
+
+enum class RecordType : uint32_t
+{
+	kMesh = 0,
+	kCurve,
+	kCamera,
+	kEnvmap,
+	kPortal,
+	// A file the scene was read from besides the source, with its size and modification time when it was.
+	kDependency,
+};
+
+struct RecordHeader
+{
+	RecordType type;
+	uint32_t reserved;
+	// Size in bytes of the whole record including this header.
+	uint64_t size;
+};
+
+static bool GetFileKey(const std::string& filepath, std::string& absolutePath, uint64_t& size, int64_t& time)
+{
+	std::error_code error;
+	const std::filesystem::path path = std::filesystem::absolute(filepath, error);
+	const uintmax_t fileSize = std::filesystem::file_size(path, error);
+	if (error)
+		return false;
+	const std::filesystem::file_time_type fileTime = std::filesystem::last_write_time(path, error);
+	if (error)
+		return false;
+
+	absolutePath = path.string();
+	size = static_cast<uint64_t>(fileSize);
+	time = static_cast<int64_t>(fileTime.time_since_epoch().count());
+
+	return true;
+}
+
+static bool GetSourceKey(const std::string& filepath, CacheHeader& header)
+{
+	std::string path;
+	if (!GetFileKey(filepath, path, header.sourceSize, header.sourceTime))
+		return false;
+
+	header.sourceHash = HashString(path);
+
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+// Writing
+// ----------------------------------------------------------------------------
+class RecordWriter
+{
+	public:
+		RecordWriter(RecordType type) { Write(RecordHeader{ type, 0, 0 }); }
+
+		template<typename T>
+		void Write(const T& value) { Append(&value, sizeof(T)); }
+
+		template<typename T>
+		void WriteArray(const std::vector<T>& array)
+		{
+			Align();
+			Append(array.data(), array.size() * sizeof(T));
+		}
+
+		void WriteString(const std::string& string) { Align(); Append(string.data(), string.size()); }
+
+		// Fill in the final size and return the record data.
+		const std::vector<char>& Finish()
+		{
+			Align();
+			const uint64_t size = m_data.size();
+			std::memcpy(m_data.data() + offsetof(RecordHeader, size), &size, sizeof(size));
+			return m_data;
+		}
+
+	private:
+		void Append(const void* data, size_t size)
+		{
+			const size_t offset = m_data.size();
+			m_data.resize(offset + size);
+			if (size)
+				std::memcpy(m_data.data() + offset, data, size);
+		}
+
+		void Align() { m_data.resize((m_data.size() + kCacheAlignment - 1) & ~(kCacheAlignment - 1), 0); }
+
+		std::vector<char> m_data;
+};
+
+SceneCache::~SceneCache()
+{
+	if (m_stream.is_open())
+		EndWrite(false);
+}
+
+bool SceneCache::BeginWrite(const std::string& filepath, const SceneLoadOptions& options)
+{
+	BASE_TRACE();
+	CacheHeader header = {};
+	if (!GetSourceKey(filepath, header))
+		return false;
+
+	std::memcpy(header.magic, kCacheMagic, sizeof(kCacheMagic));
+	header.version = kVersion;
+	header.optionsHash = options.Hash();
+
+	m_filepath = filepath;
+	m_optionsHash = header.optionsHash;
+	m_tempPath = GetCachePath(filepath) + ".tmp";
+	m_recordCount = 0;
+	m_failed = false;
+
+	m_stream.open(m_tempPath, std::ios::binary | std::ios::trunc);
+	if (!m_stream)
+	{
+		spdlog::warn("Could not create scene cache {}.", m_tempPath);
+		return false;
+	}
+
+	// The header is written again with the record count once everything has been recorded.
+	m_stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	return true;
+}
+
+bool SceneCache::EndWrite(bool success)
+{
+	BASE_TRACE();
+	if (!m_stream.is_open())
+		return false;
+
+	if (success && !m_failed)
+	{
+		CacheHeader header = {};
+		GetSourceKey(m_filepath, header);
+		std::memcpy(header.magic, kCacheMagic, sizeof(kCacheMagic));
+		header.version = kVersion;
+		header.optionsHash = m_optionsHash;
+		header.complete = 1;
+		header.recordCount = m_recordCount;
+
+		m_stream.seekp(0);
+		m_stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	}
+
+	m_stream.close();
+	success &= !m_failed && !m_stream.fail();
+
+	std::error_code error;
+	if (success)
+		std::filesystem::rename(m_tempPath, GetCachePath(m_filepath), error);
+	if (!success || error)
+	{
+		std::filesystem::remove(m_tempPath, error);
+		spdlog::warn("Scene cache for {} was not written.", m_filepath);
+		return false;
+	}
+
+	spdlog::info("Written scene cache {}.", GetCachePath(m_filepath));
+	return true;
+}
+
+void SceneCache::RecordGeometry(const Geometry& geom)
+{
+	BASE_TRACE();
+	// Records are built on the calling thread so the loaders only contend on the file write itself.
+	switch (geom.GetGeometryType())
+	{
+		case Geometry::Mesh:
+		{
+			const Mesh& mesh = dynamic_cast<const Mesh&>(geom);
+
+			// Only area lights can be attached to meshes, a black one stands for none.
+			const AreaLight* light = dynamic_cast<const AreaLight*>(mesh.GetLight());
+
+			RecordWriter record(RecordType::kMesh);
+			record.Write(mesh.GetTransform());
+			record.Write(mesh.GetDisplayColor());
+			record.Write(light ? light->GetRadiance() : Col3f(zero));
+			record.Write(static_cast<uint32_t>(mesh.GetMeshType()));
+			record.Write(static_cast<uint32_t>(mesh.IsDeforming()));
+			record.Write(static_cast<uint64_t>(mesh.GetName().size()));
+			record.Write(static_cast<uint64_t>(mesh.GetPoints().size()));
+			record.Write(static_cast<uint64_t>(mesh.GetNormals().size()));
+			record.Write(static_cast<uint64_t>(mesh.GetIndices().size()));
+			record.WriteString(mesh.GetName());
+			record.WriteArray(mesh.GetPoints());
+			record.WriteArray(mesh.GetNormals());
+			record.WriteArray(mesh.GetIndices());
+			WriteRecord(record.Finish());
+			break;
+		}
+		case Geometry::Curve:
+		{
+			const Curve& curve = dynamic_cast<const Curve&>(geom);
+
+			RecordWriter record(RecordType::kCurve);
+			record.Write(curve.GetTransform());
+			record.Write(curve.GetDisplayColor());
+			record.Write(static_cast<uint32_t>(curve.GetCurveType()));
+			record.Write(static_cast<uint32_t>(curve.IsDeforming()));
+			record.Write(static_cast<uint64_t>(curve.GetName().size()));
+			record.Write(static_cast<uint64_t>(curve.GetPoints().size()));
+			record.Write(static_cast<uint64_t>(curve.GetNormals().size()));
+			record.Write(static_cast<uint64_t>(curve.GetWidths().size()));
+			record.WriteString(curve.GetName());
+			record.WriteArray(curve.GetPoints());
+			record.WriteArray(curve.GetNormals());
+			record.WriteArray(curve.GetWidths());
+			WriteRecord(record.Finish());
+			break;
+		}
+		default:
+			spdlog::warn("Geometry {} cannot be stored in the scene cache.", geom.GetName());
+			m_failed = true;
+			break;
+	}
+}
+
+void SceneCache::RecordCamera(const Camera& camera)
+{
+	BASE_TRACE();
+	RecordWriter record(RecordType::kCamera);
+	record.Write(camera.GetAffine());
+	record.Write(camera.GetResolution());
+	record.Write(static_cast<uint32_t>(camera.GetProjection()));
+	record.Write(camera.GetHorizontalAperature());
+	record.Write(camera.GetVerticalAperature());
+	record.Write(camera.GetHorizontalAperatureOffset());
+	record.Write(camera.GetVerticalAperatureOffset());
+	record.Write(camera.GetFocalLength());
+	record.Write(camera.GetFar());
+	record.Write(camera.GetClose());
+	record.Write(camera.GetFStop());
+	record.Write(camera.GetFocusDistance());
+	record.Write(static_cast<uint64_t>(camera.GetName().size()));
+	record.WriteString(camera.GetName());
+	WriteRecord(record.Finish());
+}
+
+void SceneCache::RecordLight(const Light& light)
+{
+	BASE_TRACE();
+	if (const EnvmapLight* envmap = dynamic_cast<const EnvmapLight*>(&light))
+	{
+		RecordWriter record(RecordType::kEnvmap);
+		record.Write(envmap->GetTransform());
+		record.Write(envmap->GetScale());
+		record.Write(static_cast<uint64_t>(envmap->GetFilePath().size()));
+		record.WriteString(envmap->GetFilePath());
+		WriteRecord(record.Finish());
+	}
+	else if (const PortalLight* portal = dynamic_cast<const PortalLight*>(&light))
+	{
+		RecordWriter record(RecordType::kPortal);
+		record.Write(portal->GetTransform());
+		record.Write(portal->GetWidth());
+		record.Write(portal->GetHeight());
+		WriteRecord(record.Finish());
+	}
+	else
+	{
+		spdlog::warn("Light cannot be stored in the scene cache.");
+		m_failed = true;
+	}
+}
+
+void SceneCache::RecordDependency(const std::string& filepath)
+{
+	BASE_TRACE();
+	std::string path;
+	uint64_t size = 0;
+	int64_t time = 0;
+	if (!GetFileKey(filepath, path, size, time))
+	{
+		// A cache which cannot tell when it is out of date would go on loading stale geometry.
+		spdlog::warn("Scene dependency {} cannot be tracked by the scene cache.", filepath);
+		m_failed = true;
+		return;
+	}
+
+	RecordWriter record(RecordType::kDependency);
+	record.Write(size);
+	record.Write(time);
+	record.Write(static_cast<uint64_t>(path.size()));
+	record.WriteString(path);
+	WriteRecord(record.Finish());
+}
+
+void SceneCache::RecordUncacheable(const std::string& reason)
+{
+	spdlog::info("{} is not cached as {}.", m_filepath, reason);
+	m_failed = true;
+}
+
+void SceneCache::WriteRecord(const std::vector<char>& record)
+{
+	std::lock_guard<std::mutex> lock(m_writeMutex);
+	m_stream.write(record.data(), record.size());
+	m_failed |= m_stream.fail();
+	++m_recordCount;
+}
+
+// ----------------------------------------------------------------------------
+// Reading
+// ----------------------------------------------------------------------------
+class RecordReader
+{
+	public:
+		RecordReader(const char* data, size_t size) : m_data(data), m_size(size) { Read<RecordHeader>(); }
+
+		bool IsValid() const { return m_valid; }
+
+		template<typename T>
+		T Read()
+		{
+			T value = {};
+			if (const char* data = Take(sizeof(T)))
+				std::memcpy((void*) &value, data, sizeof(T));
+			return value;
+		}
+
+		template<typename T>
+		std::vector<T> ReadArray(uint64_t count)
+		{
+			Align();
+			std::vector<T> array;
+			if (const char* data = Take(count * sizeof(T)))
+			{
+				array.resize(count);
+				std::memcpy((void*) array.data(), data, count * sizeof(T));
+			}
+			return array;
+		}
+
+		std::string ReadString(uint64_t length)
+		{
+			Align();
+			const char* data = Take(length);
+			return data ? std::string(data, length) : std::string();
+		}
+
+	private:
+		const char* Take(uint64_t size)
+		{
+			if (!m_valid || size > m_size - m_offset)
+			{
+				m_valid = false;
+				return nullptr;
+			}
+			const char* data = m_data + m_offset;
+			m_offset += size;
+			return data;
+		}
+
+		void Align() { m_offset = std::min<size_t>((m_offset + kCacheAlignment - 1) & ~(kCacheAlignment - 1), m_size); }
+
+		const char* m_data;
+		size_t m_size;
+		size_t m_offset = 0;
+		bool m_valid = true;
+};
+
+static Geometry* ReadMesh(RecordReader& record)
+{
+	const AffineSpace3f transform = record.Read<AffineSpace3f>();
+	const Col3f displayColor = record.Read<Col3f>();
+	const Col3f radiance = record.Read<Col3f>();
+	const uint32_t meshType = record.Read<uint32_t>();
+	const uint32_t deforming = record.Read<uint32_t>();
+	const uint64_t nameLength = record.Read<uint64_t>();
+	const uint64_t pointCount = record.Read<uint64_t>();
+	const uint64_t normalCount = record.Read<uint64_t>();
+	const uint64_t indexCount = record.Read<uint64_t>();
+
+	Mesh* mesh = new Mesh(Geometry::GeometryTypes::Mesh, record.ReadString(nameLength));
+	mesh->SetTransfrom(transform);
+	mesh->SetDisplayColor(displayColor);
+	if (radiance != Col3f(zero))
+		mesh->SetLight(std::make_unique<AreaLight>(radiance));
+	mesh->SetMeshType(static_cast<Mesh::MeshType>(meshType));
+	mesh->SetDeforming(deforming != 0);
+	mesh->SetPoints(record.ReadArray<Vec3f>(pointCount));
+	mesh->SetNormals(record.ReadArray<Vec3f>(normalCount));
+	mesh->SetIndices(record.ReadArray<int>(indexCount));
+
+	return mesh;
+}
+
+static Geometry* ReadCurve(RecordReader& record)
+{
+	const AffineSpace3f transform = record.Read<AffineSpace3f>();
+	const Col3f displayColor = record.Read<Col3f>();
+	const uint32_t curveType = record.Read<uint32_t>();
+	const uint32_t deforming = record.Read<uint32_t>();
+	const uint64_t nameLength = record.Read<uint64_t>();
+	const uint64_t pointCount = record.Read<uint64_t>();
+	const uint64_t normalCount = record.Read<uint64_t>();
+	const uint64_t widthCount = record.Read<uint64_t>();
+
+	Curve* curve = new Curve(Geometry::GeometryTypes::Curve, record.ReadString(nameLength));
+	curve->SetTransfrom(transform);
+	curve->SetDisplayColor(displayColor);
+	curve->SetCurveType(static_cast<Curve::CurveTypes>(curveType));
+	curve->SetDeforming(deforming != 0);
+	curve->SetPoints(record.ReadArray<Vec3f>(pointCount));
+	curve->SetNormals(record.ReadArray<Vec3f>(normalCount));
+	curve->SetWidths(record.ReadArray<float>(widthCount));
+
+	return curve;
+}
+
+static Camera* ReadCamera(RecordReader& record)
+{
+	const AffineSpace3f affine = record.Read<AffineSpace3f>();
+	const Vec2f resolution = record.Read<Vec2f>();
+	const uint32_t projection = record.Read<uint32_t>();
+	const float horizontalAperature = record.Read<float>();
+	const float verticalAperature = record.Read<float>();
+	const float horizontalAperatureOffset = record.Read<float>();
+	const float verticalAperatureOffset = record.Read<float>();
+	const float focalLength = record.Read<float>();
+	const float far = record.Read<float>();
+	const float close = record.Read<float>();
+	const float fStop = record.Read<float>();
+	const float focusDistance = record.Read<float>();
+	const uint64_t nameLength = record.Read<uint64_t>();
+
+	Camera* camera = new Camera(record.ReadString(nameLength));
+	camera->SetProjection(static_cast<Camera::Projection>(projection));
+	camera->SetHorizontalAperatureOffset(horizontalAperatureOffset);
+	camera->SetVerticalAperatureOffset(verticalAperatureOffset);
+	camera->SetFar(far);
+	camera->SetClose(close);
+	camera->SetFStop(fStop);
+	camera->SetFocusDistance(focusDistance);
+	camera->SetResolution(resolution);
+	camera->SetHorizontalAperature(horizontalAperature);
+	camera->SetVerticalAperature(verticalAperature);
+	camera->SetFocalLength(focalLength);
+	camera->SetAffine(affine);
+
+	return camera;
+}
+
+static Light* ReadEnvmap(RecordReader& record)
+{
+	const AffineSpace3f transform = record.Read<AffineSpace3f>();
+	const Col3f scale = record.Read<Col3f>();
+	const uint64_t filepathLength = record.Read<uint64_t>();
+
+	return new EnvmapLight(record.ReadString(filepathLength), transform, scale);
+}
+
+static Light* ReadPortal(RecordReader& record)
+{
+	const AffineSpace3f transform = record.Read<AffineSpace3f>();
+	const float width = record.Read<float>();
+	const float height = record.Read<float>();
+
+	return new PortalLight(transform, width, height);
+}
+
+bool SceneCache::Load(const std::string& filepath, const SceneLoadOptions& options, Scene* scene)
+{
+	BASE_TRACE();
+	const std::string cachePath = GetCachePath(filepath);
+	if (!std::filesystem::exists(cachePath))
+		return false;
+
+	MappedFile file;
+	if (!file.Open(cachePath) || file.GetSize() < sizeof(CacheHeader))
+		return false;
+
+	CacheHeader header;
+	std::memcpy(&header, file.GetData(), sizeof(header));
+
+	CacheHeader source = {};
+	if (std::memcmp(header.magic, kCacheMagic, sizeof(kCacheMagic)) != 0 || header.version != kVersion || !header.complete)
+	{
+		spdlog::info("Scene cache {} is from an incompatible version. Ignoring it.", cachePath);
+		return false;
+	}
+	if (!GetSourceKey(filepath, source) || source.sourceHash != header.sourceHash ||
+			source.sourceSize != header.sourceSize || source.sourceTime != header.sourceTime ||
+			options.Hash() != header.optionsHash)
+	{
+		spdlog::info("Scene cache {} is out of date. Ignoring it.", cachePath);
+		return false;
+	}
+
+	const auto invalidCache = [&cachePath]()
+	{
+		spdlog::warn("Scene cache {} contains invalid records. Ignoring it.", cachePath);
+		return false;
+	};
+
+	// Find where every record starts so the geometry can be read in parallel. The files the scene was read from
+	// besides the source are checked on the way, before anything is read.
+	std::vector<std::pair<const char*, size_t>> records;
+	records.reserve(header.recordCount);
+
+	const char* data = file.GetData();
+	size_t offset = sizeof(CacheHeader);
+	for (uint64_t i = 0; i < header.recordCount; ++i)
+	{
+		RecordHeader record;
+		if (file.GetSize() - offset < sizeof(RecordHeader))
+			return invalidCache();
+		std::memcpy(&record, data + offset, sizeof(record));
+		if (record.size < sizeof(RecordHeader) || record.size > file.GetSize() - offset)
+			return invalidCache();
+
+		if (record.type == RecordType::kDependency)
+		{
+			RecordReader reader(data + offset, record.size);
+			const uint64_t size = reader.Read<uint64_t>();
+			const int64_t time = reader.Read<int64_t>();
+			const uint64_t pathLength = reader.Read<uint64_t>();
+			const std::string path = reader.ReadString(pathLength);
+			if (!reader.IsValid())
+				return invalidCache();
+
+			std::string currentPath;
+			uint64_t currentSize = 0;
+			int64_t currentTime = 0;
+			if (!GetFileKey(path, currentPath, currentSize, currentTime) || currentSize != size || currentTime != time)
+			{
+				spdlog::info("Scene cache {} is out of date as {} has changed. Ignoring it.", cachePath, path);
+				return false;
+			}
+		}
+		else
+		{
+			records.emplace_back(data + offset, record.size);
+		}
+		offset += record.size;
+	}
+
+	// Everything is read before any of it is added, so that an invalid record leaves the scene untouched for the
+	// source to be loaded into instead, which also writes the cache again.
+	std::vector<Geometry*> geometry(records.size(), nullptr);
+	std::vector<Camera*> cameras;
+	std::vector<Light*> lights;
+	std::atomic<bool> valid = true;
+	tbb::parallel_for(tbb::blocked_range<size_t>(0, records.size()), [&](const tbb::blocked_range<size_t>& range)
+	{
+		for (size_t i = range.begin(); i < range.end(); ++i)
+		{
+			RecordHeader recordHeader;
+			std::memcpy(&recordHeader, records[i].first, sizeof(recordHeader));
+
+			// Cameras and lights are read afterwards to keep their order.
+			RecordReader reader(records[i].first, records[i].second);
+			if (recordHeader.type == RecordType::kMesh)
+				geometry[i] = ReadMesh(reader);
+			else if (recordHeader.type == RecordType::kCurve)
+				geometry[i] = ReadCurve(reader);
+			else if (recordHeader.type != RecordType::kCamera && recordHeader.type != RecordType::kEnvmap &&
+					recordHeader.type != RecordType::kPortal)
+				valid = false;
+
+			if (!reader.IsValid())
+				valid = false;
+		}
+	});
+
+	for (const auto& record : records)
+	{
+		RecordHeader recordHeader;
+		std::memcpy(&recordHeader, record.first, sizeof(recordHeader));
+		RecordReader reader(record.first, record.second);
+		if (recordHeader.type == RecordType::kCamera)
+			cameras.emplace_back(ReadCamera(reader));
+		else if (recordHeader.type == RecordType::kEnvmap)
+			lights.emplace_back(ReadEnvmap(reader));
+		else if (recordHeader.type == RecordType::kPortal)
+			lights.emplace_back(ReadPortal(reader));
+
+		if (!reader.IsValid())
+			valid = false;
+	}
+
+	if (!valid)
+	{
+		for (Geometry* geom : geometry)
+			delete geom;
+		for (Camera* camera : cameras)
+			delete camera;
+		for (Light* light : lights)
+			delete light;
+		return invalidCache();
+	}
+
+	geometry.erase(std::remove(geometry.begin(), geometry.end(), nullptr), geometry.end());
+
+	scene->AddFilePath(filepath);
+	scene->ExpectGeometry(geometry.size());
+
+	tbb::parallel_for_each(geometry.begin(), geometry.end(), [scene](Geometry* geom) { scene->CreateGeomerty(geom); });
+	for (Camera* camera : cameras)
+		scene->AddCamera(camera);
+	for (Light* light : lights)
+		scene->CreateLight(light);
+
+	scene->CommitScene();
+
+	return true;
+}
+
+BASE_NAMESPACE_CLOSE_SCOPE
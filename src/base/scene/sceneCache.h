@@ -0,0 +1,63 @@
+#ifndef SCENE_CACHE_H
+#define SCENE_CACHE_H
+
+#include <string>
+#include <mutex>
+#include <fstream>
+#include <vector>
+
+#include "../spindulysBase.h"
+
+#include "scene.h"
+#include "sceneLoader.h"
+
+BASE_NAMESPACE_OPEN_SCOPE
+
+/* Binary cache of a translated scene file, stored next to it as <file>.spdcache.
+	 The cache holds the triangulated geometry, cameras and lights exactly as the scene loaders hand them
+	 to the scene, so reloading skips parsing and triangulation entirely. It is keyed on the path, size and
+	 modification time of the source file and of every file the loader read it from, along with the load
+	 options, and ignored if any of them change. Scenes which need their source kept open, to animate them or
+	 follow edits to them, are never cached. */
+class SceneCache final : public SceneRecorder
+{
+	public:
+		static constexpr uint32_t kVersion = 8;
+
+		SceneCache() = default;
+		~SceneCache();
+
+		static std::string GetCachePath(const std::string& filepath) { return filepath + ".spdcache"; }
+
+		// Load the cache of the given scene file into the scene.
+		// Returns false if there is no cache, it is out of date or any of it is invalid, in which case nothing is added.
+		static bool Load(const std::string& filepath, const SceneLoadOptions& options, Scene* scene);
+
+		// Record all the geometry, cameras and lights the loader it is set on creates until EndWrite is called.
+		// The new cache only replaces the existing one if it was written in full.
+		bool BeginWrite(const std::string& filepath, const SceneLoadOptions& options);
+		bool EndWrite(bool success);
+
+		virtual void RecordGeometry(const Geometry& geom) override;
+		virtual void RecordCamera(const Camera& camera) override;
+		virtual void RecordLight(const Light& light) override;
+		virtual void RecordDependency(const std::string& filepath) override;
+		virtual void RecordUncacheable(const std::string& reason) override;
+
+	private:
+		void WriteRecord(const std::vector<char>& record);
+
+		std::string m_filepath;
+		uint64_t m_optionsHash = 0;
+		std::string m_tempPath;
+		std::ofstream m_stream;
+
+		uint64_t m_recordCount = 0;
+		bool m_failed = false;
+
+		std::mutex m_writeMutex;
+};
+
+BASE_NAMESPACE_CLOSE_SCOPE
+
+#endif // SCENE_CACHE_H
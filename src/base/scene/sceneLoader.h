@@ -1,23 +1,113 @@
 #ifndef SCENE_LOADER_H
 #define SCENE_LOADER_H
 
+#include <string>
+#include <vector>
+
+#include <spindulys/defaults.h>
 
 #include "../spindulysBase.h"
 
+#include "../utils/hash.h"
+
 #include "scene.h"
 
 BASE_NAMESPACE_OPEN_SCOPE
 
+// Policies controlling which parts of a scene file get loaded. Not every format supports all of them.
+struct SceneLoadOptions
+{
+	// Only load prims with the default or render purpose, skipping proxy and guide prims.
+	bool m_renderPurposeOnly = kDefaultRenderPurposeOnly;
+	// Skip invisible prims along with everything beneath them.
+	bool m_skipInvisible = kDefaultSkipInvisible;
+	// Load payloads on demand, payloads beneath skipped prims are never opened.
+	bool m_loadPayloads = kDefaultLoadPayloads;
+	// Keep the source open and follow edits made to it while it is rendered.
+	bool m_watchEdits = kDefaultWatchEdits;
+	// Prim paths the scene is restricted to, everything is loaded when empty.
+	std::vector<std::string> m_populationMask;
+
+	uint64_t Hash() const
+	{
+		uint64_t hash = HashBytes(&m_renderPurposeOnly, sizeof(bool));
+		hash = HashBytes(&m_skipInvisible, sizeof(bool), hash);
+		hash = HashBytes(&m_loadPayloads, sizeof(bool), hash);
+		hash = HashBytes(&m_watchEdits, sizeof(bool), hash);
+		for (const std::string& path : m_populationMask)
+			hash = HashString(path, hash);
+		return hash;
+	}
+};
+
+// Sees everything a loader creates before the scene takes it over. Loaders create in parallel,
+// so implementations must be thread safe.
+class SceneRecorder
+{
+	public:
+		virtual ~SceneRecorder() = default;
+
+		virtual void RecordGeometry(const Geometry& geom) = 0;
+		virtual void RecordCamera(const Camera& camera) = 0;
+		virtual void RecordLight(const Light& light) = 0;
+		// Files besides the one being loaded that the scene was read from, such as USD sublayers and references.
+		virtual void RecordDependency(const std::string& /* filepath */) { }
+		// The scene needs more than what was recorded, such as its animation, so must always be loaded from the source.
+		virtual void RecordUncacheable(const std::string& /* reason */) { }
+};
+
 class SceneLoader
 {
 	public:
-		SceneLoader(Scene* scene) : m_scene(scene) { };
+		SceneLoader(Scene* scene, const SceneLoadOptions& options = SceneLoadOptions())
+			: m_scene(scene)
+			, m_options(options)
+		{ };
 		~SceneLoader() = default;
 
 		virtual bool LoadScene(const std::string& filepath) = 0;
 
+		// Several loaders can load into the same scene at once, so recording is done per loader.
+		void SetRecorder(SceneRecorder* recorder) { m_recorder = recorder; }
+
+	protected:
+		// Loaders add to the scene through these so that the recorder sees it.
+		unsigned int AddGeometry(Geometry* geom) const { return AddGeometry(m_scene, geom, m_recorder); }
+		size_t AddCamera(Camera* camera) const
+		{
+			if (m_recorder)
+				m_recorder->RecordCamera(*camera);
+			return m_scene->AddCamera(camera);
+		}
+		unsigned int AddLight(Light* light) const
+		{
+			if (m_recorder)
+				m_recorder->RecordLight(*light);
+			return m_scene->CreateLight(light);
+		}
+
+		void AddDependency(const std::string& filepath) const
+		{
+			if (m_recorder)
+				m_recorder->RecordDependency(filepath);
+		}
+		void SetUncacheable(const std::string& reason) const
+		{
+			if (m_recorder)
+				m_recorder->RecordUncacheable(reason);
+		}
+
+		static unsigned int AddGeometry(Scene* scene, Geometry* geom, SceneRecorder* recorder)
+		{
+			if (recorder)
+				recorder->RecordGeometry(*geom);
+			return scene->CreateGeomerty(geom);
+		}
+
 	protected:
 		Scene* m_scene = nullptr;
+		SceneLoadOptions m_options;
+		SceneRecorder* m_recorder = nullptr;
 	private:
 };
 
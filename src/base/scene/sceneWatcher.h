@@ -0,0 +1,25 @@
+#ifndef SCENE_WATCHER_H
+#define SCENE_WATCHER_H
+
+#include "../spindulysBase.h"
+
+BASE_NAMESPACE_OPEN_SCOPE
+
+class Scene;
+
+// Created by scene loaders for files which can be edited while they are loaded. Changes can be
+// noticed on any thread, they are queued up until the render thread is ready to apply them.
+class SceneWatcher
+{
+	public:
+		SceneWatcher() = default;
+		virtual ~SceneWatcher() = default;
+
+		// Apply everything which has changed since the last call to the scene.
+		// Returns true if anything was updated, the scene still needs committing afterwards.
+		virtual bool ApplyChanges(Scene* scene) = 0;
+};
+
+BASE_NAMESPACE_CLOSE_SCOPE
+
+#endif // SCENE_WATCHER_H
@@ -16,26 +16,19 @@ void* UsdBasisCurveTranslator::GetObjectFromPrim(const pxr::UsdPrim& prim)
 	Curve* curve = new Curve(Geometry::GeometryTypes::Curve, prim.GetName());
 
 	pxr::UsdGeomBasisCurves usdBasisCurve(prim);
-	const AffineSpace3f affine(usdBasisCurve.ComputeLocalToWorldTransform(pxr::UsdTimeCode::Default()));
+	const AffineSpace3f affine(usdBasisCurve.ComputeLocalToWorldTransform(m_time));
 	curve->SetTransfrom(affine);
 
 	pxr::VtArray<pxr::GfVec3f> pxrPoints;
-	if (usdBasisCurve.GetPointsAttr().Get(&pxrPoints))
-	{
-		std::vector<Vec3f> points;
-		for (const auto& point : pxrPoints)
-			points.emplace_back(Vec3f(point[0], point[1], point[2]));
-
-		curve->SetPoints(points);
-	}
+	if (usdBasisCurve.GetPointsAttr().Get(&pxrPoints, m_time))
+		curve->SetPoints(ToVector<Vec3f>(pxrPoints));
+	curve->SetDeforming(usdBasisCurve.GetPointsAttr().ValueMightBeTimeVarying());
 
 	bool hasNormals = false;
 	pxr::VtArray<pxr::GfVec3f> pxrNormals;
-	if (usdBasisCurve.GetNormalsAttr().Get(&pxrNormals))
+	if (usdBasisCurve.GetNormalsAttr().Get(&pxrNormals, m_time))
 	{
-		std::vector<Vec3f> normals;
-		for (const auto& normal : pxrNormals)
-			normals.emplace_back(Vec3f(normal[0], normal[1], normal[2]));
+		std::vector<Vec3f> normals = ToVector<Vec3f>(pxrNormals);
 
 		if (normals.size() < curve->GetPoints().size())
 		{
@@ -45,20 +38,19 @@ void* UsdBasisCurveTranslator::GetObjectFromPrim(const pxr::UsdPrim& prim)
 		}
 
 
-		curve->SetNormals(normals);
+		curve->SetNormals(std::move(normals));
 		hasNormals = true;
 	}
 
 	bool hasWidth = false;
 	pxr::VtArray<float> pxrWidths;
-	if (usdBasisCurve.GetWidthsAttr().Get(&pxrWidths))
+	if (usdBasisCurve.GetWidthsAttr().Get(&pxrWidths, m_time))
 	{
 		std::vector<float> widths;
 		if (pxrWidths.size() == 1)
 			widths.assign(curve->GetPoints().size(), pxrWidths[0]);
 		else
-			for (const auto& width : pxrWidths)
-				widths.emplace_back(width);
+			widths = ToVector<float>(pxrWidths);
 
 		if (widths.size() < curve->GetPoints().size())
 		{
@@ -67,15 +59,15 @@ void* UsdBasisCurveTranslator::GetObjectFromPrim(const pxr::UsdPrim& prim)
 			return nullptr;
 		}
 
-		curve->SetWidths(widths);
+		curve->SetWidths(std::move(widths));
 		hasWidth = true;
 	}
 
 	pxr::TfToken pxrType("cubic");
-	usdBasisCurve.GetTypeAttr().Get(&pxrType);
+	usdBasisCurve.GetTypeAttr().Get(&pxrType, m_time);
 
 	pxr::TfToken pxrBasis("bezier");
-	usdBasisCurve.GetBasisAttr().Get(&pxrBasis);
+	usdBasisCurve.GetBasisAttr().Get(&pxrBasis, m_time);
 
 	if (pxrType == pxr::TfToken("linear"))
 	{
@@ -113,7 +105,7 @@ void* UsdBasisCurveTranslator::GetObjectFromPrim(const pxr::UsdPrim& prim)
 	}
 
 	pxr::VtArray<pxr::GfVec3f> pxrDisplayColor;
-	if (usdBasisCurve.GetDisplayColorAttr().Get(&pxrDisplayColor))
+	if (usdBasisCurve.GetDisplayColorAttr().Get(&pxrDisplayColor, m_time))
 	{
 		const Col3f displayColor(pxrDisplayColor[0][0], pxrDisplayColor[0][1], pxrDisplayColor[0][2]);
 		curve->SetDisplayColor(displayColor);
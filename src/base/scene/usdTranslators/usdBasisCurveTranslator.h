@@ -15,7 +15,7 @@ BASE_NAMESPACE_OPEN_SCOPE
 class UsdBasisCurveTranslator final : public UsdTranslator
 {
 	public:
-		UsdBasisCurveTranslator() = default;
+		UsdBasisCurveTranslator(pxr::UsdTimeCode time = pxr::UsdTimeCode::Default()) : UsdTranslator(time) { }
 		virtual ~UsdBasisCurveTranslator() = default;
 
 		virtual void* GetObjectFromPrim(const pxr::UsdPrim& prim) override;
@@ -16,53 +16,58 @@ void* UsdCameraTranslator::GetObjectFromPrim(const pxr::UsdPrim& prim)
 {
 	BASE_TRACE();
 	Camera* camera = new Camera(prim.GetName());
+	UpdateCamera(*camera, prim);
 
+	return (void*) camera;
+}
+
+void UsdCameraTranslator::UpdateCamera(Camera& camera, const pxr::UsdPrim& prim) const
+{
+	BASE_TRACE();
 	pxr::UsdGeomCamera usdCamera(prim);
-	const AffineSpace3f affine(usdCamera.ComputeLocalToWorldTransform(pxr::UsdTimeCode::Default()));
-	camera->SetAffine(affine);
+	const AffineSpace3f affine(usdCamera.ComputeLocalToWorldTransform(m_time));
+	camera.SetAffine(affine);
 
 	pxr::TfToken projection;
-	if (GetAttribute(prim, pxr::TfToken("projection"), &projection))
-		camera->SetProjection(projection == pxr::TfToken("perspective") ? Camera::Projection::Perspective : Camera::Projection::Orthographic);
+	if (GetAttribute(prim, pxr::TfToken("projection"), &projection, m_time))
+		camera.SetProjection(projection == pxr::TfToken("perspective") ? Camera::Projection::Perspective : Camera::Projection::Orthographic);
 
 	float horizontalAperture;
-	if (GetAttribute(prim, pxr::TfToken("horizontalAperture"), &horizontalAperture))
-		camera->SetHorizontalAperature(horizontalAperture);
+	if (GetAttribute(prim, pxr::TfToken("horizontalAperture"), &horizontalAperture, m_time))
+		camera.SetHorizontalAperature(horizontalAperture);
 
 	float verticalAperture;
-	if (GetAttribute(prim, pxr::TfToken("verticalAperature"), &verticalAperture))
-		camera->SetVerticalAperature(verticalAperture);
+	if (GetAttribute(prim, pxr::TfToken("verticalAperature"), &verticalAperture, m_time))
+		camera.SetVerticalAperature(verticalAperture);
 
 	float horizontalApertureOffset;
-	if (GetAttribute(prim, pxr::TfToken("horizontalApertureOffset"), &horizontalApertureOffset))
-		camera->SetHorizontalAperatureOffset(horizontalApertureOffset);
+	if (GetAttribute(prim, pxr::TfToken("horizontalApertureOffset"), &horizontalApertureOffset, m_time))
+		camera.SetHorizontalAperatureOffset(horizontalApertureOffset);
 
 	float verticalApertureOffset;
-	if (GetAttribute(prim, pxr::TfToken("verticalApertureOffset"), &verticalApertureOffset))
-		camera->SetVerticalAperatureOffset(verticalApertureOffset);
+	if (GetAttribute(prim, pxr::TfToken("verticalApertureOffset"), &verticalApertureOffset, m_time))
+		camera.SetVerticalAperatureOffset(verticalApertureOffset);
 
 	float focalLength;
-	if (GetAttribute(prim, pxr::TfToken("focalLength"), &focalLength))
-		camera->SetFocalLength(focalLength);
+	if (GetAttribute(prim, pxr::TfToken("focalLength"), &focalLength, m_time))
+		camera.SetFocalLength(focalLength);
 
 	pxr::GfVec2f clippingRange;
-	if (GetAttribute(prim, pxr::TfToken("clippingRange"), &clippingRange))
+	if (GetAttribute(prim, pxr::TfToken("clippingRange"), &clippingRange, m_time))
 	{
-		camera->SetClose(clippingRange[0]);
-		camera->SetFar(clippingRange[1]);
+		camera.SetClose(clippingRange[0]);
+		camera.SetFar(clippingRange[1]);
 	}
 
 	// TODO: Clipping Planes
 
 	float fStop;
-	if (GetAttribute(prim, pxr::TfToken("fStop"), &fStop))
-		camera->SetFStop(fStop);
+	if (GetAttribute(prim, pxr::TfToken("fStop"), &fStop, m_time))
+		camera.SetFStop(fStop);
 
 	float focusDistance;
-	if (GetAttribute(prim, pxr::TfToken("focusDistance"), &focusDistance))
-		camera->SetFocusDistance(focusDistance);
-
-	return (void*) camera;
+	if (GetAttribute(prim, pxr::TfToken("focusDistance"), &focusDistance, m_time))
+		camera.SetFocusDistance(focusDistance);
 }
 
 BASE_NAMESPACE_CLOSE_SCOPE
@@ -10,16 +10,21 @@
 
 #include "usdTranslator.h"
 
+#include "../../camera/camera.h"
+
 BASE_NAMESPACE_OPEN_SCOPE
 
 class UsdCameraTranslator final : public UsdTranslator
 {
 	public:
-		UsdCameraTranslator() = default;
+		UsdCameraTranslator(pxr::UsdTimeCode time = pxr::UsdTimeCode::Default()) : UsdTranslator(time) { }
 		virtual ~UsdCameraTranslator() = default;
 
 		virtual void* GetObjectFromPrim(const pxr::UsdPrim& prim) override;
 
+		// Evaluate the camera attributes of the prim into an existing camera.
+		void UpdateCamera(Camera& camera, const pxr::UsdPrim& prim) const;
+
 	private:
 };
 
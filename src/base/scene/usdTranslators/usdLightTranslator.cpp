@@ -0,0 +1,75 @@
+#include "usdLightTranslator.h"
+
+#include <cmath>
+
+#include <pxr/usd/sdf/assetPath.h>
+#include <pxr/usd/usdGeom/xformable.h>
+#include <pxr/usd/usdLux/domeLight.h>
+#include <pxr/usd/usdLux/tokens.h>
+
+#include <spindulys/math/affinespace.h>
+
+#include "../../lights/envmap.h"
+#include "../../lights/portal.h"
+
+BASE_NAMESPACE_OPEN_SCOPE
+
+bool UsdLightTranslator::IsPortal(const pxr::UsdPrim& prim)
+{
+	// The schema was called LightPortal before it became PortalLight.
+	return prim.GetTypeName() == "PortalLight" || prim.GetTypeName() == "LightPortal";
+}
+
+void* UsdLightTranslator::GetObjectFromPrim(const pxr::UsdPrim& prim)
+{
+	BASE_TRACE();
+	if (IsPortal(prim))
+		return CreatePortal(prim);
+
+	const pxr::UsdLuxDomeLight dome(prim);
+	if (!dome)
+	{
+		spdlog::warn("Light {} is not supported, skipping it.", prim.GetPath().GetString());
+		return nullptr;
+	}
+
+	float intensity = 1.f;
+	float exposure = 0.f;
+	pxr::GfVec3f color(1.f);
+	dome.GetIntensityAttr().Get(&intensity, m_time);
+	dome.GetExposureAttr().Get(&exposure, m_time);
+	dome.GetColorAttr().Get(&color, m_time);
+	const Col3f scale = Col3f(color[0], color[1], color[2]) * (intensity * std::exp2(exposure));
+
+	// Without a texture the dome is lit evenly by its colour.
+	std::string filepath;
+	pxr::SdfAssetPath texture;
+	if (dome.GetTextureFileAttr().Get(&texture, m_time))
+		filepath = texture.GetResolvedPath().empty() ? texture.GetAssetPath() : texture.GetResolvedPath();
+
+	pxr::TfToken format;
+	if (!filepath.empty() && dome.GetTextureFormatAttr().Get(&format, m_time) &&
+			format != pxr::UsdLuxTokens->automatic && format != pxr::UsdLuxTokens->latlong)
+		spdlog::warn("Dome light {} has a {} texture, only latlong is supported.", prim.GetPath().GetString(), format.GetString());
+
+	const AffineSpace3f affine(dome.ComputeLocalToWorldTransform(m_time));
+
+	return (void*) new EnvmapLight(filepath, affine, scale);
+}
+
+void* UsdLightTranslator::CreatePortal(const pxr::UsdPrim& prim) const
+{
+	// Older portals have no size of their own and are scaled by their transform instead.
+	float width = 1.f;
+	float height = 1.f;
+	if (!GetAttribute(prim, pxr::TfToken("inputs:width"), &width, m_time))
+		GetAttribute(prim, pxr::TfToken("width"), &width, m_time);
+	if (!GetAttribute(prim, pxr::TfToken("inputs:height"), &height, m_time))
+		GetAttribute(prim, pxr::TfToken("height"), &height, m_time);
+
+	const AffineSpace3f affine(pxr::UsdGeomXformable(prim).ComputeLocalToWorldTransform(m_time));
+
+	return (void*) new PortalLight(affine, width, height);
+}
+
+BASE_NAMESPACE_CLOSE_SCOPE
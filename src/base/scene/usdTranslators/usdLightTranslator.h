@@ -0,0 +1,32 @@
+#ifndef USD_LIGHT_TRANSLATOR_H
+#define USD_LIGHT_TRANSLATOR_H
+
+#include <string>
+#include <mutex>
+#include <vector>
+#include <unordered_map>
+
+#include "../../spindulysBase.h"
+
+#include "usdTranslator.h"
+
+BASE_NAMESPACE_OPEN_SCOPE
+
+// Translates the UsdLux dome lights and the portals they are sampled through, returning null for the lights it does not support.
+class UsdLightTranslator final : public UsdTranslator
+{
+	public:
+		UsdLightTranslator(pxr::UsdTimeCode time = pxr::UsdTimeCode::Default()) : UsdTranslator(time) { }
+		virtual ~UsdLightTranslator() = default;
+
+		virtual void* GetObjectFromPrim(const pxr::UsdPrim& prim) override;
+
+		static bool IsPortal(const pxr::UsdPrim& prim);
+
+	private:
+		void* CreatePortal(const pxr::UsdPrim& prim) const;
+};
+
+BASE_NAMESPACE_CLOSE_SCOPE
+
+#endif // USD_LIGHT_TRANSLATOR_H
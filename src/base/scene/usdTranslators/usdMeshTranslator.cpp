@@ -1,156 +1,133 @@
 #include "usdMeshTranslator.h"
 
-#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <vector>
 
+#include <tbb/parallel_for.h>
+
+#include <pxr/pxr.h>
 #include <pxr/usd/usdGeom/mesh.h>
-#include <pxr/imaging/hd/meshUtil.h>
+#include <pxr/usd/usdGeom/tokens.h>
+#include <pxr/usd/usdShade/material.h>
+#include <pxr/usd/usdShade/materialBindingAPI.h>
+#include <pxr/usd/usdShade/shader.h>
+#if PXR_VERSION >= 2211
+#include <pxr/usd/usdLux/lightAPI.h>
+#include <pxr/usd/usdLux/meshLightAPI.h>
+#endif
 
 #include <spindulys/math/affinespace.h>
 
 #include "../../geometry/mesh.h"
+#include "../../lights/area.h"
 
 BASE_NAMESPACE_OPEN_SCOPE
 
-/* Reimplementation of some USD's Hd API functions to triangulate/quadriangulate meshes,
-	 so they can be used outside of the Hd API. */
-inline bool DoFanTriangulation(pxr::GfVec3i& triangulatedIndices,
-		const pxr::VtArray<int>& meshVertexIndices,
-		int meshVertexIndicesOffset,
-		int meshVertexIndicesIdx,
-		int meshIndicesCount,
-		bool flipWindingOrder)
+/* Fan triangulate the mesh faces into a flat triangle index list. Hole faces and faces with fewer
+	 than three vertices produce no triangles, and the winding is flipped for left handed meshes.
+	 A prefix sum over the face vertex counts gives every face its input and output offsets,
+	 so the faces themselves are triangulated in parallel straight into the preallocated output. */
+inline std::vector<int> TriangulateMeshIndices(const pxr::VtArray<int>& faceVertexCounts,
+		const pxr::VtArray<int>& faceVertexIndices,
+		const pxr::VtArray<int>& holeIndices,
+		const pxr::TfToken& orientation)
 {
-	// We check the topology.
-	if (meshVertexIndicesOffset + meshVertexIndicesIdx + 2 >= meshIndicesCount)
-	{
-		triangulatedIndices = pxr::GfVec3i(0, 0, 0);
-
-		return false;
-	}
-
-	if (flipWindingOrder)
-	{
-		triangulatedIndices = pxr::GfVec3i(meshVertexIndices[meshVertexIndicesOffset],
-				meshVertexIndices[meshVertexIndicesOffset + meshVertexIndicesIdx + 2],
-				meshVertexIndices[meshVertexIndicesOffset + meshVertexIndicesIdx + 1]);
-	}
-	else
-	{
-		triangulatedIndices = pxr::GfVec3i(meshVertexIndices[meshVertexIndicesOffset],
-				meshVertexIndices[meshVertexIndicesOffset + meshVertexIndicesIdx + 1],
-				meshVertexIndices[meshVertexIndicesOffset + meshVertexIndicesIdx + 2]);
-	}
-
-	return true;
-}
-
-inline pxr::VtVec3iArray TriangulateMeshIndices(pxr::VtArray<int>& meshVertexCounts,
-		const pxr::VtArray<int>& meshVertexIndices,
-		const pxr::VtArray<int>& meshHoleIndices,
-		const pxr::TfToken& meshOrientation)
-{
-	pxr::VtVec3iArray meshTriangulatedIndices;
-
-	int meshFacesCount = meshVertexCounts.size();
-	int meshIndicesCount = meshVertexIndices.size();
-	int meshHoleIndicesCount = meshHoleIndices.size();
-	int meshTrianglesCount = 0;
-	int meshHoleIdx = 0;
-	bool flipWindingOrder = (meshOrientation != pxr::TfToken("rightHanded"));
+	BASE_TRACE();
+	const size_t faceCount = faceVertexCounts.size();
+	const size_t indexCount = faceVertexIndices.size();
+	const bool flipWindingOrder = orientation == pxr::UsdGeomTokens->leftHanded;
+
+	// Hole indices are not required to be sorted so mark them up front.
+	std::vector<bool> holeFaces(faceCount, false);
+	for (const int holeIndex : holeIndices)
+		if (holeIndex >= 0 && static_cast<size_t>(holeIndex) < faceCount)
+			holeFaces[holeIndex] = true;
+
+	// Exclusive prefix sums of where each face starts in the input and output.
+	std::vector<size_t> faceOffsets(faceCount + 1, 0);
+	std::vector<size_t> triangleOffsets(faceCount + 1, 0);
+	bool brokenFaces = false;
 	bool invalidTopology = false;
-
-	for (int faceIdx = 0; faceIdx < meshFacesCount; ++faceIdx)
+	for (size_t faceIdx = 0; faceIdx < faceCount; ++faceIdx)
 	{
-		const int trianglesPerFace = meshVertexCounts[faceIdx] - 2;
+		const int faceVertexCount = std::max(faceVertexCounts[faceIdx], 0);
+		faceOffsets[faceIdx + 1] = faceOffsets[faceIdx] + faceVertexCount;
 
-		// We skip the broken faces
-		if (trianglesPerFace < 1)
+		size_t triangleCount = 0;
+		if (faceVertexCount < 3)
+			brokenFaces = true;
+		else if (faceOffsets[faceIdx + 1] > indexCount)
 			invalidTopology = true;
-		// We skip the hole faces
-		else if (meshHoleIdx < meshHoleIndicesCount && meshHoleIndices[meshHoleIdx] == faceIdx)
-			++meshHoleIdx;
-		else
-			meshTrianglesCount += trianglesPerFace;
+		else if (!holeFaces[faceIdx])
+			triangleCount = faceVertexCount - 2;
+
+		triangleOffsets[faceIdx + 1] = triangleOffsets[faceIdx] + triangleCount;
 	}
 
+	if (brokenFaces)
+		spdlog::warn("Broken faces have been found.");
 	if (invalidTopology)
-	{
-		std::cout << std::string("WARNING - Broken faces have been found.") << std::endl;
-		invalidTopology = false;
-	}
+		spdlog::warn("An inconsistency between the mesh faceVertexCounts and faceVertexIndices has been found.");
 
-	meshTriangulatedIndices.resize(meshTrianglesCount);
-	meshHoleIdx = 0;
+	std::vector<int> triangulatedIndices(triangleOffsets[faceCount] * 3);
 
-	for (int faceIdx = 0, triangleFaceIdx = 0, faceVertexIdx = 0; faceIdx < meshFacesCount; ++faceIdx)
+	const int* faceIndices = faceVertexIndices.cdata();
+	tbb::parallel_for(tbb::blocked_range<size_t>(0, faceCount), [&](const tbb::blocked_range<size_t>& range)
 	{
-		int faceVertexCount = meshVertexCounts[faceIdx];
-
-		if (faceVertexCount < 3)
-		{
-			// We skip the invalid triangle faces.
-		}
-		else if (meshHoleIdx < meshHoleIndicesCount && meshHoleIndices[meshHoleIdx] == faceIdx)
-		{
-			// We skip the hole faces.
-			++meshHoleIdx;
-		}
-		else
+		for (size_t faceIdx = range.begin(); faceIdx < range.end(); ++faceIdx)
 		{
-			for (int faceVertexCountIdx = 0; faceVertexCountIdx < faceVertexCount - 2; ++faceVertexCountIdx)
+			const size_t triangleCount = triangleOffsets[faceIdx + 1] - triangleOffsets[faceIdx];
+			const int* face = faceIndices + faceOffsets[faceIdx];
+
+			int* triangle = triangulatedIndices.data() + triangleOffsets[faceIdx] * 3;
+			for (size_t i = 1; i <= triangleCount; ++i, triangle += 3)
 			{
-				meshTriangulatedIndices[triangleFaceIdx] = pxr::GfVec3i(0, 0, 0);
-
-				if (!DoFanTriangulation(meshTriangulatedIndices[triangleFaceIdx],
-							meshVertexIndices,
-							faceVertexIdx,
-							faceVertexCountIdx,
-							meshIndicesCount,
-							flipWindingOrder))
-				{
-					invalidTopology = true;
-				}
-
-				if (faceVertexCount > 3)
-				{
-					if (faceVertexCountIdx == 0)
-					{
-						if (flipWindingOrder)
-						{
-							pxr::GfVec3i &triangulatedIndices = meshTriangulatedIndices[triangleFaceIdx];
-
-							triangulatedIndices.Set(triangulatedIndices[1],
-									triangulatedIndices[2],
-									triangulatedIndices[0]);
-						}
-					}
-					else if (faceVertexCountIdx == faceVertexCount - 3)
-					{
-						if (flipWindingOrder)
-						{
-							pxr::GfVec3i &triangulatedIndices = meshTriangulatedIndices[triangleFaceIdx];
-
-							triangulatedIndices.Set(triangulatedIndices[2],
-									triangulatedIndices[0],
-									triangulatedIndices[1]);
-						}
-					}
-				}
-
-				++triangleFaceIdx;
+				triangle[0] = face[0];
+				triangle[1] = face[flipWindingOrder ? i + 1 : i];
+				triangle[2] = face[flipWindingOrder ? i : i + 1];
 			}
 		}
+	});
 
-		faceVertexIdx += faceVertexCount;
-	}
+	return triangulatedIndices;
+}
 
-	if (invalidTopology)
+/* The radiance a mesh emits, taken from the mesh light API when it is applied and otherwise from the
+	 emissive colour of its bound preview surface. Black if the mesh does not emit. */
+static Col3f ComputeMeshRadiance(const pxr::UsdPrim& prim, pxr::UsdTimeCode time)
+{
+#if PXR_VERSION >= 2211
+	if (prim.HasAPI<pxr::UsdLuxMeshLightAPI>())
 	{
-		std::cout << std::string("WARNING - An inconsistency between the mesh faceVertexCounts and faceVertexIndices "
-				"has been found.") << std::endl;
+		const pxr::UsdLuxLightAPI light(prim);
+
+		float intensity = 1.f;
+		float exposure = 0.f;
+		pxr::GfVec3f color(1.f);
+		light.GetIntensityAttr().Get(&intensity, time);
+		light.GetExposureAttr().Get(&exposure, time);
+		light.GetColorAttr().Get(&color, time);
+
+		return Col3f(color[0], color[1], color[2]) * (intensity * std::exp2(exposure));
 	}
+#endif
+
+	const pxr::UsdShadeMaterial material = pxr::UsdShadeMaterialBindingAPI(prim).ComputeBoundMaterial();
+	if (!material)
+		return Col3f(zero);
 
-	return meshTriangulatedIndices;
+	const pxr::UsdShadeShader surface = material.ComputeSurfaceSource();
+	if (!surface)
+		return Col3f(zero);
+
+	// Textured emission is not supported, so only a constant colour is read.
+	pxr::GfVec3f emissiveColor(0.f);
+	const pxr::UsdShadeInput input = surface.GetInput(pxr::TfToken("emissiveColor"));
+	if (!input || !input.Get(&emissiveColor, time))
+		return Col3f(zero);
+
+	return Col3f(emissiveColor[0], emissiveColor[1], emissiveColor[2]);
 }
 
 void* UsdMeshTranslator::GetObjectFromPrim(const pxr::UsdPrim& prim)
@@ -160,75 +137,60 @@ void* UsdMeshTranslator::GetObjectFromPrim(const pxr::UsdPrim& prim)
 
 	pxr::UsdGeomMesh usdGeom(prim);
 
-	const AffineSpace3f affine(usdGeom.ComputeLocalToWorldTransform(pxr::UsdTimeCode::Default()));
+	const AffineSpace3f affine(usdGeom.ComputeLocalToWorldTransform(m_time));
 	mesh->SetTransfrom(affine);
 
 	pxr::VtArray<pxr::GfVec3f> pxrPoints;
-	if (usdGeom.GetPointsAttr().Get(&pxrPoints))
+	if (usdGeom.GetPointsAttr().Get(&pxrPoints, m_time))
+		mesh->SetPoints(ToVector<Vec3f>(pxrPoints));
+	// Animated normals are updated in place too, so the mesh can neither share its buffers nor be reordered.
+	mesh->SetDeforming(usdGeom.GetPointsAttr().ValueMightBeTimeVarying() || usdGeom.GetNormalsAttr().ValueMightBeTimeVarying());
+
+	// Only per vertex normals can be used directly, face varying ones would need the points splitting.
+	pxr::VtArray<pxr::GfVec3f> pxrNormals;
+	if (usdGeom.GetNormalsAttr().Get(&pxrNormals, m_time) && pxrNormals.size() == pxrPoints.size())
 	{
-		std::vector<Vec3f> points;
-		for (const auto& point : pxrPoints)
-			points.emplace_back(Vec3f(point[0], point[1], point[2]));
-
-		mesh->SetPoints(points);
+		const pxr::TfToken interpolation = usdGeom.GetNormalsInterpolation();
+		if (interpolation == pxr::UsdGeomTokens->vertex || interpolation == pxr::UsdGeomTokens->varying)
+			mesh->SetNormals(ToVector<Vec3f>(pxrNormals));
 	}
 
-	pxr::VtArray<int> pxrIndices;
-	if (usdGeom.GetFaceVertexIndicesAttr().Get(&pxrIndices))
+	pxr::VtArray<pxr::GfVec3f> pxrDisplayColor;
+	if (usdGeom.GetDisplayColorAttr().Get(&pxrDisplayColor, m_time) && !pxrDisplayColor.empty())
 	{
-		std::vector<int> indices;
-		for (const auto& index : pxrIndices)
-			indices.emplace_back(index);
-
-		mesh->SetIndices(indices);
+		const Col3f displayColor(pxrDisplayColor[0][0], pxrDisplayColor[0][1], pxrDisplayColor[0][2]);
+		mesh->SetDisplayColor(displayColor);
 	}
 
-	// TODO: Handle these...
-	pxr::VtArray<int> holeCount;
-	if(usdGeom.GetHoleIndicesAttr().Get(&holeCount))
-	{
-	}
+	const Col3f radiance = ComputeMeshRadiance(prim, m_time);
+	if (radiance != Col3f(zero))
+		mesh->SetLight(std::make_unique<AreaLight>(radiance));
 
-	pxr::TfToken orientation;
-	if(usdGeom.GetOrientationAttr().Get(&orientation))
-	{
-	}
+	// Triangulation
+	pxr::VtArray<int> pxrIndices;
+	usdGeom.GetFaceVertexIndicesAttr().Get(&pxrIndices, m_time);
 
-	pxr::VtArray<int> indicesCounts;
-	if (usdGeom.GetFaceVertexCountsAttr().Get(&indicesCounts))
+	// Embree and the surface interactions index the points directly, so a malformed asset cannot be let through.
+	const int pointCount = static_cast<int>(pxrPoints.size());
+	if (std::any_of(pxrIndices.cbegin(), pxrIndices.cend(), [pointCount](int index) { return index < 0 || index >= pointCount; }))
 	{
-		const size_t indexCount = pxrIndices.size() / indicesCounts.size();
-		mesh->SetMeshType(indexCount == 3 ? Mesh::MeshType::TriangleMesh : Mesh::MeshType::QuadMesh);
+		spdlog::warn("Mesh {} has face vertex indices outside of its {} points. Skipping it.", prim.GetPath().GetString(), pointCount);
+		delete mesh;
+		return nullptr;
 	}
 
-	pxr::VtArray<pxr::GfVec3f> pxrDisplayColor;
-	if (usdGeom.GetDisplayColorAttr().Get(&pxrDisplayColor))
-	{
-		const Col3f displayColor(pxrDisplayColor[0][0], pxrDisplayColor[0][1], pxrDisplayColor[0][2]);
-		mesh->SetDisplayColor(displayColor);
-	}
+	pxr::VtArray<int> pxrIndicesCounts;
+	usdGeom.GetFaceVertexCountsAttr().Get(&pxrIndicesCounts, m_time);
 
-	// Triangulation
-	// bool isTriangleMesh((static_cast<float>(pxrIndices.size()) /
-				// static_cast<float>(indicesCounts.size()) == 3.0f) ? true : false);
-	// bool isQuadMesh((static_cast<float>(pxrIndices.size()) /
-				// static_cast<float>(indicesCounts.size()) == 4.0f) ? true : false);
-	// bool needTriangulate((!isTriangleMesh && !isQuadMesh) ? true : false);
+	pxr::VtArray<int> pxrHoleIndices;
+	usdGeom.GetHoleIndicesAttr().Get(&pxrHoleIndices, m_time);
 
-	if (true)
-	{
-		const pxr::VtVec3iArray triangulated = TriangulateMeshIndices(indicesCounts, pxrIndices, holeCount, orientation);
+	// Falls back to the schema default of right handed when not authored.
+	pxr::TfToken orientation = pxr::UsdGeomTokens->rightHanded;
+	usdGeom.GetOrientationAttr().Get(&orientation, m_time);
 
-		std::vector<int> indices;
-		for (const auto& triangulatedIndices : triangulated)
-		{
-			indices.emplace_back(triangulatedIndices[0]);
-			indices.emplace_back(triangulatedIndices[1]);
-			indices.emplace_back(triangulatedIndices[2]);
-		}
-		mesh->SetIndices(indices);
-		mesh->SetMeshType(Mesh::MeshType::TriangleMesh);
-	}
+	mesh->SetIndices(TriangulateMeshIndices(pxrIndicesCounts, pxrIndices, pxrHoleIndices, orientation));
+	mesh->SetMeshType(Mesh::MeshType::TriangleMesh);
 
 	return (void*)mesh;
 }
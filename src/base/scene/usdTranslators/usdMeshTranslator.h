@@ -15,7 +15,7 @@ BASE_NAMESPACE_OPEN_SCOPE
 class UsdMeshTranslator final : public UsdTranslator
 {
 	public:
-		UsdMeshTranslator() = default;
+		UsdMeshTranslator(pxr::UsdTimeCode time = pxr::UsdTimeCode::Default()) : UsdTranslator(time) { }
 		virtual ~UsdMeshTranslator() = default;
 
 		virtual void* GetObjectFromPrim(const pxr::UsdPrim& prim) override;
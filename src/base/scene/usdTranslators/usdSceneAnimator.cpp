@@ -0,0 +1,269 @@
+#include "usdSceneAnimator.h"
+
+#include <algorithm>
+
+#include <tbb/parallel_for.h>
+
+#include <pxr/pxr.h>
+#include <pxr/usd/usd/primFlags.h>
+#include <pxr/usd/usdGeom/mesh.h>
+#include <pxr/usd/usdGeom/pointBased.h>
+#include <pxr/usd/usdGeom/tokens.h>
+#include <pxr/usd/usdGeom/xformable.h>
+#include <pxr/usd/usdSkel/binding.h>
+#include <pxr/usd/usdSkel/root.h>
+
+#include "usdCameraTranslator.h"
+#include "usdTranslator.h"
+
+#include "../scene.h"
+
+#include "../../geometry/mesh.h"
+
+BASE_NAMESPACE_OPEN_SCOPE
+
+bool UsdSceneAnimator::TransformMightBeTimeVarying(const pxr::UsdPrim& prim)
+{
+	for (pxr::UsdPrim parent = prim; parent && !parent.IsPseudoRoot(); parent = parent.GetParent())
+	{
+		const pxr::UsdGeomXformable xformable(parent);
+		if (!xformable)
+			continue;
+
+		if (xformable.TransformMightBeTimeVarying())
+			return true;
+
+		// Nothing above a reset affects the transform.
+		if (xformable.GetResetXformStack())
+			break;
+	}
+
+	return false;
+}
+
+bool UsdSceneAnimator::AddGeometry(const pxr::UsdPrim& prim, unsigned int geomID)
+{
+	std::shared_ptr<const UsdSkinnedMesh> skinned;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (const auto found = m_skinnedMeshes.find(prim.GetPath()); found != m_skinnedMeshes.end())
+		{
+			skinned = std::move(found->second);
+			m_skinnedMeshes.erase(found);
+		}
+	}
+
+	if (geomID == SPINDULYS_INVALID_GEOMETRY_ID)
+		return false;
+
+	const pxr::UsdGeomPointBased pointBased(prim);
+
+	AnimatedGeometry geometry;
+	geometry.prim = prim;
+	geometry.geomID = geomID;
+	if (skinned)
+	{
+		// The points of skinned meshes follow the skeleton rather than their own attributes.
+		geometry.transform = skinned->IsTimeVarying() || TransformMightBeTimeVarying(skinned->GetSkeletonPrim());
+		geometry.points = false;
+		geometry.normals = false;
+		geometry.skinned = std::move(skinned);
+	}
+	else
+	{
+		geometry.transform = TransformMightBeTimeVarying(prim);
+		geometry.points = pointBased.GetPointsAttr().ValueMightBeTimeVarying();
+		geometry.normals = pointBased.GetNormalsAttr().ValueMightBeTimeVarying();
+	}
+
+	if (!geometry.transform && !geometry.points && !geometry.normals)
+		return false;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_geometry.emplace_back(geometry);
+	m_prepared = false;
+
+	return true;
+}
+
+void UsdSceneAnimator::RemoveGeometry(unsigned int geomID)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_geometry.erase(std::remove_if(m_geometry.begin(), m_geometry.end(),
+				[geomID](const AnimatedGeometry& geometry) { return geometry.geomID == geomID; }),
+			m_geometry.end());
+
+	// Anything prepared no longer lines up with the geometry.
+	m_prepared = false;
+	m_samples.clear();
+}
+
+void UsdSceneAnimator::AddSkelRoot(const pxr::UsdPrim& prim)
+{
+	BASE_TRACE();
+	const pxr::UsdSkelRoot skelRoot(prim);
+	if (!skelRoot)
+		return;
+
+	std::vector<pxr::UsdSkelBinding> bindings;
+#if PXR_VERSION >= 2102
+	const auto predicate = pxr::UsdTraverseInstanceProxies();
+	if (!m_skelCache.Populate(skelRoot, predicate) || !m_skelCache.ComputeSkelBindings(skelRoot, &bindings, predicate))
+		return;
+#else
+	if (!m_skelCache.Populate(skelRoot) || !m_skelCache.ComputeSkelBindings(skelRoot, &bindings))
+		return;
+#endif
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (const pxr::UsdSkelBinding& binding : bindings)
+	{
+		const pxr::UsdSkelSkeletonQuery skelQuery = m_skelCache.GetSkelQuery(binding.GetSkeleton());
+		if (!skelQuery)
+			continue;
+
+		for (const pxr::UsdSkelSkinningQuery& skinningQuery : binding.GetSkinningTargets())
+			m_skinningBindings[skinningQuery.GetPrim().GetPath()] = { skelQuery, skinningQuery };
+	}
+}
+
+bool UsdSceneAnimator::ApplySkinning(const pxr::UsdPrim& prim, Mesh& mesh, pxr::UsdTimeCode time)
+{
+	SkinningBinding binding;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		const auto found = m_skinningBindings.find(prim.GetPath());
+		if (found == m_skinningBindings.end())
+			return false;
+		binding = found->second;
+	}
+
+	BASE_TRACE();
+	const auto skinned = std::make_shared<const UsdSkinnedMesh>(binding.skelQuery, binding.skinningQuery,
+			mesh.GetPoints(), mesh.GetNormals(), time);
+
+	std::vector<Vec3f> points;
+	std::vector<Vec3f> normals;
+	AffineSpace3f transform;
+	if (!skinned->Compute(time, points, normals, transform))
+	{
+		spdlog::warn("Could not skin {}, it is left at rest.", prim.GetPath().GetString());
+		return false;
+	}
+
+	// Whatever is left empty is unchanged from rest.
+	if (!points.empty())
+		mesh.SetPoints(std::move(points));
+	if (!normals.empty())
+		mesh.SetNormals(std::move(normals));
+	mesh.SetTransfrom(transform);
+	mesh.SetDeforming(skinned->IsDeforming());
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_skinnedMeshes[prim.GetPath()] = skinned;
+
+	return true;
+}
+
+bool UsdSceneAnimator::IsSkinned(const pxr::SdfPath& path) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_skinningBindings.find(path) != m_skinningBindings.end();
+}
+
+bool UsdSceneAnimator::AddCamera(const pxr::UsdPrim& prim, size_t cameraIndex)
+{
+	bool animated = TransformMightBeTimeVarying(prim);
+	for (const pxr::UsdAttribute& attr : prim.GetAuthoredAttributes())
+		animated |= attr.ValueMightBeTimeVarying();
+
+	if (!animated)
+		return false;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_cameras.push_back({ prim, cameraIndex });
+
+	return true;
+}
+
+void UsdSceneAnimator::Prepare(double time)
+{
+	BASE_TRACE();
+	const pxr::UsdTimeCode timeCode(time);
+
+	m_samples.resize(m_geometry.size());
+	tbb::parallel_for(size_t(0), m_geometry.size(), [&](size_t geometryIdx)
+	{
+		const AnimatedGeometry& geometry = m_geometry[geometryIdx];
+		GeometrySample& sample = m_samples[geometryIdx];
+		const pxr::UsdGeomPointBased pointBased(geometry.prim);
+
+		if (geometry.skinned)
+		{
+			geometry.skinned->Compute(timeCode, sample.points, sample.normals, sample.transform);
+			// Only the transform of meshes which are not deforming can change, and their points cannot be updated.
+			if (!geometry.skinned->IsDeforming())
+			{
+				sample.points.clear();
+				sample.normals.clear();
+			}
+			return;
+		}
+
+		if (geometry.transform)
+			sample.transform = AffineSpace3f(pointBased.ComputeLocalToWorldTransform(timeCode));
+
+		sample.points.clear();
+		pxr::VtArray<pxr::GfVec3f> pxrPoints;
+		if (geometry.points && pointBased.GetPointsAttr().Get(&pxrPoints, timeCode))
+			sample.points = UsdTranslator::ToVector<Vec3f>(pxrPoints);
+
+		sample.normals.clear();
+		pxr::VtArray<pxr::GfVec3f> pxrNormals;
+		if (geometry.normals && pointBased.GetNormalsAttr().Get(&pxrNormals, timeCode))
+		{
+			// Mirrors what the translators accept, face varying mesh normals are ignored.
+			const pxr::TfToken interpolation = pointBased.GetNormalsInterpolation();
+			if (!geometry.prim.IsA<pxr::UsdGeomMesh>() ||
+					interpolation == pxr::UsdGeomTokens->vertex || interpolation == pxr::UsdGeomTokens->varying)
+				sample.normals = UsdTranslator::ToVector<Vec3f>(pxrNormals);
+		}
+	});
+
+	m_prepared = true;
+	m_preparedTime = time;
+}
+
+bool UsdSceneAnimator::SetTime(Scene* scene, double time)
+{
+	BASE_TRACE();
+	m_time = time;
+	if (!m_prepared || m_preparedTime != time)
+		Prepare(time);
+
+	// Every geometry is only touched by one task, and the scene allows updates to different geometry in parallel.
+	tbb::parallel_for(size_t(0), m_geometry.size(), [&](size_t geometryIdx)
+	{
+		const AnimatedGeometry& geometry = m_geometry[geometryIdx];
+		const GeometrySample& sample = m_samples[geometryIdx];
+
+		if (geometry.transform)
+			scene->UpdateGeometryTransform(geometry.geomID, sample.transform);
+		if (!sample.points.empty())
+			scene->UpdateGeometryPoints(geometry.geomID, sample.points);
+		if (!sample.normals.empty())
+			scene->UpdateGeometryNormals(geometry.geomID, sample.normals);
+	});
+
+	// The samples are a copy of every animated point, so do not keep them around once applied.
+	m_prepared = false;
+	m_samples.clear();
+
+	const UsdCameraTranslator cameraTranslator((pxr::UsdTimeCode(time)));
+	for (const AnimatedCamera& camera : m_cameras)
+		cameraTranslator.UpdateCamera(scene->UpdateCamera(camera.cameraIndex), camera.prim);
+
+	return IsAnimated();
+}
+
+BASE_NAMESPACE_CLOSE_SCOPE
@@ -0,0 +1,114 @@
+#ifndef USD_SCENE_ANIMATOR_H
+#define USD_SCENE_ANIMATOR_H
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <pxr/usd/usd/stage.h>
+#include <pxr/usd/usd/prim.h>
+#include <pxr/usd/usdSkel/cache.h>
+
+#include <spindulys/math/affinespace.h>
+#include <spindulys/math/vec3.h>
+
+#include "../../spindulysBase.h"
+
+#include "../sceneAnimator.h"
+
+#include "usdSkinnedMesh.h"
+
+BASE_NAMESPACE_OPEN_SCOPE
+
+class Mesh;
+
+// Keeps the stage alive along with the time varying prims found while loading it,
+// so that only those are re-read when the frame changes.
+class UsdSceneAnimator final : public SceneAnimator
+{
+	public:
+		UsdSceneAnimator(const pxr::UsdStageRefPtr& stage, double time) : m_stage(stage), m_time(time) { }
+		virtual ~UsdSceneAnimator() = default;
+
+		// Thread safe. Returns true if the prim is animated and has been added.
+		bool AddGeometry(const pxr::UsdPrim& prim, unsigned int geomID);
+		bool AddCamera(const pxr::UsdPrim& prim, size_t cameraIndex);
+		// Stop animating geometry which has been removed from the scene.
+		void RemoveGeometry(unsigned int geomID);
+
+		// Thread safe. Find the meshes bound to the skeletons beneath the root, which must be added
+		// before any of those meshes are created.
+		void AddSkelRoot(const pxr::UsdPrim& prim);
+		// Pose a mesh bound to a skeleton at the given time, replacing its rest points, normals and transform.
+		// Returns false if the mesh is not bound to a skeleton. Thread safe.
+		bool ApplySkinning(const pxr::UsdPrim& prim, Mesh& mesh, pxr::UsdTimeCode time);
+		bool IsSkinned(const pxr::SdfPath& path) const;
+
+		// The time the stage was last set to.
+		double GetTime() const { return m_time; }
+
+		virtual void Prepare(double time) override;
+		virtual bool SetTime(Scene* scene, double time) override;
+
+		virtual bool IsAnimated() const override { return !m_geometry.empty() || !m_cameras.empty(); }
+		virtual double GetStartTime() const override { return m_stage->GetStartTimeCode(); }
+		virtual double GetEndTime() const override { return m_stage->GetEndTimeCode(); }
+
+	private:
+		struct AnimatedGeometry
+		{
+			pxr::UsdPrim prim;
+			unsigned int geomID;
+
+			bool transform;
+			bool points;
+			bool normals;
+
+			// Set for meshes posed by a skeleton, which replaces reading their points and normals.
+			std::shared_ptr<const UsdSkinnedMesh> skinned;
+		};
+
+		struct AnimatedCamera
+		{
+			pxr::UsdPrim prim;
+			size_t cameraIndex;
+		};
+
+		// The values of one AnimatedGeometry at the prepared time, empty if not animated or not authored.
+		struct GeometrySample
+		{
+			AffineSpace3f transform;
+			std::vector<Vec3f> points;
+			std::vector<Vec3f> normals;
+		};
+
+		// Whether the prim or any of the ancestors it inherits its transform from are animated.
+		static bool TransformMightBeTimeVarying(const pxr::UsdPrim& prim);
+
+		pxr::UsdStageRefPtr m_stage;
+		double m_time;
+
+		mutable std::mutex m_mutex;
+		std::vector<AnimatedGeometry> m_geometry;
+		std::vector<AnimatedCamera> m_cameras;
+
+		struct SkinningBinding
+		{
+			pxr::UsdSkelSkeletonQuery skelQuery;
+			pxr::UsdSkelSkinningQuery skinningQuery;
+		};
+
+		pxr::UsdSkelCache m_skelCache;
+		std::map<pxr::SdfPath, SkinningBinding> m_skinningBindings;
+		// Skinned meshes created by ApplySkinning, until their geometry is added.
+		std::map<pxr::SdfPath, std::shared_ptr<const UsdSkinnedMesh>> m_skinnedMeshes;
+
+		bool m_prepared = false;
+		double m_preparedTime = 0.0;
+		std::vector<GeometrySample> m_samples;
+};
+
+BASE_NAMESPACE_CLOSE_SCOPE
+
+#endif // USD_SCENE_ANIMATOR_H
@@ -1,8 +1,23 @@
 #include "usdSceneLoader.h"
 
+#include <vector>
+
+#include <tbb/parallel_for_each.h>
+
+#include <pxr/usd/ar/packageUtils.h>
+#include <pxr/usd/usd/primRange.h>
+#include <pxr/usd/usd/stagePopulationMask.h>
+#include <pxr/usd/usdGeom/imageable.h>
+#include <pxr/usd/usdGeom/tokens.h>
+#include <pxr/usd/usdLux/domeLight.h>
+#include <pxr/usd/usdSkel/root.h>
+
 #include "usdCameraTranslator.h"
+#include "usdLightTranslator.h"
 #include "usdMeshTranslator.h"
 #include "usdBasisCurveTranslator.h"
+#include "usdSceneAnimator.h"
+#include "usdStageWatcher.h"
 
 #include "../../camera/camera.h"
 #include "../../geometry/mesh.h"
@@ -15,13 +30,55 @@ bool UsdSceneLoader::LoadScene(const std::string& filepath)
 	BASE_TRACE();
 	// We assume that the incoming scene is a valid usd scene.
 
+	// The stage is opened without any payloads so that only the ones which are needed get loaded.
 	BASE_BEGIN("LOAD USD STAGE");
-	const pxr::UsdStageRefPtr stage = pxr::UsdStage::Open(filepath);
+	pxr::UsdStageRefPtr stage;
+	if (m_options.m_populationMask.empty())
+	{
+		stage = pxr::UsdStage::Open(filepath, pxr::UsdStage::LoadNone);
+	}
+	else
+	{
+		pxr::UsdStagePopulationMask mask;
+		for (const std::string& path : m_options.m_populationMask)
+			mask.Add(pxr::SdfPath(path));
+
+		stage = pxr::UsdStage::OpenMasked(filepath, mask, pxr::UsdStage::LoadNone);
+	}
+	BASE_END("LOAD USD STAGE");
+
 	if (!stage)
 		return false;
-	BASE_END("LOAD USD STAGE");
 
-	LoadPrims(stage, pxr::SdfPath("/"));
+	// Animated stages are loaded at their first frame.
+	m_time = stage->HasAuthoredTimeCodeRange() ? pxr::UsdTimeCode(stage->GetStartTimeCode()) : pxr::UsdTimeCode::Default();
+
+	if (m_options.m_loadPayloads)
+		LoadPayloads(stage);
+
+	// The stage stays open after loading so that it can be animated and edited.
+	UsdSceneAnimator* animator = new UsdSceneAnimator(stage, stage->GetStartTimeCode());
+	UsdStageWatcher* watcher = m_options.m_watchEdits ? new UsdStageWatcher(stage, m_options, m_time, animator) : nullptr;
+	LoadPrims(stage, animator, watcher);
+
+	// A cache only holds the first frame, and nothing loaded from it is tied back to the stage.
+	if (animator->IsAnimated())
+		SetUncacheable("the stage is animated");
+	else if (watcher)
+		SetUncacheable("edits to the stage are followed");
+
+	// Sublayers, references and payloads change the scene as much as the root layer does. Layers inside a
+	// package are tracked through the package file, and in memory layers have no file to track.
+	for (const pxr::SdfLayerHandle& layer : stage->GetUsedLayers())
+	{
+		const std::string realPath = layer->GetRealPath();
+		if (!realPath.empty())
+			AddDependency(pxr::ArIsPackageRelativePath(realPath) ? pxr::ArSplitPackageRelativePathOuter(realPath).first : realPath);
+	}
+
+	m_scene->AddAnimator(animator);
+	if (watcher)
+		m_scene->AddWatcher(watcher);
 
 	m_scene->AddFilePath(filepath);
 	BASE_BEGIN("COMMIT SCENE");
@@ -31,32 +88,142 @@ bool UsdSceneLoader::LoadScene(const std::string& filepath)
 	return true;
 }
 
-bool UsdSceneLoader::LoadPrims(const pxr::UsdStagePtr& stage, const pxr::SdfPath& primPath)
+bool UsdSceneLoader::SkipPrim(const pxr::UsdPrim& prim, const SceneLoadOptions& options, pxr::UsdTimeCode time)
+{
+	const pxr::UsdGeomImageable imageable(prim);
+	if (!imageable)
+		return false;
+
+	// Both visibility and purpose are inherited, so a skipped prim takes its descendants with it.
+	if (options.m_skipInvisible)
+	{
+		pxr::TfToken visibility;
+		if (imageable.GetVisibilityAttr().Get(&visibility, time) && visibility == pxr::UsdGeomTokens->invisible)
+			return true;
+	}
+
+	if (options.m_renderPurposeOnly)
+	{
+		pxr::TfToken purpose;
+		if (imageable.GetPurposeAttr().Get(&purpose, time) &&
+				(purpose == pxr::UsdGeomTokens->proxy || purpose == pxr::UsdGeomTokens->guide))
+			return true;
+	}
+
+	return false;
+}
+
+void UsdSceneLoader::LoadPayloads(const pxr::UsdStagePtr& stage)
 {
 	BASE_TRACE();
-	const pxr::UsdPrim basePrim = stage->GetPrimAtPath(primPath);
+	// Loading a payload can bring in further payloads, so they are loaded a level at a time.
+	const pxr::Usd_PrimFlagsConjunction predicate = pxr::UsdPrimIsActive && pxr::UsdPrimIsDefined && !pxr::UsdPrimIsAbstract;
+	for (;;)
+	{
+		pxr::SdfPathSet payloads;
+
+		const pxr::UsdPrimRange range = pxr::UsdPrimRange::Stage(stage, predicate);
+		for (auto it = range.begin(); it != range.end(); ++it)
+		{
+			if (SkipPrim(*it, m_options, m_time))
+			{
+				it.PruneChildren();
+			}
+			else if (it->HasAuthoredPayloads() && !it->IsLoaded())
+			{
+				payloads.insert(it->GetPath());
+				it.PruneChildren();
+			}
+		}
+
+		if (payloads.empty())
+			break;
+
+		stage->LoadAndUnload(payloads, pxr::SdfPathSet(), pxr::UsdLoadWithoutDescendants);
+	}
+}
 
-	for(const pxr::UsdPrim& prim: basePrim.GetChildren())
+unsigned int UsdSceneLoader::CreateGeometry(Scene* scene, const pxr::UsdPrim& prim, pxr::UsdTimeCode time,
+		UsdSceneAnimator* animator, SceneRecorder* recorder)
+{
+	if (prim.GetTypeName() == "Mesh")
 	{
-		if (prim.GetTypeName() == "Camera")
+		if (UsdMeshTranslator trans(time); Mesh* mesh = (Mesh*)trans.GetObjectFromPrim(prim))
 		{
-			if (UsdCameraTranslator trans; Camera* camera = (Camera*)trans.GetObjectFromPrim(prim))
-				m_scene->AddCamera(camera);
+			if (animator)
+				animator->ApplySkinning(prim, *mesh, time);
+			return AddGeometry(scene, mesh, recorder);
 		}
-		else if (prim.GetTypeName() == "Mesh")
+	}
+	else if (prim.GetTypeName() == "BasisCurves")
+	{
+		if (UsdBasisCurveTranslator trans(time); Curve* curve = (Curve*)trans.GetObjectFromPrim(prim))
+			return AddGeometry(scene, curve, recorder);
+	}
+
+	return SPINDULYS_INVALID_GEOMETRY_ID;
+}
+
+bool UsdSceneLoader::LoadPrims(const pxr::UsdStagePtr& stage, UsdSceneAnimator* animator, UsdStageWatcher* watcher)
+{
+	BASE_TRACE();
+	// Cameras and lights are added while traversing so they keep their stage order,
+	// the geometry prims are gathered and then translated in parallel.
+	std::vector<pxr::UsdPrim> geometryPrims;
+
+	BASE_BEGIN("TRAVERSE USD STAGE");
+	const pxr::UsdPrimRange range = pxr::UsdPrimRange::Stage(stage);
+	for (auto it = range.begin(); it != range.end(); ++it)
+	{
+		const pxr::UsdPrim& prim = *it;
+		if (SkipPrim(prim, m_options, m_time))
 		{
-			if (UsdMeshTranslator trans; Mesh* mesh = (Mesh*)trans.GetObjectFromPrim(prim))
-				m_scene->CreateGeomerty(mesh);
+			it.PruneChildren();
 		}
-		else if (prim.GetTypeName() == "BasisCurves")
+		else if (prim.GetTypeName() == "Camera")
 		{
-			if (UsdBasisCurveTranslator trans; Curve* curve = (Curve*)trans.GetObjectFromPrim(prim))
-				m_scene->CreateGeomerty(curve);
+			if (UsdCameraTranslator trans(m_time); Camera* camera = (Camera*)trans.GetObjectFromPrim(prim))
+			{
+				const size_t cameraIndex = AddCamera(camera);
+				animator->AddCamera(prim, cameraIndex);
+				if (watcher)
+					watcher->AddCamera(prim, cameraIndex);
+			}
+		}
+		else if (prim.IsA<pxr::UsdLuxDomeLight>() || UsdLightTranslator::IsPortal(prim))
+		{
+			if (UsdLightTranslator trans(m_time); Light* light = (Light*)trans.GetObjectFromPrim(prim))
+			{
+				const unsigned int lightID = AddLight(light);
+				if (watcher)
+					watcher->AddLight(prim, lightID);
+			}
+		}
+		else if (prim.GetTypeName() == "Mesh" || prim.GetTypeName() == "BasisCurves")
+		{
+			geometryPrims.emplace_back(prim);
+		}
+		else if (prim.IsA<pxr::UsdSkelRoot>())
+		{
+			// Skinned meshes are beneath their root, so the bindings are known before they are created.
+			animator->AddSkelRoot(prim);
 		}
-
-		if (prim.GetChildren())
-			LoadPrims(stage, prim.GetPath());
 	}
+	BASE_END("TRAVERSE USD STAGE");
+
+	m_scene->ExpectGeometry(geometryPrims.size());
+
+	// Reading from the stage is thread safe and CreateGeomerty only locks the scene to register the
+	// finished geometry, so the attribute reads, triangulation and BVH builds all run concurrently.
+	BASE_BEGIN("TRANSLATE USD PRIMS");
+	tbb::parallel_for_each(geometryPrims.begin(), geometryPrims.end(), [&](const pxr::UsdPrim& prim)
+	{
+		const unsigned int geomID = CreateGeometry(m_scene, prim, m_time, animator, m_recorder);
+		animator->AddGeometry(prim, geomID);
+		if (watcher)
+			watcher->AddGeometry(prim, geomID);
+	});
+	BASE_END("TRANSLATE USD PRIMS");
 
 	return true;
 }
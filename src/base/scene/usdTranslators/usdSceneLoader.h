@@ -11,16 +11,31 @@
 
 BASE_NAMESPACE_OPEN_SCOPE
 
+class UsdSceneAnimator;
+class UsdStageWatcher;
+
 class UsdSceneLoader final : public SceneLoader
 {
 	public:
-		UsdSceneLoader(Scene* scene) : SceneLoader(scene) { };
+		UsdSceneLoader(Scene* scene, const SceneLoadOptions& options = SceneLoadOptions()) : SceneLoader(scene, options) { };
 		~UsdSceneLoader() = default;
 
 		virtual bool LoadScene(const std::string& filepath) override;
 
+		// Whether the prim and everything beneath it is excluded by the load options.
+		static bool SkipPrim(const pxr::UsdPrim& prim, const SceneLoadOptions& options, pxr::UsdTimeCode time);
+		// Translate a Mesh or BasisCurves prim into the scene, posing meshes bound to a skeleton of the animator.
+		// Returns the id of the new geometry, or SPINDULYS_INVALID_GEOMETRY_ID if nothing was created.
+		static unsigned int CreateGeometry(Scene* scene, const pxr::UsdPrim& prim, pxr::UsdTimeCode time,
+				UsdSceneAnimator* animator, SceneRecorder* recorder = nullptr);
+
 	private:
-		bool LoadPrims(const pxr::UsdStagePtr& stage, const pxr::SdfPath& primPath);
+		void LoadPayloads(const pxr::UsdStagePtr& stage);
+		// Prims are registered with the animator, and the watcher when edits are followed, as they are created.
+		bool LoadPrims(const pxr::UsdStagePtr& stage, UsdSceneAnimator* animator, UsdStageWatcher* watcher);
+
+		// The time the stage is loaded at.
+		pxr::UsdTimeCode m_time = pxr::UsdTimeCode::Default();
 };
 
 BASE_NAMESPACE_CLOSE_SCOPE
@@ -0,0 +1,206 @@
+#include "usdSkinnedMesh.h"
+
+#include <tbb/parallel_for.h>
+
+#include <pxr/usd/usdSkel/animQuery.h>
+#include <pxr/usd/usdSkel/animMapper.h>
+#include <pxr/usd/usdSkel/bindingAPI.h>
+#include <pxr/usd/usdSkel/skeleton.h>
+
+BASE_NAMESPACE_OPEN_SCOPE
+
+UsdSkinnedMesh::UsdSkinnedMesh(const pxr::UsdSkelSkeletonQuery& skelQuery,
+		const pxr::UsdSkelSkinningQuery& skinningQuery,
+		const std::vector<Vec3f>& restPoints,
+		const std::vector<Vec3f>& restNormals,
+		pxr::UsdTimeCode time)
+	: m_skelQuery(skelQuery)
+	, m_skinningQuery(skinningQuery)
+	, m_restPoints(restPoints)
+	, m_restNormals(restNormals)
+{
+	BASE_TRACE();
+	if (!m_skelQuery || !m_skinningQuery.IsValid() || !m_skinningQuery.HasJointInfluences())
+		return;
+
+	pxr::VtIntArray jointIndices;
+	pxr::VtFloatArray jointWeights;
+	if (!m_skinningQuery.ComputeJointInfluences(&jointIndices, &jointWeights, time))
+		return;
+
+	m_rigid = m_skinningQuery.IsRigidlyDeformed();
+	m_influenceCount = m_skinningQuery.GetNumInfluencesPerComponent();
+	const size_t componentCount = m_rigid ? 1 : m_restPoints.size();
+	if (m_influenceCount < 1 || jointIndices.size() != componentCount * m_influenceCount || jointWeights.size() != jointIndices.size())
+		return;
+
+	// The influences refer to the joint order of the mesh, which can differ from the skeleton's.
+	pxr::VtTokenArray jointOrder;
+	m_jointCount = m_skinningQuery.GetJointOrder(&jointOrder) ? jointOrder.size() : m_skelQuery.GetJointOrder().size();
+
+	m_jointIndices.assign(jointIndices.begin(), jointIndices.end());
+	m_jointWeights.assign(jointWeights.begin(), jointWeights.end());
+	tbb::parallel_for(tbb::blocked_range<size_t>(0, componentCount), [&](const tbb::blocked_range<size_t>& range)
+	{
+		for (size_t component = range.begin(); component != range.end(); ++component)
+		{
+			int* indices = m_jointIndices.data() + component * m_influenceCount;
+			float* weights = m_jointWeights.data() + component * m_influenceCount;
+
+			float weightSum = 0.f;
+			for (int i = 0; i < m_influenceCount; ++i)
+			{
+				if (indices[i] < 0 || static_cast<size_t>(indices[i]) >= m_jointCount)
+				{
+					indices[i] = 0;
+					weights[i] = 0.f;
+				}
+				weightSum += weights[i];
+			}
+
+			const float normalise = weightSum > 0.f ? 1.f / weightSum : 0.f;
+			for (int i = 0; i < m_influenceCount; ++i)
+				weights[i] *= normalise;
+		}
+	});
+
+	m_geomBindTransform = AffineSpace3f(m_skinningQuery.GetGeomBindTransform(time));
+
+	if (m_skinningQuery.HasBlendShapes())
+	{
+		m_blendShapeQuery = pxr::UsdSkelBlendShapeQuery(pxr::UsdSkelBindingAPI(m_skinningQuery.GetPrim()));
+		m_blendShapePointIndices = m_blendShapeQuery.ComputeBlendShapePointIndices();
+		m_subShapeOffsets = m_blendShapeQuery.ComputeSubShapePointOffsets();
+	}
+
+	const pxr::UsdSkelAnimQuery& animQuery = m_skelQuery.GetAnimQuery();
+	m_timeVarying = animQuery && (animQuery.JointTransformsMightBeTimeVarying() ||
+			(!m_subShapeOffsets.empty() && animQuery.BlendShapeWeightsMightBeTimeVarying()));
+
+	m_valid = true;
+}
+
+void UsdSkinnedMesh::ApplyBlendShapes(pxr::UsdTimeCode time, std::vector<Vec3f>& points) const
+{
+	BASE_TRACE();
+	const pxr::UsdSkelAnimQuery& animQuery = m_skelQuery.GetAnimQuery();
+
+	pxr::VtFloatArray animWeights;
+	if (!animQuery || !animQuery.ComputeBlendShapeWeights(&animWeights, time))
+		return;
+
+	pxr::VtFloatArray weights = animWeights;
+	if (const pxr::UsdSkelAnimMapperRefPtr& mapper = m_skinningQuery.GetBlendShapeMapper())
+		if (!mapper->Remap(animWeights, &weights))
+			return;
+
+	// Inbetween shapes turn every blend shape weight into weights of up to two sub shapes.
+	pxr::VtFloatArray subShapeWeights;
+	pxr::VtUIntArray blendShapeIndices;
+	pxr::VtUIntArray subShapeIndices;
+	if (!m_blendShapeQuery.ComputeSubShapeWeights(weights, &subShapeWeights, &blendShapeIndices, &subShapeIndices))
+		return;
+
+	for (size_t i = 0; i < subShapeWeights.size(); ++i)
+	{
+		const float weight = subShapeWeights[i];
+		if (weight == 0.f || blendShapeIndices[i] >= m_blendShapePointIndices.size() || subShapeIndices[i] >= m_subShapeOffsets.size())
+			continue;
+
+		const pxr::VtIntArray& pointIndices = m_blendShapePointIndices[blendShapeIndices[i]];
+		const pxr::VtVec3fArray& offsets = m_subShapeOffsets[subShapeIndices[i]];
+
+		// Each point is only offset once per shape, so the points of a shape are offset in parallel.
+		tbb::parallel_for(tbb::blocked_range<size_t>(0, offsets.size()), [&](const tbb::blocked_range<size_t>& range)
+		{
+			for (size_t offset = range.begin(); offset != range.end(); ++offset)
+			{
+				const size_t point = pointIndices.empty() ? offset : static_cast<size_t>(pointIndices[offset]);
+				if (point < points.size())
+					points[point] += weight * Vec3f(offsets[offset][0], offsets[offset][1], offsets[offset][2]);
+			}
+		});
+	}
+}
+
+bool UsdSkinnedMesh::Compute(pxr::UsdTimeCode time,
+		std::vector<Vec3f>& points,
+		std::vector<Vec3f>& normals,
+		AffineSpace3f& transform) const
+{
+	BASE_TRACE();
+	points.clear();
+	normals.clear();
+	if (!m_valid)
+		return false;
+
+	transform = AffineSpace3f(m_skelQuery.GetSkeleton().ComputeLocalToWorldTransform(time));
+
+	pxr::VtMatrix4dArray skelTransforms;
+	if (!m_skelQuery.ComputeSkinningTransforms(&skelTransforms, time))
+		return false;
+
+	pxr::VtMatrix4dArray skinningTransforms = skelTransforms;
+	if (const pxr::UsdSkelAnimMapperRefPtr& mapper = m_skinningQuery.GetJointMapper())
+		if (!mapper->RemapTransforms(skelTransforms, &skinningTransforms))
+			return false;
+
+	if (skinningTransforms.size() < m_jointCount)
+		return false;
+
+	// Moves the rest points into the space of the skeleton and then along with each joint.
+	std::vector<AffineSpace3f> joints(m_jointCount);
+	for (size_t joint = 0; joint < m_jointCount; ++joint)
+		joints[joint] = AffineSpace3f(skinningTransforms[joint]) * m_geomBindTransform;
+
+	// Blend shapes are applied at rest, before skinning.
+	const bool blendShapes = !m_subShapeOffsets.empty();
+	if (blendShapes)
+	{
+		points.reserve(m_restPoints.size() + 1);
+		points = m_restPoints;
+		ApplyBlendShapes(time, points);
+	}
+
+	const auto blendJoints = [&](size_t component)
+	{
+		const int* indices = m_jointIndices.data() + component * m_influenceCount;
+		const float* weights = m_jointWeights.data() + component * m_influenceCount;
+
+		AffineSpace3f blended(zero);
+		for (int i = 0; i < m_influenceCount; ++i)
+			blended = blended + weights[i] * joints[indices[i]];
+		return blended;
+	};
+
+	if (m_rigid)
+	{
+		transform = transform * blendJoints(0);
+		return true;
+	}
+
+	if (!blendShapes)
+	{
+		// One extra point is reserved as Embree reads vertex buffers with 16 byte loads.
+		points.reserve(m_restPoints.size() + 1);
+		points.resize(m_restPoints.size());
+	}
+	const bool skinNormals = m_restNormals.size() == m_restPoints.size();
+	if (skinNormals)
+		normals.resize(m_restNormals.size());
+
+	tbb::parallel_for(tbb::blocked_range<size_t>(0, m_restPoints.size()), [&](const tbb::blocked_range<size_t>& range)
+	{
+		for (size_t point = range.begin(); point != range.end(); ++point)
+		{
+			const AffineSpace3f blended = blendJoints(point);
+			points[point] = xfmPoint(blended, blendShapes ? points[point] : m_restPoints[point]);
+			if (skinNormals)
+				normals[point] = normalize(xfmNormal(blended, m_restNormals[point]));
+		}
+	});
+
+	return true;
+}
+
+BASE_NAMESPACE_CLOSE_SCOPE
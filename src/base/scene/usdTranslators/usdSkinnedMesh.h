@@ -0,0 +1,69 @@
+#ifndef USD_SKINNED_MESH_H
+#define USD_SKINNED_MESH_H
+
+#include <vector>
+
+#include <pxr/usd/usdSkel/skeletonQuery.h>
+#include <pxr/usd/usdSkel/skinningQuery.h>
+#include <pxr/usd/usdSkel/blendShapeQuery.h>
+
+#include <spindulys/math/affinespace.h>
+#include <spindulys/math/vec3.h>
+
+#include "../../spindulysBase.h"
+
+BASE_NAMESPACE_OPEN_SCOPE
+
+/* Linear blend skinning and blend shapes of a mesh bound to a UsdSkel skeleton.
+	 Everything which cannot change over time, the rest points, the joint influences and the blend shape
+	 offsets, is read once when the mesh is created, so posing it only reads the joint transforms and
+	 blend shape weights. Posed points are in the space of the skeleton, which becomes the mesh transform. */
+class UsdSkinnedMesh
+{
+	public:
+		UsdSkinnedMesh(const pxr::UsdSkelSkeletonQuery& skelQuery,
+				const pxr::UsdSkelSkinningQuery& skinningQuery,
+				const std::vector<Vec3f>& restPoints,
+				const std::vector<Vec3f>& restNormals,
+				pxr::UsdTimeCode time);
+
+		bool IsValid() const { return m_valid; }
+		// Whether the joints or blend shape weights are animated.
+		bool IsTimeVarying() const { return m_timeVarying; }
+		// Rigidly deformed meshes only ever move as a whole, so only their transform changes.
+		bool IsDeforming() const { return m_timeVarying && (!m_rigid || !m_subShapeOffsets.empty()); }
+		pxr::UsdPrim GetSkeletonPrim() const { return m_skelQuery.GetPrim(); }
+
+		// Pose the mesh at the given time. The points and normals are left empty when they are unchanged from rest.
+		bool Compute(pxr::UsdTimeCode time, std::vector<Vec3f>& points, std::vector<Vec3f>& normals, AffineSpace3f& transform) const;
+
+	private:
+		// Add the weighted blend shape offsets onto the points.
+		void ApplyBlendShapes(pxr::UsdTimeCode time, std::vector<Vec3f>& points) const;
+
+		pxr::UsdSkelSkeletonQuery m_skelQuery;
+		pxr::UsdSkelSkinningQuery m_skinningQuery;
+		pxr::UsdSkelBlendShapeQuery m_blendShapeQuery;
+
+		std::vector<Vec3f> m_restPoints;
+		std::vector<Vec3f> m_restNormals;
+
+		// m_influenceCount joints per point, or a single set for the whole mesh when rigid.
+		// The weights of every point are normalised and out of range joints have no weight.
+		int m_influenceCount = 0;
+		std::vector<int> m_jointIndices;
+		std::vector<float> m_jointWeights;
+		size_t m_jointCount = 0;
+		AffineSpace3f m_geomBindTransform = AffineSpace3f(one);
+
+		std::vector<pxr::VtIntArray> m_blendShapePointIndices;
+		std::vector<pxr::VtVec3fArray> m_subShapeOffsets;
+
+		bool m_valid = false;
+		bool m_rigid = false;
+		bool m_timeVarying = false;
+};
+
+BASE_NAMESPACE_CLOSE_SCOPE
+
+#endif // USD_SKINNED_MESH_H
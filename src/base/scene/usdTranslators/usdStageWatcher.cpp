@@ -0,0 +1,393 @@
+#include "usdStageWatcher.h"
+
+#include <algorithm>
+
+#include <tbb/parallel_for_each.h>
+
+#include <pxr/base/tf/stringUtils.h>
+#include <pxr/usd/usd/primRange.h>
+#include <pxr/usd/usdGeom/pointBased.h>
+#include <pxr/usd/usdGeom/tokens.h>
+#include <pxr/usd/usdGeom/xformable.h>
+#include <pxr/usd/usdLux/domeLight.h>
+#if PXR_VERSION >= 2211
+#include <pxr/usd/usdLux/lightAPI.h>
+#endif
+#include <pxr/usd/usdShade/material.h>
+#include <pxr/usd/usdShade/shader.h>
+#include <pxr/usd/usdSkel/root.h>
+
+#include <spindulys/math/affinespace.h>
+
+#include "usdCameraTranslator.h"
+#include "usdLightTranslator.h"
+#include "usdSceneAnimator.h"
+#include "usdSceneLoader.h"
+#include "usdTranslator.h"
+
+#include "../scene.h"
+
+BASE_NAMESPACE_OPEN_SCOPE
+
+// How often the layers on disk are checked for edits.
+static constexpr std::chrono::milliseconds kLayerCheckInterval(500);
+
+static bool IsSupportedLight(const pxr::UsdPrim& prim)
+{
+	return prim.IsA<pxr::UsdLuxDomeLight>() || UsdLightTranslator::IsPortal(prim);
+}
+
+// Lights the loaders create nothing from, apart from the mesh lights, which are created with their mesh.
+static bool IsUnsupportedLight(const pxr::UsdPrim& prim)
+{
+	if (IsSupportedLight(prim))
+		return false;
+#if PXR_VERSION >= 2211
+	return prim.HasAPI<pxr::UsdLuxLightAPI>();
+#else
+	return pxr::TfStringEndsWith(prim.GetTypeName().GetString(), "Light");
+#endif
+}
+
+UsdStageWatcher::UsdStageWatcher(const pxr::UsdStageRefPtr& stage,
+		const SceneLoadOptions& options,
+		pxr::UsdTimeCode time,
+		UsdSceneAnimator* animator)
+	: m_stage(stage)
+	, m_options(options)
+	, m_time(time)
+	, m_animator(animator)
+	, m_lastLayerCheck(std::chrono::steady_clock::now())
+{
+	RecordLayers();
+
+	m_noticeKey = pxr::TfNotice::Register(pxr::TfCreateWeakPtr(this), &UsdStageWatcher::OnObjectsChanged, pxr::UsdStageWeakPtr(m_stage));
+}
+
+UsdStageWatcher::~UsdStageWatcher()
+{
+	pxr::TfNotice::Revoke(m_noticeKey);
+}
+
+void UsdStageWatcher::AddGeometry(const pxr::UsdPrim& prim, unsigned int geomID)
+{
+	if (geomID == SPINDULYS_INVALID_GEOMETRY_ID)
+		return;
+
+	std::lock_guard<std::mutex> lock(m_primsMutex);
+	m_geometry[prim.GetPath()] = geomID;
+}
+
+void UsdStageWatcher::AddCamera(const pxr::UsdPrim& prim, size_t cameraIndex)
+{
+	std::lock_guard<std::mutex> lock(m_primsMutex);
+	m_cameras[prim.GetPath()] = cameraIndex;
+}
+
+void UsdStageWatcher::AddLight(const pxr::UsdPrim& prim, unsigned int lightID)
+{
+	if (lightID == SPINDULYS_INVALID_LIGHT_ID)
+		return;
+
+	std::lock_guard<std::mutex> lock(m_primsMutex);
+	m_lights[prim.GetPath()] = lightID;
+}
+
+pxr::SdfPathVector UsdStageWatcher::LightsBeneath(const pxr::SdfPath& path) const
+{
+	pxr::SdfPathVector lightPaths;
+	for (auto light = m_lights.lower_bound(path); light != m_lights.end() && light->first.HasPrefix(path); ++light)
+		lightPaths.emplace_back(light->first);
+
+	return lightPaths;
+}
+
+void UsdStageWatcher::OnObjectsChanged(const pxr::UsdNotice::ObjectsChanged& notice, const pxr::UsdStageWeakPtr& sender)
+{
+	std::lock_guard<std::mutex> lock(m_changesMutex);
+
+	// Adding or removing a property resyncs its path, which is handled like a value change of it.
+	for (const pxr::SdfPath& path : notice.GetResyncedPaths())
+		(path.IsPropertyPath() ? m_changedPaths : m_resyncedPaths).emplace_back(path);
+
+	for (const pxr::SdfPath& path : notice.GetChangedInfoOnlyPaths())
+		if (path.IsPropertyPath())
+			m_changedPaths.emplace_back(path);
+}
+
+void UsdStageWatcher::RecordLayers()
+{
+	m_layers.clear();
+	for (const pxr::SdfLayerHandle& layer : m_stage->GetUsedLayers())
+	{
+		if (layer->IsAnonymous() || layer->GetRealPath().empty())
+			continue;
+
+		std::error_code error;
+		const std::filesystem::file_time_type writeTime = std::filesystem::last_write_time(layer->GetRealPath(), error);
+		if (!error)
+			m_layers.emplace_back(layer, writeTime);
+	}
+}
+
+void UsdStageWatcher::ReloadChangedLayers()
+{
+	const auto now = std::chrono::steady_clock::now();
+	if (now - m_lastLayerCheck < kLayerCheckInterval)
+		return;
+	m_lastLayerCheck = now;
+
+	bool reloaded = false;
+	for (const auto& [layer, writeTime] : m_layers)
+	{
+		std::error_code error;
+		if (!layer || std::filesystem::last_write_time(layer->GetRealPath(), error) == writeTime || error)
+			continue;
+
+		// The notices for whatever changed are sent from within the reload.
+		spdlog::info("Reloading {}", layer->GetIdentifier());
+		layer->Reload();
+		reloaded = true;
+	}
+
+	// Edits can add or remove sublayers and references.
+	if (reloaded)
+		RecordLayers();
+}
+
+bool UsdStageWatcher::IsPrimSkipped(const pxr::UsdPrim& prim, pxr::UsdTimeCode time) const
+{
+	for (pxr::UsdPrim parent = prim; parent && !parent.IsPseudoRoot(); parent = parent.GetParent())
+		if (UsdSceneLoader::SkipPrim(parent, m_options, time))
+			return true;
+
+	return false;
+}
+
+bool UsdStageWatcher::ApplyChanges(Scene* scene)
+{
+	BASE_TRACE();
+	ReloadChangedLayers();
+
+	pxr::SdfPathVector resyncedPaths;
+	pxr::SdfPathVector changedPaths;
+	{
+		std::lock_guard<std::mutex> lock(m_changesMutex);
+		resyncedPaths.swap(m_resyncedPaths);
+		changedPaths.swap(m_changedPaths);
+	}
+
+	if (resyncedPaths.empty() && changedPaths.empty())
+		return false;
+
+	// Edits are seen at the frame the scene is currently showing.
+	const pxr::UsdTimeCode time = m_animator->IsAnimated() ? pxr::UsdTimeCode(m_animator->GetTime()) : m_time;
+
+	// Property changes which cannot be applied in place become resyncs of their prim.
+	pxr::SdfPath::RemoveDescendentPaths(&resyncedPaths);
+	for (const pxr::SdfPath& propertyPath : changedPaths)
+	{
+		const pxr::SdfPath primPath = propertyPath.GetPrimPath();
+		const bool resynced = std::any_of(resyncedPaths.begin(), resyncedPaths.end(),
+				[&primPath](const pxr::SdfPath& path) { return primPath.HasPrefix(path); });
+
+		if (!resynced && !UpdateProperty(scene, propertyPath, time))
+			resyncedPaths.emplace_back(primPath);
+	}
+
+	pxr::SdfPath::RemoveDescendentPaths(&resyncedPaths);
+	for (const pxr::SdfPath& path : resyncedPaths)
+		ResyncPrims(scene, path, time);
+
+	return true;
+}
+
+bool UsdStageWatcher::UpdateProperty(Scene* scene, const pxr::SdfPath& propertyPath, pxr::UsdTimeCode time)
+{
+	const pxr::SdfPath primPath = propertyPath.GetPrimPath();
+	const pxr::TfToken& name = propertyPath.GetNameToken();
+
+	// Transforms and visibility are inherited, so they affect everything beneath the prim.
+	if (name == pxr::UsdGeomTokens->xformOpOrder || pxr::TfStringStartsWith(name.GetString(), "xformOp:"))
+	{
+		UpdateTransforms(scene, primPath, time);
+		return true;
+	}
+	if (name == pxr::UsdGeomTokens->visibility)
+	{
+		UpdateVisibility(scene, primPath, time);
+		return true;
+	}
+	if (name == pxr::UsdGeomTokens->purpose)
+		return false;
+
+	const pxr::UsdPrim prim = m_stage->GetPrimAtPath(primPath);
+	if (!prim)
+		return true;
+
+	if (const auto camera = m_cameras.find(primPath); camera != m_cameras.end())
+	{
+		UsdCameraTranslator(time).UpdateCamera(scene->UpdateCamera(camera->second), prim);
+		return true;
+	}
+
+	// Lights are translated whole, so any change to one creates it again.
+	if (m_lights.find(primPath) != m_lights.end())
+		return false;
+
+	const auto geometry = m_geometry.find(primPath);
+	if (geometry == m_geometry.end())
+	{
+		// Nothing was created from the prim, which is only right if it does not change how the scene looks.
+		if (IsUnsupportedLight(prim))
+			spdlog::warn("Light {} is not supported, so the edit to {} is ignored.", primPath.GetString(), propertyPath.GetString());
+		else if (prim.IsA<pxr::UsdShadeMaterial>() || prim.IsA<pxr::UsdShadeShader>())
+			spdlog::warn("Material edits are not applied in place, the edit to {} needs the scene reloading.", propertyPath.GetString());
+		return true;
+	}
+
+	// Skinned meshes are posed from their rest points, so any change to them poses them again.
+	if (m_animator->IsSkinned(primPath))
+		return false;
+
+	// Anything other than the points and normals changes the topology or shading, so is recreated.
+	const pxr::UsdGeomPointBased pointBased(prim);
+	pxr::VtArray<pxr::GfVec3f> values;
+	if (name == pxr::UsdGeomTokens->points)
+		return pointBased.GetPointsAttr().Get(&values, time) &&
+			scene->UpdateGeometryPoints(geometry->second, UsdTranslator::ToVector<Vec3f>(values));
+	if (name == pxr::UsdGeomTokens->normals)
+		return pointBased.GetNormalsAttr().Get(&values, time) &&
+			scene->UpdateGeometryNormals(geometry->second, UsdTranslator::ToVector<Vec3f>(values));
+
+	return false;
+}
+
+void UsdStageWatcher::UpdateTransforms(Scene* scene, const pxr::SdfPath& path, pxr::UsdTimeCode time)
+{
+	// Skinned meshes follow their skeleton rather than their own transform, so are posed again.
+	pxr::SdfPathVector skinnedPaths;
+	for (auto geometry = m_geometry.lower_bound(path); geometry != m_geometry.end() && geometry->first.HasPrefix(path); ++geometry)
+	{
+		if (m_animator->IsSkinned(geometry->first))
+		{
+			skinnedPaths.emplace_back(geometry->first);
+			continue;
+		}
+
+		const pxr::UsdGeomXformable xformable(m_stage->GetPrimAtPath(geometry->first));
+		if (xformable)
+			scene->UpdateGeometryTransform(geometry->second, AffineSpace3f(xformable.ComputeLocalToWorldTransform(time)));
+	}
+
+	for (const pxr::SdfPath& skinnedPath : skinnedPaths)
+		ResyncPrims(scene, skinnedPath, time);
+
+	for (const pxr::SdfPath& lightPath : LightsBeneath(path))
+		ResyncPrims(scene, lightPath, time);
+
+	for (auto camera = m_cameras.lower_bound(path); camera != m_cameras.end() && camera->first.HasPrefix(path); ++camera)
+		if (const pxr::UsdPrim prim = m_stage->GetPrimAtPath(camera->first))
+			UsdCameraTranslator(time).UpdateCamera(scene->UpdateCamera(camera->second), prim);
+}
+
+void UsdStageWatcher::UpdateVisibility(Scene* scene, const pxr::SdfPath& path, pxr::UsdTimeCode time)
+{
+	// Invisible prims are only left out when asked to, otherwise they are rendered like any other.
+	if (!m_options.m_skipInvisible)
+		return;
+
+	for (auto geometry = m_geometry.lower_bound(path); geometry != m_geometry.end() && geometry->first.HasPrefix(path); ++geometry)
+	{
+		const pxr::UsdPrim prim = m_stage->GetPrimAtPath(geometry->first);
+		scene->SetGeometryVisible(geometry->second, prim && !IsPrimSkipped(prim, time));
+	}
+
+	// Lights cannot be hidden, so are removed and only created again while visible.
+	for (const pxr::SdfPath& lightPath : LightsBeneath(path))
+		ResyncPrims(scene, lightPath, time);
+
+	// Prims which were invisible when loaded have never been created.
+	AddPrims(scene, path, time);
+}
+
+void UsdStageWatcher::ResyncPrims(Scene* scene, const pxr::SdfPath& path, pxr::UsdTimeCode time)
+{
+	BASE_TRACE();
+	auto geometry = m_geometry.lower_bound(path);
+	while (geometry != m_geometry.end() && geometry->first.HasPrefix(path))
+	{
+		scene->RemoveGeometry(geometry->second);
+		m_animator->RemoveGeometry(geometry->second);
+		geometry = m_geometry.erase(geometry);
+	}
+
+	auto light = m_lights.lower_bound(path);
+	while (light != m_lights.end() && light->first.HasPrefix(path))
+	{
+		scene->RemoveLight(light->second);
+		light = m_lights.erase(light);
+	}
+
+	// Cameras are referred to by index, so they are updated in place rather than removed.
+	for (auto camera = m_cameras.lower_bound(path); camera != m_cameras.end() && camera->first.HasPrefix(path); ++camera)
+	{
+		if (const pxr::UsdPrim prim = m_stage->GetPrimAtPath(camera->first))
+			UsdCameraTranslator(time).UpdateCamera(scene->UpdateCamera(camera->second), prim);
+		else
+			spdlog::warn("Camera {} has been removed from the stage but stays until the scene is reloaded.", camera->first.GetString());
+	}
+
+	AddPrims(scene, path, time);
+}
+
+void UsdStageWatcher::AddPrims(Scene* scene, const pxr::SdfPath& path, pxr::UsdTimeCode time)
+{
+	const pxr::UsdPrim root = m_stage->GetPrimAtPath(path);
+	if (!root || IsPrimSkipped(root.GetParent(), time))
+		return;
+
+	std::vector<pxr::UsdPrim> geometryPrims;
+
+	const pxr::UsdPrimRange range(root);
+	for (auto it = range.begin(); it != range.end(); ++it)
+	{
+		const pxr::UsdPrim& prim = *it;
+		if (UsdSceneLoader::SkipPrim(prim, m_options, time))
+		{
+			it.PruneChildren();
+		}
+		else if (prim.GetTypeName() == "Camera" && m_cameras.find(prim.GetPath()) == m_cameras.end())
+		{
+			if (UsdCameraTranslator trans(time); Camera* camera = (Camera*)trans.GetObjectFromPrim(prim))
+			{
+				const size_t cameraIndex = scene->AddCamera(camera);
+				m_animator->AddCamera(prim, cameraIndex);
+				AddCamera(prim, cameraIndex);
+			}
+		}
+		else if (IsSupportedLight(prim) && m_lights.find(prim.GetPath()) == m_lights.end())
+		{
+			if (UsdLightTranslator trans(time); Light* light = (Light*)trans.GetObjectFromPrim(prim))
+				AddLight(prim, scene->CreateLight(light));
+		}
+		else if ((prim.GetTypeName() == "Mesh" || prim.GetTypeName() == "BasisCurves") &&
+				m_geometry.find(prim.GetPath()) == m_geometry.end())
+		{
+			geometryPrims.emplace_back(prim);
+		}
+		else if (prim.IsA<pxr::UsdSkelRoot>())
+		{
+			m_animator->AddSkelRoot(prim);
+		}
+	}
+
+	tbb::parallel_for_each(geometryPrims.begin(), geometryPrims.end(), [&](const pxr::UsdPrim& prim)
+	{
+		const unsigned int geomID = UsdSceneLoader::CreateGeometry(scene, prim, time, m_animator);
+		m_animator->AddGeometry(prim, geomID);
+		AddGeometry(prim, geomID);
+	});
+}
+
+BASE_NAMESPACE_CLOSE_SCOPE
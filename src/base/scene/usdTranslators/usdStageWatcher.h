@@ -0,0 +1,92 @@
+#ifndef USD_STAGE_WATCHER_H
+#define USD_STAGE_WATCHER_H
+
+#include <chrono>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include <pxr/base/tf/notice.h>
+#include <pxr/base/tf/weakBase.h>
+#include <pxr/usd/sdf/layer.h>
+#include <pxr/usd/sdf/path.h>
+#include <pxr/usd/usd/notice.h>
+#include <pxr/usd/usd/stage.h>
+#include <pxr/usd/usd/prim.h>
+
+#include "../../spindulysBase.h"
+
+#include "../sceneLoader.h"
+#include "../sceneWatcher.h"
+
+BASE_NAMESPACE_OPEN_SCOPE
+
+class UsdSceneAnimator;
+
+/* Listens for UsdNotice::ObjectsChanged on a loaded stage and maps the changed paths back to the
+	 geometry, cameras and lights created from them, so edits only update what they touch. Layers edited on
+	 disk are reloaded, which is what sends the notices for edits made outside of spindulys. */
+class UsdStageWatcher final : public SceneWatcher, public pxr::TfWeakBase
+{
+	public:
+		UsdStageWatcher(const pxr::UsdStageRefPtr& stage,
+				const SceneLoadOptions& options,
+				pxr::UsdTimeCode time,
+				UsdSceneAnimator* animator);
+		virtual ~UsdStageWatcher();
+
+		// Thread safe.
+		void AddGeometry(const pxr::UsdPrim& prim, unsigned int geomID);
+		void AddCamera(const pxr::UsdPrim& prim, size_t cameraIndex);
+		void AddLight(const pxr::UsdPrim& prim, unsigned int lightID);
+
+		virtual bool ApplyChanges(Scene* scene) override;
+
+	private:
+		void OnObjectsChanged(const pxr::UsdNotice::ObjectsChanged& notice, const pxr::UsdStageWeakPtr& sender);
+
+		// Reload any layer which has been written to since it was last read.
+		void ReloadChangedLayers();
+		void RecordLayers();
+
+		// Whether the prim, or any prim it inherits from, is excluded by the load options.
+		bool IsPrimSkipped(const pxr::UsdPrim& prim, pxr::UsdTimeCode time) const;
+
+		// Lights at or beneath the path, which are created again for any edit that reaches them.
+		pxr::SdfPathVector LightsBeneath(const pxr::SdfPath& path) const;
+
+		// Replace everything at and beneath the path with what is now on the stage.
+		void ResyncPrims(Scene* scene, const pxr::SdfPath& path, pxr::UsdTimeCode time);
+		// Create anything at and beneath the path which has not been created yet.
+		void AddPrims(Scene* scene, const pxr::SdfPath& path, pxr::UsdTimeCode time);
+		void UpdateTransforms(Scene* scene, const pxr::SdfPath& path, pxr::UsdTimeCode time);
+		void UpdateVisibility(Scene* scene, const pxr::SdfPath& path, pxr::UsdTimeCode time);
+		// Returns false if the change cannot be applied in place and the prim needs resyncing.
+		bool UpdateProperty(Scene* scene, const pxr::SdfPath& propertyPath, pxr::UsdTimeCode time);
+
+		pxr::UsdStageRefPtr m_stage;
+		SceneLoadOptions m_options;
+		pxr::UsdTimeCode m_time;
+		UsdSceneAnimator* m_animator;
+
+		pxr::TfNotice::Key m_noticeKey;
+
+		// Notices can arrive on any thread.
+		std::mutex m_changesMutex;
+		pxr::SdfPathVector m_resyncedPaths;
+		pxr::SdfPathVector m_changedPaths;
+
+		// Sorted, so everything beneath a path directly follows it.
+		std::mutex m_primsMutex;
+		std::map<pxr::SdfPath, unsigned int> m_geometry;
+		std::map<pxr::SdfPath, size_t> m_cameras;
+		std::map<pxr::SdfPath, unsigned int> m_lights;
+
+		std::vector<std::pair<pxr::SdfLayerHandle, std::filesystem::file_time_type>> m_layers;
+		std::chrono::steady_clock::time_point m_lastLayerCheck;
+};
+
+BASE_NAMESPACE_CLOSE_SCOPE
+
+#endif // USD_STAGE_WATCHER_H
@@ -1,6 +1,7 @@
 #ifndef USD_TRANSLATOR_H
 #define USD_TRANSLATOR_H
 
+#include <cstring>
 #include <string>
 #include <mutex>
 #include <vector>
@@ -19,24 +20,42 @@ BASE_NAMESPACE_OPEN_SCOPE
 class UsdTranslator
 {
 	public:
-		UsdTranslator() = default;
+		// Attributes are evaluated at the given time.
+		UsdTranslator(pxr::UsdTimeCode time = pxr::UsdTimeCode::Default()) : m_time(time) { }
 		virtual ~UsdTranslator() = default;
 
 		virtual void* GetObjectFromPrim(const pxr::UsdPrim& prim) = 0;
 
 		template<typename T>
-		static bool GetAttribute(const pxr::UsdPrim& prim, const pxr::TfToken& token, T* value)
+		static bool GetAttribute(const pxr::UsdPrim& prim, const pxr::TfToken& token, T* value,
+				pxr::UsdTimeCode time = pxr::UsdTimeCode::Default())
 		{
 			if (pxr::UsdAttribute attr = prim.GetAttribute(token))
 			{
-				if (attr.Get(value))
+				if (attr.Get(value, time))
 					return true;
 				return false;
 			}
 			return false;
 		}
 
+		// Bulk copy a USD array into a std::vector, the element types must share the same memory layout.
+		// One extra element is reserved as Embree reads vertex buffers with 16 byte loads.
+		template<typename T, typename U>
+		static std::vector<T> ToVector(const pxr::VtArray<U>& array)
+		{
+			static_assert(sizeof(T) == sizeof(U), "USD and spindulys element types must have the same layout.");
+
+			std::vector<T> result;
+			result.reserve(array.size() + 1);
+			result.resize(array.size());
+			std::memcpy((void*) result.data(), array.cdata(), array.size() * sizeof(U));
+
+			return result;
+		}
+
 	protected:
+		pxr::UsdTimeCode m_time;
 
 	private:
 };
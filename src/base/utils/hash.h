@@ -0,0 +1,61 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include "../spindulysBase.h"
+
+BASE_NAMESPACE_OPEN_SCOPE
+
+// 64 bit MurmurHash2 (MurmurHash64A by Austin Appleby), fast enough to run over whole geometry buffers.
+inline uint64_t HashBytes(const void* data, size_t size, uint64_t seed = 0)
+{
+	constexpr uint64_t m = 0xc6a4a7935bd1e995ull;
+	constexpr int r = 47;
+
+	uint64_t h = seed ^ (size * m);
+
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	const unsigned char* end = bytes + (size / 8) * 8;
+	for (; bytes != end; bytes += 8)
+	{
+		uint64_t k;
+		std::memcpy(&k, bytes, sizeof(k));
+
+		k *= m;
+		k ^= k >> r;
+		k *= m;
+
+		h ^= k;
+		h *= m;
+	}
+
+	switch (size & 7)
+	{
+		case 7: h ^= uint64_t(bytes[6]) << 48; [[fallthrough]];
+		case 6: h ^= uint64_t(bytes[5]) << 40; [[fallthrough]];
+		case 5: h ^= uint64_t(bytes[4]) << 32; [[fallthrough]];
+		case 4: h ^= uint64_t(bytes[3]) << 24; [[fallthrough]];
+		case 3: h ^= uint64_t(bytes[2]) << 16; [[fallthrough]];
+		case 2: h ^= uint64_t(bytes[1]) << 8;  [[fallthrough]];
+		case 1: h ^= uint64_t(bytes[0]);
+				h *= m;
+	}
+
+	h ^= h >> r;
+	h *= m;
+	h ^= h >> r;
+
+	return h;
+}
+
+inline uint64_t HashString(const std::string& string, uint64_t seed = 0)
+{
+	return HashBytes(string.data(), string.size(), seed);
+}
+
+BASE_NAMESPACE_CLOSE_SCOPE
+
+#endif // HASH_H
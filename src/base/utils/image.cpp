@@ -0,0 +1,68 @@
+#include "image.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <filesystem>
+
+#define TINYEXR_IMPLEMENTATION
+#include <tinyexr.h>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+BASE_NAMESPACE_OPEN_SCOPE
+
+bool Image::Load(const std::string& filepath)
+{
+	BASE_TRACE();
+	m_width = 0;
+	m_height = 0;
+	m_pixels.clear();
+
+	std::string extension = std::filesystem::path(filepath).extension().string();
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return std::tolower(c); });
+
+	int width = 0;
+	int height = 0;
+	if (extension == ".exr")
+	{
+		float* rgba = nullptr;
+		const char* error = nullptr;
+		if (LoadEXR(&rgba, &width, &height, filepath.c_str(), &error) != TINYEXR_SUCCESS)
+		{
+			// The bundled tinyexr predates FreeEXRErrorMessage and returns string literals as well as strdup'd
+			// messages, so the message cannot be freed without risking freeing a literal.
+			spdlog::error("Could not load {}: {}", filepath, error ? error : "unknown error");
+			return false;
+		}
+
+		m_pixels.resize(static_cast<size_t>(width) * height);
+		for (size_t i = 0; i < m_pixels.size(); ++i)
+			m_pixels[i] = Col3f(rgba[i * 4], rgba[i * 4 + 1], rgba[i * 4 + 2]);
+		std::free(rgba);
+	}
+	else
+	{
+		// Low dynamic range images are converted to linear floats by stb_image.
+		int channels = 0;
+		float* rgb = stbi_loadf(filepath.c_str(), &width, &height, &channels, 3);
+		if (!rgb)
+		{
+			spdlog::error("Could not load {}: {}", filepath, stbi_failure_reason());
+			return false;
+		}
+
+		m_pixels.resize(static_cast<size_t>(width) * height);
+		for (size_t i = 0; i < m_pixels.size(); ++i)
+			m_pixels[i] = Col3f(rgb[i * 3], rgb[i * 3 + 1], rgb[i * 3 + 2]);
+		stbi_image_free(rgb);
+	}
+
+	m_width = width;
+	m_height = height;
+
+	return true;
+}
+
+BASE_NAMESPACE_CLOSE_SCOPE
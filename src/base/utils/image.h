@@ -0,0 +1,37 @@
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include <string>
+#include <vector>
+
+#include <spindulys/math/col3.h>
+
+#include "../spindulysBase.h"
+
+BASE_NAMESPACE_OPEN_SCOPE
+
+// Linear RGB pixels stored row by row from the top of the image.
+class Image
+{
+	public:
+		Image() = default;
+
+		// EXR files are read with tinyexr and anything else, such as Radiance HDR, with stb_image.
+		bool Load(const std::string& filepath);
+
+		int                       GetWidth()  const { return m_width;  }
+		int                       GetHeight() const { return m_height; }
+		const std::vector<Col3f>& GetPixels() const { return m_pixels; }
+		bool                      IsEmpty()   const { return m_pixels.empty(); }
+
+		const Col3f& GetPixel(int x, int y) const { return m_pixels[static_cast<size_t>(y) * m_width + x]; }
+
+	private:
+		int m_width = 0;
+		int m_height = 0;
+		std::vector<Col3f> m_pixels;
+};
+
+BASE_NAMESPACE_CLOSE_SCOPE
+
+#endif // IMAGE_H
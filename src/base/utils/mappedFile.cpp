@@ -0,0 +1,117 @@
+#include "mappedFile.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+BASE_NAMESPACE_OPEN_SCOPE
+
+#if defined(_WIN32)
+
+bool MappedFile::Open(const std::string& filepath)
+{
+	BASE_TRACE();
+	Close();
+
+	HANDLE file = CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+			FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size))
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	m_size = static_cast<size_t>(size.QuadPart);
+	if (m_size != 0)
+	{
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping)
+		{
+			m_data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+			CloseHandle(mapping);
+		}
+	}
+	CloseHandle(file);
+
+	if (m_size != 0 && !m_data)
+	{
+		m_size = 0;
+		return false;
+	}
+
+	m_open = true;
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (m_data)
+		UnmapViewOfFile(m_data);
+
+	m_data = nullptr;
+	m_size = 0;
+	m_open = false;
+}
+
+#else
+
+bool MappedFile::Open(const std::string& filepath)
+{
+	BASE_TRACE();
+	Close();
+
+	const int file = open(filepath.c_str(), O_RDONLY);
+	if (file < 0)
+		return false;
+
+	struct stat info;
+	if (fstat(file, &info) != 0)
+	{
+		close(file);
+		return false;
+	}
+
+	m_size = static_cast<size_t>(info.st_size);
+	if (m_size != 0)
+	{
+		void* data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, file, 0);
+		if (data == MAP_FAILED)
+		{
+			close(file);
+			m_size = 0;
+			return false;
+		}
+
+		// Files are generally read front to back by several threads at once.
+		madvise(data, m_size, MADV_WILLNEED);
+		m_data = static_cast<const char*>(data);
+	}
+	// The mapping keeps its own reference to the file.
+	close(file);
+
+	m_open = true;
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (m_data)
+		munmap((void*) m_data, m_size);
+
+	m_data = nullptr;
+	m_size = 0;
+	m_open = false;
+}
+
+#endif
+
+BASE_NAMESPACE_CLOSE_SCOPE
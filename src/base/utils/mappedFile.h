@@ -0,0 +1,38 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <string>
+
+#include "../spindulysBase.h"
+
+BASE_NAMESPACE_OPEN_SCOPE
+
+// Read only memory mapping of a whole file. The mapping is released when
+// the object is destroyed or Close is called.
+class MappedFile
+{
+	public:
+		MappedFile() = default;
+		~MappedFile() { Close(); }
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		bool Open(const std::string& filepath);
+		void Close();
+
+		const char* GetData() const { return m_data; }
+		size_t      GetSize() const { return m_size; }
+		bool        IsOpen()  const { return m_open; }
+
+	private:
+		const char* m_data = nullptr;
+		size_t m_size = 0;
+
+		// Empty files are open without having any mapping.
+		bool m_open = false;
+};
+
+BASE_NAMESPACE_CLOSE_SCOPE
+
+#endif // MAPPED_FILE_H
@@ -0,0 +1,110 @@
+#include "batch.h"
+
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <vector>
+
+#include <tbb/task_group.h>
+
+#include <render/cpuRenderManager.h>
+
+#include "output_helper.h"
+
+
+GUI_NAMESPACE_OPEN_SCOPE
+
+static bool ParseFrameRange(const std::string& frameRange, float& startFrame, float& endFrame)
+{
+	const size_t separator = frameRange.find(':');
+	try
+	{
+		startFrame = std::stof(frameRange.substr(0, separator));
+		endFrame = separator == std::string::npos ? startFrame : std::stof(frameRange.substr(separator + 1));
+	}
+	catch (const std::exception&)
+	{
+		return false;
+	}
+
+	return startFrame <= endFrame;
+}
+
+// Sequences get the frame number inserted before the extension, e.g. render.0001.exr.
+static std::string GetFramePath(const std::string& outputPath, float frame, bool sequence)
+{
+	if (!sequence)
+		return outputPath;
+
+	char frameNumber[32];
+	std::snprintf(frameNumber, sizeof(frameNumber), ".%04d", static_cast<int>(std::round(frame)));
+
+	const std::filesystem::path path(outputPath);
+	return (path.parent_path() / (path.stem().string() + frameNumber + path.extension().string())).string();
+}
+
+bool RenderBatch(const RenderGlobals& renderGlobals,
+		const std::vector<std::string>& scenePaths,
+		const std::string& frameRange,
+		const std::string& outputPath)
+{
+	GUI_TRACE();
+	CPURenderManager renderManager;
+	renderManager.SetCompactGeometry(renderGlobals.GetCompactGeometry());
+	renderManager.SetSmoothNormals(renderGlobals.GetSmoothNormals());
+	renderManager.SetOptimizeLocality(renderGlobals.GetOptimizeLocality());
+	renderManager.SetSceneCache(renderGlobals.GetSceneCache());
+	// Frames are rendered straight through, so edits to the scene are never applied.
+	SceneLoadOptions loadOptions = renderGlobals.GetSceneLoadOptions();
+	loadOptions.m_watchEdits = false;
+	renderManager.SetSceneLoadOptions(loadOptions);
+	renderManager.SetMaxIterations(renderGlobals.GetMaxIterations());
+	renderManager.SetFrame(renderGlobals.GetFrame());
+	renderManager.SetPathGuiding(renderGlobals.GetPathGuiding());
+
+	// Every file which failed to load has already been reported.
+	if (!renderManager.LoadScene(scenePaths))
+		return false;
+
+	std::vector<float> frames;
+	if (const Scene* scene = renderManager.GetScene(); scene->IsAnimated())
+	{
+		float startFrame = scene->GetStartTime();
+		float endFrame = scene->GetEndTime();
+		if (!frameRange.empty() && !ParseFrameRange(frameRange, startFrame, endFrame))
+		{
+			spdlog::error("Frame range {} is not of the form start:end.", frameRange);
+			return false;
+		}
+
+		for (float frame = startFrame; frame <= endFrame; frame += 1.f)
+			frames.emplace_back(frame);
+	}
+	else
+	{
+		if (!frameRange.empty())
+			spdlog::warn("The scene is not animated, ignoring the frame range.");
+
+		frames.emplace_back(renderManager.GetFrame());
+	}
+
+	// Images are written on the side so tracing the next frame does not wait on the disk.
+	tbb::task_group writeGroup;
+	renderManager.RenderFrames(frames, [&](float frame, const Buffer3f& buffer)
+	{
+		const std::string filepath = GetFramePath(outputPath, frame, frames.size() > 1);
+		const unsigned int width = renderManager.GetWidth();
+		const unsigned int height = renderManager.GetHeight();
+
+		writeGroup.run([filepath, width, height, buffer]
+		{
+			toEXR(width, height, buffer, filepath.c_str());
+			spdlog::info("Written {}", filepath);
+		});
+	});
+	writeGroup.wait();
+
+	return true;
+}
+
+GUI_NAMESPACE_CLOSE_SCOPE
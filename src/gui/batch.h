@@ -0,0 +1,24 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <string>
+#include <vector>
+
+#include <render/renderGlobals.h>
+
+#include "spindulysGUI.h"
+
+
+GUI_NAMESPACE_OPEN_SCOPE
+
+// Render the scene without opening a window and write every frame out as an EXR.
+// frameRange is "start:end" or a single frame, an empty range renders the whole animation.
+// The scene is assembled from all of the given files. Returns false if the scene could not be loaded.
+bool RenderBatch(const RenderGlobals& renderGlobals,
+		const std::vector<std::string>& scenePaths,
+		const std::string& frameRange,
+		const std::string& outputPath);
+
+GUI_NAMESPACE_CLOSE_SCOPE
+
+#endif // BATCH_H
@@ -1,12 +1,11 @@
 // Spindulys by Linas Beresna
 
-#define STB_IMAGE_IMPLEMENTATION
-
 #include <filesystem>
 
 #include <cxxopts.hpp>
 
 #include "window.h"
+#include "batch.h"
 
 int main(int argc, char** argv)
 {
@@ -22,8 +21,22 @@ int main(int argc, char** argv)
 	cxxopts::Options options("spindulys", "A C++ GLFW path tracer");
 
 	options.add_options()
-		("s,scene", "Path to Scene", cxxopts::value<std::string>()->default_value(""))
+		("s,scene", "Path to Scene, can be given more than once to assemble the scene from several files", cxxopts::value<std::vector<std::string>>())
 		("l,level", "Logging level from trace to off (0-6)", cxxopts::value<int>()->default_value("2"))
+		("c,compact", "Build compact BVH leaves and pack mesh normals to reduce memory usage. Points and indices stay full precision, and normals are only kept with --smooth-normals, so without it only the BVH shrinks", cxxopts::value<bool>()->default_value("false"))
+		("smooth-normals", "Shade meshes with their interpolated vertex normals rather than their geometric normals", cxxopts::value<bool>()->default_value("false"))
+		("optimize-locality", "Reorder mesh faces and vertices so that neighbouring faces are close in memory", cxxopts::value<bool>()->default_value("false"))
+		("cache", "Load scenes from and save them to a .spdcache file next to the scene, USD stages are only cached in batch mode, where edits to them are not followed, and never when animated", cxxopts::value<bool>()->default_value("false"))
+		("all-purposes", "Load proxy and guide geometry as well as render geometry", cxxopts::value<bool>()->default_value("false"))
+		("load-invisible", "Load invisible geometry", cxxopts::value<bool>()->default_value("false"))
+		("no-payloads", "Do not load any payloads", cxxopts::value<bool>()->default_value("false"))
+		("mask", "Only load the given prim paths", cxxopts::value<std::vector<std::string>>())
+		("f,frame", "Frame to render animated scenes at", cxxopts::value<float>()->default_value("1"))
+		("b,batch", "Render without opening a window and write the result to the output", cxxopts::value<bool>()->default_value("false"))
+		("frames", "Frames to render in batch mode as start:end, defaults to the whole animation", cxxopts::value<std::string>()->default_value(""))
+		("i,iterations", "Iterations to render each frame to in batch mode", cxxopts::value<uint32_t>())
+		("path-guiding", "Learn where light comes from while rendering and guide the forward path tracer's bounces with it", cxxopts::value<bool>()->default_value("false"))
+		("o,output", "EXR to write in batch mode, sequences get the frame number added", cxxopts::value<std::string>()->default_value("spindulys_render.exr"))
 		("h,help", "Print usage")
 	;
 
@@ -44,23 +57,57 @@ int main(int argc, char** argv)
 			spdlog::warn("Level {} is not within range 0 to 6, therefore resorting to default of 2 (info).", level);
 	}
 
-	std::string scenePath;
+	std::vector<std::string> scenePaths;
 	if (result.count("scene"))
 	{
-		scenePath = result["scene"].as<std::string>();
-		const std::filesystem::path path(scenePath);
+		for (const std::string& scenePath : result["scene"].as<std::vector<std::string>>())
+		{
+			const std::filesystem::path path(scenePath);
+
+			if (!std::filesystem::exists(path))
+			{
+				spdlog::error("Filepath {} does not exist.\n Please input one that does. Exiting.", path.string());
+				exit(SPINDULYS_EXIT_BAD_PATH);
+			}
+			scenePaths.emplace_back(path.is_relative() ? (std::filesystem::current_path() / path).string() : scenePath);
+		}
+	}
+
+	spindulys::spindulysBase::RenderGlobals renderGlobals;
+	renderGlobals.SetCompactGeometry(result["compact"].as<bool>());
+	renderGlobals.SetSmoothNormals(result["smooth-normals"].as<bool>());
+	renderGlobals.SetOptimizeLocality(result["optimize-locality"].as<bool>());
+	renderGlobals.SetSceneCache(result["cache"].as<bool>());
+	renderGlobals.SetRenderPurposeOnly(!result["all-purposes"].as<bool>());
+	renderGlobals.SetSkipInvisible(!result["load-invisible"].as<bool>());
+	renderGlobals.SetLoadPayloads(!result["no-payloads"].as<bool>());
+	if (result.count("mask"))
+		renderGlobals.SetPopulationMask(result["mask"].as<std::vector<std::string>>());
+	renderGlobals.SetFrame(result["frame"].as<float>());
+	renderGlobals.SetPathGuiding(result["path-guiding"].as<bool>());
+	if (result.count("iterations"))
+		renderGlobals.SetMaxIterations(result["iterations"].as<uint32_t>());
 
-		if (!std::filesystem::exists(path))
+	int exitCode = SPINDULYS_EXIT_GOOD;
+	if (result["batch"].as<bool>())
+	{
+		if (scenePaths.empty())
 		{
-			spdlog::error("Filepath {} does not exist.\n Please input one that does. Exiting.", path.string());
+			spdlog::error("Batch rendering needs a scene. Exiting.");
 			exit(SPINDULYS_EXIT_BAD_PATH);
 		}
-		if (path.is_relative())
-			scenePath = std::filesystem::current_path() / scenePath;
-	}
 
-	spindulys::spindulysBase::spindulysCPU::spindulysGUI::Window mainWindow;
-	mainWindow.RenderWindow(scenePath);
+		if (!spindulys::spindulysBase::spindulysCPU::spindulysGUI::RenderBatch(renderGlobals,
+					scenePaths,
+					result["frames"].as<std::string>(),
+					result["output"].as<std::string>()))
+			exitCode = SPINDULYS_EXIT_BAD_SCENE_FORMAT;
+	}
+	else
+	{
+		spindulys::spindulysBase::spindulysCPU::spindulysGUI::Window mainWindow(renderGlobals);
+		mainWindow.RenderWindow(scenePaths);
+	}
 
 	// Tracing Ending.
 	// ----------------------------------
@@ -70,6 +117,7 @@ int main(int argc, char** argv)
 	mtr_shutdown();
 	// ----------------------------------
 
-	spdlog::info("All good exiting now.");
-	return SPINDULYS_EXIT_GOOD;
+	if (exitCode == SPINDULYS_EXIT_GOOD)
+		spdlog::info("All good exiting now.");
+	return exitCode;
 }
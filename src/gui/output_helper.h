@@ -1,8 +1,6 @@
 #ifndef OUTPUT_HELPER_H
 #define OUTPUT_HELPER_H
 
-#define TINYEXR_IMPLEMENTATION
-
 #include <tinyexr.h>
 
 #include <spindulys/math/vec3.h>
@@ -30,7 +28,7 @@ inline void toPPM(unsigned int width, unsigned int height, const Buffer3f& buffe
 }
 
 // Based on TinyEXR way of saving a scanline EXR file
-inline void toEXR(unsigned int width, unsigned int height, const Buffer3f& buffer)
+inline void toEXR(unsigned int width, unsigned int height, const Buffer3f& buffer, const char* filepath = "spindulys_render.exr")
 {
 	EXRHeader exrHeader;
 	EXRImage exrImage;
@@ -84,7 +82,7 @@ inline void toEXR(unsigned int width, unsigned int height, const Buffer3f& buffe
 	}
 
 	const char* exrError;
-	int exrResult(SaveEXRImageToFile(&exrImage, &exrHeader, "spindulys_render.exr", &exrError));
+	int exrResult(SaveEXRImageToFile(&exrImage, &exrHeader, filepath, &exrError));
 
 	if (exrResult != TINYEXR_SUCCESS)
 	{
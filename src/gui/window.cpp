@@ -1,5 +1,6 @@
 #include "window.h"
 
+#include <algorithm>
 #include <functional>
 #include <thread>
 
@@ -11,9 +12,18 @@
 GUI_NAMESPACE_OPEN_SCOPE
 
 
-Window::Window()
+Window::Window(const RenderGlobals& renderGlobals /* = RenderGlobals() */)
+	: m_renderGlobals(renderGlobals)
 {
 	GUI_TRACE();
+	m_renderManager.SetCompactGeometry(m_renderGlobals.GetCompactGeometry());
+	m_renderManager.SetSmoothNormals(m_renderGlobals.GetSmoothNormals());
+	m_renderManager.SetOptimizeLocality(m_renderGlobals.GetOptimizeLocality());
+	m_renderManager.SetSceneCache(m_renderGlobals.GetSceneCache());
+	m_renderManager.SetSceneLoadOptions(m_renderGlobals.GetSceneLoadOptions());
+	m_renderManager.SetFrame(m_renderGlobals.GetFrame());
+	m_renderManager.SetPlayback(m_renderGlobals.GetPlayback());
+
 	IMGUI_CHECKVERSION();
 	ImGui::CreateContext();
 
@@ -78,12 +88,12 @@ bool Window::InitWindow()
 	return true;
 }
 
-void Window::RenderWindow(const std::string& scenePath)
+void Window::RenderWindow(const std::vector<std::string>& scenePaths)
 {
 	GUI_TRACE();
 
-	m_renderManager.LoadScene(scenePath);
-	m_renderManager.GetCamera().SetResolution(Vec2f(m_renderGlobals.GetWidth(), m_renderGlobals.GetHeight()));
+	// The scene streams in on the render thread, which also sets the camera resolution once it has a camera.
+	m_renderManager.LoadSceneAsync(scenePaths);
 
 	m_renderManager.SetStopRendererCallback(std::bind(&Window::CloseWindow, this));
 	m_renderManager.SetUpdateCallback(std::bind(&Window::PreRenderCallback, this));
@@ -149,6 +159,8 @@ bool Window::PreRenderCallback()
 		m_renderManager.SetRenderDirty();
 	if (m_renderManager.SetSampler(m_renderGlobals.GetSampler()))
 		m_renderManager.SetRenderDirty();
+	if (m_renderManager.SetLightSampler(m_renderGlobals.GetLightSampler()))
+		m_renderManager.SetRenderDirty();
 	if (m_renderManager.SetHideLights(m_renderGlobals.GetHideLights()))
 		m_renderManager.SetRenderDirty();
 	if (m_renderManager.SetMaxLightSamples(m_renderGlobals.GetMaxLightsSamples()))
@@ -159,10 +171,21 @@ bool Window::PreRenderCallback()
 		m_renderManager.SetRenderDirty();
 	if (m_renderManager.SetRussianRouletteDepth(m_renderGlobals.GetRussianRouletteDepth()))
 		m_renderManager.SetRenderDirty();
+	if (m_renderManager.SetPathGuiding(m_renderGlobals.GetPathGuiding()))
+		m_renderManager.SetRenderDirty();
+	if (m_renderManager.SetLightCandidates(m_renderGlobals.GetLightCandidates()))
+		m_renderManager.SetRenderDirty();
 
 	if (m_renderManager.SetCurrentCamera(m_sceneCamera))
 		m_renderManager.SetRenderDirty();
 
+	// During playback the render manager moves the frame on, so the GUI follows it instead.
+	m_renderManager.SetPlayback(m_renderGlobals.GetPlayback());
+	if (m_renderGlobals.GetPlayback())
+		m_renderGlobals.SetFrame(m_renderManager.GetFrame());
+	else
+		m_renderManager.SetFrame(m_renderGlobals.GetFrame());
+
 	m_renderManager.SetCurrentBuffer(m_renderGlobals.GetBufferID());
 	m_renderManager.SetMaxIterations(m_renderGlobals.GetMaxIterations());
 
@@ -186,6 +209,8 @@ void Window::SetupGUI()
 		AboutWindow();
 	if (m_renderConfigState)
 		RenderConfigWindow();
+	if (m_renderManager.IsLoading())
+		LoadingWindow();
 
 	if (ImGui::BeginMainMenuBar())
 	{
@@ -219,6 +244,10 @@ void Window::SetupGUI()
 			{
 				ImGui::RadioButton("Direct", reinterpret_cast<int *>(&m_renderGlobals.m_integratorID), 0);
 				ImGui::RadioButton("ForwardPath", reinterpret_cast<int *>(&m_renderGlobals.m_integratorID), 1);
+				ImGui::RadioButton("ReSTIR Direct", reinterpret_cast<int *>(&m_renderGlobals.m_integratorID), 2);
+				ImGui::RadioButton("Bidirectional", reinterpret_cast<int *>(&m_renderGlobals.m_integratorID), 3);
+				ImGui::RadioButton("Light Tracer", reinterpret_cast<int *>(&m_renderGlobals.m_integratorID), 4);
+				ImGui::RadioButton("SPPM", reinterpret_cast<int *>(&m_renderGlobals.m_integratorID), 5);
 
 				ImGui::EndMenu();
 			}
@@ -239,6 +268,15 @@ void Window::SetupGUI()
 				ImGui::EndMenu();
 			}
 
+			if (ImGui::BeginMenu("Light Sampler"))
+			{
+				ImGui::RadioButton("Uniform", reinterpret_cast<int *>(&m_renderGlobals.m_lightSamplerId), 0);
+				ImGui::RadioButton("BVH", reinterpret_cast<int *>(&m_renderGlobals.m_lightSamplerId), 1);
+				ImGui::RadioButton("Power", reinterpret_cast<int *>(&m_renderGlobals.m_lightSamplerId), 2);
+
+				ImGui::EndMenu();
+			}
+
 			ImGui::Separator();
 			ImGui::MenuItem("Config", NULL, &m_renderConfigState);
 
@@ -264,15 +302,14 @@ void Window::SetupGUI()
 			{
 				if (const std::string filepath = GetBrowserFilePath(); !filepath.empty())
 				{
-					m_renderManager.LoadScene(filepath);
-					m_renderManager.SetRenderDirty();
+					m_renderManager.LoadSceneAsync({ filepath });
 				}
 			}
 			if (ImGui::MenuItem("Import..."))
 			{
+				// Streamed in on the render thread like a load, so the scene is not changed under the renderer.
 				if (const std::string filepath = GetBrowserFilePath(); !filepath.empty())
-					if (m_renderManager.ImportScene(filepath))
-						m_renderManager.SetRenderDirty();
+					m_renderManager.ImportScenesAsync({ filepath });
 			}
 
 			ImGui::EndMenu();
@@ -351,9 +388,24 @@ void Window::RenderConfigWindow()
 
 	ImGui::InputInt("Max Depth", reinterpret_cast<int*>(&m_renderGlobals.m_maxDepth));
 	ImGui::InputInt("Russian Roulette Depth", reinterpret_cast<int*>(&m_renderGlobals.m_russianRouletteDepth));
+	ImGui::Checkbox("Path Guiding", &m_renderGlobals.m_pathGuiding);
+
+	ImGui::Separator();
+
+	int lightCandidates = static_cast<int>(m_renderGlobals.GetLightCandidates());
+	if (ImGui::InputInt("Light Candidates", &lightCandidates))
+		m_renderGlobals.SetLightCandidates(static_cast<uint32_t>(std::clamp(lightCandidates, 1, static_cast<int>(kMaxLightCandidates))));
 
 	ImGui::Separator();
 
+	if (const Scene* scene = m_renderManager.GetScene(); scene && scene->IsAnimated())
+	{
+		ImGui::SliderFloat("Frame", &m_renderGlobals.m_frame, scene->GetStartTime(), scene->GetEndTime(), "%.0f");
+		ImGui::Checkbox("Playback", &m_renderGlobals.m_playback);
+
+		ImGui::Separator();
+	}
+
 
 	ImGui::End();
 }
@@ -374,6 +426,17 @@ void Window::ProfilingWindow()
 	ImGui::End();
 }
 
+void Window::LoadingWindow()
+{
+	GUI_TRACE();
+	ImGui::Begin("Loading", nullptr, ImGuiWindowFlags_NoTitleBar | ImGuiWindowFlags_AlwaysAutoResize);
+
+	ImGui::Text("Loading scene...");
+	ImGui::ProgressBar(m_renderManager.GetLoadProgress(), ImVec2(200.f, 0.f));
+
+	ImGui::End();
+}
+
 void Window::AboutWindow()
 {
 	GUI_TRACE();
@@ -27,10 +27,10 @@ GUI_NAMESPACE_OPEN_SCOPE
 class Window
 {
 	public:
-		Window();
+		Window(const RenderGlobals& renderGlobals = RenderGlobals());
 		~Window() = default;
 
-		void RenderWindow(const std::string& scenePath);
+		void RenderWindow(const std::vector<std::string>& scenePaths);
 
 		// Callbacks for Renderer
 		bool CloseWindow() const { return glfwWindowShouldClose(m_window); }
@@ -84,6 +84,7 @@ class Window
 		void StopGUI();
 		void RenderConfigWindow();
 		void ProfilingWindow();
+		void LoadingWindow();
 		void AboutWindow();
 
 		// Callbacks for GLFW
@@ -62,5 +62,6 @@
 
 
 #define SPINDULYS_INVALID_GEOMETRY_ID ((unsigned int)-1)
+#define SPINDULYS_INVALID_LIGHT_ID ((unsigned int)-1)
 
 #endif //SPINDULYS_H
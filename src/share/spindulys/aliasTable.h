@@ -0,0 +1,151 @@
+#ifndef SPINDULYS_ALIAS_TABLE_H
+#define SPINDULYS_ALIAS_TABLE_H
+
+#include <vector>
+
+#include "../spindulys.h"
+
+#include "math/math.h"
+#include "math/constants.h"
+
+SPINDULYS_NAMESPACE_OPEN_SCOPE
+
+/**
+ * Sample a discrete distribution in constant time using Walker's alias method,
+ * built with Vose's linear time construction.
+ *
+ * Every entry splits its share of the unit interval between itself and one
+ * alias, so a sample picks an entry uniformly and then one of the two.
+ */
+class AliasTable
+{
+	public:
+		static constexpr uint32_t kInvalidIndex = uint32_t(-1);
+
+		AliasTable() = default;
+		AliasTable(const std::vector<float>& weights) { Build(weights); }
+
+		// Weights do not have to be normalised, but must not be negative.
+		// A table whose weights sum to zero is left empty.
+		void Build(const std::vector<float>& weights)
+		{
+			m_bins.clear();
+
+			double weightSum = 0.0;
+			for (float weight : weights)
+				weightSum += max(weight, 0.f);
+			if (weightSum <= 0.0)
+				return;
+
+			m_bins.resize(weights.size());
+			for (size_t i = 0; i < weights.size(); ++i)
+				m_bins[i].pmf = static_cast<float>(max(weights[i], 0.f) / weightSum);
+
+			// Split into the bins with too little and too much of their share, in doubles so that rounding does not pile up.
+			std::vector<std::pair<uint32_t, double>> under;
+			std::vector<std::pair<uint32_t, double>> over;
+			for (uint32_t i = 0; i < m_bins.size(); ++i)
+			{
+				const double scaled = max(weights[i], 0.f) / weightSum * m_bins.size();
+				if (scaled < 1.0)
+					under.emplace_back(i, scaled);
+				else
+					over.emplace_back(i, scaled);
+			}
+
+			// Top up each bin with too little from one with too much.
+			while (!under.empty() && !over.empty())
+			{
+				const auto [small, smallScaled] = under.back();
+				under.pop_back();
+				const auto [large, largeScaled] = over.back();
+				over.pop_back();
+
+				m_bins[small].q = static_cast<float>(smallScaled);
+				m_bins[small].alias = large;
+
+				const double excess = largeScaled - (1.0 - smallScaled);
+				if (excess < 1.0)
+					under.emplace_back(large, excess);
+				else
+					over.emplace_back(large, excess);
+			}
+
+			// Whatever is left over is within rounding of its share.
+			for (const auto& [i, scaled] : over)
+			{
+				m_bins[i].q = 1.f;
+				m_bins[i].alias = kInvalidIndex;
+			}
+			for (const auto& [i, scaled] : under)
+			{
+				m_bins[i].q = 1.f;
+				m_bins[i].alias = kInvalidIndex;
+			}
+		}
+
+		void Clear() { m_bins.clear(); }
+
+		/**
+		 * \param sample
+		 *     Uniformly distributed sample in [0, 1)
+		 *
+		 * \param pmf
+		 *     Set to the probability of the returned index if not null
+		 *
+		 * \param remapped
+		 *     Set to a fresh uniformly distributed sample in [0, 1) if not null
+		 *
+		 * \return
+		 *     The picked index, or kInvalidIndex if the table is empty
+		 */
+		uint32_t Sample(float sample, float* pmf = nullptr, float* remapped = nullptr) const
+		{
+			if (m_bins.empty())
+			{
+				if (pmf)
+					*pmf = 0.f;
+				return kInvalidIndex;
+			}
+
+			const float scaled = sample * m_bins.size();
+			const uint32_t offset = min(static_cast<uint32_t>(scaled), static_cast<uint32_t>(m_bins.size() - 1));
+			const float up = min(scaled - offset, OneMinusEpsilon<float>);
+
+			const Bin& bin = m_bins[offset];
+			if (up < bin.q)
+			{
+				if (pmf)
+					*pmf = bin.pmf;
+				if (remapped)
+					*remapped = min(up / bin.q, OneMinusEpsilon<float>);
+				return offset;
+			}
+
+			if (pmf)
+				*pmf = m_bins[bin.alias].pmf;
+			if (remapped)
+				*remapped = min((up - bin.q) / (1.f - bin.q), OneMinusEpsilon<float>);
+			return bin.alias;
+		}
+
+		float Pmf(uint32_t index) const { return index < m_bins.size() ? m_bins[index].pmf : 0.f; }
+
+		size_t Size() const { return m_bins.size(); }
+		bool   Empty() const { return m_bins.empty(); }
+
+	private:
+		struct Bin
+		{
+			// The share of the bin which picks itself, the rest picks the alias.
+			float q = 0.f;
+			float pmf = 0.f;
+			uint32_t alias = kInvalidIndex;
+		};
+
+		std::vector<Bin> m_bins;
+};
+
+SPINDULYS_NAMESPACE_CLOSE_SCOPE
+
+#endif // SPINDULYS_ALIAS_TABLE_H
@@ -19,10 +19,32 @@ static constexpr size_t kMaxBSDFSamples = 1;
 
 static constexpr uint32_t kDefaultMaxDepth = 3;
 static constexpr uint32_t kDefaultRussianRouletteDepth = 5;
+static constexpr bool kDefaultPathGuiding = false;
+
+static constexpr uint32_t kDefaultLightCandidates = 16;
+static constexpr uint32_t kMaxLightCandidates = 256;
 
 static constexpr bool kDefaultScaleResolution = false;
 static constexpr float kDefaultGrowSize = 0.25f;
 
+// Compact BVH leaves, and packed vertex normals, which only exist when smooth normals are on as well.
+static constexpr bool kDefaultCompactGeometry = false;
+static constexpr bool kDefaultSmoothNormals = false;
+static constexpr bool kDefaultOptimizeLocality = false;
+static constexpr bool kDefaultSceneCache = false;
+
+// Scene Loading
+static constexpr bool kDefaultRenderPurposeOnly = true;
+static constexpr bool kDefaultSkipInvisible = true;
+static constexpr bool kDefaultLoadPayloads = true;
+static constexpr bool kDefaultWatchEdits = true;
+// Milliseconds between adding batches of streamed geometry to the scene.
+static constexpr uint32_t kStreamCommitInterval = 250;
+
+// Animation
+static constexpr float kDefaultFrame = 1.f;
+static constexpr bool kDefaultPlayback = false;
+
 
 SPINDULYS_NAMESPACE_CLOSE_SCOPE
 
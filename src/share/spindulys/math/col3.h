@@ -107,6 +107,9 @@ template<typename T> __forceinline T reduce_mul( const Col3<T>& a ) { return a.r
 template<typename T> __forceinline T reduce_min( const Col3<T>& a ) { return min(a.r, a.g, a.b); }
 template<typename T> __forceinline T reduce_max( const Col3<T>& a ) { return max(a.r, a.g, a.b); }
 
+/*! luminance of a linear Rec. 709 colour */
+template<typename T> __forceinline T luminance( const Col3<T>& a ) { return a.r * T(0.212671f) + a.g * T(0.715160f) + a.b * T(0.072169f); }
+
 ////////////////////////////////////////////////////////////////////////////////
 /// Comparison Operators
 ////////////////////////////////////////////////////////////////////////////////
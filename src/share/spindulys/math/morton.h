@@ -0,0 +1,35 @@
+#ifndef SPINDULYS_MORTON_H
+#define SPINDULYS_MORTON_H
+
+#include <cstdint>
+
+#include "../../spindulys.h"
+#include "../platform.h"
+
+SPINDULYS_NAMESPACE_OPEN_SCOPE
+
+// =======================================================================
+// Morton (Z-order) codes, which keep points close in space close in order.
+// =======================================================================
+
+// Spread the lower 10 bits of x out so there are two zero bits between each of them.
+__forceinline uint32_t morton_expand_bits(uint32_t x)
+{
+	x &= 0x3ff;
+	x = (x | (x << 16)) & 0x030000ff;
+	x = (x | (x <<  8)) & 0x0300f00f;
+	x = (x | (x <<  4)) & 0x030c30c3;
+	x = (x | (x <<  2)) & 0x09249249;
+
+	return x;
+}
+
+// Interleave three 10 bit coordinates into a 30 bit code.
+__forceinline uint32_t morton_encode(uint32_t x, uint32_t y, uint32_t z)
+{
+	return (morton_expand_bits(x) << 2) | (morton_expand_bits(y) << 1) | morton_expand_bits(z);
+}
+
+SPINDULYS_NAMESPACE_CLOSE_SCOPE
+
+#endif // SPINDULYS_MORTON_H
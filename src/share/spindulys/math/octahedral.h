@@ -0,0 +1,57 @@
+#ifndef SPINDULYS_OCTAHEDRAL_H
+#define SPINDULYS_OCTAHEDRAL_H
+
+#include <cstdint>
+
+#include "../../spindulys.h"
+#include "../platform.h"
+
+#include "math.h"
+#include "vec3.h"
+
+SPINDULYS_NAMESPACE_OPEN_SCOPE
+
+// =======================================================================
+// Octahedral unit vector encoding, see "A Survey of Efficient Representations
+// for Independent Unit Vectors" by Cigolle et al. 2014.
+// =======================================================================
+
+// Pack a unit vector into two 16 bit snorm values stored in a single 32 bit integer.
+__forceinline uint32_t oct_encode(const Vec3f& n)
+{
+	const float invL1 = 1.f / (abs(n.x) + abs(n.y) + abs(n.z));
+
+	float u = n.x * invL1;
+	float v = n.y * invL1;
+
+	// Fold the lower hemisphere over the diagonals
+	if (n.z < 0.f)
+	{
+		const float tu = u;
+		u = (1.f - abs(v)) * sign(tu);
+		v = (1.f - abs(tu)) * sign(v);
+	}
+
+	auto quantise = [](float x) { return (uint32_t) ((int32_t) std::round(clamp(x, -1.f, 1.f) * 32767.f) & 0xffff); };
+
+	return quantise(u) | (quantise(v) << 16);
+}
+
+// Inverse of the mapping oct_encode
+__forceinline Vec3f oct_decode(uint32_t packed)
+{
+	const float u = max((float) (int16_t) (packed & 0xffff) / 32767.f, -1.f);
+	const float v = max((float) (int16_t) (packed >> 16) / 32767.f, -1.f);
+
+	Vec3f n(u, v, 1.f - abs(u) - abs(v));
+
+	const float t = max(-n.z, 0.f);
+	n.x += n.x >= 0.f ? -t : t;
+	n.y += n.y >= 0.f ? -t : t;
+
+	return normalize(n);
+}
+
+SPINDULYS_NAMESPACE_CLOSE_SCOPE
+
+#endif // SPINDULYS_OCTAHEDRAL_H
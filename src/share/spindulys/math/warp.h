@@ -14,7 +14,7 @@ SPINDULYS_NAMESPACE_OPEN_SCOPE
 // Warping techniques that operate in the plane
 // =======================================================================
 
-__forceinline float circ(float x) { return safe_sqrt(madd(x, x, 1.f)); }
+__forceinline float circ(float x) { return safe_sqrt(nmadd(x, x, 1.f)); }
 
 __forceinline Vec2f square_to_cosine_uniform_disk(const Vec2f& sample)
 {
@@ -62,7 +62,7 @@ __forceinline Vec2f square_to_uniform_disk_concentric(const Vec2f& sample)
 // Uniformly sample a vector on the unit sphere with respect to solid angles
 __forceinline Vec3f square_to_uniform_sphere(const Vec2f& sample)
 {
-	float z = madd(2.f, sample.y, 1.f);
+	float z = nmadd(2.f, sample.y, 1.f);
 	float r = circ(z);
 
 	float _sin, _cos;
@@ -101,6 +101,83 @@ __forceinline float square_to_cosine_hemisphere_pdf(const Vec3f &v)
 	return InvPi<float> * v.z;
 }
 
+// =======================================================================
+// Warping techniques related to triangles
+// =======================================================================
+
+// Uniformly sample the barycentric coordinates (b1, b2) of a point on a triangle with respect to area,
+// using Eric Heitz's low distortion mapping
+__forceinline Vec2f square_to_uniform_triangle(const Vec2f& sample)
+{
+	float b0, b1;
+	if (sample.x < sample.y)
+	{
+		b0 = sample.x * 0.5f;
+		b1 = sample.y - b0;
+	}
+	else
+	{
+		b1 = sample.y * 0.5f;
+		b0 = sample.x - b1;
+	}
+
+	return { b1, 1.f - b0 - b1 };
+}
+
+// Solid angle of the spherical triangle with the given unit vertices, by Van Oosterom and Strackee
+__forceinline float spherical_triangle_area(const Vec3f& a, const Vec3f& b, const Vec3f& c)
+{
+	return abs(2.f * atan2(dot(a, cross(b, c)), 1.f + dot(a, b) + dot(a, c) + dot(b, c)));
+}
+
+// Angle between two unit vectors, stable for small angles unlike the arc cosine of their dot product
+__forceinline float unit_angle(const Vec3f& a, const Vec3f& b)
+{
+	return dot(a, b) < 0.f ? Pi<float> - 2.f * asin(min(length(a + b) * 0.5f, 1.f)) : 2.f * asin(min(length(b - a) * 0.5f, 1.f));
+}
+
+/* Uniformly sample a direction within the spherical triangle with the given unit vertices with respect to
+	 solid angles, using James Arvo's "Stratified Sampling of Spherical Triangles". The density is one over
+	 spherical_triangle_area. Returns zero if the triangle is degenerate. */
+__forceinline Vec3f square_to_spherical_triangle(const Vec3f& a, const Vec3f& b, const Vec3f& c, const Vec2f& sample)
+{
+	Vec3f nab = cross(a, b);
+	Vec3f nbc = cross(b, c);
+	Vec3f nca = cross(c, a);
+	if (dot(nab, nab) == 0.f || dot(nbc, nbc) == 0.f || dot(nca, nca) == 0.f)
+		return Vec3f(zero);
+	nab = normalize(nab);
+	nbc = normalize(nbc);
+	nca = normalize(nca);
+
+	// The angles at each vertex, whose excess over pi is the area
+	const float alpha = unit_angle(nab, -nca);
+	const float beta  = unit_angle(nbc, -nab);
+	const float gamma = unit_angle(nca, -nbc);
+
+	// Pick the area of the sub triangle the sample lies in, and with it the vertex c' along the edge from a to c
+	const float areaPi = alpha + beta + gamma;
+	const float subAreaPi = madd(sample.x, areaPi - Pi<float>, Pi<float>);
+	const float cosAlpha = cos(alpha);
+	const float sinAlpha = sin(alpha);
+	const float sinPhi = sin(subAreaPi) * cosAlpha - cos(subAreaPi) * sinAlpha;
+	const float cosPhi = cos(subAreaPi) * cosAlpha + sin(subAreaPi) * sinAlpha;
+	const float k1 = cosPhi + cosAlpha;
+	const float k2 = sinPhi - sinAlpha * dot(a, b);
+	const float cosBp = clamp((k2 + (k2 * cosPhi - k1 * sinPhi) * cosAlpha) / ((k2 * sinPhi + k1 * cosPhi) * sinAlpha), -1.f, 1.f);
+	const float sinBp = safe_sqrt(1.f - sqr(cosBp));
+	const Vec3f cp = cosBp * a + sinBp * normalize(c - dot(c, a) * a);
+
+	// Then the direction along the arc from b to c'
+	const float cosTheta = 1.f - sample.y * (1.f - dot(cp, b));
+	const float sinTheta = safe_sqrt(1.f - sqr(cosTheta));
+	const Vec3f perp = cp - dot(cp, b) * b;
+	if (dot(perp, perp) == 0.f)
+		return b;
+
+	return normalize(cosTheta * b + sinTheta * normalize(perp));
+}
+
 SPINDULYS_NAMESPACE_CLOSE_SCOPE
 
 #endif // SPINDULYS_WARP_H
@@ -0,0 +1,85 @@
+#ifndef SPINDULYS_SPLAT_BUFFER_H
+#define SPINDULYS_SPLAT_BUFFER_H
+
+#include <atomic>
+#include <memory>
+
+#include "../spindulys.h"
+
+#include "math/math.h"
+#include "math/col3.h"
+
+SPINDULYS_NAMESPACE_OPEN_SCOPE
+
+/**
+ * Accumulates contributions to arbitrary pixels from many threads at once.
+ *
+ * Every channel is added to with a compare and swap, so splatting never takes
+ * a lock. Contributions from different paths rarely land on the same pixel at
+ * the same time, so the swaps hardly ever have to retry.
+ */
+class SplatBuffer
+{
+	public:
+		SplatBuffer() = default;
+
+		// Only reallocates, and so clears, if the number of pixels changed. Taking every pixel clears it otherwise.
+		void Resize(size_t width, size_t height)
+		{
+			const size_t size = width * height;
+			if (size == m_size)
+				return;
+
+			m_data = std::make_unique<std::atomic<float>[]>(size * 3);
+			m_size = size;
+		}
+
+		void Clear()
+		{
+			for (size_t i = 0; i < m_size * 3; ++i)
+				m_data[i].store(0.f, std::memory_order_relaxed);
+		}
+
+		void Splat(size_t pixelIndex, const Col3f& value)
+		{
+			if (pixelIndex >= m_size || !isfinite(value.r) || !isfinite(value.g) || !isfinite(value.b))
+				return;
+
+			AtomicAdd(m_data[pixelIndex * 3], value.r);
+			AtomicAdd(m_data[pixelIndex * 3 + 1], value.g);
+			AtomicAdd(m_data[pixelIndex * 3 + 2], value.b);
+		}
+
+		// Returns what was splatted into the pixel and clears it, ready for the next iteration.
+		Col3f Take(size_t pixelIndex)
+		{
+			if (pixelIndex >= m_size)
+				return Col3f(zero);
+
+			return Col3f(
+					m_data[pixelIndex * 3].exchange(0.f, std::memory_order_relaxed),
+					m_data[pixelIndex * 3 + 1].exchange(0.f, std::memory_order_relaxed),
+					m_data[pixelIndex * 3 + 2].exchange(0.f, std::memory_order_relaxed));
+		}
+
+		size_t Size() const { return m_size; }
+
+	private:
+		static void AtomicAdd(std::atomic<float>& value, float add)
+		{
+			if (add == 0.f)
+				return;
+
+			float current = value.load(std::memory_order_relaxed);
+			while (!value.compare_exchange_weak(current, current + add, std::memory_order_relaxed));
+		}
+
+	private:
+		// Three channels per pixel.
+		std::unique_ptr<std::atomic<float>[]> m_data;
+		size_t m_size = 0;
+};
+
+SPINDULYS_NAMESPACE_CLOSE_SCOPE
+
+#endif // SPINDULYS_SPLAT_BUFFER_H
@@ -13,15 +13,10 @@ CPUCurve::CPUCurve()
 
 }
 
-CPUCurve::CPUCurve(Curve* curve)
-	: Curve(Geometry::GeometryTypes::Mesh, curve->GetName())
+CPUCurve::CPUCurve(Curve&& curve)
+	: Curve(std::move(curve))
 {
-	m_transform = curve->GetTransform();
-	m_displayColor = curve->GetDisplayColor();
-	m_points = curve->GetPoints();
-	m_normals = curve->GetNormals();
-	m_widths = curve->GetWidths();
-	m_curveType = curve->GetCurveType();
+
 }
 
 bool CPUCurve::CreatePrototype(const RTCDevice& device)
@@ -106,6 +101,45 @@ bool CPUCurve::CreatePrototype(const RTCDevice& device)
 	return true;
 }
 
+bool CPUCurve::UpdatePoints(const std::vector<Vec3f>& points)
+{
+	if (points.size() != m_points.size())
+	{
+		spdlog::warn("Curve {} cannot change its number of points.", m_name);
+		return false;
+	}
+
+	m_points = points;
+
+	Vec4f* verts = (Vec4f*)rtcGetGeometryBufferData(m_geom, RTC_BUFFER_TYPE_VERTEX, 0);
+	for (size_t i = 0; i < m_points.size(); ++i)
+		verts[i] = Vec4f(m_points[i].x, m_points[i].y, m_points[i].z, m_widths[i] / 2.f);
+
+	rtcUpdateGeometryBuffer(m_geom, RTC_BUFFER_TYPE_VERTEX, 0);
+	rtcCommitGeometry(m_geom);
+	rtcCommitScene(m_scene);
+
+	return true;
+}
+
+bool CPUCurve::UpdateNormals(const std::vector<Vec3f>& normals)
+{
+	if (normals.size() != m_normals.size())
+		return false;
+
+	// Copied in place so the buffer shared with Embree does not move.
+	std::copy(normals.begin(), normals.end(), m_normals.begin());
+
+	if (m_curveType == CurveTypes::NormalOrientatedBezier || m_curveType == CurveTypes::NormalOrientatedBSpline)
+	{
+		rtcUpdateGeometryBuffer(m_geom, RTC_BUFFER_TYPE_NORMAL, 0);
+		rtcCommitGeometry(m_geom);
+		rtcCommitScene(m_scene);
+	}
+
+	return true;
+}
+
 SurfaceInteraction CPUCurve::ComputeSurfaceInteraction(const Ray& ray,
 		const PreliminaryIntersection& pi,
 		uint32_t rayFlags,
@@ -128,9 +162,6 @@ SurfaceInteraction CPUCurve::ComputeSurfaceInteraction(const Ray& ray,
 
 	si.uv = pi.primUV;
 
-	// Currently everything is an instance so...
-	ComputeInstanceSurfaceInteraction(si, ray);
-
 	return si;
 }
 
@@ -14,10 +14,13 @@ class CPUCurve final : public CPUGeometry, public Curve
 {
 	public:
 		CPUCurve();
-		CPUCurve(Curve* curve);
+		CPUCurve(Curve&& curve);
 
 		virtual bool CreatePrototype(const RTCDevice& device) override;
 
+		virtual bool UpdatePoints(const std::vector<Vec3f>& points) override;
+		virtual bool UpdateNormals(const std::vector<Vec3f>& normals) override;
+
 		virtual SurfaceInteraction ComputeSurfaceInteraction(const Ray& ray,
 				const PreliminaryIntersection& pi,
 				uint32_t rayFlags = (uint32_t) RayFlags::All,
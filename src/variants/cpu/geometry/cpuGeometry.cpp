@@ -24,21 +24,47 @@ CPUGeometry::CPUGeometry()
 
 CPUGeometry::~CPUGeometry()
 {
-
+	// The instance holds its own reference to the prototype, so it stays alive until the instance is detached.
+	if (m_scene)
+		rtcReleaseScene(m_scene);
 }
 
-bool CPUGeometry::Create(const RTCDevice& device,
-		const RTCScene& topScene)
+bool CPUGeometry::CommitPrototype(const RTCDevice& device)
 {
-	CreatePrototype(device);
+	if (!CreatePrototype(device))
+		return false;
+
+	// Deforming geometry has its BVH refitted rather than rebuilt when the points change.
+	if (IsDeforming())
+	{
+		rtcSetGeometryBuildQuality(m_geom, RTC_BUILD_QUALITY_REFIT);
+		rtcSetSceneFlags(m_scene, (RTCSceneFlags) (rtcGetSceneFlags(m_scene) | RTC_SCENE_FLAG_DYNAMIC));
+	}
 
 	rtcCommitGeometry(m_geom);
 	rtcReleaseGeometry(m_geom);
 
 	rtcCommitScene(m_scene);
 
+	return true;
+}
+
+void CPUGeometry::SharePrototype(const std::shared_ptr<const CPUGeometry>& prototype)
+{
+	m_prototype = prototype;
+
+	m_scene = prototype->m_scene;
+	rtcRetainScene(m_scene);
+}
+
+void CPUGeometry::CreateInstance(const RTCDevice& device,
+		const RTCScene& topScene,
+		unsigned int geomInstanceID)
+{
+	// Attaching to the top scene is thread safe so geometry can be created in parallel.
 	m_geomInstance = rtcNewGeometry(device, RTC_GEOMETRY_TYPE_INSTANCE);
-	m_geomInstanceID = rtcAttachGeometry(topScene, m_geomInstance);
+	m_geomInstanceID = geomInstanceID;
+	rtcAttachGeometryByID(topScene, m_geomInstance, m_geomInstanceID);
 
 	rtcSetGeometryInstancedScene(m_geomInstance, m_scene);
 	rtcSetGeometryTimeStepCount(m_geomInstance, 1);
@@ -50,6 +76,31 @@ bool CPUGeometry::Create(const RTCDevice& device,
 
 	rtcCommitGeometry(m_geomInstance);
 	rtcReleaseGeometry(m_geomInstance);
+}
+
+bool CPUGeometry::UpdateTransform(const AffineSpace3f& affine)
+{
+	if (!SetTransfrom(affine))
+		return false;
+
+	rtcSetGeometryTransform(m_geomInstance,
+			0,
+			RTC_FORMAT_FLOAT3X4_COLUMN_MAJOR,
+			(float*)&m_transform);
+	rtcCommitGeometry(m_geomInstance);
+
+	return true;
+}
+
+bool CPUGeometry::SetVisible(bool visible)
+{
+	if (visible == std::exchange(m_visible, visible))
+		return false;
+
+	if (visible)
+		rtcEnableGeometry(m_geomInstance);
+	else
+		rtcDisableGeometry(m_geomInstance);
 
 	return true;
 }
@@ -58,10 +109,11 @@ void CPUGeometry::ComputeInstanceSurfaceInteraction(SurfaceInteraction& si, cons
 {
 	si.p = xfmPoint(GetTransform(), si.p);
 
-	si.n = xfmVector(GetTransform(), si.n);
+	// Normals only stay perpendicular to the surface under the inverse transpose.
+	si.n = xfmNormal(GetTransform(), si.n);
 	si.n = normalize(si.n);
 
-	si.shadingFrame.vz = xfmVector(GetTransform(), si.shadingFrame.vz);
+	si.shadingFrame.vz = xfmNormal(GetTransform(), si.shadingFrame.vz);
 	si.shadingFrame.vz = normalize(si.shadingFrame.vz);
 
 	si.instID = m_geomInstanceID;
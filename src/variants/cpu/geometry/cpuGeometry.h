@@ -1,6 +1,8 @@
 #ifndef CPU_GEOMETRY_H
 #define CPU_GEOMETRY_H
 
+#include <memory>
+
 #include <embree3/rtcore.h>
 #include <embree3/rtcore_ray.h>
 
@@ -19,6 +21,7 @@ CPU_NAMESPACE_OPEN_SCOPE
 
 struct SurfaceInteraction;
 struct PreliminaryIntersection;
+class CPUAreaLight;
 
 class CPUGeometry : virtual public Geometry
 {
@@ -26,8 +29,27 @@ class CPUGeometry : virtual public Geometry
 		CPUGeometry();
 		virtual ~CPUGeometry();
 
-		virtual bool Create(const RTCDevice& device, const RTCScene& topScene);
+		// Build the prototype BVH, this does not touch the top level scene so it can run while rendering.
+		bool CommitPrototype(const RTCDevice& device);
+		// Instance the prototype into the top level scene under the given id.
+		void CreateInstance(const RTCDevice& device, const RTCScene& topScene, unsigned int geomInstanceID);
 		virtual bool CreatePrototype(const RTCDevice& device) = 0;
+		// Instance the prototype of identical geometry instead of building one. The prototype geometry is kept alive
+		// by this and is what gets shaded, so implementations drop their own copy of the buffers.
+		virtual void SharePrototype(const std::shared_ptr<const CPUGeometry>& prototype);
+		bool IsShared() const { return m_prototype != nullptr; }
+
+		// Hash of the content the prototype was built from, zero when it is not offered for sharing.
+		void SetContentHash(uint64_t hash) { m_contentHash = hash; }
+		uint64_t GetContentHash() const { return m_contentHash; }
+
+		// Update the geometry after it has been created, the top level scene needs committing afterwards.
+		// The number of points cannot change.
+		bool UpdateTransform(const AffineSpace3f& affine);
+		bool SetVisible(bool visible);
+		bool IsVisible() const { return m_visible; }
+		virtual bool UpdatePoints(const std::vector<Vec3f>& points) = 0;
+		virtual bool UpdateNormals(const std::vector<Vec3f>& normals) = 0;
 
 		virtual SurfaceInteraction ComputeSurfaceInteraction(const Ray& ray,
 				const PreliminaryIntersection& pi,
@@ -36,14 +58,26 @@ class CPUGeometry : virtual public Geometry
 
 		void ComputeInstanceSurfaceInteraction(SurfaceInteraction& si, const Ray& ray) const;
 
+		// The geometry holding the data this instances, which is itself unless the prototype is shared.
+		const CPUGeometry* GetShape() const { return m_prototype ? m_prototype.get() : this; }
 		const CPUBSDF* GetBSDF() const { return m_bsdf.get(); }
 
+		// The light emitted from this instance's surface, owned by the scene.
+		CPUAreaLight* GetEmitter() const { return m_emitter; }
+		void SetEmitter(CPUAreaLight* emitter) { m_emitter = emitter; }
+
 	protected:
 		RTCScene m_scene = nullptr;
 		RTCGeometry m_geom = nullptr;
 
+		std::shared_ptr<const CPUGeometry> m_prototype;
+		uint64_t m_contentHash = 0;
+
 	private:
 		RTCGeometry m_geomInstance = nullptr;
+		bool m_visible = true;
+
+		CPUAreaLight* m_emitter = nullptr;
 
 		std::unique_ptr<CPUBSDF> m_bsdf;
 };
@@ -10,22 +10,26 @@ CPUMesh::CPUMesh()
 
 }
 
-CPUMesh::CPUMesh(Mesh* mesh)
-	: Mesh(Geometry::GeometryTypes::Mesh, mesh->GetName())
+CPUMesh::CPUMesh(Mesh&& mesh)
+	: Mesh(std::move(mesh))
 {
-	m_transform = mesh->GetTransform();
-	m_displayColor = mesh->GetDisplayColor();
-	m_points = mesh->GetPoints();
-	m_indices = mesh->GetIndices();
-	m_type = mesh->GetMeshType();
+
 }
 
 bool CPUMesh::CreatePrototype(const RTCDevice& device)
 {
 	m_scene = rtcNewScene(device);
+	// Compact BVH leaves reference the shared vertex buffer rather than holding their own copy.
+	if (m_compact)
+		rtcSetSceneFlags(m_scene, RTC_SCENE_FLAG_COMPACT);
 	m_geom = rtcNewGeometry(device, m_type == MeshType::QuadMesh ? RTC_GEOMETRY_TYPE_QUAD : RTC_GEOMETRY_TYPE_TRIANGLE);
 	m_geomID = rtcAttachGeometry(m_scene, m_geom);
 
+	// Embree reads vertices with 16 byte loads so the shared buffer needs padding past the last point.
+	// The loaders already reserve this, so this only reallocates for meshes built elsewhere.
+	if (m_points.capacity() == m_points.size())
+		m_points.reserve(m_points.size() + 1);
+
 	rtcSetSharedGeometryBuffer(m_geom,
 			RTC_BUFFER_TYPE_VERTEX,
 			0,
@@ -62,6 +66,65 @@ bool CPUMesh::CreatePrototype(const RTCDevice& device)
 	return true;
 }
 
+void CPUMesh::SharePrototype(const std::shared_ptr<const CPUGeometry>& prototype)
+{
+	CPUGeometry::SharePrototype(prototype);
+
+	std::vector<Vec3f>().swap(m_points);
+	std::vector<Vec3f>().swap(m_normals);
+	std::vector<int>().swap(m_indices);
+	std::vector<uint32_t>().swap(m_packedNormals);
+}
+
+bool CPUMesh::UpdatePoints(const std::vector<Vec3f>& points)
+{
+	// The points no longer line up with the ones given, so it has to be recreated.
+	if (m_reordered)
+		return false;
+
+	if (points.size() != m_points.size())
+	{
+		spdlog::warn("Mesh {} cannot change its number of points.", m_name);
+		return false;
+	}
+
+	// Copied in place so the buffer shared with Embree does not move.
+	std::copy(points.begin(), points.end(), m_points.begin());
+
+	rtcUpdateGeometryBuffer(m_geom, RTC_BUFFER_TYPE_VERTEX, 0);
+	rtcCommitGeometry(m_geom);
+	rtcCommitScene(m_scene);
+
+	return true;
+}
+
+bool CPUMesh::UpdateNormals(const std::vector<Vec3f>& normals)
+{
+	// Meshes shaded with their geometric normals have no vertex normals to update.
+	if (!HasVertexNormals())
+		return true;
+
+	if (m_reordered)
+		return false;
+
+	if (normals.size() != m_points.size())
+		return false;
+
+	// Normals are only used for shading so the BVH does not need updating.
+	if (m_compact)
+	{
+		m_packedNormals.resize(normals.size());
+		for (size_t i = 0; i < normals.size(); ++i)
+			m_packedNormals[i] = oct_encode(normals[i]);
+	}
+	else
+	{
+		m_normals = normals;
+	}
+
+	return true;
+}
+
 SurfaceInteraction CPUMesh::ComputeSurfaceInteraction(const Ray& ray,
 		const PreliminaryIntersection& pi,
 		uint32_t rayFlags,
@@ -126,10 +189,6 @@ SurfaceInteraction CPUMesh::ComputeSurfaceInteraction(const Ray& ray,
 
 	// TODO: Boundry test
 
-	// TODO: Currently everything is an instance so...
-	ComputeInstanceSurfaceInteraction(si, ray);
-
-
 	return si;
 }
 
@@ -14,9 +14,13 @@ class CPUMesh final : public CPUGeometry, public Mesh
 {
 	public:
 		CPUMesh();
-		CPUMesh(Mesh* mesh);
+		CPUMesh(Mesh&& mesh);
 
 		virtual bool CreatePrototype(const RTCDevice& device) override;
+		virtual void SharePrototype(const std::shared_ptr<const CPUGeometry>& prototype) override;
+
+		virtual bool UpdatePoints(const std::vector<Vec3f>& points) override;
+		virtual bool UpdateNormals(const std::vector<Vec3f>& normals) override;
 
 		virtual SurfaceInteraction ComputeSurfaceInteraction(const Ray& ray,
 				const PreliminaryIntersection& pi,
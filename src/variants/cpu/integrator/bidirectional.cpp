@@ -0,0 +1,461 @@
+#include "bidirectional.h"
+
+#include <spindulys/fwd.h>
+
+#include "../bsdf/cpuBSDF.h"
+
+#include "../utils/records.h"
+
+
+CPU_NAMESPACE_OPEN_SCOPE
+
+// Sets a value and puts the old one back once out of scope, so the weights can try out a connection in place.
+template <typename T>
+class ScopedAssignment
+{
+public:
+	ScopedAssignment(T* target = nullptr, T value = T())
+		: m_target(target)
+	{
+		if (m_target)
+		{
+			m_backup = *m_target;
+			*m_target = value;
+		}
+	}
+	~ScopedAssignment() { if (m_target) *m_target = m_backup; }
+
+	ScopedAssignment(const ScopedAssignment&) = delete;
+	ScopedAssignment& operator=(const ScopedAssignment&) = delete;
+
+private:
+	T* m_target;
+	T m_backup;
+};
+
+// Delta densities are stored as zero, which count the same as any other in the ratio of two strategies.
+static float Remap0(float pdf) { return pdf != 0.f ? pdf : 1.f; }
+
+Bidirectional::Bidirectional(uint32_t maxDepth, bool hideLights)
+	: m_maxDepth(maxDepth)
+{
+	m_hideLights = hideLights;
+}
+
+std::pair<Col3f, float>
+Bidirectional::Sample(const CPUScene* scene, Sampler* sampler, const Ray& ray, Col3f* /* aovs */) const
+{
+	if (unlikely(m_maxDepth == 0))
+		return { zero, false };
+
+	Subpaths& subpaths = m_subpaths.local();
+	if (subpaths.camera.size() < m_maxDepth + 1)
+	{
+		subpaths.camera.resize(m_maxDepth + 1);
+		subpaths.light.resize(m_maxDepth);
+	}
+
+	const uint32_t cameraVertices = GenerateCameraSubpath(scene, sampler, ray, subpaths.camera);
+	const uint32_t lightVertices = GenerateLightSubpath(scene, sampler, ray.time, subpaths.light);
+
+	// Only the environment is there where the camera ray missed, which hiding the lights takes away.
+	const bool validRay = cameraVertices > 1 &&
+		(!subpaths.camera[1].infinite || !m_hideLights);
+	if (!validRay)
+		return { zero, false };
+
+	Col3f result = zero;
+	for (uint32_t t = 2; t <= cameraVertices; ++t)
+	{
+		for (uint32_t s = 0; s <= lightVertices; ++s)
+		{
+			if (s + t - 1 > m_maxDepth)
+				break;
+
+			// Lights seen straight from the camera.
+			if (s == 0 && t == 2 && m_hideLights)
+				continue;
+
+			result += Connect(scene, sampler, subpaths.light, subpaths.camera, s, t);
+		}
+	}
+
+	return { result, validRay };
+}
+
+uint32_t Bidirectional::GenerateCameraSubpath(const CPUScene* scene, Sampler* sampler, const Ray& ray, std::vector<PathVertex>& path) const
+{
+	PathVertex& camera = path[0];
+	camera = PathVertex();
+	camera.type = PathVertex::Type::Camera;
+	camera.si.p = ray.origin;
+	camera.si.time = ray.time;
+	camera.beta = Col3f(one);
+	camera.pdfFwd = 1.f;
+
+	// The camera is never connected to, so the density of the ray leaving it never takes part in the weights.
+	return RandomWalk(scene, sampler, ray, Col3f(one), 1.f, m_maxDepth, TransportMode::Radiance, &path[1]) + 1;
+}
+
+uint32_t Bidirectional::GenerateLightSubpath(const CPUScene* scene, Sampler* sampler, float time, std::vector<PathVertex>& path) const
+{
+	// The camera needs at least one vertex of its own to connect to, so light paths stop a segment short.
+	if (m_maxDepth < 2)
+		return 0;
+
+	const auto [light, pmf] = scene->SampleEmitter(sampler->Next1d());
+	if (!light || pmf == 0.f)
+		return 0;
+
+	const Vec2f positionSample = sampler->Next2d();
+	const Vec2f directionSample = sampler->Next2d();
+	const auto [es, emitted] = light->SampleEmission(positionSample, directionSample, time);
+	if (es.pdf == 0.f || es.pdfDirection == 0.f || reduce_max(emitted) <= 0.f)
+		return 0;
+
+	PathVertex& origin = path[0];
+	origin = PathVertex();
+	origin.type = PathVertex::Type::Light;
+	origin.light = light;
+	origin.si.p = es.p;
+	origin.si.n = es.n;
+	origin.si.time = time;
+	origin.beta = emitted / (pmf * es.pdf);
+	origin.pdfFwd = pmf * es.pdf;
+	origin.infinite = HasFlag(light->GetFlags(), LightFlags::Infinite);
+
+	// Point lights have no normal and emit the same over every direction.
+	const float cosTheta = es.n != Vec3f(zero) ? abs(dot(es.n, es.d)) : 1.f;
+	const Col3f beta = emitted * cosTheta / (pmf * es.pdf * es.pdfDirection);
+
+	const Ray ray = Interaction(0.f, time, es.p, es.n).SpawnRay(es.d);
+	const uint32_t vertices = RandomWalk(scene, sampler, ray, beta, es.pdfDirection, m_maxDepth - 2, TransportMode::Importance, &path[1]) + 1;
+
+	// Paths from lights at infinity are picked by their direction, and where they start on the disk is
+	// the density of the first hit.
+	if (origin.infinite)
+	{
+		if (vertices > 1)
+		{
+			path[1].pdfFwd = es.pdf;
+			if (path[1].IsOnSurface())
+				path[1].pdfFwd *= abs(dot(es.d, path[1].si.n));
+		}
+		origin.pdfFwd = pmf * es.pdfDirection;
+	}
+
+	return vertices;
+}
+
+uint32_t Bidirectional::RandomWalk(const CPUScene* scene, Sampler* sampler, Ray ray, Col3f beta, float pdf,
+		uint32_t maxVertices, TransportMode mode, PathVertex* path) const
+{
+	if (maxVertices == 0)
+		return 0;
+
+	const BSDFContext bsdfContext(mode);
+	float pdfFwd = pdf;
+	uint32_t bounces = 0;
+	while (true)
+	{
+		if (reduce_max(beta) <= 0.f)
+			break;
+
+		SurfaceInteraction si = scene->RayIntersect(ray);
+		PathVertex& vertex = path[bounces];
+		PathVertex& prev = path[static_cast<int>(bounces) - 1];
+		vertex = PathVertex();
+
+		if (!si.IsValid())
+		{
+			// Camera paths which leave the scene end on the environment.
+			if (mode == TransportMode::Radiance && scene->GetEnvironment())
+			{
+				vertex.type = PathVertex::Type::Light;
+				vertex.light = scene->GetEnvironment();
+				vertex.si = si;
+				vertex.si.p = ray.origin + ray.direction;
+				vertex.si.n = -ray.direction;
+				vertex.beta = beta;
+				vertex.pdfFwd = pdfFwd;
+				vertex.infinite = true;
+				++bounces;
+			}
+			break;
+		}
+
+		vertex.type = PathVertex::Type::Surface;
+		vertex.si = si;
+		vertex.beta = beta;
+		vertex.pdfFwd = ConvertDensity(pdfFwd, prev, vertex);
+		if (mode == TransportMode::Radiance)
+			vertex.light = scene->LightHit(si);
+
+		if (++bounces >= maxVertices)
+			break;
+
+		const CPUBSDF* bsdf = si.shape->GetBSDF();
+		const float sample1 = sampler->Next1d();
+		const Vec2f sample2 = sampler->Next2d();
+		const auto [bs, bsdfWeight] = bsdf->Sample(bsdfContext, si, sample1, sample2);
+		if (bs.pdf <= 0.f || reduce_max(bsdfWeight) <= 0.f)
+			break;
+
+		const Vec3f wo = si.shadingFrame * si.wi;
+		const Vec3f wi = si.shadingFrame * bs.wo;
+		pdfFwd = bs.pdf;
+		beta = beta * bsdfWeight;
+
+		// The density of sampling the way back, with the directions swapped.
+		SurfaceInteraction reversed = si;
+		reversed.wi = bs.wo;
+		float pdfRev = bsdf->Pdf(BSDFContext(), reversed, si.wi);
+
+		if (HasFlag(bs.sampledType, BSDFFlags::Delta) || HasFlag(bs.sampledType, BSDFFlags::Delta1D))
+		{
+			vertex.delta = true;
+			pdfFwd = pdfRev = 0.f;
+		}
+
+		// Shading normals break the symmetry of the BSDF for importance.
+		if (mode == TransportMode::Importance)
+		{
+			const float denominator = abs(dot(wo, si.n)) * abs(dot(wi, si.shadingFrame.vz));
+			beta *= denominator != 0.f ? abs(dot(wo, si.shadingFrame.vz)) * abs(dot(wi, si.n)) / denominator : 0.f;
+		}
+
+		ray = si.SpawnRay(wi);
+		prev.pdfRev = ConvertDensity(pdfRev, vertex, prev);
+	}
+
+	return bounces;
+}
+
+Col3f Bidirectional::Connect(const CPUScene* scene, Sampler* sampler, std::vector<PathVertex>& lightPath,
+		std::vector<PathVertex>& cameraPath, uint32_t s, uint32_t t) const
+{
+	const PathVertex& pt = cameraPath[t - 1];
+
+	// The environment can only be reached by the camera path itself.
+	if (s != 0 && pt.type == PathVertex::Type::Light)
+		return zero;
+
+	Col3f result = zero;
+	PathVertex sampled;
+	if (s == 0)
+	{
+		// The camera path reached a light by itself.
+		if (!pt.IsLight())
+			return zero;
+
+		result = pt.beta * pt.light->Eval(pt.si, true);
+	}
+	else if (s == 1)
+	{
+		// Sample a point on a light just as the forward path tracer would, rather than using the light path.
+		if (!IsConnectible(pt))
+			return zero;
+
+		const auto [ds, lightVal] = scene->SampleLightDirection(pt.si, sampler->Next2d(), true, true);
+		if (ds.pdf == 0.f || !ds.light || reduce_max(lightVal) <= 0.f)
+			return zero;
+
+		sampled.type = PathVertex::Type::Light;
+		sampled.light = ds.light;
+		sampled.si.p = ds.p;
+		sampled.si.time = ds.time;
+		sampled.infinite = HasFlag(ds.light->GetFlags(), LightFlags::Infinite);
+		sampled.si.n = sampled.infinite ? -ds.d : ds.n;
+		sampled.beta = lightVal;
+		sampled.pdfFwd = PdfLightOrigin(scene, sampled, pt);
+
+		result = pt.beta * EvalBSDF(pt, ds.d, TransportMode::Radiance) * lightVal;
+	}
+	else
+	{
+		const PathVertex& qs = lightPath[s - 1];
+		if (!IsConnectible(qs) || !IsConnectible(pt))
+			return zero;
+
+		const Vec3f d = qs.si.p - pt.si.p;
+		const float distSqr = dot(d, d);
+		if (distSqr == 0.f)
+			return zero;
+
+		const Vec3f w = d / sqrt(distSqr);
+		result = qs.beta * EvalBSDF(qs, -w, TransportMode::Importance) * EvalBSDF(pt, w, TransportMode::Radiance) * pt.beta / distSqr;
+		if (reduce_max(result) <= 0.f || scene->RayTest(pt.si.SpawnRayTo(qs.si.p)))
+			return zero;
+	}
+
+	if (reduce_max(result) <= 0.f)
+		return zero;
+
+	return result * MultipleImportantSampleWeight(scene, lightPath, cameraPath, sampled, s, t);
+}
+
+float Bidirectional::MultipleImportantSampleWeight(const CPUScene* scene, std::vector<PathVertex>& lightPath,
+		std::vector<PathVertex>& cameraPath, const PathVertex& sampled, uint32_t s, uint32_t t) const
+{
+	if (s + t == 2)
+		return 1.f;
+
+	PathVertex* qs = s > 0 ? &lightPath[s - 1] : nullptr;
+	PathVertex* pt = &cameraPath[t - 1];
+	PathVertex* qsMinus = s > 1 ? &lightPath[s - 2] : nullptr;
+	PathVertex* ptMinus = t > 1 ? &cameraPath[t - 2] : nullptr;
+
+	// Make the path look as if it was generated by this strategy.
+	ScopedAssignment<PathVertex> a1(s == 1 ? qs : nullptr, sampled);
+
+	// The ends being connected scatter, whatever their BSDF did to leave them.
+	ScopedAssignment<bool> a2(&pt->delta, false);
+	ScopedAssignment<bool> a3(qs ? &qs->delta : nullptr, false);
+
+	// The reverse densities of the vertices at and next to the connection.
+	ScopedAssignment<float> a4(&pt->pdfRev, s > 0 ? Pdf(scene, *qs, qsMinus, *pt) : PdfLightOrigin(scene, *pt, *ptMinus));
+	ScopedAssignment<float> a5(ptMinus ? &ptMinus->pdfRev : nullptr,
+			ptMinus ? (s > 0 ? Pdf(scene, *pt, qs, *ptMinus) : PdfLight(*pt, *ptMinus)) : 0.f);
+	ScopedAssignment<float> a6(qs ? &qs->pdfRev : nullptr, qs ? Pdf(scene, *pt, ptMinus, *qs) : 0.f);
+	ScopedAssignment<float> a7(qsMinus ? &qsMinus->pdfRev : nullptr, qsMinus ? Pdf(scene, *qs, pt, *qsMinus) : 0.f);
+
+	// Every other strategy, moving the connection one vertex at a time, compared with the power heuristic.
+	float sumRi = 0.f;
+	float ri = 1.f;
+	for (uint32_t i = t - 1; i > 1; --i)
+	{
+		ri *= Remap0(cameraPath[i].pdfRev) / Remap0(cameraPath[i].pdfFwd);
+		if (!cameraPath[i].delta && !cameraPath[i - 1].delta)
+			sumRi += sqr(ri);
+	}
+
+	ri = 1.f;
+	for (int i = static_cast<int>(s) - 1; i >= 0; --i)
+	{
+		ri *= Remap0(lightPath[i].pdfRev) / Remap0(lightPath[i].pdfFwd);
+		const bool deltaLight = i > 0 ? lightPath[i - 1].delta : IsDeltaLight(lightPath[0]);
+		if (!lightPath[i].delta && !deltaLight)
+			sumRi += sqr(ri);
+	}
+
+	const float weight = 1.f / (1.f + sumRi);
+	return select(isfinite(weight), weight, 0.f);
+}
+
+Col3f Bidirectional::EvalBSDF(const PathVertex& vertex, const Vec3f& d, TransportMode mode)
+{
+	if (vertex.type != PathVertex::Type::Surface)
+		return zero;
+
+	const CPUBSDF* bsdf = vertex.si.shape->GetBSDF();
+	return bsdf->Eval(BSDFContext(mode), vertex.si, toLocal(vertex.si.shadingFrame, d));
+}
+
+float Bidirectional::Pdf(const CPUScene* scene, const PathVertex& vertex, const PathVertex* prev, const PathVertex& next)
+{
+	if (vertex.type == PathVertex::Type::Light)
+		return PdfLight(vertex, next);
+
+	// Camera vertices are never connected to, so how the camera samples rays is never asked for.
+	if (vertex.type == PathVertex::Type::Camera || !prev)
+		return 0.f;
+
+	SurfaceInteraction si = vertex.si;
+	si.wi = toLocal(si.shadingFrame, Direction(vertex, *prev));
+	const float pdf = si.shape->GetBSDF()->Pdf(BSDFContext(), si, toLocal(si.shadingFrame, Direction(vertex, next)));
+
+	return ConvertDensity(pdf, vertex, next);
+}
+
+float Bidirectional::PdfLight(const PathVertex& vertex, const PathVertex& next)
+{
+	if (!vertex.light)
+		return 0.f;
+
+	const Vec3f w = Direction(vertex, next);
+	float pdf = 0.f;
+	if (vertex.infinite)
+	{
+		// Any point of the disk the rays start on lines up with the next vertex.
+		pdf = vertex.light->PdfEmission(vertex.si.p, vertex.si.n, w).first;
+	}
+	else
+	{
+		const Vec3f d = next.si.p - vertex.si.p;
+		const float distSqr = dot(d, d);
+		if (distSqr == 0.f)
+			return 0.f;
+
+		const Vec3f n = vertex.type == PathVertex::Type::Light ? vertex.si.n : vertex.si.shadingFrame.vz;
+		pdf = vertex.light->PdfEmission(vertex.si.p, n, w).second / distSqr;
+	}
+
+	if (next.IsOnSurface())
+		pdf *= abs(dot(next.si.n, w));
+
+	return pdf;
+}
+
+float Bidirectional::PdfLightOrigin(const CPUScene* scene, const PathVertex& vertex, const PathVertex& next)
+{
+	if (!vertex.light)
+		return 0.f;
+
+	const Vec3f w = Direction(vertex, next);
+	const Vec3f n = vertex.type == PathVertex::Type::Light ? vertex.si.n : vertex.si.shadingFrame.vz;
+	const auto [pdfPosition, pdfDirection] = vertex.light->PdfEmission(vertex.si.p, n, w);
+
+	// Paths from lights at infinity are picked by their direction first.
+	return scene->PdfEmitter(vertex.light) * (vertex.infinite ? pdfDirection : pdfPosition);
+}
+
+float Bidirectional::ConvertDensity(float pdf, const PathVertex& from, const PathVertex& to)
+{
+	// Every point at infinity in the same direction is the same vertex.
+	if (to.infinite)
+		return pdf;
+
+	const Vec3f d = to.si.p - from.si.p;
+	const float distSqr = dot(d, d);
+	if (distSqr == 0.f)
+		return 0.f;
+
+	if (to.IsOnSurface())
+		pdf *= abs(dot(to.si.n, d / sqrt(distSqr)));
+
+	return pdf / distSqr;
+}
+
+Vec3f Bidirectional::Direction(const PathVertex& from, const PathVertex& to)
+{
+	// Vertices at infinity keep the direction into the scene as their normal.
+	if (from.infinite)
+		return from.si.n;
+	if (to.infinite)
+		return -to.si.n;
+
+	return normalize(to.si.p - from.si.p);
+}
+
+bool Bidirectional::IsConnectible(const PathVertex& vertex)
+{
+	switch (vertex.type)
+	{
+		case PathVertex::Type::Camera:
+			return true;
+		case PathVertex::Type::Light:
+			return vertex.light && !HasFlag(vertex.light->GetFlags(), LightFlags::DeltaDirection);
+		case PathVertex::Type::Surface:
+			return HasFlag(vertex.si.shape->GetBSDF()->GetFlags(), BSDFFlags::Smooth);
+	}
+
+	return false;
+}
+
+bool Bidirectional::IsDeltaLight(const PathVertex& vertex)
+{
+	return vertex.type == PathVertex::Type::Light && vertex.light &&
+		(HasFlag(vertex.light->GetFlags(), LightFlags::DeltaPosition) || HasFlag(vertex.light->GetFlags(), LightFlags::DeltaDirection));
+}
+
+CPU_NAMESPACE_CLOSE_SCOPE
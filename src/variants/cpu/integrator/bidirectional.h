@@ -0,0 +1,98 @@
+#ifndef CPU_BIDIRECTIONAL_H
+#define CPU_BIDIRECTIONAL_H
+
+#include <vector>
+
+#include <tbb/enumerable_thread_specific.h>
+
+#include "../spindulysCPU.h"
+
+#include "integrator.h"
+
+CPU_NAMESPACE_OPEN_SCOPE
+
+/* Bidirectional path tracing, after Veach. A path is traced from the camera and another from a light picked by
+	 its power, and every vertex of one is connected to every vertex of the other. Each connection is weighted
+	 with the power heuristic against every other way the same path could have been made.
+	 Light paths are not connected to the camera itself, as that needs splatting into other pixels, so those
+	 strategies are left out of the weights. */
+class Bidirectional final : public Integrator
+{
+public:
+	Bidirectional(uint32_t maxDepth = 3, bool hideLights = false);
+
+	virtual std::pair<Col3f, float>
+	Sample(const CPUScene* scene, Sampler* sampler, const Ray& ray, Col3f* /* aovs */) const override;
+
+	bool SetMaxDepth(uint32_t depth) { return depth != std::exchange(m_maxDepth, depth); }
+
+private:
+	struct PathVertex
+	{
+		enum class Type : uint8_t
+		{
+			Camera,
+			Light,
+			Surface,
+		};
+
+		bool IsLight() const    { return type == Type::Light || light; }
+		// Lights at a single point or in a single direction have no area to connect to.
+		bool IsOnSurface() const { return type == Type::Surface || (type == Type::Light && !infinite && si.n != Vec3f(zero)); }
+
+		Type type = Type::Surface;
+		// Lights only fill in the position and normal. Lights at infinity have the direction into the scene as normal.
+		SurfaceInteraction si;
+		// The light at the vertex, or the one a surface seen from the camera emits.
+		const CPULight* light = nullptr;
+		Col3f beta = Col3f(zero);
+		// Densities over area of sampling the vertex from either side.
+		float pdfFwd = 0.f;
+		float pdfRev = 0.f;
+		bool delta = false;
+		bool infinite = false;
+	};
+
+	// Vertices are kept per thread, so tracing paths does not allocate.
+	struct Subpaths
+	{
+		std::vector<PathVertex> camera;
+		std::vector<PathVertex> light;
+	};
+
+	uint32_t GenerateCameraSubpath(const CPUScene* scene, Sampler* sampler, const Ray& ray, std::vector<PathVertex>& path) const;
+	uint32_t GenerateLightSubpath(const CPUScene* scene, Sampler* sampler, float time, std::vector<PathVertex>& path) const;
+	// Extend the path from the vertex before the first one given. Returns the number of vertices added.
+	uint32_t RandomWalk(const CPUScene* scene, Sampler* sampler, Ray ray, Col3f beta, float pdf,
+			uint32_t maxVertices, TransportMode mode, PathVertex* path) const;
+
+	// The contribution of the first s light and t camera vertices joined up.
+	Col3f Connect(const CPUScene* scene, Sampler* sampler, std::vector<PathVertex>& lightPath,
+			std::vector<PathVertex>& cameraPath, uint32_t s, uint32_t t) const;
+	float MultipleImportantSampleWeight(const CPUScene* scene, std::vector<PathVertex>& lightPath,
+			std::vector<PathVertex>& cameraPath, const PathVertex& sampled, uint32_t s, uint32_t t) const;
+
+	// The BSDF at the vertex towards the world direction, with its cosine.
+	static Col3f EvalBSDF(const PathVertex& vertex, const Vec3f& d, TransportMode mode);
+	// Density over area of sampling next from the vertex, having reached it from prev.
+	static float Pdf(const CPUScene* scene, const PathVertex& vertex, const PathVertex* prev, const PathVertex& next);
+	// Density over area of the light at the vertex emitting towards next.
+	static float PdfLight(const PathVertex& vertex, const PathVertex& next);
+	// Density of picking the light vertex as the start of a light path.
+	static float PdfLightOrigin(const CPUScene* scene, const PathVertex& vertex, const PathVertex& next);
+	// Density over solid angle at from converted into one over area at to.
+	static float ConvertDensity(float pdf, const PathVertex& from, const PathVertex& to);
+	static Vec3f Direction(const PathVertex& from, const PathVertex& to);
+	static bool IsConnectible(const PathVertex& vertex);
+	static bool IsDeltaLight(const PathVertex& vertex);
+
+private:
+	// Paths are at most this many segments long, the same as the forward path tracer.
+	uint32_t m_maxDepth = 3;
+
+	mutable tbb::enumerable_thread_specific<Subpaths> m_subpaths;
+};
+
+CPU_NAMESPACE_CLOSE_SCOPE
+
+#endif // CPU_BIDIRECTIONAL_H
@@ -111,7 +111,7 @@ Direct::Sample(const CPUScene* scene, Sampler* sampler, const Ray& ray, Col3f* /
 		{
 			const Col3f lightVal = light->Eval(si_bsdf, true);
 
-			DirectionSample ds(si, si_bsdf, light);
+			DirectionSample ds(si_bsdf, si, light);
 
 			const float lightPDF = scene->PdfLightDirection(si, ds, true);
 			float mis = MultipleImportantSampleWeight(bs.pdf * m_fracBSDF, lightPDF * m_fracLum);
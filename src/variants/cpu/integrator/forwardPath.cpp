@@ -9,10 +9,34 @@
 
 CPU_NAMESPACE_OPEN_SCOPE
 
-ForwardPath::ForwardPath(uint32_t maxDepth, uint32_t russianRouletteDepth, bool hideLights)
+// Guided bounces past this are still sampled from the guide, but do not train it.
+static constexpr uint32_t kMaxGuidingRecords = 32;
+
+// A guided bounce, recorded into the guide once the radiance which came back along it is known.
+struct GuidingRecord
+{
+	GuidingRegion* region;
+	Vec3f direction;
+	// Throughput after the bounce and the radiance gathered before it.
+	Col3f throughput;
+	Col3f result;
+	float pdf;
+};
+
+ForwardPath::ForwardPath(uint32_t maxDepth, uint32_t russianRouletteDepth, bool hideLights, bool pathGuiding)
 	: m_maxDepth(maxDepth), m_russianRouletteDepth(russianRouletteDepth)
 {
 	m_hideLights = hideLights;
+	SetPathGuiding(pathGuiding);
+}
+
+bool ForwardPath::SetPathGuiding(bool pathGuiding)
+{
+	if (pathGuiding == (m_guide != nullptr))
+		return false;
+
+	m_guide = pathGuiding ? std::make_unique<PathGuide>() : nullptr;
+	return true;
 }
 
 
@@ -40,6 +64,12 @@ ForwardPath::Sample(const CPUScene* scene, Sampler* sampler, const Ray& ray, Col
 	bool prevBSDFDelta = true;
 	BSDFContext bsdfContext;
 
+	// Paths only train the guide while it is still learning.
+	std::array<GuidingRecord, kMaxGuidingRecords> guidingRecords;
+	uint32_t guidingRecordCount = 0;
+	const bool training = m_guide && m_guide->IsTraining();
+	const float bsdfFraction = PathGuide::kBSDFSamplingFraction;
+
 	while (active)
 	{
 		SurfaceInteraction si = scene->RayIntersect(continuousRay);
@@ -70,6 +100,10 @@ ForwardPath::Sample(const CPUScene* scene, Sampler* sampler, const Ray& ray, Col
 		uint32_t flags = bsdf->GetFlags();
 		uint32_t activeLight = HasFlag(flags, BSDFFlags::Smooth);
 
+		// Bounces are sampled from a mix of the BSDF and the guide once its region has learnt anything.
+		GuidingRegion* region = m_guide && IsGuidable(flags) ? m_guide->GetRegion(si.p) : nullptr;
+		const bool guided = region && region->CanSample();
+
 		if (activeLight)
 		{
 			DirectionSample ds;
@@ -88,6 +122,8 @@ ForwardPath::Sample(const CPUScene* scene, Sampler* sampler, const Ray& ray, Col
 				/* Determine BSDF value and probability of having sampled
 					 that same direction using BSDF sampling. */
 				auto [bsdfVal, bsdfPdf] = bsdf->EvalPdf(bsdfContext, si, wo, activeLight);
+				if (guided)
+					bsdfPdf = bsdfFraction * bsdfPdf + (1.f - bsdfFraction) * region->Pdf(ds.d);
 				float mis = select(ds.delta, 1.f, MultipleImportantSampleWeight(ds.pdf, bsdfPdf));
 
 				result += bsdfVal * lightVal * mis * throughput;
@@ -97,14 +133,38 @@ ForwardPath::Sample(const CPUScene* scene, Sampler* sampler, const Ray& ray, Col
 		// ------------------------ BSDF sampling -------------------------
 		float sample1 = sampler->Next1d();
 		Vec2f sample2 = sampler->Next2d();
+		// Drawn on every bounce while guiding is on, so every path uses the same sample dimensions.
+		const float guideSample = m_guide ? sampler->Next1d() : 0.f;
 		BSDFSample bs;
 		Col3f bsdfValue;
-		std::tie(bs, bsdfValue) = bsdf->Sample(bsdfContext, si, sample1, sample2);
+		if (guided && guideSample >= bsdfFraction)
+		{
+			// Sample the guide and weigh by the density of the whole mix.
+			const Vec3f direction = region->Sample(sample2);
+			bs.wo = toLocal(si.shadingFrame, direction);
+			const auto [value, bsdfPdf] = bsdf->EvalPdf(bsdfContext, si, bs.wo);
+			bs.pdf = bsdfFraction * bsdfPdf + (1.f - bsdfFraction) * region->Pdf(direction);
+			bs.sampledType = flags & +BSDFFlags::Smooth;
+			bsdfValue = bs.pdf > 0.f ? value / bs.pdf : Col3f(zero);
+		}
+		else
+		{
+			std::tie(bs, bsdfValue) = bsdf->Sample(bsdfContext, si, sample1, sample2);
+			if (guided && bs.pdf > 0.f)
+			{
+				const float mixturePdf = bsdfFraction * bs.pdf + (1.f - bsdfFraction) * region->Pdf(si.shadingFrame * bs.wo);
+				bsdfValue *= bs.pdf / mixturePdf;
+				bs.pdf = mixturePdf;
+			}
+		}
 
 		continuousRay = si.SpawnRay(si.shadingFrame * bs.wo);
 
 		// ------ Update loop variables based on current interaction ------
 		throughput = throughput * bsdfValue;
+
+		if (training && region && bs.pdf > 0.f && guidingRecordCount < kMaxGuidingRecords)
+			guidingRecords[guidingRecordCount++] = { region, continuousRay.direction, throughput, result, bs.pdf };
 		eta *= bs.eta;
 		validRay |= active && si.IsValid() && !HasFlag(bs.sampledType, BSDFFlags::Null);
 
@@ -130,10 +190,30 @@ ForwardPath::Sample(const CPUScene* scene, Sampler* sampler, const Ray& ray, Col
 		active = activeNext && (!russianRoulleteActive || russianRouletteContinue) && (throughputMax != 0.f);
 	}
 
+	// The radiance which arrived along each guided bounce is whatever the path gathered after it.
+	for (uint32_t i = 0; i < guidingRecordCount; ++i)
+	{
+		const GuidingRecord& record = guidingRecords[i];
+		const Col3f gathered = result - record.result;
+		const Col3f radiance(
+				record.throughput.r > 0.f ? gathered.r / record.throughput.r : 0.f,
+				record.throughput.g > 0.f ? gathered.g / record.throughput.g : 0.f,
+				record.throughput.b > 0.f ? gathered.b / record.throughput.b : 0.f);
+
+		record.region->Record(record.direction, luminance(radiance) / record.pdf);
+	}
+
 	return { validRay ? result : zero, validRay };
 }
 
 
+bool ForwardPath::IsGuidable(uint32_t flags)
+{
+	// Guided directions do not go through the BSDF's sampling, so refraction would lose its change of eta.
+	return HasFlag(flags, BSDFFlags::Smooth) &&
+		!HasFlag(flags, BSDFFlags::Delta) && !HasFlag(flags, BSDFFlags::Delta1D) && !HasFlag(flags, BSDFFlags::Transmission);
+}
+
 float ForwardPath::MultipleImportantSampleWeight(float pdfA, float pdfB) const
 {
 	pdfA *= pdfA;
@@ -1,6 +1,8 @@
 #ifndef CPU_FORWARD_PATH_H
 #define CPU_FORWARD_PATH_H
 
+#include <memory>
+
 #include <spindulys/math/col3.h>
 
 #include <render/renderManager.h>
@@ -8,30 +10,47 @@
 #include "../spindulysCPU.h"
 
 #include "integrator.h"
+#include "pathGuide.h"
 
 CPU_NAMESPACE_OPEN_SCOPE
 
 class ForwardPath: public Integrator
 {
 public:
-	ForwardPath(uint32_t maxDepth = 3, uint32_t russianRouletteDepth = 5, bool hideLights = false);
+	ForwardPath(uint32_t maxDepth = 3, uint32_t russianRouletteDepth = 5, bool hideLights = false, bool pathGuiding = false);
 
 	virtual std::pair<Col3f, float>
 	Sample(const CPUScene* scene, Sampler* sampler, const Ray& ray, Col3f* /* aovs */) const override;
 
+	virtual void BeginIteration(const CPUScene* scene, const Vec2i& /* resolution */) override
+	{
+		if (m_guide)
+			m_guide->BeginIteration(scene->GetSceneBounds());
+	}
+	virtual void EndIteration() override { if (m_guide) m_guide->EndIteration(); }
+	virtual void Reset() override        { if (m_guide) m_guide->Reset();        }
+
 	bool SetMaxDepth(uint32_t depth)             { return depth != std::exchange(m_maxDepth, depth);             }
 	bool SetRussianRouletteDepth(uint32_t depth) { return depth != std::exchange(m_russianRouletteDepth, depth); }
+	// Learn where light arrives from over the iterations and sample bounces towards it alongside the BSDF.
+	bool SetPathGuiding(bool pathGuiding);
 
 protected:
 
 private:
 	float MultipleImportantSampleWeight(float pdfA, float pdfB) const;
 
+	// Only bounces which the BSDF spreads over a 2D set of directions are worth guiding.
+	static bool IsGuidable(uint32_t flags);
+
 private:
 	uint32_t m_maxDepth = 2;
 
 	// Depth to begin using russian roulette
 	uint32_t m_russianRouletteDepth = 5;
+
+	// Null unless path guiding is on.
+	std::unique_ptr<PathGuide> m_guide;
 };
 
 CPU_NAMESPACE_CLOSE_SCOPE
@@ -2,6 +2,8 @@
 #define CPU_INTGRATOR_H
 
 #include <spindulys/math/col3.h>
+#include <spindulys/math/vec2.h>
+#include <spindulys/splatBuffer.h>
 
 #include <render/renderManager.h>
 
@@ -21,8 +23,25 @@ public:
 	virtual std::pair<Col3f, float>
 	Sample(const CPUScene* scene, Sampler* sample, const Ray& ray, Col3f* /* aovs */) const = 0;
 
+	// Integrators which reuse work between neighbouring pixels need to know which pixel the ray is for.
+	virtual std::pair<Col3f, float>
+	SamplePixel(const CPUScene* scene, Sampler* sampler, const Ray& ray, const Vec2i& /* pixel */, Col3f* aovs) const
+	{
+		return Sample(scene, sampler, ray, aovs);
+	}
+
 	bool SetHideLights(bool hideLights) { return hideLights != std::exchange(m_hideLights, hideLights); }
 
+	// Called around every render iteration, for integrators which learn from the iterations before.
+	virtual void BeginIteration(const CPUScene* /* scene */, const Vec2i& /* resolution */) {}
+	virtual void EndIteration() {}
+	// The render restarted, so anything learnt so far is out of date.
+	virtual void Reset() {}
+
+	// Integrators which add to pixels other than the one being sampled splat into a buffer, which is taken into
+	// the image at the end of every iteration as if it was part of the samples traced for each pixel.
+	virtual SplatBuffer* GetSplats() { return nullptr; }
+
 protected:
 	bool m_stop = false;
 
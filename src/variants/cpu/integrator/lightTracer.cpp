@@ -0,0 +1,146 @@
+#include "lightTracer.h"
+
+#include <spindulys/fwd.h>
+
+#include "../bsdf/cpuBSDF.h"
+
+#include "../utils/records.h"
+
+
+CPU_NAMESPACE_OPEN_SCOPE
+
+// Shading normals break the symmetry of the BSDF for importance, wi being towards the light and wo away from it.
+static float ShadingNormalCorrection(const SurfaceInteraction& si, const Vec3f& wi, const Vec3f& wo)
+{
+	const float denominator = abs(dot(wi, si.n)) * abs(dot(wo, si.shadingFrame.vz));
+	return denominator != 0.f ? abs(dot(wi, si.shadingFrame.vz)) * abs(dot(wo, si.n)) / denominator : 0.f;
+}
+
+LightTracer::LightTracer(uint32_t maxDepth, bool hideLights)
+	: m_maxDepth(maxDepth)
+{
+	m_hideLights = hideLights;
+}
+
+void LightTracer::BeginIteration(const CPUScene* /* scene */, const Vec2i& resolution)
+{
+	m_resolution = resolution;
+	m_splats.Resize(static_cast<size_t>(max(resolution.x, 0)), static_cast<size_t>(max(resolution.y, 0)));
+}
+
+std::pair<Col3f, float>
+LightTracer::Sample(const CPUScene* scene, Sampler* sampler, const Ray& ray, Col3f* /* aovs */) const
+{
+	if (unlikely(m_maxDepth == 0))
+		return { zero, false };
+
+	// Paths from the lights never reach the environment, so it is seen through the pixel's own ray instead.
+	Col3f result = zero;
+	bool validRay = true;
+	if (const CPULight* environment = scene->GetEnvironment())
+	{
+		const SurfaceInteraction si = scene->RayIntersect(ray);
+		validRay = si.IsValid() || !m_hideLights;
+		if (!si.IsValid() && !m_hideLights)
+			result = environment->Eval(si, true);
+	}
+
+	const auto [light, pmf] = scene->SampleEmitter(sampler->Next1d());
+	if (!light || pmf == 0.f)
+		return { result, validRay };
+
+	const Vec2f positionSample = sampler->Next2d();
+	const Vec2f directionSample = sampler->Next2d();
+	const auto [es, emitted] = light->SampleEmission(positionSample, directionSample, ray.time);
+	if (es.pdf == 0.f || es.pdfDirection == 0.f || reduce_max(emitted) <= 0.f)
+		return { result, validRay };
+
+	const Vec3f cameraPosition = scene->GetSceneCamera().GetPosition();
+	const bool infinite = HasFlag(light->GetFlags(), LightFlags::Infinite);
+
+	// Lights seen straight from the camera. Point lights cannot be seen and rays from lights at infinity do not
+	// start on anything.
+	if (!m_hideLights && !infinite && es.n != Vec3f(zero))
+	{
+		const float cosTheta = dot(es.n, normalize(cameraPosition - es.p));
+		if (cosTheta > 0.f)
+			SplatToCamera(scene, Interaction(0.f, ray.time, es.p, es.n), emitted * cosTheta / (pmf * es.pdf));
+	}
+
+	// Point lights have no normal and emit the same over every direction.
+	const float cosTheta = es.n != Vec3f(zero) ? abs(dot(es.n, es.d)) : 1.f;
+	Col3f throughput = emitted * cosTheta / (pmf * es.pdf * es.pdfDirection);
+
+	const BSDFContext bsdfContext(TransportMode::Importance);
+	Ray continuousRay = Interaction(0.f, ray.time, es.p, es.n).SpawnRay(es.d);
+
+	// The vertex at each depth is connected to the camera by one more segment.
+	for (uint32_t depth = 1; depth < m_maxDepth; ++depth)
+	{
+		const SurfaceInteraction si = scene->RayIntersect(continuousRay);
+		if (!si.IsValid())
+			break;
+
+		const CPUBSDF* bsdf = si.shape->GetBSDF();
+		const Vec3f wi = si.shadingFrame * si.wi;
+
+		// ---------------------- Camera connection ----------------------
+		if (HasFlag(bsdf->GetFlags(), BSDFFlags::Smooth))
+		{
+			const Vec3f toCamera = cameraPosition - si.p;
+			if (dot(toCamera, toCamera) > 0.f)
+			{
+				const Vec3f wo = normalize(toCamera);
+				const Col3f bsdfVal = bsdf->Eval(bsdfContext, si, toLocal(si.shadingFrame, wo));
+				SplatToCamera(scene, si, throughput * bsdfVal * ShadingNormalCorrection(si, wi, wo));
+			}
+		}
+
+		// ------------------------ BSDF sampling -------------------------
+		const float sample1 = sampler->Next1d();
+		const Vec2f sample2 = sampler->Next2d();
+		const auto [bs, bsdfWeight] = bsdf->Sample(bsdfContext, si, sample1, sample2);
+		if (bs.pdf <= 0.f)
+			break;
+
+		const Vec3f wo = si.shadingFrame * bs.wo;
+		throughput = throughput * bsdfWeight * ShadingNormalCorrection(si, wi, wo);
+		if (reduce_max(throughput) <= 0.f)
+			break;
+
+		continuousRay = si.SpawnRay(wo);
+	}
+
+	return { result, validRay };
+}
+
+void LightTracer::SplatToCamera(const CPUScene* scene, const Interaction& it, const Col3f& value) const
+{
+	if (reduce_max(value) <= 0.f)
+		return;
+
+	const Camera& camera = scene->GetSceneCamera();
+	Vec2f pixel;
+	if (!camera.ProjectToPixel(it.p, pixel))
+		return;
+
+	const int pixelX = min(static_cast<int>(pixel.x), m_resolution.x - 1);
+	const int pixelY = min(static_cast<int>(pixel.y), m_resolution.y - 1);
+	if (pixelX < 0 || pixelY < 0)
+		return;
+
+	// The camera is a single point, so only its importance and the falloff with distance are left.
+	const Vec3f toPoint = it.p - camera.GetPosition();
+	const float distSqr = dot(toPoint, toPoint);
+	const float importance = camera.EvalImportance(toPoint);
+	if (importance <= 0.f || distSqr == 0.f)
+		return;
+
+	if (scene->RayTest(it.SpawnRayTo(camera.GetPosition())))
+		return;
+
+	m_splats.Splat(static_cast<size_t>(pixelX) + static_cast<size_t>(pixelY) * static_cast<size_t>(m_resolution.x),
+			value * importance / distSqr);
+}
+
+CPU_NAMESPACE_CLOSE_SCOPE
@@ -0,0 +1,42 @@
+#ifndef CPU_LIGHT_TRACER_H
+#define CPU_LIGHT_TRACER_H
+
+#include "../spindulysCPU.h"
+
+#include "integrator.h"
+
+CPU_NAMESPACE_OPEN_SCOPE
+
+/* Light tracing, which follows paths from the lights and connects every vertex to the camera, splatting the
+	 result into whichever pixel it lands on. Caustics seen directly by the camera converge far faster than by
+	 tracing from the camera, at the cost of everything seen through glass or in a mirror being left out.
+	 One light path is traced for each pixel sample, so the splats of an iteration add up to the image. */
+class LightTracer final : public Integrator
+{
+public:
+	LightTracer(uint32_t maxDepth = 3, bool hideLights = false);
+
+	virtual std::pair<Col3f, float>
+	Sample(const CPUScene* scene, Sampler* sampler, const Ray& ray, Col3f* /* aovs */) const override;
+
+	virtual void BeginIteration(const CPUScene* scene, const Vec2i& resolution) override;
+	virtual void Reset() override { m_splats.Clear(); }
+	virtual SplatBuffer* GetSplats() override { return &m_splats; }
+
+	bool SetMaxDepth(uint32_t depth) { return depth != std::exchange(m_maxDepth, depth); }
+
+private:
+	// Splat what arrives at the camera from the point, given the throughput up to it including the cosine there.
+	void SplatToCamera(const CPUScene* scene, const Interaction& it, const Col3f& value) const;
+
+private:
+	// Paths are at most this many segments long including the one to the camera, the same as the forward path tracer.
+	uint32_t m_maxDepth = 3;
+
+	mutable SplatBuffer m_splats;
+	Vec2i m_resolution = Vec2i(zero);
+};
+
+CPU_NAMESPACE_CLOSE_SCOPE
+
+#endif // CPU_LIGHT_TRACER_H
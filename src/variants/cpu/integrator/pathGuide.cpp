@@ -0,0 +1,348 @@
+#include "pathGuide.h"
+
+#include <spindulys/math/constants.h>
+
+CPU_NAMESPACE_OPEN_SCOPE
+
+// Quadrants holding more than this share of the energy get subdivided, down to the maximum depth.
+static constexpr float kDirectionalThreshold = 0.01f;
+static constexpr int kMaxDirectionalDepth = 20;
+// Regions are split once this many paths times the square root of the pass length passed through them.
+static constexpr float kSpatialThreshold = 12000.f;
+static constexpr int kMaxSpatialDepth = 48;
+// Passes double in length, so training takes 2^kTrainingPasses - 1 iterations.
+static constexpr uint32_t kTrainingPasses = 5;
+
+static void AtomicAdd(std::atomic<float>& value, float add)
+{
+	float current = value.load(std::memory_order_relaxed);
+	while (!value.compare_exchange_weak(current, current + add, std::memory_order_relaxed));
+}
+
+// ----------------------------------------------------------------------------
+// DTree
+// ----------------------------------------------------------------------------
+DTree::Node::Node()
+{
+	for (std::atomic<float>& quadrant : energy)
+		quadrant.store(0.f, std::memory_order_relaxed);
+}
+
+DTree::Node::Node(const Node& other)
+{
+	*this = other;
+}
+
+DTree::Node& DTree::Node::operator=(const Node& other)
+{
+	for (int quadrant = 0; quadrant < 4; ++quadrant)
+		energy[quadrant].store(other.energy[quadrant].load(std::memory_order_relaxed), std::memory_order_relaxed);
+	children = other.children;
+	return *this;
+}
+
+DTree::DTree()
+	: m_nodes(1)
+{
+}
+
+DTree::DTree(const DTree& other)
+	: m_nodes(other.m_nodes)
+	, m_weight(other.GetWeight())
+{
+}
+
+DTree& DTree::operator=(const DTree& other)
+{
+	m_nodes = other.m_nodes;
+	SetWeight(other.GetWeight());
+	return *this;
+}
+
+int DTree::Quadrant(Vec2f& p)
+{
+	const int x = p.x >= 0.5f;
+	const int y = p.y >= 0.5f;
+	p.x = min(2.f * p.x - x, OneMinusEpsilon<float>);
+	p.y = min(2.f * p.y - y, OneMinusEpsilon<float>);
+	return x + 2 * y;
+}
+
+void DTree::Record(const Vec2f& p_, float radiance)
+{
+	AtomicAdd(m_weight, 1.f);
+	if (!(radiance > 0.f) || !isfinite(radiance))
+		return;
+
+	// Every node on the way down holds the energy of the quadrant, so the sums stay consistent.
+	Vec2f p(p_);
+	uint32_t node = 0;
+	for (;;)
+	{
+		const int quadrant = Quadrant(p);
+		AtomicAdd(m_nodes[node].energy[quadrant], radiance);
+		if (!m_nodes[node].children[quadrant])
+			break;
+		node = m_nodes[node].children[quadrant];
+	}
+}
+
+float DTree::GetEnergy() const
+{
+	float energy = 0.f;
+	for (const std::atomic<float>& quadrant : m_nodes[0].energy)
+		energy += quadrant.load(std::memory_order_relaxed);
+	return energy;
+}
+
+Vec2f DTree::Sample(Vec2f sample) const
+{
+	// Pick the column and then the quadrant within it, so the sample can be reused all the way down.
+	Vec2f origin(zero);
+	float size = 1.f;
+	uint32_t node = 0;
+	for (;;)
+	{
+		const Node& current = m_nodes[node];
+		std::array<float, 4> energy;
+		for (int quadrant = 0; quadrant < 4; ++quadrant)
+			energy[quadrant] = current.energy[quadrant].load(std::memory_order_relaxed);
+
+		const float left = energy[0] + energy[2];
+		const float total = left + energy[1] + energy[3];
+		if (total <= 0.f)
+			break;
+
+		int x = 0;
+		const float partX = left / total;
+		if (sample.x < partX)
+		{
+			sample.x = min(sample.x / partX, OneMinusEpsilon<float>);
+		}
+		else
+		{
+			x = 1;
+			sample.x = min((sample.x - partX) / (1.f - partX), OneMinusEpsilon<float>);
+		}
+
+		int y = 0;
+		const float column = energy[x] + energy[x + 2];
+		const float partY = column > 0.f ? energy[x] / column : 0.5f;
+		if (sample.y < partY)
+		{
+			sample.y = min(sample.y / partY, OneMinusEpsilon<float>);
+		}
+		else
+		{
+			y = 1;
+			sample.y = min((sample.y - partY) / (1.f - partY), OneMinusEpsilon<float>);
+		}
+
+		size *= 0.5f;
+		origin += size * Vec2f(x, y);
+
+		const uint32_t child = current.children[x + 2 * y];
+		if (!child)
+			break;
+		node = child;
+	}
+
+	return origin + size * sample;
+}
+
+float DTree::Pdf(Vec2f p) const
+{
+	float pdf = 1.f;
+	uint32_t node = 0;
+	for (;;)
+	{
+		const Node& current = m_nodes[node];
+		float total = 0.f;
+		for (const std::atomic<float>& quadrant : current.energy)
+			total += quadrant.load(std::memory_order_relaxed);
+		if (total <= 0.f)
+			return pdf;
+
+		const int quadrant = Quadrant(p);
+		pdf *= 4.f * current.energy[quadrant].load(std::memory_order_relaxed) / total;
+		if (pdf <= 0.f || !current.children[quadrant])
+			return pdf;
+		node = current.children[quadrant];
+	}
+}
+
+DTree DTree::Refine(float threshold, int maxDepth) const
+{
+	DTree refined;
+	std::array<float, 4> energy;
+	for (int quadrant = 0; quadrant < 4; ++quadrant)
+		energy[quadrant] = m_nodes[0].energy[quadrant].load(std::memory_order_relaxed);
+
+	const float total = GetEnergy();
+	if (total > 0.f)
+		refined.RefineNode(*this, 0, 0, energy, threshold * total, 1, maxDepth);
+
+	return refined;
+}
+
+void DTree::RefineNode(const DTree& source, uint32_t node, int sourceNode, const std::array<float, 4>& energy,
+		float threshold, int depth, int maxDepth)
+{
+	for (int quadrant = 0; quadrant < 4; ++quadrant)
+	{
+		if (energy[quadrant] <= threshold || depth >= maxDepth)
+			continue;
+
+		const int sourceChild = sourceNode >= 0 && source.m_nodes[sourceNode].children[quadrant] ?
+			static_cast<int>(source.m_nodes[sourceNode].children[quadrant]) : -1;
+
+		std::array<float, 4> childEnergy;
+		for (int childQuadrant = 0; childQuadrant < 4; ++childQuadrant)
+		{
+			childEnergy[childQuadrant] = sourceChild >= 0 ?
+				source.m_nodes[sourceChild].energy[childQuadrant].load(std::memory_order_relaxed) : 0.25f * energy[quadrant];
+		}
+
+		const uint32_t child = m_nodes.size();
+		m_nodes.emplace_back();
+		m_nodes[node].children[quadrant] = child;
+		RefineNode(source, child, sourceChild, childEnergy, threshold, depth + 1, maxDepth);
+	}
+}
+
+// ----------------------------------------------------------------------------
+// GuidingRegion
+// ----------------------------------------------------------------------------
+Vec3f GuidingRegion::ToDirection(const Vec2f& p)
+{
+	const float cosTheta = 2.f * p.x - 1.f;
+	const float sinTheta = safe_sqrt(1.f - sqr(cosTheta));
+	const float phi = TwoPi<float> * p.y;
+	return Vec3f(sinTheta * cos(phi), sinTheta * sin(phi), cosTheta);
+}
+
+Vec2f GuidingRegion::ToSquare(const Vec3f& d)
+{
+	float phi = atan2(d.y, d.x);
+	if (phi < 0.f)
+		phi += TwoPi<float>;
+
+	return Vec2f(clamp(0.5f * (d.z + 1.f), 0.f, OneMinusEpsilon<float>), clamp(phi * InvTwoPi<float>, 0.f, OneMinusEpsilon<float>));
+}
+
+Vec3f GuidingRegion::Sample(const Vec2f& sample) const
+{
+	return ToDirection(sampling.Sample(sample));
+}
+
+float GuidingRegion::Pdf(const Vec3f& direction) const
+{
+	// The cylindrical mapping preserves area, and the square covers the whole sphere.
+	return sampling.Pdf(ToSquare(direction)) * InvFourPi<float>;
+}
+
+// ----------------------------------------------------------------------------
+// PathGuide
+// ----------------------------------------------------------------------------
+void PathGuide::Reset()
+{
+	m_nodes.clear();
+	m_regions.clear();
+	m_bounds = BBox3f(empty);
+	m_training = true;
+	m_pass = 0;
+	m_passIterations = 0;
+}
+
+void PathGuide::BeginIteration(const BBox3f& sceneBounds)
+{
+	if (!m_nodes.empty() || sceneBounds.empty())
+		return;
+
+	const Vec3f center = sceneBounds.center();
+	const float extent = 0.5f * reduce_max(sceneBounds.size()) * 1.01f + Epsilon<float>;
+	m_bounds = BBox3f(center - Vec3f(extent), center + Vec3f(extent));
+
+	m_nodes.emplace_back();
+	m_regions.emplace_back();
+}
+
+void PathGuide::EndIteration()
+{
+	if (!m_training || m_nodes.empty())
+		return;
+
+	if (++m_passIterations < (1u << m_pass))
+		return;
+
+	Update();
+	m_passIterations = 0;
+	m_training = ++m_pass < kTrainingPasses;
+}
+
+GuidingRegion* PathGuide::GetRegion(const Vec3f& p)
+{
+	if (m_nodes.empty())
+		return nullptr;
+
+	Vec3f local = (p - m_bounds.lower) / m_bounds.size();
+	uint32_t node = 0;
+	while (!m_nodes[node].leaf)
+	{
+		const int axis = m_nodes[node].axis;
+		const float offset = clamp(local[axis], 0.f, OneMinusEpsilon<float>);
+		const int child = offset >= 0.5f;
+		local[axis] = 2.f * offset - child;
+		node = m_nodes[node].children[child];
+	}
+
+	return &m_regions[m_nodes[node].region];
+}
+
+void PathGuide::Update()
+{
+	CPU_TRACE();
+	// Passes double in length, so the threshold grows with the square root of the paths traced.
+	SplitRegions(0, 0, kSpatialThreshold * std::sqrt(static_cast<float>(1u << m_pass)));
+
+	// What was recorded is sampled from in the next pass, while a tree refined from it records.
+	for (GuidingRegion& region : m_regions)
+	{
+		region.sampling = region.building;
+		region.building = region.sampling.Refine(kDirectionalThreshold, kMaxDirectionalDepth);
+	}
+}
+
+void PathGuide::SplitRegions(uint32_t node, int depth, float threshold)
+{
+	if (!m_nodes[node].leaf)
+	{
+		SplitRegions(m_nodes[node].children[0], depth + 1, threshold);
+		SplitRegions(m_nodes[node].children[1], depth + 1, threshold);
+		return;
+	}
+
+	const uint32_t region = m_nodes[node].region;
+	if (m_regions[region].building.GetWeight() <= threshold || depth >= kMaxSpatialDepth)
+		return;
+
+	// Both halves start from what the whole region learnt, with half of its paths each.
+	m_regions[region].building.SetWeight(0.5f * m_regions[region].building.GetWeight());
+	const uint32_t otherRegion = m_regions.size();
+	m_regions.emplace_back(m_regions[region]);
+
+	const uint32_t firstChild = m_nodes.size();
+	m_nodes.resize(m_nodes.size() + 2);
+	m_nodes[firstChild].region = region;
+	m_nodes[firstChild].axis = (m_nodes[node].axis + 1) % 3;
+	m_nodes[firstChild + 1].region = otherRegion;
+	m_nodes[firstChild + 1].axis = (m_nodes[node].axis + 1) % 3;
+
+	m_nodes[node].leaf = false;
+	m_nodes[node].children = { firstChild, firstChild + 1 };
+
+	SplitRegions(firstChild, depth + 1, threshold);
+	SplitRegions(firstChild + 1, depth + 1, threshold);
+}
+
+CPU_NAMESPACE_CLOSE_SCOPE
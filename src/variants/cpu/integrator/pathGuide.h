@@ -0,0 +1,131 @@
+#ifndef CPU_PATH_GUIDE_H
+#define CPU_PATH_GUIDE_H
+
+#include <array>
+#include <atomic>
+#include <vector>
+
+#include <spindulys/math/vec2.h>
+#include <spindulys/math/vec3.h>
+#include <spindulys/math/bbox.h>
+
+#include "../spindulysCPU.h"
+
+CPU_NAMESPACE_OPEN_SCOPE
+
+/* Distribution of incident radiance over the sphere of directions, stored as a quadtree over the square which
+	 the sphere maps to with an equal area cylindrical mapping. Every node holds the energy of each of its four
+	 quadrants, so a direction is sampled by walking down the tree and the density is read back the same way.
+	 Recording only adds to the existing nodes with atomics, so every thread can record into it at once. */
+class DTree
+{
+	public:
+		DTree();
+		DTree(const DTree& other);
+		DTree& operator=(const DTree& other);
+
+		// Add the radiance arriving from the point of the square.
+		void Record(const Vec2f& p, float radiance);
+
+		// A point of the square in proportion to the energy recorded, and the density of picking it.
+		Vec2f Sample(Vec2f sample) const;
+		float Pdf(Vec2f p) const;
+
+		float GetEnergy() const;
+		float GetWeight() const { return m_weight.load(std::memory_order_relaxed); }
+		void SetWeight(float weight) { m_weight.store(weight, std::memory_order_relaxed); }
+
+		// An empty tree, subdivided wherever a quadrant of this one holds more than the given share of its energy.
+		DTree Refine(float threshold, int maxDepth) const;
+
+	private:
+		struct Node
+		{
+			Node();
+			Node(const Node& other);
+			Node& operator=(const Node& other);
+
+			// Children are never the root, so zero marks a quadrant without one.
+			std::array<std::atomic<float>, 4> energy;
+			std::array<uint32_t, 4> children = { 0, 0, 0, 0 };
+		};
+
+		// The quadrant of the node the point lies in, moving the point into it.
+		static int Quadrant(Vec2f& p);
+
+		// Subdivide the node's quadrants by the energy of the matching node of the source, or of its parent's
+		// quadrant spread evenly where the source was not subdivided that far.
+		void RefineNode(const DTree& source, uint32_t node, int sourceNode, const std::array<float, 4>& energy,
+				float threshold, int depth, int maxDepth);
+
+	private:
+		std::vector<Node> m_nodes;
+		// The number of radiance records that went into the tree.
+		std::atomic<float> m_weight = 0.f;
+};
+
+/* Guiding distribution of one region of space. Paths are sampled from what was learnt in the previous training
+	 pass while the current pass records into a tree refined from it. */
+struct GuidingRegion
+{
+	// Directions are in world space.
+	bool CanSample() const { return sampling.GetEnergy() > 0.f; }
+	Vec3f Sample(const Vec2f& sample) const;
+	float Pdf(const Vec3f& direction) const;
+	void Record(const Vec3f& direction, float radiance) { building.Record(ToSquare(direction), radiance); }
+
+	static Vec3f ToDirection(const Vec2f& p);
+	static Vec2f ToSquare(const Vec3f& d);
+
+	DTree sampling;
+	DTree building;
+};
+
+/* Practical path guiding, after Müller et al. Incident radiance is learnt online in a binary tree over space whose
+	 leaves each hold a directional quadtree. Training runs in passes which double in length, and after each one
+	 the regions which saw many paths are split and the quadtrees are refined to where the energy arrived from. */
+class PathGuide
+{
+	public:
+		// Forget everything learnt, as the scene or camera changed.
+		void Reset();
+
+		// Called around every render iteration, which records one path per pixel.
+		void BeginIteration(const BBox3f& sceneBounds);
+		void EndIteration();
+
+		bool IsTraining() const { return m_training; }
+
+		// The region the point is in, null before the guide has been set up.
+		GuidingRegion* GetRegion(const Vec3f& p);
+
+		// How often the BSDF is sampled rather than the guide, where the guide has learnt anything.
+		static constexpr float kBSDFSamplingFraction = 0.5f;
+
+	private:
+		struct Node
+		{
+			uint8_t axis = 0;
+			// Either both children or the region of a leaf.
+			std::array<uint32_t, 2> children = { 0, 0 };
+			uint32_t region = 0;
+			bool leaf = true;
+		};
+
+		void Update();
+		void SplitRegions(uint32_t node, int depth, float threshold);
+
+	private:
+		std::vector<Node> m_nodes;
+		std::vector<GuidingRegion> m_regions;
+		// A cube around the scene, so that the splits stay evenly shaped.
+		BBox3f m_bounds = BBox3f(empty);
+
+		bool m_training = true;
+		uint32_t m_pass = 0;
+		uint32_t m_passIterations = 0;
+};
+
+CPU_NAMESPACE_CLOSE_SCOPE
+
+#endif // CPU_PATH_GUIDE_H
@@ -0,0 +1,251 @@
+#include "restirDirect.h"
+
+#include <spindulys/fwd.h>
+
+#include "../bsdf/cpuBSDF.h"
+
+#include "../utils/records.h"
+
+
+CPU_NAMESPACE_OPEN_SCOPE
+
+// Neighbours are picked at random within the radius in pixels.
+static constexpr int kSpatialNeighbours = 3;
+static constexpr int kSpatialRadius = 16;
+// Caps how many candidates a reservoir stands for, relative to those drawn per pixel, so the past fades out.
+static constexpr float kMaxHistory = 20.f;
+// Neighbours are only reused on surfaces facing the same way at a similar distance from the camera.
+static constexpr float kNormalThreshold = 0.9f;
+static constexpr float kDepthThreshold = 0.1f;
+
+bool ReSTIRDirect::Reservoir::Update(const LightCandidate& newCandidate, float newWeight, float sample)
+{
+	if (!(newWeight > 0.f) || !isfinite(newWeight))
+		return false;
+
+	weightSum += newWeight;
+	if (sample * weightSum >= newWeight)
+		return false;
+
+	candidate = newCandidate;
+	return true;
+}
+
+ReSTIRDirect::ReSTIRDirect(uint32_t lightCandidates, bool hideLights)
+	: m_lightCandidates(lightCandidates)
+{
+	m_hideLights = hideLights;
+}
+
+void ReSTIRDirect::BeginIteration(const CPUScene* /* scene */, const Vec2i& resolution)
+{
+	// Nothing from a render at another resolution lines up with the pixels any more.
+	const size_t pixels = static_cast<size_t>(max(resolution.x, 0)) * static_cast<size_t>(max(resolution.y, 0));
+	if (resolution != m_resolution || m_previous.size() != pixels)
+	{
+		m_resolution = resolution;
+		m_previous.assign(pixels, Reservoir());
+		m_current.assign(pixels, Reservoir());
+	}
+}
+
+void ReSTIRDirect::EndIteration()
+{
+	m_previous.swap(m_current);
+}
+
+void ReSTIRDirect::Reset()
+{
+	m_resolution = Vec2i(zero);
+	m_previous.clear();
+	m_current.clear();
+}
+
+std::pair<Col3f, float>
+ReSTIRDirect::Sample(const CPUScene* scene, Sampler* sampler, const Ray& ray, Col3f* /* aovs */) const
+{
+	// Without knowing the pixel there is nothing to reuse, so this is plain resampled importance sampling.
+	return Shade(scene, sampler, ray, -1);
+}
+
+std::pair<Col3f, float>
+ReSTIRDirect::SamplePixel(const CPUScene* scene, Sampler* sampler, const Ray& ray, const Vec2i& pixel, Col3f* /* aovs */) const
+{
+	const bool inside = pixel.x >= 0 && pixel.y >= 0 && pixel.x < m_resolution.x && pixel.y < m_resolution.y;
+	return Shade(scene, sampler, ray, inside ? pixel.x + pixel.y * m_resolution.x : -1);
+}
+
+std::pair<Col3f, float>
+ReSTIRDirect::Shade(const CPUScene* scene, Sampler* sampler, const Ray& ray, int pixelIdx) const
+{
+	Col3f result(zero);
+
+	SurfaceInteraction si = scene->RayIntersect(ray);
+	// Like the forward path, a miss still counts when the environment behind it is visible.
+	const bool validRay = si.IsValid() || (!m_hideLights && scene->GetEnvironment() != nullptr);
+
+	// Whatever happens the pixel's reservoir from the previous iteration is replaced.
+	Reservoir* stored = pixelIdx >= 0 ? &m_current[pixelIdx] : nullptr;
+	if (stored)
+		*stored = Reservoir();
+
+	// ----------------------- Visible emitters -----------------------
+
+	if (!m_hideLights)
+		if (const CPULight* visibleLight = scene->LightHit(si))
+			result += visibleLight->Eval(si, true);
+
+	if (!si.IsValid())
+		return { result, validRay };
+
+	const CPUBSDF* bsdf = si.shape->GetBSDF();
+	if (!HasFlag(bsdf->GetFlags(), BSDFFlags::Smooth))
+		return { result, validRay };
+
+	Reservoir reservoir;
+	reservoir.p = si.p;
+	reservoir.n = si.n;
+	reservoir.depth = si.t;
+	reservoir.valid = true;
+
+	// ---------------------- Candidate sampling ----------------------
+	for (uint32_t i = 0; i < m_lightCandidates; ++i)
+	{
+		const auto [ds, lightVal] = scene->SampleLightDirection(si, sampler->Next2d(), false, true);
+		const float sample = sampler->Next1d();
+		if (ds.pdf == 0.f || !ds.light)
+			continue;
+
+		// Convert the sample into the measure the light is re-evaluated in from other points.
+		LightCandidate candidate;
+		candidate.light = ds.light;
+		Col3f emission = lightVal * ds.pdf;
+		float pdf = ds.pdf;
+		const uint32_t lightFlags = ds.light->GetFlags();
+		if (HasFlag(lightFlags, LightFlags::Infinite))
+		{
+			candidate.p = ds.d;
+		}
+		else
+		{
+			candidate.p = ds.p;
+			candidate.n = ds.n;
+			if (HasFlag(lightFlags, LightFlags::DeltaPosition))
+				emission *= sqr(ds.dist);
+			else if (!ds.delta)
+				pdf *= abs(dot(ds.d, ds.n)) / sqr(ds.dist);
+		}
+		candidate.emission = emission;
+
+		const float target = luminance(Evaluate(candidate, si, bsdf));
+		reservoir.Update(candidate, pdf > 0.f ? target / pdf : 0.f, sample);
+	}
+	reservoir.count = static_cast<float>(m_lightCandidates);
+
+	// ------------------------ Reservoir reuse -----------------------
+	const float maxCount = kMaxHistory * max(m_lightCandidates, 1u);
+	auto merge = [&](const Reservoir& other)
+	{
+		if (!other.valid || !Similar(reservoir, other))
+			return;
+
+		const float count = min(other.count, maxCount);
+		if (other.weight > 0.f)
+		{
+			const float target = luminance(Evaluate(other.candidate, si, bsdf));
+			reservoir.Update(other.candidate, target * other.weight * count, sampler->Next1d());
+		}
+		reservoir.count += count;
+	};
+
+	if (pixelIdx >= 0 && !m_previous.empty())
+	{
+		// Temporal, from the same pixel in the previous iteration.
+		merge(m_previous[pixelIdx]);
+
+		// Spatial, from neighbours in the previous iteration, as this iteration's are still being written.
+		const int pixelX = pixelIdx % m_resolution.x;
+		const int pixelY = pixelIdx / m_resolution.x;
+		for (int i = 0; i < kSpatialNeighbours; ++i)
+		{
+			const Vec2f offset = sampler->Next2d();
+			const int x = pixelX + static_cast<int>((2.f * offset.x - 1.f) * kSpatialRadius);
+			const int y = pixelY + static_cast<int>((2.f * offset.y - 1.f) * kSpatialRadius);
+			if (x < 0 || y < 0 || x >= m_resolution.x || y >= m_resolution.y || (x == pixelX && y == pixelY))
+				continue;
+
+			merge(m_previous[x + y * m_resolution.x]);
+		}
+	}
+
+	// ------------------------- Shadow ray ---------------------------
+	if (reservoir.weightSum > 0.f)
+	{
+		const Col3f contribution = Evaluate(reservoir.candidate, si, bsdf);
+		const float target = luminance(contribution);
+		reservoir.weight = target > 0.f ? reservoir.weightSum / (reservoir.count * target) : 0.f;
+
+		// Occluded lights are not passed on, so neighbours in shadow stop picking them.
+		if (reservoir.weight > 0.f && Visible(scene, reservoir.candidate, si))
+			result += contribution * reservoir.weight;
+		else
+			reservoir.weight = 0.f;
+	}
+
+	reservoir.count = min(reservoir.count, maxCount);
+	if (stored)
+		*stored = reservoir;
+
+	return { result, validRay };
+}
+
+Col3f ReSTIRDirect::Evaluate(const LightCandidate& candidate, const SurfaceInteraction& si, const CPUBSDF* bsdf)
+{
+	if (!candidate.light)
+		return zero;
+
+	Vec3f d;
+	float geometry = 1.f;
+	const uint32_t lightFlags = candidate.light->GetFlags();
+	if (HasFlag(lightFlags, LightFlags::Infinite))
+	{
+		d = candidate.p;
+	}
+	else
+	{
+		const Vec3f rel = candidate.p - si.p;
+		const float dist2 = dot(rel, rel);
+		if (dist2 == 0.f)
+			return zero;
+
+		d = rel * rsqrt(dist2);
+		geometry = 1.f / dist2;
+		if (!HasFlag(lightFlags, LightFlags::DeltaPosition))
+		{
+			// Surfaces only emit from their front.
+			const float cosTheta = -dot(d, candidate.n);
+			if (cosTheta <= 0.f)
+				return zero;
+			geometry *= cosTheta;
+		}
+	}
+
+	BSDFContext ctx;
+	return bsdf->Eval(ctx, si, toLocal(si.shadingFrame, d)) * candidate.emission * geometry;
+}
+
+bool ReSTIRDirect::Visible(const CPUScene* scene, const LightCandidate& candidate, const SurfaceInteraction& si)
+{
+	if (HasFlag(candidate.light->GetFlags(), LightFlags::Infinite))
+		return !scene->RayTest(si.SpawnRay(candidate.p));
+
+	return !scene->RayTest(si.SpawnRayTo(candidate.p));
+}
+
+bool ReSTIRDirect::Similar(const Reservoir& reservoir, const Reservoir& other)
+{
+	return dot(reservoir.n, other.n) >= kNormalThreshold &&
+		abs(reservoir.depth - other.depth) <= kDepthThreshold * reservoir.depth;
+}
+
+CPU_NAMESPACE_CLOSE_SCOPE
@@ -0,0 +1,87 @@
+#ifndef CPU_RESTIR_DIRECT_H
+#define CPU_RESTIR_DIRECT_H
+
+#include <vector>
+
+#include "../spindulysCPU.h"
+
+#include "integrator.h"
+
+CPU_NAMESPACE_OPEN_SCOPE
+
+class CPUBSDF;
+
+/* Direct lighting by reservoir resampling, after Bitterli et al.'s ReSTIR.
+	 Every pixel draws many cheap light candidates and keeps one in proportion to its unshadowed contribution.
+	 The reservoir is then merged with the one the pixel kept in the previous iteration and those of a few of its
+	 neighbours, and only the light that wins is traced with a shadow ray. Reuse ignores visibility, so the result
+	 is slightly biased near shadow edges in exchange for much less noise with many lights. */
+class ReSTIRDirect final : public Integrator
+{
+public:
+	ReSTIRDirect(uint32_t lightCandidates = 16, bool hideLights = false);
+
+	virtual std::pair<Col3f, float>
+	Sample(const CPUScene* scene, Sampler* sampler, const Ray& ray, Col3f* /* aovs */) const override;
+
+	virtual std::pair<Col3f, float>
+	SamplePixel(const CPUScene* scene, Sampler* sampler, const Ray& ray, const Vec2i& pixel, Col3f* /* aovs */) const override;
+
+	virtual void BeginIteration(const CPUScene* scene, const Vec2i& resolution) override;
+	virtual void EndIteration() override;
+	virtual void Reset() override;
+
+	bool SetLightCandidates(uint32_t candidates) { return candidates != std::exchange(m_lightCandidates, candidates); }
+
+private:
+	// A point on a light which can be re-evaluated from any shading point.
+	struct LightCandidate
+	{
+		const CPULight* light = nullptr;
+		// Direction towards lights at infinity, otherwise the point on the light.
+		Vec3f p = Vec3f(zero);
+		Vec3f n = Vec3f(zero);
+		// Radiance, or intensity for lights at a single point.
+		Col3f emission = Col3f(zero);
+	};
+
+	struct Reservoir
+	{
+		// Stream the candidate through the reservoir, returning true if it was kept.
+		bool Update(const LightCandidate& candidate, float weight, float sample);
+
+		LightCandidate candidate;
+		float weightSum = 0.f;
+		// Number of candidates seen, and the weight that makes the kept one an unbiased estimate.
+		float count = 0.f;
+		float weight = 0.f;
+
+		// Surface it was gathered at, to only reuse it on similar surfaces.
+		Vec3f p = Vec3f(zero);
+		Vec3f n = Vec3f(zero);
+		float depth = 0.f;
+		bool valid = false;
+	};
+
+	std::pair<Col3f, float>
+	Shade(const CPUScene* scene, Sampler* sampler, const Ray& ray, int pixelIdx) const;
+
+	// The unshadowed contribution of the candidate to the shading point, in the candidate's measure.
+	static Col3f Evaluate(const LightCandidate& candidate, const SurfaceInteraction& si, const CPUBSDF* bsdf);
+	// Whether nothing blocks the shading point from the candidate.
+	static bool Visible(const CPUScene* scene, const LightCandidate& candidate, const SurfaceInteraction& si);
+	static bool Similar(const Reservoir& reservoir, const Reservoir& other);
+
+private:
+	uint32_t m_lightCandidates = 16;
+
+	// Reservoirs kept in the previous iteration, which are read while the current ones are written.
+	// Every pixel only writes its own, so they can be shared across threads.
+	Vec2i m_resolution = Vec2i(zero);
+	std::vector<Reservoir> m_previous;
+	mutable std::vector<Reservoir> m_current;
+};
+
+CPU_NAMESPACE_CLOSE_SCOPE
+
+#endif // CPU_RESTIR_DIRECT_H
@@ -0,0 +1,467 @@
+#include "sppm.h"
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <tbb/parallel_reduce.h>
+
+#include <spindulys/fwd.h>
+#include <spindulys/random.h>
+#include <spindulys/samplers/independent.h>
+
+#include "../bsdf/cpuBSDF.h"
+
+#include "../utils/records.h"
+
+
+CPU_NAMESPACE_OPEN_SCOPE
+
+// How much of the photons that arrive are kept as the radius shrinks, the alpha of the original paper.
+static constexpr float kRadiusReduction = 2.f / 3.f;
+// Starting radius, in footprints of the pixel on the surface it sees.
+static constexpr float kInitialRadiusPixels = 2.f;
+// Keeps the grid from running out of cell indices when the radii are tiny next to the scene.
+static constexpr int kMaxGridResolution = 1 << 20;
+
+static void AtomicAdd(std::atomic<float>& value, float add)
+{
+	float current = value.load(std::memory_order_relaxed);
+	while (!value.compare_exchange_weak(current, current + add, std::memory_order_relaxed));
+}
+
+// Shading normals break the symmetry of the BSDF for importance, wi being towards the light and wo away from it.
+static float ShadingNormalCorrection(const SurfaceInteraction& si, const Vec3f& wi, const Vec3f& wo)
+{
+	const float denominator = abs(dot(wi, si.n)) * abs(dot(wo, si.shadingFrame.vz));
+	return denominator != 0.f ? abs(dot(wi, si.shadingFrame.vz)) * abs(dot(wo, si.n)) / denominator : 0.f;
+}
+
+SPPM::SPPM(uint32_t maxDepth, bool hideLights)
+	: m_maxDepth(maxDepth)
+{
+	m_hideLights = hideLights;
+}
+
+void SPPM::BeginIteration(const CPUScene* scene, const Vec2i& resolution)
+{
+	m_scene = scene;
+
+	// Visible points and radii only make sense for the pixels they were found for.
+	const size_t pixels = static_cast<size_t>(max(resolution.x, 0)) * static_cast<size_t>(max(resolution.y, 0));
+	if (resolution != m_resolution || m_pixels.size() != pixels)
+	{
+		m_resolution = resolution;
+		// Atomics cannot be moved, so the vectors are swapped for new ones rather than resized.
+		std::vector<SPPMPixel>(pixels).swap(m_pixels);
+		std::vector<std::atomic<uint32_t>>(pixels).swap(m_cellCounts);
+		m_cellOffsets.assign(pixels + 1, 0);
+	}
+
+	m_splats.Resize(static_cast<size_t>(max(resolution.x, 0)), static_cast<size_t>(max(resolution.y, 0)));
+}
+
+void SPPM::EndIteration()
+{
+	if (!m_scene || m_pixels.empty())
+		return;
+
+	BuildGrid();
+	TracePhotons();
+	UpdatePixels();
+	++m_iteration;
+}
+
+void SPPM::Reset()
+{
+	m_resolution = Vec2i(zero);
+	m_iteration = 0;
+	m_pixels.clear();
+	m_cellCounts.clear();
+	m_cellOffsets.clear();
+	m_cellEntries.clear();
+	m_splats.Clear();
+}
+
+std::pair<Col3f, float>
+SPPM::Sample(const CPUScene* scene, Sampler* sampler, const Ray& ray, Col3f* /* aovs */) const
+{
+	// Without knowing the pixel there is nowhere to gather photons, so only direct lighting is left.
+	return Shade(scene, sampler, ray, -1);
+}
+
+std::pair<Col3f, float>
+SPPM::SamplePixel(const CPUScene* scene, Sampler* sampler, const Ray& ray, const Vec2i& pixel, Col3f* /* aovs */) const
+{
+	const bool inside = pixel.x >= 0 && pixel.y >= 0 && pixel.x < m_resolution.x && pixel.y < m_resolution.y &&
+		static_cast<size_t>(pixel.x + pixel.y * m_resolution.x) < m_pixels.size();
+	return Shade(scene, sampler, ray, inside ? pixel.x + pixel.y * m_resolution.x : -1);
+}
+
+std::pair<Col3f, float>
+SPPM::Shade(const CPUScene* scene, Sampler* sampler, const Ray& ray, int pixelIdx) const
+{
+	SPPMPixel* pixel = pixelIdx >= 0 ? &m_pixels[pixelIdx] : nullptr;
+	if (pixel)
+		pixel->vp = VisiblePoint();
+
+	if (unlikely(m_maxDepth == 0))
+		return { zero, false };
+
+	Col3f result = zero;
+	Col3f beta = one;
+	bool validRay = false;
+	// Emission is only added where nothing before it could have lit the path directly.
+	bool addEmission = !m_hideLights;
+	float pathLength = 0.f;
+
+	Ray continuousRay = ray;
+	const BSDFContext bsdfContext;
+	for (uint32_t depth = 0; depth < m_maxDepth; ++depth)
+	{
+		const SurfaceInteraction si = scene->RayIntersect(continuousRay);
+		if (depth == 0)
+			validRay = si.IsValid() || (!m_hideLights && scene->GetEnvironment());
+
+		if (const CPULight* light = scene->LightHit(si); light && addEmission)
+			result += beta * light->Eval(si, true);
+
+		if (!si.IsValid())
+			break;
+
+		pathLength += si.t;
+
+		const CPUBSDF* bsdf = si.shape->GetBSDF();
+		const uint32_t flags = bsdf->GetFlags();
+		const bool diffuse = HasFlag(flags, BSDFFlags::Diffuse);
+		const bool glossy = HasFlag(flags, BSDFFlags::Glossy);
+
+		// Direct lighting covers every light one bounce away, whichever way the path goes on from here.
+		if (diffuse || glossy)
+			result += beta * DirectLighting(scene, sampler, si, bsdf);
+
+		// Glossy surfaces are followed like mirrors unless the path has run out of depth.
+		if (diffuse || (glossy && depth + 1 == m_maxDepth))
+		{
+			if (pixel)
+			{
+				pixel->vp.si = si;
+				pixel->vp.bsdf = bsdf;
+				pixel->vp.beta = beta;
+
+				if (pixel->radius == 0.f)
+				{
+					// The solid angle of the pixel spread over the distance the path travelled.
+					const float importance = scene->GetSceneCamera().EvalImportance(ray.direction);
+					const float pixelSolidAngle = importance > 0.f ? 1.f / (importance * m_pixels.size()) : 0.f;
+					pixel->radius = kInitialRadiusPixels * pathLength * sqrt(pixelSolidAngle * InvPi<float>);
+					if (!(pixel->radius > 0.f) || !isfinite(pixel->radius))
+						pixel->radius = 1e-3f * length(scene->GetSceneBounds().size());
+				}
+			}
+			break;
+		}
+
+		if (depth + 1 == m_maxDepth)
+			break;
+
+		const float sample1 = sampler->Next1d();
+		const Vec2f sample2 = sampler->Next2d();
+		const auto [bs, bsdfWeight] = bsdf->Sample(bsdfContext, si, sample1, sample2);
+		if (bs.pdf <= 0.f)
+			break;
+
+		beta = beta * bsdfWeight;
+		if (reduce_max(beta) <= 0.f)
+			break;
+
+		addEmission = !(diffuse || glossy) && HasFlag(bs.sampledType, BSDFFlags::Delta);
+		continuousRay = si.SpawnRay(si.shadingFrame * bs.wo);
+	}
+
+	return { validRay ? result : zero, validRay };
+}
+
+Col3f SPPM::DirectLighting(const CPUScene* scene, Sampler* sampler, const SurfaceInteraction& si, const CPUBSDF* bsdf) const
+{
+	Col3f result = zero;
+	const BSDFContext bsdfContext;
+
+	// ---------------------- Emitter sampling ----------------------
+	if (HasFlag(bsdf->GetFlags(), BSDFFlags::Smooth))
+	{
+		const auto [ds, lightVal] = scene->SampleLightDirection(si, sampler->Next2d(), true, true);
+		if (ds.pdf != 0.f)
+		{
+			const auto [bsdfVal, bsdfPdf] = bsdf->EvalPdf(bsdfContext, si, toLocal(si.shadingFrame, ds.d));
+			result += bsdfVal * lightVal * select(ds.delta, 1.f, MultipleImportantSampleWeight(ds.pdf, bsdfPdf));
+		}
+	}
+
+	// ------------------------ BSDF sampling -------------------------
+	const float sample1 = sampler->Next1d();
+	const Vec2f sample2 = sampler->Next2d();
+	const auto [bs, bsdfWeight] = bsdf->Sample(bsdfContext, si, sample1, sample2);
+	if (bs.pdf <= 0.f || reduce_max(bsdfWeight) <= 0.f)
+		return result;
+
+	const SurfaceInteraction hit = scene->RayIntersect(si.SpawnRay(si.shadingFrame * bs.wo));
+	if (const CPULight* light = scene->LightHit(hit))
+	{
+		// Lights cannot be sampled towards a mirror's reflection, so it has it all to itself.
+		const DirectionSample ds(hit, si, light);
+		const bool delta = HasFlag(bs.sampledType, BSDFFlags::Delta);
+		const float lightPdf = delta ? 0.f : scene->PdfLightDirection(si, ds, true);
+		result += bsdfWeight * light->Eval(hit, true) * MultipleImportantSampleWeight(bs.pdf, lightPdf);
+	}
+
+	return result;
+}
+
+void SPPM::BuildGrid()
+{
+	const size_t pixelCount = m_pixels.size();
+
+	// The visible points, grown by their radii, and the largest radius.
+	using Extent = std::pair<BBox3f, float>;
+	const Extent extent = tbb::parallel_reduce(tbb::blocked_range<size_t>(0, pixelCount), Extent(BBox3f(empty), 0.f),
+			[&](const tbb::blocked_range<size_t>& range, Extent result)
+			{
+				for (size_t pixelIdx = range.begin(); pixelIdx < range.end(); ++pixelIdx)
+				{
+					const SPPMPixel& pixel = m_pixels[pixelIdx];
+					if (!pixel.vp.bsdf)
+						continue;
+
+					result.first.extend(pixel.vp.si.p - Vec3f(pixel.radius));
+					result.first.extend(pixel.vp.si.p + Vec3f(pixel.radius));
+					result.second = max(result.second, pixel.radius);
+				}
+				return result;
+			},
+			[](Extent a, const Extent& b)
+			{
+				a.first.extend(b.first);
+				a.second = max(a.second, b.second);
+				return a;
+			});
+
+	for (std::atomic<uint32_t>& count : m_cellCounts)
+		count.store(0, std::memory_order_relaxed);
+	m_cellOffsets.assign(pixelCount + 1, 0);
+	m_cellEntries.clear();
+
+	m_gridBounds = extent.first;
+	m_gridResolution = Vec3i(zero);
+	if (extent.second <= 0.f || m_gridBounds.empty())
+		return;
+
+	// Cells about as wide as the largest radius, so each visible point only overlaps a few of them.
+	const Vec3f diagonal = m_gridBounds.size();
+	const float maxDiagonal = reduce_max(diagonal);
+	const float baseResolution = min(maxDiagonal / extent.second, static_cast<float>(kMaxGridResolution));
+	m_gridResolution = Vec3i(
+			max(static_cast<int>(baseResolution * diagonal.x / maxDiagonal), 1),
+			max(static_cast<int>(baseResolution * diagonal.y / maxDiagonal), 1),
+			max(static_cast<int>(baseResolution * diagonal.z / maxDiagonal), 1));
+
+	// Every cell the visible point overlaps, by the hash the photons look it up with.
+	const auto forEachCell = [&](const SPPMPixel& pixel, const auto& function)
+	{
+		Vec3i lower, upper;
+		GridCell(pixel.vp.si.p - Vec3f(pixel.radius), lower);
+		GridCell(pixel.vp.si.p + Vec3f(pixel.radius), upper);
+		for (int z = lower.z; z <= upper.z; ++z)
+			for (int y = lower.y; y <= upper.y; ++y)
+				for (int x = lower.x; x <= upper.x; ++x)
+					function(HashCell(Vec3i(x, y, z)));
+	};
+
+	// Count the visible points of each hash, lay the hashes out one after another and fill them in.
+	tbb::parallel_for(tbb::blocked_range<size_t>(0, pixelCount), [&](const tbb::blocked_range<size_t>& range)
+	{
+		for (size_t pixelIdx = range.begin(); pixelIdx < range.end(); ++pixelIdx)
+			if (m_pixels[pixelIdx].vp.bsdf)
+				forEachCell(m_pixels[pixelIdx], [&](size_t hash) { m_cellCounts[hash].fetch_add(1, std::memory_order_relaxed); });
+	});
+
+	uint32_t total = 0;
+	for (size_t hash = 0; hash < pixelCount; ++hash)
+	{
+		m_cellOffsets[hash] = total;
+		total += m_cellCounts[hash].exchange(total, std::memory_order_relaxed);
+	}
+	m_cellOffsets[pixelCount] = total;
+	m_cellEntries.resize(total);
+
+	tbb::parallel_for(tbb::blocked_range<size_t>(0, pixelCount), [&](const tbb::blocked_range<size_t>& range)
+	{
+		for (size_t pixelIdx = range.begin(); pixelIdx < range.end(); ++pixelIdx)
+			if (m_pixels[pixelIdx].vp.bsdf)
+				forEachCell(m_pixels[pixelIdx], [&](size_t hash)
+				{
+					m_cellEntries[m_cellCounts[hash].fetch_add(1, std::memory_order_relaxed)] = static_cast<uint32_t>(pixelIdx);
+				});
+	});
+}
+
+void SPPM::TracePhotons()
+{
+	if (m_cellEntries.empty())
+		return;
+
+	// As many photons as pixels, so a photon lands on about every visible point.
+	const size_t photonCount = m_pixels.size();
+	tbb::parallel_for(tbb::blocked_range<size_t>(0, photonCount), [&](const tbb::blocked_range<size_t>& range)
+	{
+		IndependentSampler sampler;
+		const BSDFContext bsdfContext(TransportMode::Importance);
+
+		for (size_t photon = range.begin(); photon < range.end(); ++photon)
+		{
+			sampler.Seed(SampleTea32(m_iteration, static_cast<uint32_t>(photon)).first);
+
+			const auto [light, pmf] = m_scene->SampleEmitter(sampler.Next1d());
+			if (!light || pmf == 0.f)
+				continue;
+
+			const Vec2f positionSample = sampler.Next2d();
+			const Vec2f directionSample = sampler.Next2d();
+			const auto [es, emitted] = light->SampleEmission(positionSample, directionSample, 0.f);
+			if (es.pdf == 0.f || es.pdfDirection == 0.f || reduce_max(emitted) <= 0.f)
+				continue;
+
+			// Point lights have no normal and emit the same over every direction.
+			const float cosTheta = es.n != Vec3f(zero) ? abs(dot(es.n, es.d)) : 1.f;
+			Col3f beta = emitted * cosTheta / (pmf * es.pdf * es.pdfDirection);
+			Ray ray = Interaction(0.f, 0.f, es.p, es.n).SpawnRay(es.d);
+
+			for (uint32_t depth = 0; depth < m_maxDepth; ++depth)
+			{
+				const SurfaceInteraction si = m_scene->RayIntersect(ray);
+				if (!si.IsValid())
+					break;
+
+				// Direct lighting was already added at the visible points.
+				Vec3i cell;
+				if (depth > 0 && GridCell(si.p, cell))
+				{
+					const size_t hash = HashCell(cell);
+					for (uint32_t entry = m_cellOffsets[hash]; entry < m_cellOffsets[hash + 1]; ++entry)
+					{
+						SPPMPixel& pixel = m_pixels[m_cellEntries[entry]];
+						const Vec3f offset = pixel.vp.si.p - si.p;
+						if (dot(offset, offset) > sqr(pixel.radius))
+							continue;
+
+						// The BSDF's cosine is already in the photon's flux.
+						const Vec3f wo = toLocal(pixel.vp.si.shadingFrame, -ray.direction);
+						if (wo.z == 0.f)
+							continue;
+
+						const Col3f phi = beta * pixel.vp.bsdf->Eval(BSDFContext(), pixel.vp.si, wo) / abs(wo.z);
+						if (reduce_max(phi) <= 0.f || !isfinite(phi.r) || !isfinite(phi.g) || !isfinite(phi.b))
+							continue;
+
+						AtomicAdd(pixel.phi[0], phi.r);
+						AtomicAdd(pixel.phi[1], phi.g);
+						AtomicAdd(pixel.phi[2], phi.b);
+						pixel.m.fetch_add(1, std::memory_order_relaxed);
+					}
+				}
+
+				const CPUBSDF* bsdf = si.shape->GetBSDF();
+				const float sample1 = sampler.Next1d();
+				const Vec2f sample2 = sampler.Next2d();
+				const auto [bs, bsdfWeight] = bsdf->Sample(bsdfContext, si, sample1, sample2);
+				if (bs.pdf <= 0.f)
+					break;
+
+				const Vec3f wi = si.shadingFrame * si.wi;
+				const Vec3f wo = si.shadingFrame * bs.wo;
+				const Col3f next = beta * bsdfWeight * ShadingNormalCorrection(si, wi, wo);
+
+				// Russian roulette by how much of the photon the bounce kept.
+				const float kept = luminance(beta) > 0.f ? luminance(next) / luminance(beta) : 0.f;
+				const float terminate = max(0.f, 1.f - kept);
+				if (!(kept > 0.f) || sampler.Next1d() < terminate)
+					break;
+
+				beta = next / (1.f - terminate);
+				ray = si.SpawnRay(wo);
+			}
+		}
+	});
+}
+
+void SPPM::UpdatePixels()
+{
+	const float photonCount = static_cast<float>(m_pixels.size());
+	tbb::parallel_for(tbb::blocked_range<size_t>(0, m_pixels.size()), [&](const tbb::blocked_range<size_t>& range)
+	{
+		for (size_t pixelIdx = range.begin(); pixelIdx < range.end(); ++pixelIdx)
+		{
+			SPPMPixel& pixel = m_pixels[pixelIdx];
+			const uint32_t m = pixel.m.exchange(0, std::memory_order_relaxed);
+			const Col3f phi(
+					pixel.phi[0].exchange(0.f, std::memory_order_relaxed),
+					pixel.phi[1].exchange(0.f, std::memory_order_relaxed),
+					pixel.phi[2].exchange(0.f, std::memory_order_relaxed));
+
+			// Keep a share of the new photons and shrink the radius to match, scaling down what was gathered with it.
+			if (m > 0)
+			{
+				const float n = pixel.n + kRadiusReduction * m;
+				const float radius = pixel.radius * sqrt(n / (pixel.n + m));
+				pixel.tau = (pixel.tau + pixel.vp.beta * phi) * (sqr(radius) / sqr(pixel.radius));
+				pixel.n = n;
+				pixel.radius = radius;
+			}
+			pixel.vp = VisiblePoint();
+
+			// The image holds the photon estimate averaged over the iterations, while the estimate is of everything
+			// gathered so far over the current radius. Splatting the change in the total keeps the two in step.
+			if (pixel.radius > 0.f)
+			{
+				const Col3f estimate = pixel.tau / (photonCount * Pi<float> * sqr(pixel.radius));
+				m_splats.Splat(pixelIdx, estimate - pixel.estimate);
+				pixel.estimate = estimate;
+			}
+		}
+	});
+}
+
+bool SPPM::GridCell(const Vec3f& p, Vec3i& cell) const
+{
+	const Vec3f diagonal = m_gridBounds.size();
+	const Vec3f offset = p - m_gridBounds.lower;
+	const auto toCell = [](float offset, float size, int resolution)
+	{
+		const int index = size > 0.f ? static_cast<int>(offset / size * resolution) : 0;
+		return clamp(index, 0, resolution - 1);
+	};
+
+	cell = Vec3i(
+			toCell(offset.x, diagonal.x, m_gridResolution.x),
+			toCell(offset.y, diagonal.y, m_gridResolution.y),
+			toCell(offset.z, diagonal.z, m_gridResolution.z));
+
+	return m_gridResolution.x > 0 &&
+		p.x >= m_gridBounds.lower.x && p.y >= m_gridBounds.lower.y && p.z >= m_gridBounds.lower.z &&
+		p.x <= m_gridBounds.upper.x && p.y <= m_gridBounds.upper.y && p.z <= m_gridBounds.upper.z;
+}
+
+size_t SPPM::HashCell(const Vec3i& cell) const
+{
+	const uint32_t hash = (static_cast<uint32_t>(cell.x) * 73856093u) ^ (static_cast<uint32_t>(cell.y) * 19349663u) ^
+		(static_cast<uint32_t>(cell.z) * 83492791u);
+	return hash % m_cellCounts.size();
+}
+
+float SPPM::MultipleImportantSampleWeight(float pdfA, float pdfB)
+{
+	pdfA *= pdfA;
+	pdfB *= pdfB;
+	const float w = pdfA / (pdfA + pdfB);
+	return select(isfinite(w), w, 0.f);
+}
+
+CPU_NAMESPACE_CLOSE_SCOPE
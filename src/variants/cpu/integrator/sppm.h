@@ -0,0 +1,107 @@
+#ifndef CPU_SPPM_H
+#define CPU_SPPM_H
+
+#include <array>
+#include <atomic>
+#include <vector>
+
+#include <spindulys/math/bbox.h>
+
+#include "../spindulysCPU.h"
+
+#include "integrator.h"
+
+CPU_NAMESPACE_OPEN_SCOPE
+
+class CPUBSDF;
+
+/* Stochastic progressive photon mapping, after Hachisuka and Jensen. Every iteration each pixel follows its camera
+	 path through mirrors and glass to the first diffuse surface, which becomes its visible point, and lights it
+	 directly there. The visible points go into a hash grid and as many photons as there are pixels are traced
+	 from the lights, each adding to every visible point within its radius. Each pixel's radius shrinks as photons
+	 arrive, so caustics seen through glass converge where tracing from either end alone never does. */
+class SPPM final : public Integrator
+{
+public:
+	SPPM(uint32_t maxDepth = 3, bool hideLights = false);
+
+	virtual std::pair<Col3f, float>
+	Sample(const CPUScene* scene, Sampler* sampler, const Ray& ray, Col3f* /* aovs */) const override;
+
+	virtual std::pair<Col3f, float>
+	SamplePixel(const CPUScene* scene, Sampler* sampler, const Ray& ray, const Vec2i& pixel, Col3f* /* aovs */) const override;
+
+	virtual void BeginIteration(const CPUScene* scene, const Vec2i& resolution) override;
+	// Photons are traced once every pixel has found its visible point.
+	virtual void EndIteration() override;
+	virtual void Reset() override;
+	virtual SplatBuffer* GetSplats() override { return &m_splats; }
+
+	bool SetMaxDepth(uint32_t depth) { return depth != std::exchange(m_maxDepth, depth); }
+
+private:
+	// Where the camera path of the pixel ended this iteration.
+	struct VisiblePoint
+	{
+		// Only valid while bsdf is set. The incident direction points back along the camera path.
+		SurfaceInteraction si;
+		const CPUBSDF* bsdf = nullptr;
+		Col3f beta = Col3f(zero);
+	};
+
+	struct SPPMPixel
+	{
+		VisiblePoint vp;
+		// Zero until the pixel first finds a visible point, which sets it from the pixel's footprint.
+		float radius = 0.f;
+
+		// Photons gathered this iteration, added to from every thread.
+		std::array<std::atomic<float>, 3> phi = { 0.f, 0.f, 0.f };
+		std::atomic<uint32_t> m = 0;
+
+		// Photons gathered over every iteration, scaled down with the radius.
+		float n = 0.f;
+		Col3f tau = Col3f(zero);
+		// The photon estimate summed over the iterations so far, so that only the change is splatted.
+		Col3f estimate = Col3f(zero);
+	};
+
+	std::pair<Col3f, float> Shade(const CPUScene* scene, Sampler* sampler, const Ray& ray, int pixelIdx) const;
+	// Light sampled and BSDF sampled direct lighting, weighted against each other.
+	Col3f DirectLighting(const CPUScene* scene, Sampler* sampler, const SurfaceInteraction& si, const CPUBSDF* bsdf) const;
+
+	// Hash every visible point into each cell its radius overlaps, in parallel.
+	void BuildGrid();
+	void TracePhotons();
+	// Shrink the radii by the photons that arrived and splat the change in each pixel's estimate.
+	void UpdatePixels();
+
+	bool GridCell(const Vec3f& p, Vec3i& cell) const;
+	size_t HashCell(const Vec3i& cell) const;
+
+	static float MultipleImportantSampleWeight(float pdfA, float pdfB);
+
+private:
+	// Camera paths follow this many segments to find a visible point, and photons bounce this many times.
+	uint32_t m_maxDepth = 3;
+
+	const CPUScene* m_scene = nullptr;
+	Vec2i m_resolution = Vec2i(zero);
+	uint32_t m_iteration = 0;
+
+	// Written by each pixel for itself while tracing from the camera.
+	mutable std::vector<SPPMPixel> m_pixels;
+
+	// Visible points by the hash of the cells they overlap, sorted by counting.
+	BBox3f m_gridBounds = BBox3f(empty);
+	Vec3i m_gridResolution = Vec3i(zero);
+	std::vector<std::atomic<uint32_t>> m_cellCounts;
+	std::vector<uint32_t> m_cellOffsets;
+	std::vector<uint32_t> m_cellEntries;
+
+	SplatBuffer m_splats;
+};
+
+CPU_NAMESPACE_CLOSE_SCOPE
+
+#endif // CPU_SPPM_H
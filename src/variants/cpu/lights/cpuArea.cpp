@@ -1,29 +1,275 @@
 #include "cpuArea.h"
 
+#include <spindulys/math/warp.h>
+
+#include "../geometry/cpuMesh.h"
+
 #include "../utils/interaction.h"
 #include "../utils/records.h"
 
 CPU_NAMESPACE_OPEN_SCOPE
 
+// Below this the spherical triangle is too thin to sample accurately, above it the triangle covers nearly the
+// whole sphere around the point. Both fall back to sampling the area.
+static constexpr float kMinSolidAngle = 3e-4f;
+static constexpr float kMaxSolidAngle = 6.22f;
+
+CPUAreaLight::CPUAreaLight(const CPUGeometry* geometry, const Col3f& radiance)
+	: AreaLight(radiance)
+	, m_geometry(geometry)
+{
+	Update();
+}
+
+void CPUAreaLight::Update()
+{
+	CPU_TRACE();
+	m_mesh = dynamic_cast<const CPUMesh*>(m_geometry->GetShape());
+	m_triangles.Clear();
+	m_area = 0.f;
+	m_bounds = LightBounds();
+
+	if (!m_mesh)
+		return;
+
+	if (m_mesh->GetMeshType() != Mesh::MeshType::TriangleMesh)
+	{
+		spdlog::warn("Only triangle meshes can emit light, {} does not.", m_geometry->GetName());
+		m_mesh = nullptr;
+		return;
+	}
+
+	const uint32_t triangleCount = m_mesh->GetIndices().size() / 3;
+	std::vector<float> areas(triangleCount);
+	BBox3f bounds(empty);
+	Vec3f axis(zero);
+	for (uint32_t triangle = 0; triangle < triangleCount; ++triangle)
+	{
+		Vec3f p0, p1, p2;
+		if (!GetTriangle(triangle, p0, p1, p2))
+			continue;
+
+		const Vec3f normal = cross(p1 - p0, p2 - p0);
+		areas[triangle] = 0.5f * length(normal);
+		m_area += areas[triangle];
+		bounds.extend(p0);
+		bounds.extend(p1);
+		bounds.extend(p2);
+		axis += 0.5f * normal;
+	}
+
+	m_triangles.Build(areas);
+	if (m_triangles.Empty())
+		return;
+
+	// The area weighted average normal, widened to take in the normal of every triangle.
+	const bool flip = m_geometry->GetTransform().l.det() < 0.f;
+	float cosThetaO = -1.f;
+	if (dot(axis, axis) > 0.f)
+	{
+		axis = normalize(flip ? -axis : axis);
+		cosThetaO = 1.f;
+		for (uint32_t triangle = 0; triangle < triangleCount; ++triangle)
+		{
+			Vec3f p0, p1, p2;
+			if (areas[triangle] > 0.f && GetTriangle(triangle, p0, p1, p2))
+			{
+				const Vec3f normal = normalize(cross(p1 - p0, p2 - p0));
+				cosThetaO = min(cosThetaO, dot(flip ? -normal : normal, axis));
+			}
+		}
+	}
+	else
+	{
+		axis = Vec3f(0.f, 0.f, 1.f);
+	}
+
+	// Each point emits over the hemisphere in front of it.
+	const float phi = Pi<float> * luminance(GetRadiance()) * m_area;
+	m_bounds = LightBounds(bounds, axis, phi, clamp(cosThetaO, -1.f, 1.f), 0.f, false);
+}
+
+bool CPUAreaLight::GetTriangle(uint32_t index, Vec3f& p0, Vec3f& p1, Vec3f& p2) const
+{
+	if (!m_mesh)
+		return false;
+
+	const std::vector<int>& indices = m_mesh->GetIndices();
+	const std::vector<Vec3f>& points = m_mesh->GetPoints();
+	if (static_cast<size_t>(index) * 3 + 2 >= indices.size())
+		return false;
+
+	const int i0 = indices[index * 3];
+	const int i1 = indices[index * 3 + 1];
+	const int i2 = indices[index * 3 + 2];
+	if (i0 < 0 || i1 < 0 || i2 < 0 ||
+			static_cast<size_t>(i0) >= points.size() || static_cast<size_t>(i1) >= points.size() || static_cast<size_t>(i2) >= points.size())
+		return false;
+
+	const AffineSpace3f transform = m_geometry->GetTransform();
+	p0 = xfmPoint(transform, points[i0]);
+	p1 = xfmPoint(transform, points[i1]);
+	p2 = xfmPoint(transform, points[i2]);
+
+	return true;
+}
+
+bool CPUAreaLight::UseSolidAngle(float solidAngle)
+{
+	return solidAngle >= kMinSolidAngle && solidAngle <= kMaxSolidAngle;
+}
+
 Col3f CPUAreaLight::Eval(const SurfaceInteraction& si, uint32_t active) const
 {
 	return (active && si.wi.z > 0.f) ? GetRadiance() : Col3f(zero);
 }
 
 std::pair<DirectionSample, Col3f> CPUAreaLight::SampleDirection(
-		const Interaction& it, const Vec2f& sample,
+		const Interaction& it, const Vec2f& sample_,
 		uint32_t active) const
 {
-	// TODO:
-	DirectionSample ds(zero, zero, zero, zero, zero, zero, zero, zero, nullptr);
-	return { ds, zero };
+	DirectionSample ds;
+	if (!active || !m_geometry->IsVisible())
+		return { ds, zero };
+
+	// Pick a triangle by its area
+	Vec2f sample(sample_);
+	float pmf = 0.f;
+	const uint32_t triangle = m_triangles.Sample(sample.x, &pmf, &sample.x);
+
+	Vec3f p0, p1, p2;
+	if (triangle == AliasTable::kInvalidIndex || !GetTriangle(triangle, p0, p1, p2))
+		return { ds, zero };
+
+	Vec3f n = normalize(cross(p1 - p0, p2 - p0));
+	if (m_geometry->GetTransform().l.det() < 0.f)
+		n = -n;
+
+	const Vec3f a = normalize(p0 - it.p);
+	const Vec3f b = normalize(p1 - it.p);
+	const Vec3f c = normalize(p2 - it.p);
+	const float solidAngle = spherical_triangle_area(a, b, c);
+
+	Vec2f barycentrics;
+	if (UseSolidAngle(solidAngle))
+	{
+		const Vec3f w = square_to_spherical_triangle(a, b, c, sample);
+
+		// Find where the sampled direction meets the triangle.
+		const Vec3f e1 = p1 - p0;
+		const Vec3f e2 = p2 - p0;
+		const Vec3f s1 = cross(w, e2);
+		const float divisor = dot(s1, e1);
+		if (divisor == 0.f || w == Vec3f(zero))
+			return { ds, zero };
+
+		const Vec3f s = it.p - p0;
+		float b1 = clamp(dot(s, s1) / divisor, 0.f, 1.f);
+		float b2 = clamp(dot(w, cross(s, e1)) / divisor, 0.f, 1.f);
+		if (b1 + b2 > 1.f)
+		{
+			const float sum = b1 + b2;
+			b1 /= sum;
+			b2 /= sum;
+		}
+		barycentrics = Vec2f(b1, b2);
+		ds.pdf = pmf / solidAngle;
+	}
+	else
+	{
+		barycentrics = square_to_uniform_triangle(sample);
+	}
+
+	ds.p = madd(1.f - barycentrics.x - barycentrics.y, p0, madd(barycentrics.x, p1, barycentrics.y * p2));
+	ds.n = n;
+	ds.uv = barycentrics;
+	ds.time = it.time;
+	ds.delta = false;
+	ds.primID = triangle;
+	ds.light = this;
+
+	const Vec3f rel = ds.p - it.p;
+	ds.dist = length(rel);
+	if (ds.dist == 0.f)
+		return { DirectionSample(), zero };
+	ds.d = rel / ds.dist;
+
+	// Convert the density over the area into one over solid angle
+	const float cosTheta = -dot(ds.d, n);
+	if (!UseSolidAngle(solidAngle))
+		ds.pdf = cosTheta != 0.f ? sqr(ds.dist) / (abs(cosTheta) * m_area) : 0.f;
+
+	if (ds.pdf == 0.f || cosTheta <= 0.f)
+		return { ds, zero };
+
+	return { ds, GetRadiance() / ds.pdf };
 }
 
 float CPUAreaLight::PdfDirection(const Interaction& it, const DirectionSample& ds,
 		uint32_t active) const
 {
-	// TODO:
-	return zero;
+	Vec3f p0, p1, p2;
+	if (!active || !m_geometry->IsVisible() || !GetTriangle(ds.primID, p0, p1, p2))
+		return 0.f;
+
+	const float solidAngle = spherical_triangle_area(normalize(p0 - it.p), normalize(p1 - it.p), normalize(p2 - it.p));
+	if (UseSolidAngle(solidAngle))
+		return m_triangles.Pmf(ds.primID) / solidAngle;
+
+	const float cosTheta = abs(dot(ds.d, normalize(cross(p1 - p0, p2 - p0))));
+	return cosTheta != 0.f && m_area > 0.f ? sqr(ds.dist) / (cosTheta * m_area) : 0.f;
+}
+
+std::pair<EmissionSample, Col3f>
+CPUAreaLight::SampleEmission(const Vec2f& positionSample, const Vec2f& directionSample, float time) const
+{
+	EmissionSample es;
+	if (!m_geometry->IsVisible() || m_area <= 0.f)
+		return { es, zero };
+
+	// Pick a triangle by its area and a point on it, so the density is uniform over the whole area.
+	Vec2f sample(positionSample);
+	const uint32_t triangle = m_triangles.Sample(sample.x, nullptr, &sample.x);
+
+	Vec3f p0, p1, p2;
+	if (triangle == AliasTable::kInvalidIndex || !GetTriangle(triangle, p0, p1, p2))
+		return { es, zero };
+
+	Vec3f n = normalize(cross(p1 - p0, p2 - p0));
+	if (m_geometry->GetTransform().l.det() < 0.f)
+		n = -n;
+
+	const Vec2f barycentrics = square_to_uniform_triangle(sample);
+	const Vec3f local = square_to_cosine_hemisphere(directionSample);
+
+	es.p = madd(1.f - barycentrics.x - barycentrics.y, p0, madd(barycentrics.x, p1, barycentrics.y * p2));
+	es.n = n;
+	es.uv = barycentrics;
+	es.time = time;
+	es.pdf = 1.f / m_area;
+	es.primID = triangle;
+	es.d = frame(n) * local;
+	es.pdfDirection = square_to_cosine_hemisphere_pdf(local);
+	es.light = this;
+
+	return { es, es.pdfDirection > 0.f ? GetRadiance() : Col3f(zero) };
+}
+
+std::pair<float, float> CPUAreaLight::PdfEmission(const Vec3f& /* p */, const Vec3f& n, const Vec3f& d) const
+{
+	if (!m_geometry->IsVisible() || m_area <= 0.f)
+		return { 0.f, 0.f };
+
+	return { 1.f / m_area, max(dot(n, d), 0.f) * InvPi<float> };
+}
+
+std::optional<LightBounds> CPUAreaLight::GetBounds() const
+{
+	// Hidden geometry is kept out of the way with no power.
+	if (!m_geometry->IsVisible())
+		return LightBounds();
+
+	return m_bounds;
 }
 
 CPU_NAMESPACE_CLOSE_SCOPE
@@ -1,6 +1,8 @@
 #ifndef CPU_AREA_LIGHT_H
 #define CPU_AREA_LIGHT_H
 
+#include <spindulys/aliasTable.h>
+
 #include <lights/area.h>
 
 #include "../spindulysCPU.h"
@@ -10,11 +12,22 @@
 
 CPU_NAMESPACE_OPEN_SCOPE
 
+class CPUGeometry;
+class CPUMesh;
+
+/* Light emitted from the front of every triangle of a mesh instance.
+	 A triangle is picked in proportion to its area in world space, and then a direction towards it is sampled
+	 uniformly over the solid angle it subtends, falling back to sampling its area when it is too small or too
+	 large for that to be reliable. */
 class CPUAreaLight final : public CPULight, public AreaLight
 {
 	public:
-		CPUAreaLight(const Col3f& radiance = Col3f(one))
-			: AreaLight(radiance) { }
+		CPUAreaLight(const CPUGeometry* geometry, const Col3f& radiance = Col3f(one));
+
+		// Pick up changes to the transform or points of the geometry.
+		void Update();
+
+		const CPUGeometry* GetGeometry() const { return m_geometry; }
 
 		virtual Col3f Eval(const SurfaceInteraction& si, uint32_t active) const override;
 
@@ -24,7 +37,29 @@ class CPUAreaLight final : public CPULight, public AreaLight
 
 		virtual float PdfDirection(const Interaction& it, const DirectionSample& ds,
 				uint32_t active) const override;
+
+		virtual std::pair<EmissionSample, Col3f>
+		SampleEmission(const Vec2f& positionSample, const Vec2f& directionSample, float time) const override;
+
+		virtual std::pair<float, float>
+		PdfEmission(const Vec3f& p, const Vec3f& n, const Vec3f& d) const override;
+
+		virtual std::optional<LightBounds> GetBounds() const override;
+
 	private:
+		// The triangle in world space, false if there is no such triangle.
+		bool GetTriangle(uint32_t index, Vec3f& p0, Vec3f& p1, Vec3f& p2) const;
+		// Whether to sample the triangle by the solid angle it subtends rather than by its area.
+		static bool UseSolidAngle(float solidAngle);
+
+	private:
+		const CPUGeometry* m_geometry = nullptr;
+		// The geometry holding the triangles, which the instance may share.
+		const CPUMesh* m_mesh = nullptr;
+
+		AliasTable m_triangles;
+		float m_area = 0.f;
+		LightBounds m_bounds;
 };
 
 CPU_NAMESPACE_CLOSE_SCOPE
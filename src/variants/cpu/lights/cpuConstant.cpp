@@ -16,7 +16,15 @@ std::pair<DirectionSample, Col3f> CPUConstantLight::SampleDirection(
 		const Interaction& it, const Vec2f& sample,
 		uint32_t active) const
 {
-	const Vec3f d = square_to_uniform_sphere(sample);
+	Vec3f d = square_to_uniform_sphere(sample);
+	float pdf = square_to_uniform_sphere_pdf();
+	if (const float portalSolidAngle = m_portals.SolidAngle(it.p); portalSolidAngle > 0.f)
+	{
+		d = m_portals.Sample(it.p, portalSolidAngle, sample);
+		pdf = m_portals.Pdf(it.p, d, portalSolidAngle);
+		if (pdf == 0.f)
+			return { DirectionSample(), zero };
+	}
 
 	// Automatically enlarge the bounding sphere when it does not contain the reference point
 	const float radius = max(m_radius, length(it.p - m_point));
@@ -27,7 +35,7 @@ std::pair<DirectionSample, Col3f> CPUConstantLight::SampleDirection(
 	/* Normal: */     -d,
 	/* UV: */         sample,
 	/* Time value: */ it.time,
-	/* pdf: */        square_to_uniform_sphere_pdf(),
+	/* pdf: */        pdf,
 	/* delta: */      false,
 	/* direction: */  d,
 	/* distance: */   dist,
@@ -41,7 +49,40 @@ std::pair<DirectionSample, Col3f> CPUConstantLight::SampleDirection(
 float CPUConstantLight::PdfDirection(const Interaction& it, const DirectionSample& ds,
 		uint32_t active) const
 {
+	if (const float portalSolidAngle = m_portals.SolidAngle(it.p); portalSolidAngle > 0.f)
+		return m_portals.Pdf(it.p, ds.d, portalSolidAngle);
+
 	return InvFourPi<float>;
 }
 
+std::pair<EmissionSample, Col3f>
+CPUConstantLight::SampleEmission(const Vec2f& positionSample, const Vec2f& directionSample, float time) const
+{
+	EmissionSample es = SampleInfiniteEmission(m_point, m_radius, square_to_uniform_sphere(directionSample), positionSample, time);
+	es.pdfDirection = square_to_uniform_sphere_pdf();
+	es.light = this;
+
+	return { es, GetRadiance() };
+}
+
+std::pair<float, float> CPUConstantLight::PdfEmission(const Vec3f&, const Vec3f&, const Vec3f&) const
+{
+	return { PdfInfiniteEmission(m_radius), square_to_uniform_sphere_pdf() };
+}
+
+float CPUConstantLight::GetPower() const
+{
+	// The radiance arriving at a disk across the scene from every direction.
+	return FourPi<float> * Pi<float> * sqr(m_radius) * luminance(GetRadiance());
+}
+
+void CPUConstantLight::SetSceneBounds(const BBox3f& sceneBounds)
+{
+	if (sceneBounds.empty())
+		return;
+
+	SetPoint(sceneBounds.center());
+	SetRadius(max(length(sceneBounds.size()) / 2.f, Epsilon<float>));
+}
+
 CPU_NAMESPACE_CLOSE_SCOPE
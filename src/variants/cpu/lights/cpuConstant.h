@@ -6,6 +6,7 @@
 #include "../spindulysCPU.h"
 
 #include "cpuLight.h"
+#include "cpuPortals.h"
 
 
 CPU_NAMESPACE_OPEN_SCOPE
@@ -25,7 +26,18 @@ class CPUConstantLight final : public CPULight, public ConstantLight
 
 		virtual float PdfDirection(const Interaction& it, const DirectionSample& ds,
 				uint32_t active) const override;
+
+		virtual std::pair<EmissionSample, Col3f>
+		SampleEmission(const Vec2f& positionSample, const Vec2f& directionSample, float time) const override;
+
+		virtual std::pair<float, float>
+		PdfEmission(const Vec3f& p, const Vec3f& n, const Vec3f& d) const override;
+
+		virtual float GetPower() const override;
+		virtual void SetSceneBounds(const BBox3f& sceneBounds) override;
+		virtual void SetPortals(const CPUPortals& portals) override { m_portals = portals; }
 	private:
+		CPUPortals m_portals;
 };
 
 CPU_NAMESPACE_CLOSE_SCOPE
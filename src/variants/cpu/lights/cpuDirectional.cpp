@@ -5,24 +5,71 @@
 
 CPU_NAMESPACE_OPEN_SCOPE
 
-Col3f CPUDirectionalLight::Eval(const SurfaceInteraction& si, uint32_t active) const
+Col3f CPUDirectionalLight::Eval(const SurfaceInteraction&, uint32_t) const
 {
-	return Col3f(zero);
+	// Rays cannot hit a single direction by chance.
+	return zero;
 }
 
 std::pair<DirectionSample, Col3f> CPUDirectionalLight::SampleDirection(
-		const Interaction& it, const Vec2f& sample,
+		const Interaction& it, const Vec2f& /* sample */,
 		uint32_t active) const
 {
-	// TODO:
-	DirectionSample ds(zero, zero, zero, zero, zero, zero, zero, zero, nullptr);
-	return { ds, zero };
+	const Vec3f d = ToLight();
+
+	// Automatically enlarge the bounding sphere when it does not contain the reference point
+	const float radius = max(m_radius, length(it.p - m_point));
+	const float dist   = 2.f * radius;
+
+	DirectionSample ds(
+	/* Position: */         madd(dist, d, it.p),
+	/* Surface Normal: */   -d,
+	/* Surface UV: */       zero,
+	/* Time Value: */       it.time,
+	/* PDF: */              1.f,
+	/* Delta: */            true,
+	/* Direction: */        d,
+	/* Distance: */         dist,
+	/* Associated light: */ this
+	);
+
+	return { ds, active ? GetIrradiance() : zero };
 }
 
-float CPUDirectionalLight::PdfDirection(const Interaction& it, const DirectionSample& ds,
-		uint32_t active) const
+float CPUDirectionalLight::PdfDirection(const Interaction&, const DirectionSample&, uint32_t) const
 {
 	return zero;
 }
 
+std::pair<EmissionSample, Col3f>
+CPUDirectionalLight::SampleEmission(const Vec2f& positionSample, const Vec2f& /* directionSample */, float time) const
+{
+	EmissionSample es = SampleInfiniteEmission(m_point, m_radius, ToLight(), positionSample, time);
+	es.pdfDirection = 1.f;
+	es.light = this;
+
+	return { es, GetIrradiance() };
+}
+
+std::pair<float, float> CPUDirectionalLight::PdfEmission(const Vec3f&, const Vec3f&, const Vec3f&) const
+{
+	// There is no density to pick the direction itself.
+	return { PdfInfiniteEmission(m_radius), 0.f };
+}
+
+float CPUDirectionalLight::GetPower() const
+{
+	// The irradiance arriving at a disk across the scene.
+	return Pi<float> * sqr(m_radius) * luminance(GetIrradiance());
+}
+
+void CPUDirectionalLight::SetSceneBounds(const BBox3f& sceneBounds)
+{
+	if (sceneBounds.empty())
+		return;
+
+	m_point = sceneBounds.center();
+	m_radius = max(length(sceneBounds.size()) / 2.f, Epsilon<float>);
+}
+
 CPU_NAMESPACE_CLOSE_SCOPE
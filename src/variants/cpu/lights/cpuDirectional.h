@@ -13,8 +13,8 @@ CPU_NAMESPACE_OPEN_SCOPE
 class CPUDirectionalLight final : public CPULight, public DirectionalLight
 {
 	public:
-		CPUDirectionalLight(const Col3f& irradiance = Col3f(one))
-			: DirectionalLight(irradiance) { }
+		CPUDirectionalLight(const Col3f& irradiance = Col3f(one), const AffineSpace3f& transform = AffineSpace3f(one, zero))
+			: DirectionalLight(irradiance, transform) { }
 
 		virtual Col3f Eval(const SurfaceInteraction& si, uint32_t active) const override;
 
@@ -24,7 +24,22 @@ class CPUDirectionalLight final : public CPULight, public DirectionalLight
 
 		virtual float PdfDirection(const Interaction& it, const DirectionSample& ds,
 				uint32_t active) const override;
+
+		virtual std::pair<EmissionSample, Col3f>
+		SampleEmission(const Vec2f& positionSample, const Vec2f& directionSample, float time) const override;
+
+		virtual std::pair<float, float>
+		PdfEmission(const Vec3f& p, const Vec3f& n, const Vec3f& d) const override;
+
+		virtual float GetPower() const override;
+		virtual void SetSceneBounds(const BBox3f& sceneBounds) override;
 	private:
+		// The world space direction from any point towards the light.
+		Vec3f ToLight() const { return normalize(GetTransform().l.vz); }
+
+		// The bounding sphere of the scene, sampled points are placed outside it.
+		Vec3f m_point = Vec3f(zero);
+		float m_radius = 1.f;
 };
 
 CPU_NAMESPACE_CLOSE_SCOPE
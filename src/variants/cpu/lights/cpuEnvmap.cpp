@@ -0,0 +1,220 @@
+#include "cpuEnvmap.h"
+
+#include <tuple>
+
+#include <spindulys/math/constants.h>
+#include <spindulys/math/linearspace3.h>
+
+#include "../utils/interaction.h"
+#include "../utils/records.h"
+
+CPU_NAMESPACE_OPEN_SCOPE
+
+// The latitude-longitude parameterisation, u goes around from +Z and v down from +Y.
+static Vec3f ToDirection(const Vec2f& uv)
+{
+	const float phi = TwoPi<float> * uv.x - Pi<float>;
+	const float theta = Pi<float> * uv.y;
+	const float sinTheta = sin(theta);
+	return Vec3f(sinTheta * sin(phi), cos(theta), -sinTheta * cos(phi));
+}
+
+static Vec2f ToUV(const Vec3f& d)
+{
+	const float u = (atan2(d.x, -d.z) + Pi<float>) * InvTwoPi<float>;
+	const float v = acos(clamp(d.y, -1.f, 1.f)) * InvPi<float>;
+	return Vec2f(u, v);
+}
+
+CPUEnvmapLight::CPUEnvmapLight(const std::string& filepath, const AffineSpace3f& transform, const Col3f& scale)
+	: EnvmapLight(filepath, transform, scale)
+{
+	CPU_TRACE();
+	m_toLocal = transform.l.inverse();
+
+	if (filepath.empty() || !m_image.Load(filepath) || m_image.IsEmpty())
+	{
+		if (!filepath.empty())
+			spdlog::warn("Environment map {} could not be loaded, using a constant environment instead.", filepath);
+		m_image = Image();
+	}
+
+	const int width = m_image.IsEmpty() ? 1 : m_image.GetWidth();
+	const int height = m_image.IsEmpty() ? 1 : m_image.GetHeight();
+
+	// Pixels near the poles cover less of the sphere, so they are weighted by sin(theta) at their centre.
+	std::vector<float> weights(static_cast<size_t>(width) * height, 1.f);
+	double integral[3] = { 0.0, 0.0, 0.0 };
+	for (int y = 0; y < height && !m_image.IsEmpty(); ++y)
+	{
+		const float sinTheta = sin(Pi<float> * (y + 0.5f) / height);
+		for (int x = 0; x < width; ++x)
+		{
+			const Col3f pixel = m_image.GetPixel(x, y);
+			weights[static_cast<size_t>(y) * width + x] = max(luminance(pixel), 0.f) * sinTheta;
+			integral[0] += max(pixel.r, 0.f) * sinTheta;
+			integral[1] += max(pixel.g, 0.f) * sinTheta;
+			integral[2] += max(pixel.b, 0.f) * sinTheta;
+		}
+	}
+
+	if (!m_image.IsEmpty())
+	{
+		// Every pixel covers 2pi^2 / (width * height) of the sphere before the sin(theta) weighting.
+		const double pixelArea = 2.0 * sqr(Pi<double>) / (static_cast<double>(width) * height);
+		m_integral = Col3f(static_cast<float>(integral[0] * pixelArea),
+				static_cast<float>(integral[1] * pixelArea),
+				static_cast<float>(integral[2] * pixelArea));
+	}
+
+	m_pixels.Build(weights);
+
+	// A black image is sampled uniformly, so that its directions still have a density.
+	if (m_pixels.Empty())
+		m_pixels.Build(std::vector<float>(weights.size(), 1.f));
+}
+
+std::pair<uint32_t, Vec2f> CPUEnvmapLight::Lookup(const Vec3f& direction) const
+{
+	const Vec2f uv = ToUV(normalize(xfmVector(m_toLocal, direction)));
+	const int width = m_image.IsEmpty() ? 1 : m_image.GetWidth();
+	const int height = m_image.IsEmpty() ? 1 : m_image.GetHeight();
+	const int x = clamp(static_cast<int>(uv.x * width), 0, width - 1);
+	const int y = clamp(static_cast<int>(uv.y * height), 0, height - 1);
+	return { static_cast<uint32_t>(y) * width + x, uv };
+}
+
+float CPUEnvmapLight::Pdf(uint32_t pixel, float v) const
+{
+	// From the density over the image to the one over the sphere.
+	const float sinTheta = sin(Pi<float> * v);
+	if (sinTheta <= 0.f)
+		return 0.f;
+
+	return m_pixels.Pmf(pixel) * m_pixels.Size() / (2.f * sqr(Pi<float>) * sinTheta);
+}
+
+Col3f CPUEnvmapLight::GetRadiance(uint32_t pixel) const
+{
+	return m_image.IsEmpty() ? GetScale() : m_image.GetPixels()[pixel] * GetScale();
+}
+
+Col3f CPUEnvmapLight::Eval(const SurfaceInteraction& si, uint32_t active) const
+{
+	if (!active)
+		return zero;
+
+	// Rays which miss the scene keep their flipped direction as wi.
+	return GetRadiance(Lookup(-si.wi).first);
+}
+
+std::pair<DirectionSample, Col3f> CPUEnvmapLight::SampleDirection(
+		const Interaction& it, const Vec2f& sample,
+		uint32_t active) const
+{
+	DirectionSample ds;
+	if (!active)
+		return { ds, zero };
+
+	Vec3f d;
+	Vec2f uv;
+	uint32_t pixel;
+	float pdf;
+	if (const float portalSolidAngle = m_portals.SolidAngle(it.p); portalSolidAngle > 0.f)
+	{
+		// Through the openings, ignoring how bright the environment is behind them
+		d = m_portals.Sample(it.p, portalSolidAngle, sample);
+		pdf = m_portals.Pdf(it.p, d, portalSolidAngle);
+		std::tie(pixel, uv) = Lookup(d);
+	}
+	else
+	{
+		std::tie(d, uv, pixel, pdf) = SampleImage(sample);
+	}
+
+	if (pdf == 0.f)
+		return { ds, zero };
+
+	// Automatically enlarge the bounding sphere when it does not contain the reference point
+	const float radius = max(m_radius, length(it.p - m_point));
+	const float dist   = 2.f * radius;
+
+	ds = DirectionSample(
+	/* Position: */   madd(dist, d, it.p),
+	/* Normal: */     -d,
+	/* UV: */         uv,
+	/* Time value: */ it.time,
+	/* pdf: */        pdf,
+	/* delta: */      false,
+	/* direction: */  d,
+	/* distance: */   dist,
+	/* light: */      this
+	);
+
+	return { ds, GetRadiance(pixel) / pdf };
+}
+
+std::tuple<Vec3f, Vec2f, uint32_t, float> CPUEnvmapLight::SampleImage(const Vec2f& sample) const
+{
+	// Pick a pixel, then a point within it
+	float remapped = 0.f;
+	const uint32_t pixel = m_pixels.Sample(sample.x, nullptr, &remapped);
+	if (pixel == AliasTable::kInvalidIndex)
+		return { Vec3f(zero), Vec2f(zero), 0, 0.f };
+
+	const int width = m_image.IsEmpty() ? 1 : m_image.GetWidth();
+	const int height = m_image.IsEmpty() ? 1 : m_image.GetHeight();
+	const Vec2f uv((pixel % width + remapped) / width, (pixel / width + sample.y) / height);
+	return { normalize(xfmVector(GetTransform().l, ToDirection(uv))), uv, pixel, Pdf(pixel, uv.y) };
+}
+
+float CPUEnvmapLight::PdfDirection(const Interaction& it, const DirectionSample& ds,
+		uint32_t active) const
+{
+	if (!active)
+		return 0.f;
+
+	if (const float portalSolidAngle = m_portals.SolidAngle(it.p); portalSolidAngle > 0.f)
+		return m_portals.Pdf(it.p, ds.d, portalSolidAngle);
+
+	const auto [pixel, uv] = Lookup(ds.d);
+	return Pdf(pixel, uv.y);
+}
+
+std::pair<EmissionSample, Col3f>
+CPUEnvmapLight::SampleEmission(const Vec2f& positionSample, const Vec2f& directionSample, float time) const
+{
+	const auto [d, uv, pixel, pdf] = SampleImage(directionSample);
+	if (pdf == 0.f)
+		return { EmissionSample(), zero };
+
+	EmissionSample es = SampleInfiniteEmission(m_point, m_radius, d, positionSample, time);
+	es.uv = uv;
+	es.pdfDirection = pdf;
+	es.light = this;
+
+	return { es, GetRadiance(pixel) };
+}
+
+std::pair<float, float> CPUEnvmapLight::PdfEmission(const Vec3f&, const Vec3f&, const Vec3f& d) const
+{
+	const auto [pixel, uv] = Lookup(-d);
+	return { PdfInfiniteEmission(m_radius), Pdf(pixel, uv.y) };
+}
+
+float CPUEnvmapLight::GetPower() const
+{
+	// The radiance arriving at a disk across the scene, summed over the whole sphere.
+	return Pi<float> * sqr(m_radius) * max(luminance(m_integral * GetScale()), 0.f);
+}
+
+void CPUEnvmapLight::SetSceneBounds(const BBox3f& sceneBounds)
+{
+	if (sceneBounds.empty())
+		return;
+
+	m_point = sceneBounds.center();
+	m_radius = max(length(sceneBounds.size()) / 2.f, Epsilon<float>);
+}
+
+CPU_NAMESPACE_CLOSE_SCOPE
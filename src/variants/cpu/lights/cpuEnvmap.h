@@ -0,0 +1,71 @@
+#ifndef CPU_ENVMAP_LIGHT_H
+#define CPU_ENVMAP_LIGHT_H
+
+#include <spindulys/aliasTable.h>
+
+#include <lights/envmap.h>
+#include <utils/image.h>
+
+#include "../spindulysCPU.h"
+
+#include "cpuLight.h"
+#include "cpuPortals.h"
+
+
+CPU_NAMESPACE_OPEN_SCOPE
+
+/* Environment lit by a latitude-longitude image, sampled in proportion to the luminance of each pixel times
+	 the solid angle it covers. Pixels are picked from an alias table, so both sampling a direction and looking
+	 up its density take constant time. Points inside portals sample through them instead. */
+class CPUEnvmapLight final : public CPULight, public EnvmapLight
+{
+	public:
+		// Falls back to a constant environment of the scale if the image cannot be loaded.
+		CPUEnvmapLight(const std::string& filepath = "", const AffineSpace3f& transform = AffineSpace3f(one, zero),
+				const Col3f& scale = Col3f(one));
+
+		virtual Col3f Eval(const SurfaceInteraction& si, uint32_t active) const override;
+
+		virtual std::pair<DirectionSample, Col3f> SampleDirection(
+				const Interaction& it, const Vec2f& sample,
+				uint32_t active) const override;
+
+		virtual float PdfDirection(const Interaction& it, const DirectionSample& ds,
+				uint32_t active) const override;
+
+		virtual std::pair<EmissionSample, Col3f>
+		SampleEmission(const Vec2f& positionSample, const Vec2f& directionSample, float time) const override;
+
+		virtual std::pair<float, float>
+		PdfEmission(const Vec3f& p, const Vec3f& n, const Vec3f& d) const override;
+
+		virtual float GetPower() const override;
+		virtual void SetSceneBounds(const BBox3f& sceneBounds) override;
+		virtual void SetPortals(const CPUPortals& portals) override { m_portals = portals; }
+
+	private:
+		// The pixel the world space direction falls in, and where within the image.
+		std::pair<uint32_t, Vec2f> Lookup(const Vec3f& direction) const;
+		// Density over solid angle of picking the direction within the pixel.
+		float Pdf(uint32_t pixel, float v) const;
+		// A direction picked by the brightness of the image, ignoring any portals.
+		std::tuple<Vec3f, Vec2f, uint32_t, float> SampleImage(const Vec2f& sample) const;
+		Col3f GetRadiance(uint32_t pixel) const;
+
+	private:
+		Image m_image;
+		AliasTable m_pixels;
+		// The image radiance integrated over the sphere before scaling, so the power needs no pass over the pixels.
+		Col3f m_integral = Col3f(FourPi<float>);
+		LinearSpace3f m_toLocal = LinearSpace3f(one);
+
+		// The bounding sphere of the scene, sampled points are placed outside it.
+		Vec3f m_point = Vec3f(zero);
+		float m_radius = 1.f;
+
+		CPUPortals m_portals;
+};
+
+CPU_NAMESPACE_CLOSE_SCOPE
+
+#endif // CPU_ENVMAP_LIGHT_H
@@ -0,0 +1,25 @@
+#include "cpuLight.h"
+
+#include <spindulys/math/linearspace3.h>
+#include <spindulys/math/warp.h>
+
+#include "../utils/records.h"
+
+CPU_NAMESPACE_OPEN_SCOPE
+
+EmissionSample CPULight::SampleInfiniteEmission(const Vec3f& center, float radius, const Vec3f& towardsLight,
+		const Vec2f& positionSample, float time)
+{
+	const LinearSpace3f basis = frame(towardsLight);
+	const Vec2f disk = radius * square_to_uniform_disk_concentric(positionSample);
+
+	EmissionSample es;
+	es.p = center + radius * towardsLight + disk.x * basis.vx + disk.y * basis.vy;
+	es.n = -towardsLight;
+	es.time = time;
+	es.pdf = PdfInfiniteEmission(radius);
+	es.d = -towardsLight;
+	return es;
+}
+
+CPU_NAMESPACE_CLOSE_SCOPE
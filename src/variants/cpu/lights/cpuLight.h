@@ -1,17 +1,24 @@
 #ifndef CPU_LIGHT_H
 #define CPU_LIGHT_H
 
+#include <optional>
+
 #include <spindulys/math/col3.h>
+#include <spindulys/math/constants.h>
 
 #include <lights/light.h>
 
 #include "../spindulysCPU.h"
 
+#include "cpuLightBounds.h"
+
 CPU_NAMESPACE_OPEN_SCOPE
 
 struct Interaction;
 struct SurfaceInteraction;
 struct DirectionSample;
+struct EmissionSample;
+class CPUPortals;
 
 class CPULight : virtual public Light
 {
@@ -31,7 +38,41 @@ public:
 	virtual float
 	PdfDirection(const Interaction& it, const DirectionSample& ds, uint32_t active) const = 0;
 
+	// Sample a ray leaving the light, to trace a path from it. Rays from lights at infinity start on a disk
+	// facing the scene outside of its bounds. Returns the emitted radiance, or intensity for a point light.
+	virtual std::pair<EmissionSample, Col3f>
+	SampleEmission(const Vec2f& positionSample, const Vec2f& directionSample, float time) const = 0;
+
+	// The densities of SampleEmission leaving from the point with the normal in the direction,
+	// over the area it starts on and over solid angle.
+	virtual std::pair<float, float>
+	PdfEmission(const Vec3f& p, const Vec3f& n, const Vec3f& d) const = 0;
+
+	// Where and how much the light emits, used to pick lights by their importance to a point.
+	// Lights at infinity have no bounds and are picked separately.
+	virtual std::optional<LightBounds> GetBounds() const { return std::nullopt; }
+
+	// The total power the light emits, used to pick lights regardless of the point being lit.
+	// Lights at infinity have to override it as they have no bounds to take it from.
+	virtual float GetPower() const
+	{
+		const std::optional<LightBounds> bounds = GetBounds();
+		return bounds ? bounds->phi : 0.f;
+	}
+
+	// Lights at infinity surround the scene, so are told its bounds whenever they change.
+	virtual void SetSceneBounds(const BBox3f& sceneBounds) { }
+
+	// Lights at infinity can be sampled through the openings of an interior instead of in every direction.
+	virtual void SetPortals(const CPUPortals& portals) { }
+
 protected:
+	// Rays from lights at infinity arrive in parallel, so start on a disk across the scene's bounding sphere
+	// on the side of the direction towards the light.
+	static EmissionSample SampleInfiniteEmission(const Vec3f& center, float radius, const Vec3f& towardsLight,
+			const Vec2f& positionSample, float time);
+	static float PdfInfiniteEmission(float radius) { return 1.f / (Pi<float> * sqr(radius)); }
+
 private:
 };
 
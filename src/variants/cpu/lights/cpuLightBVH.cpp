@@ -0,0 +1,258 @@
+#include "cpuLightBVH.h"
+
+#include <algorithm>
+#include <array>
+
+#include <spindulys/math/constants.h>
+
+CPU_NAMESPACE_OPEN_SCOPE
+
+// Splits are only considered at the boundaries of this many buckets along each axis.
+static constexpr int kBucketCount = 12;
+// Bit trails hold one bit per level.
+static constexpr int kMaxDepth = 64;
+
+// The surface area orientation heuristic, which favours splits into groups that are small, dim and point one way.
+static float SplitCost(const LightBounds& lightBounds, const BBox3f& nodeBounds, int dim)
+{
+	const float thetaO = acos(clamp(lightBounds.cosThetaO, -1.f, 1.f));
+	const float thetaE = acos(clamp(lightBounds.cosThetaE, -1.f, 1.f));
+	const float thetaW = min(thetaO + thetaE, Pi<float>);
+	const float sinThetaO = safe_sqrt(1.f - sqr(lightBounds.cosThetaO));
+	const float orientation = TwoPi<float> * (1.f - lightBounds.cosThetaO) +
+		Pi<float> / 2.f * (2.f * thetaW * sinThetaO - cos(thetaO - 2.f * thetaW) - 2.f * thetaO * sinThetaO + lightBounds.cosThetaO);
+
+	// Penalises splitting thin nodes across their thin side.
+	const Vec3f diagonal = nodeBounds.size();
+	const float regularity = diagonal[dim] > 0.f ? reduce_max(diagonal) / diagonal[dim] : 0.f;
+
+	return lightBounds.phi * orientation * regularity * area(lightBounds.bounds);
+}
+
+void CPULightBVH::Clear()
+{
+	m_nodes.clear();
+	m_infiniteLights.clear();
+	m_bitTrails.clear();
+	m_bounded.clear();
+}
+
+void CPULightBVH::Build(const std::vector<std::unique_ptr<CPULight>>& lights)
+{
+	CPU_TRACE();
+	Clear();
+
+	m_bitTrails.resize(lights.size(), 0);
+	m_bounded.resize(lights.size(), false);
+
+	std::vector<std::pair<uint32_t, LightBounds>> boundedLights;
+	for (uint32_t lightIndex = 0; lightIndex < lights.size(); ++lightIndex)
+	{
+		if (const std::optional<LightBounds> bounds = lights[lightIndex]->GetBounds())
+		{
+			// Lights which emit nothing are never picked.
+			if (bounds->phi > 0.f)
+				boundedLights.emplace_back(lightIndex, *bounds);
+		}
+		else
+		{
+			m_infiniteLights.emplace_back(lightIndex);
+		}
+	}
+
+	if (!boundedLights.empty())
+		BuildNodes(boundedLights, 0, boundedLights.size(), 0, 0);
+}
+
+uint32_t CPULightBVH::BuildNodes(std::vector<std::pair<uint32_t, LightBounds>>& lights, size_t begin, size_t end, uint64_t bitTrail, int depth)
+{
+	const uint32_t nodeIndex = m_nodes.size();
+	m_nodes.emplace_back();
+
+	if (end - begin == 1)
+	{
+		const auto& [lightIndex, bounds] = lights[begin];
+		m_nodes[nodeIndex].bounds = bounds;
+		m_nodes[nodeIndex].childOrLight = lightIndex;
+		m_nodes[nodeIndex].leaf = true;
+		m_bitTrails[lightIndex] = bitTrail;
+		m_bounded[lightIndex] = true;
+		return nodeIndex;
+	}
+
+	BBox3f bounds(empty);
+	BBox3f centroidBounds(empty);
+	for (size_t i = begin; i < end; ++i)
+	{
+		bounds.extend(lights[i].second.bounds);
+		centroidBounds.extend(lights[i].second.Centroid());
+	}
+
+	// Lights are only split by cost while there is room left to split the rest in half, so the bit trails cannot overflow.
+	int halvingDepth = 0;
+	while ((size_t(1) << halvingDepth) < end - begin)
+		++halvingDepth;
+	const bool splitByCost = depth + 1 + halvingDepth <= kMaxDepth;
+
+	// Find the cheapest split along any axis.
+	float minCost = Infinity<float>;
+	int minBucket = -1;
+	int minDim = -1;
+	const Vec3f centroidSize = centroidBounds.size();
+	for (int dim = 0; dim < 3 && splitByCost; ++dim)
+	{
+		if (centroidSize[dim] <= 0.f)
+			continue;
+
+		const auto bucketOf = [&](const LightBounds& lightBounds)
+		{
+			const float offset = (lightBounds.Centroid()[dim] - centroidBounds.lower[dim]) / centroidSize[dim];
+			return clamp(static_cast<int>(offset * kBucketCount), 0, kBucketCount - 1);
+		};
+
+		std::array<LightBounds, kBucketCount> buckets;
+		for (size_t i = begin; i < end; ++i)
+		{
+			LightBounds& bucket = buckets[bucketOf(lights[i].second)];
+			bucket = LightBounds::Union(bucket, lights[i].second);
+		}
+
+		for (int split = 0; split < kBucketCount - 1; ++split)
+		{
+			LightBounds below;
+			LightBounds above;
+			for (int bucket = 0; bucket <= split; ++bucket)
+				below = LightBounds::Union(below, buckets[bucket]);
+			for (int bucket = split + 1; bucket < kBucketCount; ++bucket)
+				above = LightBounds::Union(above, buckets[bucket]);
+
+			const float cost = SplitCost(below, bounds, dim) + SplitCost(above, bounds, dim);
+			if (cost > 0.f && cost < minCost)
+			{
+				minCost = cost;
+				minBucket = split;
+				minDim = dim;
+			}
+		}
+	}
+
+	size_t middle = (begin + end) / 2;
+	if (minDim != -1)
+	{
+		const auto split = std::partition(lights.begin() + begin, lights.begin() + end, [&](const std::pair<uint32_t, LightBounds>& light)
+		{
+			const float offset = (light.second.Centroid()[minDim] - centroidBounds.lower[minDim]) / centroidSize[minDim];
+			return clamp(static_cast<int>(offset * kBucketCount), 0, kBucketCount - 1) <= minBucket;
+		});
+
+		const size_t splitIndex = split - lights.begin();
+		if (splitIndex != begin && splitIndex != end)
+			middle = splitIndex;
+	}
+	else
+	{
+		// Nothing to tell the lights apart by, so they are split by their order along the widest axis.
+		const int dim = centroidSize.x >= centroidSize.y && centroidSize.x >= centroidSize.z ? 0 : (centroidSize.y >= centroidSize.z ? 1 : 2);
+		std::nth_element(lights.begin() + begin, lights.begin() + middle, lights.begin() + end,
+				[dim](const std::pair<uint32_t, LightBounds>& a, const std::pair<uint32_t, LightBounds>& b)
+				{ return a.second.Centroid()[dim] < b.second.Centroid()[dim]; });
+	}
+
+	// The first child always directly follows its parent.
+	BuildNodes(lights, begin, middle, bitTrail, depth + 1);
+	const uint32_t secondChild = BuildNodes(lights, middle, end, bitTrail | (uint64_t(1) << depth), depth + 1);
+
+	m_nodes[nodeIndex].bounds = LightBounds::Union(m_nodes[nodeIndex + 1].bounds, m_nodes[secondChild].bounds);
+	m_nodes[nodeIndex].childOrLight = secondChild;
+
+	return nodeIndex;
+}
+
+float CPULightBVH::InfiniteProbability() const
+{
+	const float infiniteCount = m_infiniteLights.size();
+	return infiniteCount / (infiniteCount + (m_nodes.empty() ? 0.f : 1.f));
+}
+
+std::pair<uint32_t, float> CPULightBVH::Sample(const Vec3f& p, const Vec3f& n, float& sample) const
+{
+	const float infiniteProbability = InfiniteProbability();
+	if (sample < infiniteProbability)
+	{
+		sample /= infiniteProbability;
+		const uint32_t index = min(static_cast<uint32_t>(sample * m_infiniteLights.size()), static_cast<uint32_t>(m_infiniteLights.size() - 1));
+		sample = min(sample * m_infiniteLights.size() - index, OneMinusEpsilon<float>);
+		return { m_infiniteLights[index], infiniteProbability / m_infiniteLights.size() };
+	}
+
+	if (m_nodes.empty())
+		return { kInvalidLight, 0.f };
+
+	sample = min((sample - infiniteProbability) / (1.f - infiniteProbability), OneMinusEpsilon<float>);
+	float pmf = 1.f - infiniteProbability;
+
+	uint32_t nodeIndex = 0;
+	while (!m_nodes[nodeIndex].leaf)
+	{
+		const Node& node = m_nodes[nodeIndex];
+		const float importance0 = m_nodes[nodeIndex + 1].bounds.Importance(p, n);
+		const float importance1 = m_nodes[node.childOrLight].bounds.Importance(p, n);
+		if (importance0 == 0.f && importance1 == 0.f)
+			return { kInvalidLight, 0.f };
+
+		const float probability0 = importance0 / (importance0 + importance1);
+		if (sample < probability0)
+		{
+			sample = min(sample / probability0, OneMinusEpsilon<float>);
+			pmf *= probability0;
+			nodeIndex = nodeIndex + 1;
+		}
+		else
+		{
+			sample = min((sample - probability0) / (1.f - probability0), OneMinusEpsilon<float>);
+			pmf *= importance1 / (importance0 + importance1);
+			nodeIndex = node.childOrLight;
+		}
+	}
+
+	// A lone light is only checked here, otherwise its parent already has.
+	if (nodeIndex == 0 && m_nodes[0].bounds.Importance(p, n) == 0.f)
+		return { kInvalidLight, 0.f };
+
+	return { m_nodes[nodeIndex].childOrLight, pmf };
+}
+
+float CPULightBVH::Pmf(const Vec3f& p, const Vec3f& n, uint32_t lightIndex) const
+{
+	if (lightIndex >= m_bounded.size())
+		return 0.f;
+
+	const float infiniteProbability = InfiniteProbability();
+	if (!m_bounded[lightIndex])
+	{
+		const bool infinite = std::find(m_infiniteLights.begin(), m_infiniteLights.end(), lightIndex) != m_infiniteLights.end();
+		return infinite ? infiniteProbability / m_infiniteLights.size() : 0.f;
+	}
+
+	// Follow the same path down as sampling would have.
+	uint64_t bitTrail = m_bitTrails[lightIndex];
+	float pmf = 1.f - infiniteProbability;
+	uint32_t nodeIndex = 0;
+	while (!m_nodes[nodeIndex].leaf)
+	{
+		const Node& node = m_nodes[nodeIndex];
+		const float importance0 = m_nodes[nodeIndex + 1].bounds.Importance(p, n);
+		const float importance1 = m_nodes[node.childOrLight].bounds.Importance(p, n);
+		const float importance = (bitTrail & 1) ? importance1 : importance0;
+		if (importance == 0.f)
+			return 0.f;
+
+		pmf *= importance / (importance0 + importance1);
+		nodeIndex = (bitTrail & 1) ? node.childOrLight : nodeIndex + 1;
+		bitTrail >>= 1;
+	}
+
+	return pmf;
+}
+
+CPU_NAMESPACE_CLOSE_SCOPE
@@ -0,0 +1,58 @@
+#ifndef CPU_LIGHT_BVH_H
+#define CPU_LIGHT_BVH_H
+
+#include <memory>
+#include <vector>
+
+#include <spindulys/math/vec3.h>
+
+#include "../spindulysCPU.h"
+
+#include "cpuLight.h"
+#include "cpuLightBounds.h"
+
+CPU_NAMESPACE_OPEN_SCOPE
+
+/* Picks lights in proportion to an estimate of how much each contributes at a point.
+	 The bounded lights are held in a hierarchy of their bounds, which is walked from the root picking
+	 either child by its importance to the point, so only a path of nodes is visited per sample.
+	 Lights at infinity cannot be bounded and are picked uniformly alongside the hierarchy. */
+class CPULightBVH
+{
+	public:
+		static constexpr uint32_t kInvalidLight = uint32_t(-1);
+
+		void Build(const std::vector<std::unique_ptr<CPULight>>& lights);
+		void Clear();
+
+		// Pick a light for the point and its normal, which is zero away from a surface. Returns the index of the
+		// light in the list the BVH was built from along with the probability of picking it, or kInvalidLight if
+		// no light reaches the point. The sample is remapped so that it can be reused.
+		std::pair<uint32_t, float> Sample(const Vec3f& p, const Vec3f& n, float& sample) const;
+		// The probability of Sample picking the light.
+		float Pmf(const Vec3f& p, const Vec3f& n, uint32_t lightIndex) const;
+
+	private:
+		struct Node
+		{
+			LightBounds bounds;
+			// The second child of interior nodes, the first follows its parent.
+			uint32_t childOrLight = 0;
+			bool leaf = false;
+		};
+
+		// Returns the index of the node holding the lights between begin and end.
+		uint32_t BuildNodes(std::vector<std::pair<uint32_t, LightBounds>>& lights, size_t begin, size_t end, uint64_t bitTrail, int depth);
+		// The probability of picking an infinite light rather than descending into the hierarchy.
+		float InfiniteProbability() const;
+
+		std::vector<Node> m_nodes;
+		std::vector<uint32_t> m_infiniteLights;
+		// Which child to take at each level to reach a light, in the bits from lowest upwards.
+		std::vector<uint64_t> m_bitTrails;
+		std::vector<bool> m_bounded;
+};
+
+CPU_NAMESPACE_CLOSE_SCOPE
+
+#endif // CPU_LIGHT_BVH_H
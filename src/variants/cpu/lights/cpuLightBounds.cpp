@@ -0,0 +1,102 @@
+#include "cpuLightBounds.h"
+
+#include <spindulys/math/constants.h>
+#include <spindulys/math/linearspace3.h>
+
+CPU_NAMESPACE_OPEN_SCOPE
+
+// cos(a - b), or one if b is already beyond a.
+static float CosSubClamped(float sinThetaA, float cosThetaA, float sinThetaB, float cosThetaB)
+{
+	return cosThetaA > cosThetaB ? 1.f : cosThetaA * cosThetaB + sinThetaA * sinThetaB;
+}
+
+// sin(a - b), or zero if b is already beyond a.
+static float SinSubClamped(float sinThetaA, float cosThetaA, float sinThetaB, float cosThetaB)
+{
+	return cosThetaA > cosThetaB ? 0.f : sinThetaA * cosThetaB - cosThetaA * sinThetaB;
+}
+
+// Stable for small angles, unlike the arc cosine of the dot product.
+static float AngleBetween(const Vec3f& a, const Vec3f& b)
+{
+	return dot(a, b) < 0.f ? Pi<float> - 2.f * asin(min(length(a + b) / 2.f, 1.f)) : 2.f * asin(min(length(b - a) / 2.f, 1.f));
+}
+
+float LightBounds::Importance(const Vec3f& p, const Vec3f& n) const
+{
+	// Clamped so that points within the bounds do not blow up.
+	const Vec3f centroid = Centroid();
+	const float radius = length(bounds.size()) / 2.f;
+	const float dist2 = dot(p - centroid, p - centroid);
+	const float d2 = max(dist2, radius);
+
+	const Vec3f wi = normalize(p - centroid);
+	float cosThetaW = dot(axis, wi);
+	if (twoSided)
+		cosThetaW = abs(cosThetaW);
+	const float sinThetaW = safe_sqrt(1.f - sqr(cosThetaW));
+
+	// The cone of directions the bounds subtend from the point, the whole sphere if the point is inside them.
+	const float cosThetaB = dist2 <= sqr(radius) ? -1.f : safe_sqrt(1.f - sqr(radius) / dist2);
+	const float sinThetaB = safe_sqrt(1.f - sqr(cosThetaB));
+
+	// The smallest angle between the direction to the point and any emitting direction.
+	const float sinThetaO = safe_sqrt(1.f - sqr(cosThetaO));
+	const float cosThetaX = CosSubClamped(sinThetaW, cosThetaW, sinThetaO, cosThetaO);
+	const float sinThetaX = SinSubClamped(sinThetaW, cosThetaW, sinThetaO, cosThetaO);
+	const float cosThetaP = CosSubClamped(sinThetaX, cosThetaX, sinThetaB, cosThetaB);
+	if (cosThetaP <= cosThetaE)
+		return 0.f;
+
+	float importance = phi * cosThetaP / d2;
+
+	if (n != Vec3f(zero))
+	{
+		const float cosThetaI = abs(dot(wi, n));
+		const float sinThetaI = safe_sqrt(1.f - sqr(cosThetaI));
+		importance *= CosSubClamped(sinThetaI, cosThetaI, sinThetaB, cosThetaB);
+	}
+
+	return max(importance, 0.f);
+}
+
+LightBounds LightBounds::Union(const LightBounds& a, const LightBounds& b)
+{
+	if (a.phi == 0.f)
+		return b;
+	if (b.phi == 0.f)
+		return a;
+
+	// The smallest cone holding both cones of normals, unless one already holds the other.
+	Vec3f axis = a.axis;
+	float cosThetaO = a.cosThetaO;
+
+	const float thetaA = acos(clamp(a.cosThetaO, -1.f, 1.f));
+	const float thetaB = acos(clamp(b.cosThetaO, -1.f, 1.f));
+	const float thetaD = AngleBetween(a.axis, b.axis);
+	if (min(thetaD + thetaA, Pi<float>) <= thetaB)
+	{
+		axis = b.axis;
+		cosThetaO = b.cosThetaO;
+	}
+	else if (min(thetaD + thetaB, Pi<float>) > thetaA)
+	{
+		const float thetaO = (thetaA + thetaD + thetaB) / 2.f;
+		const Vec3f rotationAxis = cross(a.axis, b.axis);
+		if (thetaO >= Pi<float> || dot(rotationAxis, rotationAxis) == 0.f)
+		{
+			cosThetaO = -1.f;
+		}
+		else
+		{
+			axis = normalize(xfmVector(LinearSpace3f::rotate(rotationAxis, thetaO - thetaA), a.axis));
+			cosThetaO = cos(thetaO);
+		}
+	}
+
+	return LightBounds(merge(a.bounds, b.bounds), axis, a.phi + b.phi, cosThetaO,
+			min(a.cosThetaE, b.cosThetaE), a.twoSided || b.twoSided);
+}
+
+CPU_NAMESPACE_CLOSE_SCOPE
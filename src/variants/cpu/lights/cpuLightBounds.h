@@ -0,0 +1,37 @@
+#ifndef CPU_LIGHT_BOUNDS_H
+#define CPU_LIGHT_BOUNDS_H
+
+#include <spindulys/math/bbox.h>
+#include <spindulys/math/vec3.h>
+
+#include "../spindulysCPU.h"
+
+CPU_NAMESPACE_OPEN_SCOPE
+
+// Where a light, or a group of lights, emits from and in which directions, along with how much it emits.
+// The emitting surface normals lie within cosThetaO of the axis, and each emits up to cosThetaE away from its normal.
+struct LightBounds
+{
+	BBox3f bounds = BBox3f(empty);
+	Vec3f axis = Vec3f(0.f, 0.f, 1.f);
+	float cosThetaO = 1.f;
+	float cosThetaE = 1.f;
+	float phi = 0.f;
+	bool twoSided = false;
+
+	LightBounds() = default;
+	LightBounds(const BBox3f& bounds, const Vec3f& axis, float phi, float cosThetaO, float cosThetaE, bool twoSided)
+		: bounds(bounds), axis(axis), cosThetaO(cosThetaO), cosThetaE(cosThetaE), phi(phi), twoSided(twoSided)
+	{ }
+
+	Vec3f Centroid() const { return bounds.center(); }
+
+	// A conservative estimate of how much of the light reaches the point, the normal is ignored if zero.
+	float Importance(const Vec3f& p, const Vec3f& n) const;
+
+	static LightBounds Union(const LightBounds& a, const LightBounds& b);
+};
+
+CPU_NAMESPACE_CLOSE_SCOPE
+
+#endif // CPU_LIGHT_BOUNDS_H
@@ -1,5 +1,7 @@
 #include "cpuPoint.h"
 
+#include <spindulys/math/warp.h>
+
 #include "../utils/interaction.h"
 #include "../utils/records.h"
 
@@ -39,4 +41,32 @@ float CPUPointLight::PdfDirection(const Interaction&, const DirectionSample&, ui
 	return zero;
 }
 
+std::pair<EmissionSample, Col3f>
+CPUPointLight::SampleEmission(const Vec2f& /* positionSample */, const Vec2f& directionSample, float time) const
+{
+	EmissionSample es;
+	es.p = GetPosition();
+	es.time = time;
+	es.pdf = 1.f;
+	es.delta = true;
+	es.d = square_to_uniform_sphere(directionSample);
+	es.pdfDirection = square_to_uniform_sphere_pdf();
+	es.light = this;
+
+	return { es, GetIntensity() };
+}
+
+std::pair<float, float> CPUPointLight::PdfEmission(const Vec3f&, const Vec3f&, const Vec3f&) const
+{
+	// There is no density to pick the point itself.
+	return { 0.f, square_to_uniform_sphere_pdf() };
+}
+
+std::optional<LightBounds> CPUPointLight::GetBounds() const
+{
+	// Emits equally in every direction.
+	const float phi = FourPi<float> * luminance(GetIntensity());
+	return LightBounds(BBox3f(GetPosition()), Vec3f(0.f, 0.f, 1.f), phi, -1.f, 0.f, false);
+}
+
 CPU_NAMESPACE_CLOSE_SCOPE
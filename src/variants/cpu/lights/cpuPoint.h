@@ -25,6 +25,14 @@ public:
 	virtual float
 	PdfDirection(const Interaction& it, const DirectionSample& ds, uint32_t active) const override;
 
+	virtual std::pair<EmissionSample, Col3f>
+	SampleEmission(const Vec2f& positionSample, const Vec2f& directionSample, float time) const override;
+
+	virtual std::pair<float, float>
+	PdfEmission(const Vec3f& p, const Vec3f& n, const Vec3f& d) const override;
+
+	virtual std::optional<LightBounds> GetBounds() const override;
+
 private:
 };
 
@@ -0,0 +1,127 @@
+#include "cpuPortals.h"
+
+#include <spindulys/math/linearspace3.h>
+#include <spindulys/math/warp.h>
+
+CPU_NAMESPACE_OPEN_SCOPE
+
+// Below this the openings are too small to sample accurately, so the light samples the whole environment.
+static constexpr float kMinSolidAngle = 1e-4f;
+
+void CPUPortals::Add(const PortalLight& portal)
+{
+	Portal added;
+	added.corners = portal.GetCorners();
+	added.normal = normalize(xfmNormal(portal.GetTransform().l, Vec3f(0.f, 0.f, -1.f)));
+
+	// Degenerate portals cannot be seen through.
+	if (dot(added.normal, added.normal) > 0.f && portal.GetWidth() > 0.f && portal.GetHeight() > 0.f)
+		m_portals.emplace_back(added);
+}
+
+void CPUPortals::Append(const CPUPortals& portals)
+{
+	m_portals.insert(m_portals.end(), portals.m_portals.begin(), portals.m_portals.end());
+}
+
+bool CPUPortals::Faces(const Portal& portal, const Vec3f& p)
+{
+	return dot(p - portal.corners[0], portal.normal) > 0.f;
+}
+
+float CPUPortals::TriangleSolidAngle(const Portal& portal, int triangle, const Vec3f& p)
+{
+	const Vec3f a = normalize(portal.corners[0] - p);
+	const Vec3f b = normalize(portal.corners[1 + triangle] - p);
+	const Vec3f c = normalize(portal.corners[2 + triangle] - p);
+	return spherical_triangle_area(a, b, c);
+}
+
+float CPUPortals::SolidAngle(const Vec3f& p) const
+{
+	float solidAngle = 0.f;
+	for (const Portal& portal : m_portals)
+	{
+		if (Faces(portal, p))
+			solidAngle += TriangleSolidAngle(portal, 0, p) + TriangleSolidAngle(portal, 1, p);
+	}
+
+	return solidAngle >= kMinSolidAngle ? solidAngle : 0.f;
+}
+
+Vec3f CPUPortals::Sample(const Vec3f& p, float solidAngle, const Vec2f& sample_) const
+{
+	// Pick a triangle by the solid angle it covers, then a direction uniformly within it.
+	Vec2f sample(sample_);
+	float target = sample.x * solidAngle;
+	const Portal* picked = nullptr;
+	int pickedTriangle = 0;
+	for (const Portal& portal : m_portals)
+	{
+		if (!Faces(portal, p))
+			continue;
+
+		for (int triangle = 0; triangle < 2; ++triangle)
+		{
+			const float triangleSolidAngle = TriangleSolidAngle(portal, triangle, p);
+			if (triangleSolidAngle <= 0.f)
+				continue;
+
+			picked = &portal;
+			pickedTriangle = triangle;
+			if (target < triangleSolidAngle)
+			{
+				sample.x = min(target / triangleSolidAngle, OneMinusEpsilon<float>);
+				return square_to_spherical_triangle(
+						normalize(portal.corners[0] - p),
+						normalize(portal.corners[1 + triangle] - p),
+						normalize(portal.corners[2 + triangle] - p), sample);
+			}
+			target -= triangleSolidAngle;
+		}
+	}
+
+	// Rounding left the sample past the end, so it belongs to the last triangle.
+	if (!picked)
+		return Vec3f(zero);
+
+	sample.x = OneMinusEpsilon<float>;
+	return square_to_spherical_triangle(
+			normalize(picked->corners[0] - p),
+			normalize(picked->corners[1 + pickedTriangle] - p),
+			normalize(picked->corners[2 + pickedTriangle] - p), sample);
+}
+
+float CPUPortals::Pdf(const Vec3f& p, const Vec3f& d, float solidAngle) const
+{
+	if (solidAngle <= 0.f)
+		return 0.f;
+
+	// Every triangle is sampled with the same density, so overlapping portals add up.
+	int hits = 0;
+	for (const Portal& portal : m_portals)
+	{
+		if (!Faces(portal, p) || dot(d, portal.normal) >= 0.f)
+			continue;
+
+		for (int triangle = 0; triangle < 2; ++triangle)
+		{
+			const Vec3f e1 = portal.corners[1 + triangle] - portal.corners[0];
+			const Vec3f e2 = portal.corners[2 + triangle] - portal.corners[0];
+			const Vec3f s1 = cross(d, e2);
+			const float divisor = dot(s1, e1);
+			if (divisor == 0.f)
+				continue;
+
+			const Vec3f s = p - portal.corners[0];
+			const float b1 = dot(s, s1) / divisor;
+			const float b2 = dot(d, cross(s, e1)) / divisor;
+			if (b1 >= 0.f && b2 >= 0.f && b1 + b2 <= 1.f)
+				++hits;
+		}
+	}
+
+	return hits / solidAngle;
+}
+
+CPU_NAMESPACE_CLOSE_SCOPE
@@ -0,0 +1,55 @@
+#ifndef CPU_PORTALS_H
+#define CPU_PORTALS_H
+
+#include <array>
+#include <vector>
+
+#include <lights/portal.h>
+
+#include "../spindulysCPU.h"
+
+
+CPU_NAMESPACE_OPEN_SCOPE
+
+/* The portals a light at infinity is sampled through. From a point inside the portals, directions are sampled
+	 uniformly over the solid angle of the openings it can see, so hardly any shadow rays end up in the walls.
+	 Points which no portal faces fall back to the light's own sampling, and since that choice only depends on the
+	 point, sampling and the density stay consistent for MIS. */
+class CPUPortals
+{
+	public:
+		void Add(const PortalLight& portal);
+		void Append(const CPUPortals& portals);
+		void Clear() { m_portals.clear(); }
+
+		bool Empty() const { return m_portals.empty(); }
+
+		// The solid angle of the openings p sees the environment through,
+		// zero if it should be sampled without the portals.
+		float SolidAngle(const Vec3f& p) const;
+
+		// A direction from p through one of the portals, given the solid angle they cover.
+		Vec3f Sample(const Vec3f& p, float solidAngle, const Vec2f& sample) const;
+
+		// Density over solid angle of sampling direction d from p, given the solid angle the portals cover.
+		float Pdf(const Vec3f& p, const Vec3f& d, float solidAngle) const;
+
+	private:
+		struct Portal
+		{
+			std::array<Vec3f, 4> corners;
+			// Points into the scene, the side the portal lets light through to.
+			Vec3f normal;
+		};
+
+		// Every portal is split into two triangles, the second of which starts at corner 0 too.
+		static float TriangleSolidAngle(const Portal& portal, int triangle, const Vec3f& p);
+		static bool Faces(const Portal& portal, const Vec3f& p);
+
+	private:
+		std::vector<Portal> m_portals;
+};
+
+CPU_NAMESPACE_CLOSE_SCOPE
+
+#endif // CPU_PORTALS_H
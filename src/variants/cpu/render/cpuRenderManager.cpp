@@ -1,13 +1,20 @@
 #include "cpuRenderManager.h"
 
+#include <tbb/parallel_for.h>
+
+#include "../integrator/bidirectional.h"
 #include "../integrator/direct.h"
 #include "../integrator/forwardPath.h"
+#include "../integrator/lightTracer.h"
+#include "../integrator/restirDirect.h"
+#include "../integrator/sppm.h"
 
 CPU_NAMESPACE_OPEN_SCOPE
 
 CPURenderManager::CPURenderManager()
 {
 	m_scene = new CPUScene();
+	static_cast<CPUScene*>(m_scene)->SetLightSampler(m_renderGlobals.GetLightSampler());
 
 	InitialiseIntegrator(m_renderGlobals.GetIntegrator());
 }
@@ -41,7 +48,8 @@ void CPURenderManager::Trace(int iterations, size_t heightBegin, size_t heightEn
 			m_scene->GetSceneCamera().GetCameraRay(cameraSample, origin, direction);
 			Ray primaryRay(origin, direction);
 
-			const auto [color, _] = m_integrator->Sample(dynamic_cast<CPUScene*>(m_scene), workerSampler, primaryRay, nullptr);
+			const auto [color, _] = m_integrator->SamplePixel(dynamic_cast<CPUScene*>(m_scene), workerSampler, primaryRay,
+					Vec2i(pixelX, pixelY), nullptr);
 
 			m_buffers[BufferIds::kBeauty]->MultiplyPixel(pixelIdx, static_cast<float>(iterations - 1));
 			m_buffers[BufferIds::kBeauty]->AddPixel(pixelIdx, color);
@@ -52,6 +60,25 @@ void CPURenderManager::Trace(int iterations, size_t heightBegin, size_t heightEn
 	delete workerSampler;
 }
 
+void CPURenderManager::IterationFinished()
+{
+	m_integrator->EndIteration();
+
+	// Splats are averaged in with the samples of this iteration, which every pixel has already been divided by.
+	SplatBuffer* splats = m_integrator->GetSplats();
+	if (!splats)
+		return;
+
+	Buffer3f* beauty = m_buffers[BufferIds::kBeauty];
+	const size_t pixels = std::min(splats->Size(), beauty->GetPixelData().size());
+	const float scale = 1.f / static_cast<float>(m_iterations);
+	tbb::parallel_for(tbb::blocked_range<size_t>(0, pixels), [&](const tbb::blocked_range<size_t>& range)
+	{
+		for (size_t pixelIdx = range.begin(); pixelIdx < range.end(); ++pixelIdx)
+			beauty->AddPixel(pixelIdx, splats->Take(pixelIdx) * scale);
+	});
+}
+
 bool CPURenderManager::SetIntegrator(IntegratorIds integratorID)
 {
 	if (!RenderManager::SetIntegrator(integratorID))
@@ -82,8 +109,16 @@ bool CPURenderManager::SetMaxBSDFSamples(uint32_t samples)
 bool CPURenderManager::SetMaxDepth(uint32_t depth)
 {
 	if (RenderManager::SetMaxDepth(depth))
+	{
 		if (ForwardPath* forwardIntegrator = dynamic_cast<ForwardPath*>(m_integrator.get()))
 			return forwardIntegrator->SetMaxDepth(depth);
+		if (Bidirectional* bidirectionalIntegrator = dynamic_cast<Bidirectional*>(m_integrator.get()))
+			return bidirectionalIntegrator->SetMaxDepth(depth);
+		if (LightTracer* lightIntegrator = dynamic_cast<LightTracer*>(m_integrator.get()))
+			return lightIntegrator->SetMaxDepth(depth);
+		if (SPPM* sppmIntegrator = dynamic_cast<SPPM*>(m_integrator.get()))
+			return sppmIntegrator->SetMaxDepth(depth);
+	}
 
 	return false;
 }
@@ -97,6 +132,33 @@ bool CPURenderManager::SetRussianRouletteDepth(uint32_t depth)
 	return false;
 }
 
+bool CPURenderManager::SetPathGuiding(bool pathGuiding)
+{
+	if (RenderManager::SetPathGuiding(pathGuiding))
+		if (ForwardPath* forwardIntegrator = dynamic_cast<ForwardPath*>(m_integrator.get()))
+			return forwardIntegrator->SetPathGuiding(pathGuiding);
+
+	return false;
+}
+
+bool CPURenderManager::SetLightCandidates(uint32_t candidates)
+{
+	if (RenderManager::SetLightCandidates(candidates))
+		if (ReSTIRDirect* restirIntegrator = dynamic_cast<ReSTIRDirect*>(m_integrator.get()))
+			return restirIntegrator->SetLightCandidates(candidates);
+
+	return false;
+}
+
+bool CPURenderManager::SetLightSampler(LightSamplerIds lightSamplerID)
+{
+	if (!RenderManager::SetLightSampler(lightSamplerID))
+		return false;
+
+	static_cast<CPUScene*>(m_scene)->SetLightSampler(lightSamplerID);
+	return true;
+}
+
 void CPURenderManager::InitialiseIntegrator(IntegratorIds integratorID)
 {
 	switch (m_renderGlobals.GetIntegrator())
@@ -105,7 +167,20 @@ void CPURenderManager::InitialiseIntegrator(IntegratorIds integratorID)
 			m_integrator = std::make_unique<Direct>(m_renderGlobals.GetMaxLightsSamples(), m_renderGlobals.GetMaxBSDFSamples(), m_renderGlobals.GetHideLights());
 			break;
 		case (IntegratorIds::kForwardPath):
-			m_integrator = std::make_unique<ForwardPath>(m_renderGlobals.GetMaxDepth(), m_renderGlobals.GetRussianRouletteDepth(), m_renderGlobals.GetHideLights());
+			m_integrator = std::make_unique<ForwardPath>(m_renderGlobals.GetMaxDepth(), m_renderGlobals.GetRussianRouletteDepth(), m_renderGlobals.GetHideLights(),
+					m_renderGlobals.GetPathGuiding());
+			break;
+		case (IntegratorIds::kReSTIRDirect):
+			m_integrator = std::make_unique<ReSTIRDirect>(m_renderGlobals.GetLightCandidates(), m_renderGlobals.GetHideLights());
+			break;
+		case (IntegratorIds::kBidirectional):
+			m_integrator = std::make_unique<Bidirectional>(m_renderGlobals.GetMaxDepth(), m_renderGlobals.GetHideLights());
+			break;
+		case (IntegratorIds::kLightTracer):
+			m_integrator = std::make_unique<LightTracer>(m_renderGlobals.GetMaxDepth(), m_renderGlobals.GetHideLights());
+			break;
+		case (IntegratorIds::kSPPM):
+			m_integrator = std::make_unique<SPPM>(m_renderGlobals.GetMaxDepth(), m_renderGlobals.GetHideLights());
 			break;
 	}
 }
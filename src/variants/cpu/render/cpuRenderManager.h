@@ -34,8 +34,15 @@ class CPURenderManager final : public RenderManager
 		virtual bool SetMaxBSDFSamples(uint32_t samples) override;
 		virtual bool SetMaxDepth(uint32_t depth) override;
 		virtual bool SetRussianRouletteDepth(uint32_t depth) override;
+		virtual bool SetLightSampler(LightSamplerIds lightSamplerID) override;
+		virtual bool SetPathGuiding(bool pathGuiding) override;
+		virtual bool SetLightCandidates(uint32_t candidates) override;
 
 	private:
+		virtual void IterationStarted() override  { m_integrator->BeginIteration(static_cast<CPUScene*>(m_scene), m_currentResolution); }
+		virtual void IterationFinished() override;
+		virtual void RenderReset() override       { m_integrator->Reset(); }
+
 		void InitialiseIntegrator(IntegratorIds integratorID);
 
 	private:
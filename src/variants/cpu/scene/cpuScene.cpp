@@ -1,9 +1,12 @@
 #include "cpuScene.h"
 
+#include <algorithm>
+
 #include "../geometry/cpuMesh.h"
 #include "../geometry/cpuCurve.h"
 
 #include "../lights/cpuConstant.h"
+#include "../lights/cpuEnvmap.h"
 #include "../lights/cpuPoint.h"
 
 #include <spindulys/math/linearspace3.h>
@@ -20,26 +23,54 @@ CPUScene::CPUScene()
 
 CPUScene::~CPUScene()
 {
+	m_pendingGeometry.clear();
+	m_sceneGeometry.clear();
+	m_pendingLights.clear();
+	m_lights.clear();
+
 	rtcReleaseScene(m_scene);
 	rtcReleaseDevice(m_device);
 }
 
-bool CPUScene::CreateGeomerty(Geometry* geom)
+void CPUScene::CommitScene()
+{
+	if (m_streaming)
+		return;
+
+	rtcCommitScene(m_scene);
+	UpdateSceneBounds();
+
+	if (m_lightsDirty)
+		UpdateLightSampler();
+	else
+		UpdateLightPowers();
+}
+
+unsigned int CPUScene::CreateGeomerty(Geometry* geom)
 {
-	bool success = true;
+	GeometryCreated();
 
+	std::shared_ptr<CPUGeometry> geometry;
+	bool committed = false;
 	switch(geom->GetGeometryType())
 	{
 		case Geometry::Mesh:
 		{
-			CPUMesh* mesh(new CPUMesh(dynamic_cast<Mesh*>(geom)));
-			success &= CommitGeometry(mesh);
+			std::shared_ptr<CPUMesh> mesh(std::make_shared<CPUMesh>(std::move(*dynamic_cast<Mesh*>(geom))));
+			if (!m_smoothNormals)
+				mesh->SetNormals(std::vector<Vec3f>());
+			if (m_optimizeLocality)
+				mesh->OptimizeLocality();
+			if (m_compactGeometry)
+				mesh->Compact();
+			committed = CommitMeshPrototype(mesh);
+			geometry = mesh;
 			break;
 		}
 		case Geometry::Curve:
 		{
-			CPUCurve* curve(new CPUCurve(dynamic_cast<Curve*>(geom)));
-			success &= CommitGeometry(curve);
+			geometry = std::make_shared<CPUCurve>(std::move(*dynamic_cast<Curve*>(geom)));
+			committed = geometry->CommitPrototype(m_device);
 			break;
 		}
 		default:
@@ -48,31 +79,316 @@ bool CPUScene::CreateGeomerty(Geometry* geom)
 
 	delete geom;
 
-	return success;
+	if (!committed)
+		return SPINDULYS_INVALID_GEOMETRY_ID;
+
+	// Ids are handed out up front so that loaders can refer to geometry which is still pending.
+	const unsigned int geomID = m_nextGeomID++;
+	if (m_streaming)
+	{
+		const std::lock_guard<std::mutex> lock(m_sceneMutex);
+		m_pendingGeometry.emplace_back(geomID, geometry);
+	}
+	else
+	{
+		CommitGeometry(geometry, geomID);
+	}
+
+	return geomID;
 }
 
-bool CPUScene::CommitGeometry(CPUGeometry* geometry)
+bool CPUScene::CommitMeshPrototype(const std::shared_ptr<CPUMesh>& mesh)
 {
-	if(!geometry->Create(m_device, m_scene))
+	// Deforming meshes change their points, so cannot share them.
+	if (mesh->IsDeforming())
+		return mesh->CommitPrototype(m_device);
+
+	const uint64_t hash = mesh->ContentHash();
+	std::shared_ptr<CPUMesh> prototype;
+	{
+		const std::lock_guard<std::mutex> lock(m_sceneMutex);
+		const auto found = m_meshPrototypes.find(hash);
+		if (found != m_meshPrototypes.end())
+			prototype = found->second.lock();
+	}
+
+	if (prototype && mesh->SameContent(*prototype))
+	{
+		GeometryShared(mesh->BufferSize());
+		mesh->SharePrototype(prototype);
+		return true;
+	}
+
+	if (!mesh->CommitPrototype(m_device))
 		return false;
 
-	m_sceneMutex.lock();
-	m_sceneGeometry[geometry->GetGeomInstanceID()] = std::unique_ptr<CPUGeometry>(geometry);
-	m_sceneMutex.unlock();
+	// Identical meshes loaded at the same time each build their own prototype, only the first is offered.
+	const std::lock_guard<std::mutex> lock(m_sceneMutex);
+	std::weak_ptr<CPUMesh>& offered = m_meshPrototypes[hash];
+	if (offered.expired())
+	{
+		offered = mesh;
+		mesh->SetContentHash(hash);
+	}
 
 	return true;
 }
 
-bool CPUScene::CreateLight(Light* light)
+bool CPUScene::UnsharePrototype(const std::shared_ptr<CPUGeometry>& geometry)
 {
-	if (!light)
+	if (geometry->IsShared() || geometry.use_count() > 1)
 		return false;
 
+	// Nothing shares it yet, so only stop offering it.
+	if (geometry->GetContentHash() != 0)
+	{
+		const std::lock_guard<std::mutex> lock(m_sceneMutex);
+		m_meshPrototypes.erase(geometry->GetContentHash());
+		geometry->SetContentHash(0);
+	}
+
+	return true;
+}
+
+bool CPUScene::UpdateGeometryTransform(unsigned int geomID, const AffineSpace3f& affine)
+{
+	const auto geometry = m_sceneGeometry.find(geomID);
+	if (geometry == m_sceneGeometry.end() || !geometry->second->UpdateTransform(affine))
+		return false;
+
+	if (CPUAreaLight* emitter = geometry->second->GetEmitter())
+	{
+		emitter->Update();
+		m_lightsDirty = true;
+	}
+
+	return true;
+}
+
+bool CPUScene::UpdateGeometryPoints(unsigned int geomID, const std::vector<Vec3f>& points)
+{
+	const auto geometry = m_sceneGeometry.find(geomID);
+	if (geometry == m_sceneGeometry.end() || !UnsharePrototype(geometry->second) || !geometry->second->UpdatePoints(points))
+		return false;
+
+	if (CPUAreaLight* emitter = geometry->second->GetEmitter())
+	{
+		emitter->Update();
+		m_lightsDirty = true;
+	}
+
+	return true;
+}
+
+bool CPUScene::UpdateGeometryNormals(unsigned int geomID, const std::vector<Vec3f>& normals)
+{
+	const auto geometry = m_sceneGeometry.find(geomID);
+	return geometry != m_sceneGeometry.end() && UnsharePrototype(geometry->second) && geometry->second->UpdateNormals(normals);
+}
+
+bool CPUScene::SetGeometryVisible(unsigned int geomID, bool visible)
+{
+	const auto geometry = m_sceneGeometry.find(geomID);
+	if (geometry == m_sceneGeometry.end() || !geometry->second->SetVisible(visible))
+		return false;
+
+	// Hidden geometry stops emitting.
+	if (geometry->second->GetEmitter())
+		m_lightsDirty = true;
+
+	return true;
+}
+
+bool CPUScene::RemoveGeometry(unsigned int geomID)
+{
+	const std::lock_guard<std::mutex> lock(m_sceneMutex);
+	const auto geometry = m_sceneGeometry.find(geomID);
+	if (geometry == m_sceneGeometry.end())
+		return false;
+
+	rtcDetachGeometry(m_scene, geomID);
+	RemoveEmitter(geometry->second);
+	m_sceneGeometry.erase(geometry);
+
+	return true;
+}
+
+void CPUScene::RemoveEmitter(const std::shared_ptr<CPUGeometry>& geometry)
+{
+	const CPUAreaLight* emitter = geometry->GetEmitter();
+	if (!emitter)
+		return;
+
+	geometry->SetEmitter(nullptr);
+	for (std::vector<std::unique_ptr<CPULight>>* lights : { &m_lights, &m_pendingLights })
+	{
+		const auto found = std::find_if(lights->begin(), lights->end(),
+				[emitter](const std::unique_ptr<CPULight>& light) { return light.get() == emitter; });
+		if (found != lights->end())
+			lights->erase(found);
+	}
+
+	m_lightsDirty = true;
+}
+
+void CPUScene::CommitGeometry(const std::shared_ptr<CPUGeometry>& geometry, unsigned int geomID)
+{
+	geometry->CreateInstance(m_device, m_scene, geomID);
+
+	// The emitter refers to the instance, so every instance of a shared prototype emits on its own.
+	if (geometry->IsLight())
+	{
+		if (const AreaLight* areaLight = dynamic_cast<const AreaLight*>(geometry->GetLight()))
+		{
+			auto emitter = std::make_unique<CPUAreaLight>(geometry.get(), areaLight->GetRadiance());
+			geometry->SetEmitter(emitter.get());
+			AddLight(std::move(emitter));
+		}
+		else
+		{
+			spdlog::warn("Only area lights can be attached to geometry, {} does not emit.", geometry->GetName());
+		}
+	}
+
 	m_sceneMutex.lock();
-	// m_lights.emplace_back(std::unique_ptr<CPULight>(light));
-	m_lightPMF = m_lights.empty() ? 0.f : (1.f / m_lights.size());
+	m_sceneGeometry[geomID] = geometry;
 	m_sceneMutex.unlock();
+}
+
+bool CPUScene::CommitPending()
+{
+	BASE_TRACE();
+	std::vector<std::pair<unsigned int, std::shared_ptr<CPUGeometry>>> pendingGeometry;
+	{
+		const std::lock_guard<std::mutex> lock(m_sceneMutex);
+		pendingGeometry.swap(m_pendingGeometry);
+	}
+
+	for (const auto& [geomID, geometry] : pendingGeometry)
+		CommitGeometry(geometry, geomID);
 
+	// Taken after the geometry, whose emitters join the pending lights as it is committed.
+	std::vector<std::unique_ptr<CPULight>> pendingLights;
+	{
+		// Held while committing, as loaders still record the ids of the lights they create.
+		const std::lock_guard<std::mutex> lock(m_sceneMutex);
+		pendingLights.swap(m_pendingLights);
+		for (std::unique_ptr<CPULight>& light : pendingLights)
+			CommitLight(std::move(light));
+	}
+
+	std::vector<std::pair<unsigned int, PortalLight>> pendingPortals;
+	{
+		const std::lock_guard<std::mutex> lock(m_sceneMutex);
+		pendingPortals.swap(m_pendingPortals);
+	}
+	for (const auto& [lightID, portal] : pendingPortals)
+	{
+		m_portals.Add(portal);
+		m_portalLights.emplace_back(lightID, portal);
+	}
+
+	const bool lightsChanged = !pendingLights.empty() || !pendingPortals.empty();
+	const bool updated = Scene::CommitPending() || !pendingGeometry.empty() || lightsChanged;
+
+	// Committed directly as CommitScene is skipped while streaming.
+	if (updated)
+	{
+		rtcCommitScene(m_scene);
+		UpdateSceneBounds();
+
+		if (lightsChanged)
+			UpdateLightSampler();
+		else
+			UpdateLightPowers();
+	}
+
+	return updated;
+}
+
+unsigned int CPUScene::CreateLight(Light* light)
+{
+	if (!light)
+		return SPINDULYS_INVALID_LIGHT_ID;
+
+	const unsigned int lightID = m_nextLightID++;
+
+	// Loaders create the base lights, which are turned into the ones which can be sampled here.
+	std::unique_ptr<CPULight> cpuLight;
+	if (CPULight* created = dynamic_cast<CPULight*>(light))
+	{
+		cpuLight.reset(created);
+		light = nullptr;
+	}
+	else if (const PointLight* point = dynamic_cast<const PointLight*>(light))
+	{
+		cpuLight = std::make_unique<CPUPointLight>(point->GetTransform(), point->GetIntensity());
+	}
+	else if (const ConstantLight* constant = dynamic_cast<const ConstantLight*>(light))
+	{
+		cpuLight = std::make_unique<CPUConstantLight>(constant->GetRadius(), constant->GetPoint(),
+				constant->GetSurfaceArea(), constant->GetRadiance());
+	}
+	else if (const EnvmapLight* envmap = dynamic_cast<const EnvmapLight*>(light))
+	{
+		cpuLight = std::make_unique<CPUEnvmapLight>(envmap->GetFilePath(), envmap->GetTransform(), envmap->GetScale());
+	}
+	else if (const PortalLight* portal = dynamic_cast<const PortalLight*>(light))
+	{
+		// Portals emit nothing, they only guide the lights at infinity.
+		AddPortal(*portal, lightID);
+		delete light;
+		return lightID;
+	}
+
+	delete light;
+
+	if (!cpuLight)
+	{
+		spdlog::warn("Unsupported light type, skipping it.");
+		return SPINDULYS_INVALID_LIGHT_ID;
+	}
+
+	AddLight(std::move(cpuLight), lightID);
+	return lightID;
+}
+
+bool CPUScene::RemoveLight(unsigned int lightID)
+{
+	const std::lock_guard<std::mutex> lock(m_sceneMutex);
+	const auto samePortal = [lightID](const std::pair<unsigned int, PortalLight>& portal) { return portal.first == lightID; };
+
+	if (const auto portal = std::find_if(m_pendingPortals.begin(), m_pendingPortals.end(), samePortal); portal != m_pendingPortals.end())
+	{
+		m_pendingPortals.erase(portal);
+		return true;
+	}
+
+	if (const auto portal = std::find_if(m_portalLights.begin(), m_portalLights.end(), samePortal); portal != m_portalLights.end())
+	{
+		m_portalLights.erase(portal);
+		RebuildPortals();
+		return true;
+	}
+
+	const auto found = m_lightIDs.find(lightID);
+	if (found == m_lightIDs.end())
+		return false;
+
+	const CPULight* light = found->second;
+	m_lightIDs.erase(found);
+	if (light == m_environment)
+		m_environment = nullptr;
+
+	for (std::vector<std::unique_ptr<CPULight>>* lights : { &m_lights, &m_pendingLights })
+	{
+		const auto removed = std::find_if(lights->begin(), lights->end(),
+				[light](const std::unique_ptr<CPULight>& other) { return other.get() == light; });
+		if (removed != lights->end())
+			lights->erase(removed);
+	}
+
+	m_lightsDirty = true;
 	return true;
 }
 
@@ -81,16 +397,139 @@ void CPUScene::CreateDefaultLight()
 	// Can only have one enivronment light.
 	assert(m_environment == nullptr);
 
-	m_environment = std::make_unique<CPUConstantLight>();
+	auto environment = std::make_unique<CPUConstantLight>();
 
 	// Reduce the light level of the environment light
-	if (auto constantLight = dynamic_cast<CPUConstantLight*>(m_environment.get()))
-		constantLight->SetRadiance(Col3f(0.1f));
+	environment->SetRadiance(Col3f(0.1f));
+
+	m_defaultLight = environment.get();
+	AddLight(std::move(environment));
+}
+
+void CPUScene::AddLight(std::unique_ptr<CPULight> light, unsigned int lightID)
+{
+	const std::lock_guard<std::mutex> lock(m_sceneMutex);
+	if (lightID != SPINDULYS_INVALID_LIGHT_ID)
+		m_lightIDs[lightID] = light.get();
+
+	if (m_streaming)
+		m_pendingLights.emplace_back(std::move(light));
+	else
+		CommitLight(std::move(light));
+}
+
+void CPUScene::AddPortal(const PortalLight& portal, unsigned int lightID)
+{
+	const std::lock_guard<std::mutex> lock(m_sceneMutex);
+	if (m_streaming)
+	{
+		m_pendingPortals.emplace_back(lightID, portal);
+	}
+	else
+	{
+		m_portals.Add(portal);
+		m_portalLights.emplace_back(lightID, portal);
+		m_lightsDirty = true;
+	}
+}
+
+void CPUScene::RebuildPortals()
+{
+	m_portals.Clear();
+	for (const auto& [lightID, portal] : m_portalLights)
+		m_portals.Add(portal);
+
+	m_lightsDirty = true;
+}
+
+void CPUScene::CommitLight(std::unique_ptr<CPULight> light)
+{
+	// Rays which miss the scene can only see one environment, which replaces the default light.
+	if (light->IsEnvironment())
+	{
+		if (m_environment && m_environment != m_defaultLight)
+		{
+			spdlog::warn("Only one environment light is supported, skipping the others.");
+			const auto found = std::find_if(m_lightIDs.begin(), m_lightIDs.end(),
+					[&light](const std::pair<const unsigned int, const CPULight*>& lightID) { return lightID.second == light.get(); });
+			if (found != m_lightIDs.end())
+				m_lightIDs.erase(found);
+			return;
+		}
 
-	// TODO: Fix this.
-	// m_lights.emplace_back(m_environment);
-	// m_lightPMF = m_lights.empty() ? 0.f : (1.f / m_lights.size());
-	m_lightPMF = 1.f;
+		if (m_environment)
+		{
+			m_lights.erase(std::find_if(m_lights.begin(), m_lights.end(),
+					[this](const std::unique_ptr<CPULight>& other) { return other.get() == m_environment; }));
+			m_defaultLight = nullptr;
+		}
+
+		m_environment = light.get();
+	}
+
+	m_lights.emplace_back(std::move(light));
+	m_lightsDirty = true;
+}
+
+bool CPUScene::SetLightSampler(LightSamplerIds lightSamplerID)
+{
+	if (lightSamplerID == std::exchange(m_lightSampler, lightSamplerID))
+		return false;
+
+	UpdateLightSampler();
+	return true;
+}
+
+void CPUScene::UpdateLightSampler()
+{
+	CPU_TRACE();
+	m_lightIndices.clear();
+	for (uint32_t lightIndex = 0; lightIndex < m_lights.size(); ++lightIndex)
+	{
+		m_lightIndices[m_lights[lightIndex].get()] = lightIndex;
+		m_lights[lightIndex]->SetPortals(m_portals);
+	}
+
+	if (m_lightSampler == LightSamplerIds::kBVH)
+		m_lightBVH.Build(m_lights);
+	else
+		m_lightBVH.Clear();
+
+	// The powers are compared against the last build, so are dropped to force a rebuild for the new lights.
+	m_lightPowers.clear();
+	m_lightPowerTable.Clear();
+	UpdateLightPowers();
+
+	m_lightsDirty = false;
+}
+
+void CPUScene::UpdateSceneBounds()
+{
+	RTCBounds rtcBounds;
+	rtcGetSceneBounds(m_scene, &rtcBounds);
+	m_sceneBounds = BBox3f(Vec3f(rtcBounds.lower_x, rtcBounds.lower_y, rtcBounds.lower_z),
+			Vec3f(rtcBounds.upper_x, rtcBounds.upper_y, rtcBounds.upper_z));
+}
+
+void CPUScene::UpdateLightPowers()
+{
+	for (const std::unique_ptr<CPULight>& light : m_lights)
+		light->SetSceneBounds(m_sceneBounds);
+
+	std::vector<float> lightPowers(m_lights.size());
+	for (uint32_t lightIndex = 0; lightIndex < m_lights.size(); ++lightIndex)
+		lightPowers[lightIndex] = m_lights[lightIndex]->GetPower();
+
+	if (lightPowers == m_lightPowers && !m_lightPowerTable.Empty())
+		return;
+
+	CPU_TRACE();
+	m_lightPowers.swap(lightPowers);
+	m_lightPowerTable.Build(m_lightPowers);
+
+	// Nothing emits anything measurable, so fall back to picking every light equally.
+	if (m_lightPowerTable.Empty() && !m_lights.empty())
+		m_lightPowerTable.Build(std::vector<float>(m_lights.size(), 1.f));
 }
 
 void CPUScene::ResetScene()
@@ -101,13 +540,24 @@ void CPUScene::ResetScene()
   rtcSetSceneFlags(m_scene, RTC_SCENE_FLAG_DYNAMIC);
 
 	m_sceneGeometry.clear();
+	m_pendingGeometry.clear();
+	m_meshPrototypes.clear();
+	m_nextGeomID = 0;
 	m_lights.clear();
-
-	// TODO: Remove once scenes have lights and automatically create an environment light if no lights
-	// CPUPointLight* l = new CPUPointLight(AffineSpace3f(one, Vec3f(-1.5f, 1.9f, -11.f)), Col3f(10.f, 14.f, 10.f));
-	// m_lights.emplace_back(l);
-
-	m_lightPMF = m_lights.empty() ? 0.f : (1.f / m_lights.size());
+	m_pendingLights.clear();
+	m_lightIndices.clear();
+	m_lightIDs.clear();
+	m_nextLightID = 0;
+	m_environment = nullptr;
+	m_defaultLight = nullptr;
+	m_portals.Clear();
+	m_portalLights.clear();
+	m_pendingPortals.clear();
+	m_lightBVH.Clear();
+	m_lightPowers.clear();
+	m_lightPowerTable.Clear();
+	m_lightsDirty = false;
+	m_sceneBounds = BBox3f(empty);
 
 	// Reset Parent scene stuff
 	Scene::ResetScene();
@@ -156,7 +606,7 @@ SurfaceInteraction CPUScene::RayIntersect(const Ray& ray) const
 		// Initialise preliminary intersection
 		pi.t = ray.tfar;
 		pi.instance = geom;
-		pi.shape = geom;
+		pi.shape = geom->GetShape();
 
 		pi.shapeIndex = shapeIndex;
 		pi.primIndex = primIndex;
@@ -169,8 +619,10 @@ SurfaceInteraction CPUScene::RayIntersect(const Ray& ray) const
 
 const CPULight* CPUScene::LightHit(const SurfaceInteraction& si, uint32_t active) const
 {
-	// TODO: Return shape light if hit that.
-	return si.IsValid() ? nullptr : GetEnvironment();
+	if (!si.IsValid())
+		return GetEnvironment();
+
+	return si.instance ? si.instance->GetEmitter() : nullptr;
 }
 
 
@@ -181,44 +633,28 @@ CPUScene::SampleLightDirection(const Interaction& ref, const Vec2f& sample_, boo
 	DirectionSample ds;
 	Col3f color(zero);
 
-	const size_t lightCount = m_lights.size();
-	if (lightCount > 1)
-	{
-		// Randomly pick an emitter
-		auto [index, lightWeight, resampledX] = SampleLight(sample.x, active);
-		sample.x = resampledX;
+	// Pick an emitter
+	const auto [index, lightWeight, resampledX] = SampleLight(ref, sample.x, active);
+	if (index == CPULightBVH::kInvalidLight)
+		return { ds, color };
+	sample.x = resampledX;
 
-		// Sample a direction towards the emitter
-		std::tie(ds, color) = m_lights[index]->SampleDirection(ref, sample, active);
+	// Sample a direction towards the emitter
+	std::tie(ds, color) = m_lights[index]->SampleDirection(ref, sample, active);
 
-		// Account for the discrete probability of sampling this emitter
-		ds.pdf *= PdfLight();
-		color *= lightWeight;
+	// Account for the discrete probability of sampling this emitter
+	ds.pdf /= lightWeight;
+	color *= lightWeight;
 
-		active &= ds.pdf != 0.f;
+	active &= ds.pdf != 0.f;
 
-		// Mark occluded samles as invalid if requested by the user
-		if (testVisibility && active)
-		{
-			if (RayTest(ref.SpawnRayTo(ds.p)))
-			{
-				color = zero;
-				ds.pdf = 0.f;
-			}
-		}
-	}
-	else if (lightCount == 1)
+	// Mark occluded samles as invalid if requested by the user
+	if (testVisibility && active)
 	{
-		std::tie(ds, color) = m_lights[0]->SampleDirection(ref, sample, active);
-		active &= ds.pdf != 0.f;
-
-		if (testVisibility && active)
+		if (RayTest(ref.SpawnRayTo(ds.p)))
 		{
-			if (RayTest(ref.SpawnRayTo(ds.p)))
-			{
-				color = zero;
-				ds.pdf = 0.f;
-			}
+			color = zero;
+			ds.pdf = 0.f;
 		}
 	}
 
@@ -227,18 +663,28 @@ CPUScene::SampleLightDirection(const Interaction& ref, const Vec2f& sample_, boo
 
 float CPUScene::PdfLightDirection(const Interaction& ref, const DirectionSample& ds, uint32_t active) const
 {
-	return ds.light->PdfDirection(ref, ds, active) * m_lightPMF;
+	return ds.light ? ds.light->PdfDirection(ref, ds, active) * PdfLight(ref, ds.light) : 0.f;
 }
 
 std::tuple<uint32_t, float, float>
-CPUScene::SampleLight(float indexSample, uint32_t active) const
+CPUScene::SampleLight(const Interaction& ref, float indexSample, uint32_t active) const
 {
-	if (unlikely(m_lights.size() < 2))
+	if (unlikely(m_lights.empty()))
+		return { CPULightBVH::kInvalidLight, 0.f, indexSample };
+
+	if (m_lightSampler == LightSamplerIds::kBVH)
 	{
-		if (m_lights.size() == 1)
-			return { size_t(0), 1.f, indexSample };
-		else
-			return { size_t(-1), 0.f, indexSample};
+		const auto [index, pmf] = m_lightBVH.Sample(ref.p, ref.n, indexSample);
+		return { index, pmf > 0.f ? 1.f / pmf : 0.f, indexSample };
+	}
+
+	if (m_lightSampler == LightSamplerIds::kPower)
+	{
+		float pmf = 0.f;
+		const uint32_t index = m_lightPowerTable.Sample(indexSample, &pmf, &indexSample);
+		if (index == AliasTable::kInvalidIndex)
+			return { CPULightBVH::kInvalidLight, 0.f, indexSample };
+		return { index, 1.f / pmf, indexSample };
 	}
 
 	const uint32_t lightCount = (uint32_t) m_lights.size();
@@ -248,7 +694,37 @@ CPUScene::SampleLight(float indexSample, uint32_t active) const
 	const uint32_t index = min(uint32_t(indexSampleScaled), lightCount - 1u);
 
 	return { index, lightCountf, indexSampleScaled - float(index) };
+}
+
+float CPUScene::PdfLight(const Interaction& ref, const CPULight* light) const
+{
+	const auto found = m_lightIndices.find(light);
+	if (found == m_lightIndices.end())
+		return 0.f;
 
+	if (m_lightSampler == LightSamplerIds::kBVH)
+		return m_lightBVH.Pmf(ref.p, ref.n, found->second);
+
+	if (m_lightSampler == LightSamplerIds::kPower)
+		return m_lightPowerTable.Pmf(found->second);
+
+	return 1.f / m_lights.size();
+}
+
+std::pair<const CPULight*, float> CPUScene::SampleEmitter(float sample) const
+{
+	float pmf = 0.f;
+	const uint32_t index = m_lightPowerTable.Sample(sample, &pmf);
+	if (index == AliasTable::kInvalidIndex)
+		return { nullptr, 0.f };
+
+	return { m_lights[index].get(), pmf };
+}
+
+float CPUScene::PdfEmitter(const CPULight* light) const
+{
+	const auto found = m_lightIndices.find(light);
+	return found != m_lightIndices.end() ? m_lightPowerTable.Pmf(found->second) : 0.f;
 }
 
 CPU_NAMESPACE_CLOSE_SCOPE
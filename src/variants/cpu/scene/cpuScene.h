@@ -4,15 +4,22 @@
 #include <embree3/rtcore.h>
 #include <embree3/rtcore_ray.h>
 
+#include <render/renderGlobals.h>
 #include <scene/scene.h>
 
 
+#include <spindulys/aliasTable.h>
+
 #include "../spindulysCPU.h"
 
 #include "../geometry/cpuGeometry.h"
+#include "../geometry/cpuMesh.h"
 
 #include "../lights/cpuLight.h"
 #include "../lights/cpuConstant.h"
+#include "../lights/cpuArea.h"
+#include "../lights/cpuLightBVH.h"
+#include "../lights/cpuPortals.h"
 
 #include "../bsdf/cpuBSDF.h"
 
@@ -28,15 +35,26 @@ class CPUScene final : public Scene
 		CPUScene();
 		~CPUScene();
 
-		virtual void CommitScene() override { rtcCommitScene(m_scene); }
-		virtual bool CreateGeomerty(Geometry* geom) override;
-		bool CommitGeometry(CPUGeometry* geometry);
+		// Loaders commit once they are done, which is left to CommitPending while streaming.
+		virtual void CommitScene() override;
+		virtual unsigned int CreateGeomerty(Geometry* geom) override;
+		virtual bool CommitPending() override;
+
+		virtual bool UpdateGeometryTransform(unsigned int geomID, const AffineSpace3f& affine) override;
+		virtual bool UpdateGeometryPoints(unsigned int geomID, const std::vector<Vec3f>& points) override;
+		virtual bool UpdateGeometryNormals(unsigned int geomID, const std::vector<Vec3f>& normals) override;
+		virtual bool SetGeometryVisible(unsigned int geomID, bool visible) override;
+		virtual bool RemoveGeometry(unsigned int geomID) override;
 
-		virtual bool CreateLight(Light* light) override;
+		virtual unsigned int CreateLight(Light* light) override;
+		virtual bool RemoveLight(unsigned int lightID) override;
 		virtual void CreateDefaultLight() override;
 
 		virtual int NumLights() const override { return m_lights.size(); }
 
+		// Rebuilds whatever the light sampler needs straight away, so must not be called while rendering.
+		bool SetLightSampler(LightSamplerIds lightSamplerID);
+
 		RTCScene GetScene() { return m_scene; }
 
 		virtual void ResetScene() override;
@@ -44,7 +62,8 @@ class CPUScene final : public Scene
 		// Get Methods
 		const CPUGeometry* GetGeometery(unsigned int geomInstanceID) const { return m_sceneGeometry.at(geomInstanceID).get(); }
 		const CPULight*    GetLight(uint32_t lightIndex)             const { return m_lights[lightIndex].get(); }
-		const CPULight*    GetEnvironment()                          const { return m_environment.get(); }
+		const CPULight*    GetEnvironment()                          const { return m_environment;       }
+		const BBox3f&      GetSceneBounds()                          const { return m_sceneBounds;       }
 
 		bool               RayTest(const Ray& ray) const;
 		SurfaceInteraction RayIntersect(const Ray& ray) const;
@@ -56,22 +75,80 @@ class CPUScene final : public Scene
 
 		float PdfLightDirection(const Interaction& ref, const DirectionSample& ds, uint32_t active) const;
 
+		// Pick a light for the reference point. Returns its index, the inverse of the probability of picking it
+		// and the index sample remapped so that it can be reused. The index is CPULightBVH::kInvalidLight if none was picked.
 		std::tuple<uint32_t, float, float>
-		SampleLight(float indexSample, uint32_t active) const;
+		SampleLight(const Interaction& ref, float indexSample, uint32_t active) const;
+
+		// The probability of SampleLight picking the light for the reference point.
+		float PdfLight(const Interaction& ref, const CPULight* light) const;
 
-		float PdfLight() const { return m_lightPMF; }
+		// Pick a light to trace a path from in proportion to its power, whichever light sampler is used for
+		// the reference points. Returns null if there are no lights.
+		std::pair<const CPULight*, float> SampleEmitter(float sample) const;
+		float PdfEmitter(const CPULight* light) const;
+
+	private:
+		void CommitGeometry(const std::shared_ptr<CPUGeometry>& geometry, unsigned int geomID);
+		// Share the prototype of an identical mesh if one exists, otherwise build the prototype and offer it for sharing.
+		bool CommitMeshPrototype(const std::shared_ptr<CPUMesh>& mesh);
+		// Geometry which shares its prototype cannot change it in place, so is recreated instead.
+		bool UnsharePrototype(const std::shared_ptr<CPUGeometry>& geometry);
+
+		// Lights are held back like geometry while streaming.
+		void AddLight(std::unique_ptr<CPULight> light, unsigned int lightID = SPINDULYS_INVALID_LIGHT_ID);
+		// Portals are held back like lights while streaming.
+		void AddPortal(const PortalLight& portal, unsigned int lightID);
+		// Moves the light into the scene, keeping to a single environment.
+		void CommitLight(std::unique_ptr<CPULight> light);
+		// Portals are not kept apart, so removing one builds the rest again.
+		void RebuildPortals();
+		// Geometry with an area light attached emits from its surface. Must be called with the scene mutex held.
+		void RemoveEmitter(const std::shared_ptr<CPUGeometry>& geometry);
+		void UpdateLightSampler();
+		// Embree only has bounds for a committed scene, so they are kept from the last commit.
+		void UpdateSceneBounds();
+		// Lights at infinity are sized to the scene, which changes how much power they emit.
+		// The alias table is only rebuilt when the power of any light has changed. It is kept up to date whichever
+		// light sampler is used, as paths traced from the lights pick them by power.
+		void UpdateLightPowers();
 
 	private:
 		RTCDevice m_device = nullptr;
 		RTCScene m_scene = nullptr; // Contains the instanced (single or not) geometry objects. This is the scene we are tracing against.
 
-		std::unordered_map<unsigned int, std::unique_ptr<CPUGeometry>> m_sceneGeometry;
+		// Shared as duplicate geometry keeps the geometry it instances alive.
+		std::unordered_map<unsigned int, std::shared_ptr<CPUGeometry>> m_sceneGeometry;
+		// Geometry with a finished prototype waiting to be instanced into the scene.
+		std::vector<std::pair<unsigned int, std::shared_ptr<CPUGeometry>>> m_pendingGeometry;
+		// Meshes offered for sharing by their content hash.
+		std::unordered_map<uint64_t, std::weak_ptr<CPUMesh>> m_meshPrototypes;
+		std::atomic<unsigned int> m_nextGeomID = 0;
 
 		std::vector<std::unique_ptr<CPULight>> m_lights;
-
-		std::unique_ptr<CPULight> m_environment;
-
-		float m_lightPMF = m_lights.empty() ? 0.f : (1.f / m_lights.size());
+		std::vector<std::unique_ptr<CPULight>> m_pendingLights;
+		std::unordered_map<const CPULight*, uint32_t> m_lightIndices;
+
+		// Also one of m_lights.
+		const CPULight* m_environment = nullptr;
+		// Made up for a scene without lights, so its own environment takes over from it.
+		const CPULight* m_defaultLight = nullptr;
+		// Lights made by CreateLight by their id, which portals are kept by along with their light.
+		std::unordered_map<unsigned int, const CPULight*> m_lightIDs;
+		std::atomic<unsigned int> m_nextLightID = 0;
+		// Given to every light, though only the ones at infinity sample through them.
+		CPUPortals m_portals;
+		std::vector<std::pair<unsigned int, PortalLight>> m_portalLights;
+		std::vector<std::pair<unsigned int, PortalLight>> m_pendingPortals;
+
+		LightSamplerIds m_lightSampler = LightSamplerIds::kBVH;
+		CPULightBVH m_lightBVH;
+		// The power of each light, which the alias table was built from.
+		std::vector<float> m_lightPowers;
+		AliasTable m_lightPowerTable;
+		// Set by geometry updates, which the animators apply in parallel.
+		std::atomic<bool> m_lightsDirty = false;
+		BBox3f m_sceneBounds = BBox3f(empty);
 };
 
 CPU_NAMESPACE_CLOSE_SCOPE
@@ -199,8 +199,10 @@ struct PreliminaryIntersection
 			return si;
 		}
 
-		const CPUGeometry* target = instance ? instance : shape;
-		SurfaceInteraction si = target->ComputeSurfaceInteraction(ray, *this, rayFlags, 0u, active);
+		// The shape is in the local space of the prototype, which the instance moves into place.
+		SurfaceInteraction si = shape->ComputeSurfaceInteraction(ray, *this, rayFlags, 0u, active);
+		if (instance)
+			instance->ComputeInstanceSurfaceInteraction(si, ray);
 
 		si.t = active ? si.t : Infinity<float>;
 		active &= si.IsValid();
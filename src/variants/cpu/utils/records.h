@@ -51,6 +51,9 @@ struct PositionSample
 	/// Set if the sample was drawn from a degenerate (Dirac delta) distribution
 	uint32_t delta = false;
 
+	/// Index of the primitive the position lies on (if applicable)
+	unsigned int primID = SPINDULYS_INVALID_GEOMETRY_ID;
+
 	/**
 	 * \brief Create a position sampling record from a surface intersection
 	 *
@@ -62,7 +65,7 @@ struct PositionSample
 
 	PositionSample(const SurfaceInteraction& si)
 		: p(si.p), n(si.shadingFrame.vz), uv(si.uv), time(si.time), pdf(0.f),
-		delta(false) { }
+		delta(false), primID(si.primID) { }
 
 	/// Basic field constructor
 	PositionSample(const Vec3f& p, const Vec3f& n, const Vec2f& uv,
@@ -129,6 +132,28 @@ struct DirectionSample : public PositionSample
 
 // -----------------------------------------------------------------------------
 
+/**
+ * \brief Record for sampling rays leaving an emitter
+ *
+ * Used to trace paths starting from the lights. The inherited density is over
+ * the area of the light, or of the disk that rays from lights at infinity
+ * start on, and the direction has its own density over solid angle.
+ */
+struct EmissionSample : public PositionSample
+{
+	/// Unit direction the ray leaves in
+	Vec3f d = zero;
+
+	/// Density of the direction over solid angle, one if the light only emits in a single direction
+	float pdfDirection = zero;
+
+	const CPULight* light = nullptr;
+
+	EmissionSample() = default;
+};
+
+// -----------------------------------------------------------------------------
+
 MAYBE_UNUSED static std::ostream &operator<<(std::ostream& os, const PositionSample& ps)
 {
 	return os << "{ "